@@ -27,7 +27,10 @@ namespace analysis {
 
 class OpCountAnalysis {
 public:
-  OpCountAnalysis(Operation *moduleOp, mlir::AnalysisManager &am);
+  OpCountAnalysis(Operation *moduleOp, mlir::AnalysisManager &am)
+      : OpCountAnalysis(moduleOp) {}
+  /// Count the operations outside of an analysis manager.
+  explicit OpCountAnalysis(Operation *moduleOp);
 
   /// Get the frequency of operations of a specific name
   size_t getOpCount(OperationName opName);
@@ -36,7 +36,8 @@ std::unique_ptr<mlir::Pass> createExportVerilogPass(llvm::raw_ostream &os);
 std::unique_ptr<mlir::Pass> createExportVerilogPass();
 
 std::unique_ptr<mlir::Pass>
-createExportSplitVerilogPass(llvm::StringRef directory = "./");
+createExportSplitVerilogPass(llvm::StringRef directory = "./",
+                             bool writeIfChanged = false);
 
 /// Export a module containing HW, and SV dialect code. Requires that the SV
 /// dialect is loaded in to the context.
@@ -29,7 +29,8 @@ namespace arc {
 
 std::unique_ptr<mlir::Pass>
 createAddTapsPass(const AddTapsOptions &options = {});
-std::unique_ptr<mlir::Pass> createAllocateStatePass();
+std::unique_ptr<mlir::Pass>
+createAllocateStatePass(const AllocateStateOptions &options = {});
 std::unique_ptr<mlir::Pass> createArcCanonicalizerPass();
 std::unique_ptr<mlir::Pass> createDedupPass();
 std::unique_ptr<mlir::Pass> createFindInitialVectorsPass();
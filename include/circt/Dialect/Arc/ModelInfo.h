@@ -16,6 +16,7 @@
 #include "mlir/IR/BuiltinOps.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/raw_ostream.h"
+#include <optional>
 #include <string>
 
 namespace circt {
@@ -29,6 +30,8 @@ struct StateInfo {
   unsigned numBits;
   unsigned memoryStride = 0; // byte separation between memory words
   unsigned memoryDepth = 0;  // number of words in a memory
+  /// Offset of a flag set whenever the state is written, if any.
+  std::optional<unsigned> dirtyOffset;
 };
 
 /// Gathers information about a given Arc model.
@@ -38,14 +41,20 @@ struct ModelInfo {
   llvm::SmallVector<StateInfo> states;
   mlir::FlatSymbolRefAttr initialFnSym;
   mlir::FlatSymbolRefAttr finalFnSym;
+  /// Phases of eval partition functions; see `ModelOp`'s `partitions`.
+  mlir::ArrayAttr evalPartitions;
+  /// Number of instances simulated in lock-step; see `ModelOp`'s `lanes`.
+  unsigned numLanes;
 
   ModelInfo(std::string name, size_t numStateBytes,
             llvm::SmallVector<StateInfo> states,
             mlir::FlatSymbolRefAttr initialFnSym,
-            mlir::FlatSymbolRefAttr finalFnSym)
+            mlir::FlatSymbolRefAttr finalFnSym,
+            mlir::ArrayAttr evalPartitions = {}, unsigned numLanes = 1)
       : name(std::move(name)), numStateBytes(numStateBytes),
         states(std::move(states)), initialFnSym(initialFnSym),
-        finalFnSym(finalFnSym) {}
+        finalFnSym(finalFnSym), evalPartitions(evalPartitions),
+        numLanes(numLanes) {}
 };
 
 /// Collects information about states within the provided Arc model storage
@@ -0,0 +1,61 @@
+//===- FieldLayoutCache.h - Aggregate field layout cache --------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares FieldLayoutCache, a thread-safe cache of the fields of
+// bundle and vector types, as seen when a lowering peels off their outer layer.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_FIRRTL_FIELDLAYOUTCACHE_H
+#define CIRCT_DIALECT_FIRRTL_FIELDLAYOUTCACHE_H
+
+#include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
+#include "circt/Support/LLVM.h"
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+
+namespace circt {
+namespace firrtl {
+
+/// One field of a bundle or vector type.
+struct FieldLayoutEntry {
+  /// The type of the field.
+  FIRRTLBaseType type;
+  /// The index of the field in the aggregate.
+  size_t index;
+  /// The field ID of the field, relative to the aggregate.
+  uint64_t fieldID;
+  /// The suffix which lowerings append to the name of the aggregate to name
+  /// the field: "_" followed by the bundle field name or the vector index.
+  std::string suffix;
+  /// Whether the field is flipped with respect to the aggregate.
+  bool isFlip;
+};
+
+/// Caches the fields of bundle and vector types, such that passes which lower
+/// the same large aggregate types in many modules compute and allocate them
+/// once. The cache can be shared by all the threads of a pass.
+class FieldLayoutCache {
+public:
+  /// Get the fields of a bundle or vector type, in order. Returns an empty
+  /// array for all other types. The fields remain valid for the lifetime of
+  /// the cache.
+  ArrayRef<FieldLayoutEntry> getFields(FIRRTLBaseType type);
+
+private:
+  using Layout = SmallVector<FieldLayoutEntry, 0>;
+  std::shared_mutex mutex;
+  DenseMap<Type, std::unique_ptr<Layout>> layouts;
+};
+
+} // namespace firrtl
+} // namespace circt
+
+#endif // CIRCT_DIALECT_FIRRTL_FIELDLAYOUTCACHE_H
@@ -33,6 +33,18 @@ bool importAnnotationsFromJSONRaw(llvm::json::Value &value,
                                   SmallVectorImpl<Attribute> &annotations,
                                   llvm::json::Path path, MLIRContext *context);
 
+/// Deserialize JSON text into FIRRTL Annotations, appending them to
+/// `annotations`.  This is equivalent to parsing the text with llvm::json and
+/// calling importAnnotationsFromJSONRaw, but converts the text directly to
+/// attributes without building a JSON DOM, and converts the annotations in
+/// parallel if the context has multithreading enabled.  No diagnostics are
+/// produced: returns false, without changing `annotations`, if the text is
+/// malformed or is not an array of objects.  Callers should then use
+/// importAnnotationsFromJSONRaw to report the problem.
+bool importAnnotationsFromJSONString(StringRef text,
+                                     SmallVectorImpl<Attribute> &annotations,
+                                     MLIRContext *context);
+
 } // namespace firrtl
 } // namespace circt
 
@@ -145,6 +145,8 @@ public:
 
   bool shouldInlineInputOnlyModules() const { return inlineInputOnlyModules; }
 
+  bool shouldWriteIfChanged() const { return writeIfChanged; }
+
   // Setters, used by the CAPI
   FirtoolOptions &setOutputFilename(StringRef name) {
     outputFilename = name;
@@ -399,6 +401,11 @@ public:
     return *this;
   }
 
+  FirtoolOptions &setWriteIfChanged(bool value) {
+    writeIfChanged = value;
+    return *this;
+  }
+
 private:
   std::string outputFilename;
 
@@ -454,6 +461,7 @@ private:
   bool lintXmrsInDesign;
   bool emitAllBindFiles;
   bool inlineInputOnlyModules;
+  bool writeIfChanged;
 };
 
 void registerFirtoolCLOptions();
@@ -0,0 +1,104 @@
+//===- PassReport.h - Per-pass resource report ------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pass instrumentation which records the resources used by
+// each pass of a pipeline, and checks them against per-pass budgets.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_FIRTOOL_PASSREPORT_H
+#define CIRCT_FIRTOOL_PASSREPORT_H
+
+#include "circt/Support/LLVM.h"
+#include "mlir/Pass/PassInstrumentation.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+
+#include <chrono>
+#include <functional>
+#include <optional>
+
+namespace circt {
+namespace firtool {
+
+/// The resources a pass may use. Unset limits are not checked.
+struct PassBudget {
+  /// Wall time in seconds.
+  std::optional<double> wallTime;
+  /// CPU time across all threads in seconds.
+  std::optional<double> cpuTime;
+  /// Growth of the peak resident set size of the process in bytes.
+  std::optional<uint64_t> peakRSSDelta;
+};
+
+/// Budgets keyed by pass argument, e.g. "firrtl-lower-types".
+using PassBudgets = llvm::StringMap<PassBudget>;
+
+/// Parse budgets from JSON of the form
+///
+///   { "firrtl-infer-widths": { "wall_time": 10.0, "peak_rss_delta": 1e9 } }
+///
+/// where each pass may have a "wall_time", "cpu_time" and "peak_rss_delta".
+llvm::Expected<PassBudgets> parsePassBudgets(StringRef json);
+
+/// Record the wall time, the CPU time of all threads, the growth of the peak
+/// RSS and the number of operations before and after each pass that runs on an
+/// operation accepted by the filter. Passes which run on many operations in
+/// parallel, like the ones nested under a module, should be filtered out: they
+/// are accounted for by the pass adaptor which runs them.
+class PassReportInstrumentation : public mlir::PassInstrumentation {
+public:
+  using Filter = std::function<bool(Operation *)>;
+  PassReportInstrumentation(Filter filter) : filter(std::move(filter)) {}
+
+  struct Record {
+    /// The pass argument, or the pass name if it has none.
+    std::string name;
+    /// The number of recorded passes this one is nested in.
+    unsigned depth;
+    double wallTime;
+    double cpuTime;
+    uint64_t peakRSSDelta;
+    size_t opsBefore;
+    size_t opsAfter;
+    bool failed;
+  };
+
+  void runBeforePass(Pass *pass, Operation *op) override;
+  void runAfterPass(Pass *pass, Operation *op) override;
+  void runAfterPassFailed(Pass *pass, Operation *op) override;
+
+  /// Get the records in the order the passes finished.
+  ArrayRef<Record> getRecords() const { return records; }
+
+  /// Write the records as JSON.
+  void writeJSON(raw_ostream &os) const;
+
+  /// Check the records against the budgets, and report every pass which
+  /// exceeded its budget as an error on `op`.
+  LogicalResult checkBudgets(const PassBudgets &budgets, Operation *op) const;
+
+private:
+  void finishPass(Pass *pass, Operation *op, bool failed);
+
+  struct Start {
+    std::chrono::steady_clock::time_point wallTime;
+    std::chrono::nanoseconds cpuTime;
+    uint64_t peakRSS;
+    size_t ops;
+  };
+
+  Filter filter;
+  SmallVector<Start> running;
+  std::vector<Record> records;
+};
+
+} // namespace firtool
+} // namespace circt
+
+#endif // CIRCT_FIRTOOL_PASSREPORT_H
@@ -77,6 +77,11 @@ struct ArcOptimizationOptions
   Option<bool> shouldMakeLUTs{
       *this, "lookup-tables",
       llvm::cl::desc("Optimize arcs into lookup tables"), llvm::cl::init(true)};
+
+  Option<bool> shouldSkipUnchanged{
+      *this, "skip-unchanged-states",
+      llvm::cl::desc("Only update states when their inputs have changed"),
+      llvm::cl::init(false)};
 };
 void populateArcOptimizationPipeline(
     mlir::OpPassManager &pm, const ArcOptimizationOptions &options = {});
@@ -98,6 +103,23 @@ struct ArcStateAllocationOptions
       llvm::cl::desc("Split large MLIR functions that occur above the given "
                      "size threshold"),
       llvm::cl::ValueOptional};
+
+  Option<unsigned> numEvalPartitions{
+      *this, "eval-partitions",
+      llvm::cl::desc("Split the model evaluation into up to the given number "
+                     "of concurrently executable partitions"),
+      llvm::cl::init(0)};
+
+  Option<bool> dirtyFlags{
+      *this, "dirty-flags",
+      llvm::cl::desc("Track writes to observable states in dirty flags"),
+      llvm::cl::init(false)};
+
+  Option<unsigned> numLanes{
+      *this, "lanes",
+      llvm::cl::desc("Simulate the given number of model instances in "
+                     "lock-step"),
+      llvm::cl::init(0)};
 };
 void populateArcStateAllocationPipeline(
     mlir::OpPassManager &pm, const ArcStateAllocationOptions &options = {});
@@ -9,6 +9,7 @@
 // Test ESI utils
 // RUN: esiquery trace w:%t6/hw/esi_system_manifest.json info | FileCheck %s --check-prefix=QUERY-INFO
 // RUN: esiquery trace w:%t6/hw/esi_system_manifest.json hier | FileCheck %s --check-prefix=QUERY-HIER
+// RUN: esiquery --metrics trace w:%t6/hw/esi_system_manifest.json info | FileCheck %s --check-prefix=QUERY-METRICS
 
 // Test cosimulation
 // RUN: cp %esi_prims %t6/hw
@@ -128,6 +129,10 @@ hw.module @top(in %clk: !seq.clock, in %rst: i1) {
 
 // CPP-TEST: depth: 0x5
 
+// QUERY-METRICS: API version: 0
+// QUERY-METRICS: * Module information
+// QUERY-METRICS: {{^[{].*[}]$}}
+
 // QUERY-INFO: API version: 0
 // QUERY-INFO: ********************************
 // QUERY-INFO: * Module information
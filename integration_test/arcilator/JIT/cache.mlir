@@ -0,0 +1,72 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: arcilator %s --run --jit-entry=main --jit-cache=%t/cache --jit-report=%t/first.json | FileCheck %s
+// RUN: FileCheck %s --check-prefix=FIRST < %t/first.json
+// RUN: arcilator %s --run --jit-entry=main --jit-cache=%t/cache --jit-report=%t/second.json --state-file=%t/second-state.json | FileCheck %s
+// RUN: FileCheck %s --check-prefix=SECOND < %t/second.json
+// RUN: FileCheck %s --check-prefix=STATE < %t/second-state.json
+// RUN: arcilator %s --run --jit-entry=main --jit-cache=%t/cache --jit-report=%t/inspected.json --mlir-print-ir-after=arc-lower-state 2>&1 | FileCheck %s --check-prefix=INSPECTED
+// RUN: FileCheck %s --check-prefix=INSPECTED-REPORT < %t/inspected.json
+// RUN: not arcilator %s --run --jit-entry=main --jit-cache=%t/cache --until-before=llvm-lowering 2>&1 | FileCheck %s --check-prefix=UNTIL
+// RUN: sed -e 's/%ub = arith.constant 10/%ub = arith.constant 4/' %s > %t/changed.mlir
+// RUN: arcilator %t/changed.mlir --run --jit-entry=main --jit-cache=%t/cache --jit-report=%t/changed.json | FileCheck %s --check-prefix=CHANGED
+// RUN: FileCheck %s --check-prefix=INCREMENTAL < %t/changed.json
+// RUN: arcilator %s --run --jit-entry=main --jit-cache=%t/cache --jit-report=%t/options.json --observe-wires | FileCheck %s
+// RUN: FileCheck %s --check-prefix=OPTIONS < %t/options.json
+// REQUIRES: arcilator-jit
+
+// CHECK: counter_value = 0a
+// CHANGED: counter_value = 04
+
+// FIRST: "hit": false
+// FIRST-NEXT: "compiledFunctions": {{[1-9][0-9]*}}
+// FIRST-NEXT: "cachedFunctions": 0
+
+// A hit reports the models and writes the state file as if the pipeline ran.
+// SECOND:      "name": "counter"
+// SECOND-NEXT: "numStateBytes": {{[1-9][0-9]*}}
+// SECOND:      "hit": true
+// STATE:       "name": "counter"
+// STATE:       "numStateBytes": {{[1-9][0-9]*}}
+
+// Options that inspect the pipeline bypass the program cache.
+// INSPECTED: IR Dump After
+// INSPECTED: counter_value = 0a
+// INSPECTED-REPORT: "hit": false
+// UNTIL: full pipeline must be run for JIT execution
+
+// Only the functions affected by the change are recompiled.
+// INCREMENTAL: "hit": false
+// INCREMENTAL-NEXT: "compiledFunctions": {{[1-9][0-9]*}}
+// INCREMENTAL-NEXT: "cachedFunctions": {{[1-9][0-9]*}}
+
+// Options that affect compilation are part of the program key.
+// OPTIONS: "hit": false
+
+hw.module @counter(in %clk: i1, out o: i8) {
+  %seq_clk = seq.to_clock %clk
+  %reg = seq.compreg %added, %seq_clk : i8
+  %one = hw.constant 1 : i8
+  %added = comb.add %reg, %one : i8
+  hw.output %reg : i8
+}
+
+func.func @main() {
+  %zero = arith.constant 0 : i1
+  %one = arith.constant 1 : i1
+  %lb = arith.constant 0 : index
+  %ub = arith.constant 10 : index
+  %step = arith.constant 1 : index
+
+  arc.sim.instantiate @counter as %model {
+    scf.for %i = %lb to %ub step %step {
+      arc.sim.set_input %model, "clk" = %one : i1, !arc.sim.instance<@counter>
+      arc.sim.step %model : !arc.sim.instance<@counter>
+      arc.sim.set_input %model, "clk" = %zero : i1, !arc.sim.instance<@counter>
+      arc.sim.step %model : !arc.sim.instance<@counter>
+    }
+    %counter_val = arc.sim.get_port %model, "o" : i8, !arc.sim.instance<@counter>
+    arc.sim.emit "counter_value", %counter_val : i8
+  }
+
+  return
+}
@@ -0,0 +1,125 @@
+// RUN: arcilator %s --run --jit-entry=main --args=64 | FileCheck %s
+// REQUIRES: arcilator-jit
+
+// A farm of counters where counter N only counts every 2^(N+1) cycles. Most
+// counters are idle most of the time, which makes this representative of
+// designs with sparse activity.
+
+// CHECK: checksum = 0000003f
+
+hw.module @Counter(in %clk: !seq.clock, in %en: i1, in %inc: i32, out count: i32) {
+  %count = seq.compreg %next, %clk : i32
+  %sum = comb.add %count, %inc : i32
+  %next = comb.mux %en, %sum, %count : i32
+  hw.output %count : i32
+}
+
+hw.module @CounterFarm(in %clk: i1, out checksum: i32) {
+  %seq_clk = seq.to_clock %clk
+  %c1_i16 = hw.constant 1 : i16
+  %tick = seq.compreg %tickNext, %seq_clk : i16
+  %tickNext = comb.add %tick, %c1_i16 : i16
+  %low0 = comb.extract %tick from 0 : (i16) -> i1
+  %c0_i1 = hw.constant 0 : i1
+  %en0 = comb.icmp eq %low0, %c0_i1 : i1
+  %inc0 = hw.constant 1 : i32
+  %cnt0 = hw.instance "counter0" @Counter(clk: %seq_clk: !seq.clock, en: %en0: i1, inc: %inc0: i32) -> (count: i32)
+  %low1 = comb.extract %tick from 0 : (i16) -> i2
+  %c0_i2 = hw.constant 0 : i2
+  %en1 = comb.icmp eq %low1, %c0_i2 : i2
+  %inc1 = hw.constant 3 : i32
+  %cnt1 = hw.instance "counter1" @Counter(clk: %seq_clk: !seq.clock, en: %en1: i1, inc: %inc1: i32) -> (count: i32)
+  %low2 = comb.extract %tick from 0 : (i16) -> i3
+  %c0_i3 = hw.constant 0 : i3
+  %en2 = comb.icmp eq %low2, %c0_i3 : i3
+  %inc2 = hw.constant 5 : i32
+  %cnt2 = hw.instance "counter2" @Counter(clk: %seq_clk: !seq.clock, en: %en2: i1, inc: %inc2: i32) -> (count: i32)
+  %low3 = comb.extract %tick from 0 : (i16) -> i4
+  %c0_i4 = hw.constant 0 : i4
+  %en3 = comb.icmp eq %low3, %c0_i4 : i4
+  %inc3 = hw.constant 7 : i32
+  %cnt3 = hw.instance "counter3" @Counter(clk: %seq_clk: !seq.clock, en: %en3: i1, inc: %inc3: i32) -> (count: i32)
+  %low4 = comb.extract %tick from 0 : (i16) -> i5
+  %c0_i5 = hw.constant 0 : i5
+  %en4 = comb.icmp eq %low4, %c0_i5 : i5
+  %inc4 = hw.constant 9 : i32
+  %cnt4 = hw.instance "counter4" @Counter(clk: %seq_clk: !seq.clock, en: %en4: i1, inc: %inc4: i32) -> (count: i32)
+  %low5 = comb.extract %tick from 0 : (i16) -> i6
+  %c0_i6 = hw.constant 0 : i6
+  %en5 = comb.icmp eq %low5, %c0_i6 : i6
+  %inc5 = hw.constant 11 : i32
+  %cnt5 = hw.instance "counter5" @Counter(clk: %seq_clk: !seq.clock, en: %en5: i1, inc: %inc5: i32) -> (count: i32)
+  %low6 = comb.extract %tick from 0 : (i16) -> i7
+  %c0_i7 = hw.constant 0 : i7
+  %en6 = comb.icmp eq %low6, %c0_i7 : i7
+  %inc6 = hw.constant 13 : i32
+  %cnt6 = hw.instance "counter6" @Counter(clk: %seq_clk: !seq.clock, en: %en6: i1, inc: %inc6: i32) -> (count: i32)
+  %low7 = comb.extract %tick from 0 : (i16) -> i8
+  %c0_i8 = hw.constant 0 : i8
+  %en7 = comb.icmp eq %low7, %c0_i8 : i8
+  %inc7 = hw.constant 15 : i32
+  %cnt7 = hw.instance "counter7" @Counter(clk: %seq_clk: !seq.clock, en: %en7: i1, inc: %inc7: i32) -> (count: i32)
+  %low8 = comb.extract %tick from 0 : (i16) -> i9
+  %c0_i9 = hw.constant 0 : i9
+  %en8 = comb.icmp eq %low8, %c0_i9 : i9
+  %inc8 = hw.constant 17 : i32
+  %cnt8 = hw.instance "counter8" @Counter(clk: %seq_clk: !seq.clock, en: %en8: i1, inc: %inc8: i32) -> (count: i32)
+  %low9 = comb.extract %tick from 0 : (i16) -> i10
+  %c0_i10 = hw.constant 0 : i10
+  %en9 = comb.icmp eq %low9, %c0_i10 : i10
+  %inc9 = hw.constant 19 : i32
+  %cnt9 = hw.instance "counter9" @Counter(clk: %seq_clk: !seq.clock, en: %en9: i1, inc: %inc9: i32) -> (count: i32)
+  %low10 = comb.extract %tick from 0 : (i16) -> i11
+  %c0_i11 = hw.constant 0 : i11
+  %en10 = comb.icmp eq %low10, %c0_i11 : i11
+  %inc10 = hw.constant 21 : i32
+  %cnt10 = hw.instance "counter10" @Counter(clk: %seq_clk: !seq.clock, en: %en10: i1, inc: %inc10: i32) -> (count: i32)
+  %low11 = comb.extract %tick from 0 : (i16) -> i12
+  %c0_i12 = hw.constant 0 : i12
+  %en11 = comb.icmp eq %low11, %c0_i12 : i12
+  %inc11 = hw.constant 23 : i32
+  %cnt11 = hw.instance "counter11" @Counter(clk: %seq_clk: !seq.clock, en: %en11: i1, inc: %inc11: i32) -> (count: i32)
+  %low12 = comb.extract %tick from 0 : (i16) -> i13
+  %c0_i13 = hw.constant 0 : i13
+  %en12 = comb.icmp eq %low12, %c0_i13 : i13
+  %inc12 = hw.constant 25 : i32
+  %cnt12 = hw.instance "counter12" @Counter(clk: %seq_clk: !seq.clock, en: %en12: i1, inc: %inc12: i32) -> (count: i32)
+  %low13 = comb.extract %tick from 0 : (i16) -> i14
+  %c0_i14 = hw.constant 0 : i14
+  %en13 = comb.icmp eq %low13, %c0_i14 : i14
+  %inc13 = hw.constant 27 : i32
+  %cnt13 = hw.instance "counter13" @Counter(clk: %seq_clk: !seq.clock, en: %en13: i1, inc: %inc13: i32) -> (count: i32)
+  %low14 = comb.extract %tick from 0 : (i16) -> i15
+  %c0_i15 = hw.constant 0 : i15
+  %en14 = comb.icmp eq %low14, %c0_i15 : i15
+  %inc14 = hw.constant 29 : i32
+  %cnt14 = hw.instance "counter14" @Counter(clk: %seq_clk: !seq.clock, en: %en14: i1, inc: %inc14: i32) -> (count: i32)
+  %low15 = comb.extract %tick from 0 : (i16) -> i16
+  %c0_i16 = hw.constant 0 : i16
+  %en15 = comb.icmp eq %low15, %c0_i16 : i16
+  %inc15 = hw.constant 31 : i32
+  %cnt15 = hw.instance "counter15" @Counter(clk: %seq_clk: !seq.clock, en: %en15: i1, inc: %inc15: i32) -> (count: i32)
+  %checksum = comb.xor %cnt0, %cnt1, %cnt2, %cnt3, %cnt4, %cnt5, %cnt6, %cnt7, %cnt8, %cnt9, %cnt10, %cnt11, %cnt12, %cnt13, %cnt14, %cnt15 : i32
+  hw.output %checksum : i32
+}
+
+func.func @main(%cycles: i64) {
+  %zero = arith.constant 0 : i1
+  %one = arith.constant 1 : i1
+  %lb = arith.constant 0 : index
+  %step = arith.constant 1 : index
+  %ub = arith.index_cast %cycles : i64 to index
+
+  arc.sim.instantiate @CounterFarm as %model {
+    scf.for %i = %lb to %ub step %step {
+      arc.sim.set_input %model, "clk" = %one : i1, !arc.sim.instance<@CounterFarm>
+      arc.sim.step %model : !arc.sim.instance<@CounterFarm>
+      arc.sim.set_input %model, "clk" = %zero : i1, !arc.sim.instance<@CounterFarm>
+      arc.sim.step %model : !arc.sim.instance<@CounterFarm>
+    }
+    %checksum = arc.sim.get_port %model, "checksum" : i32, !arc.sim.instance<@CounterFarm>
+    arc.sim.emit "checksum", %checksum : i32
+  }
+
+  return
+}
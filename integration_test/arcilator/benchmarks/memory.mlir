@@ -0,0 +1,76 @@
+// RUN: arcilator %s --run --jit-entry=main --args=64 | FileCheck %s
+// REQUIRES: arcilator-jit
+
+// Four 1024-word memories accessed at pseudo-random addresses every cycle,
+// stressing memory reads, writes, and their bounds checks.
+
+// CHECK: checksum = c6d2d243
+
+hw.module @Memory(in %clk: i1, out checksum: i32) {
+  %seq_clk = seq.to_clock %clk
+  %true = hw.constant true
+  %c1_i32 = hw.constant 1 : i32
+  %tick = seq.compreg %tickNext, %seq_clk : i32
+  %tickNext = comb.add %tick, %c1_i32 : i32
+
+  %k0 = hw.constant -1640531535 : i32
+  %hash0 = comb.mul %tick, %k0 : i32
+  %raddr0 = comb.extract %hash0 from 22 : (i32) -> i10
+  %waddr0 = comb.extract %hash0 from 12 : (i32) -> i10
+  %mem0 = seq.firmem 0, 1, undefined, undefined : <1024 x 32>
+  %rdata0 = seq.firmem.read_port %mem0[%raddr0], clock %seq_clk : <1024 x 32>
+  %wdata0 = comb.xor %rdata0, %hash0 : i32
+  seq.firmem.write_port %mem0[%waddr0] = %wdata0, clock %seq_clk enable %true : <1024 x 32>
+
+  %k1 = hw.constant -2048144777 : i32
+  %hash1 = comb.mul %tick, %k1 : i32
+  %raddr1 = comb.extract %hash1 from 22 : (i32) -> i10
+  %waddr1 = comb.extract %hash1 from 12 : (i32) -> i10
+  %mem1 = seq.firmem 0, 1, undefined, undefined : <1024 x 32>
+  %rdata1 = seq.firmem.read_port %mem1[%raddr1], clock %seq_clk : <1024 x 32>
+  %wdata1 = comb.xor %rdata1, %hash1 : i32
+  seq.firmem.write_port %mem1[%waddr1] = %wdata1, clock %seq_clk enable %true : <1024 x 32>
+
+  %k2 = hw.constant -1028477379 : i32
+  %hash2 = comb.mul %tick, %k2 : i32
+  %raddr2 = comb.extract %hash2 from 22 : (i32) -> i10
+  %waddr2 = comb.extract %hash2 from 12 : (i32) -> i10
+  %mem2 = seq.firmem 0, 1, undefined, undefined : <1024 x 32>
+  %rdata2 = seq.firmem.read_port %mem2[%raddr2], clock %seq_clk : <1024 x 32>
+  %wdata2 = comb.xor %rdata2, %hash2 : i32
+  seq.firmem.write_port %mem2[%waddr2] = %wdata2, clock %seq_clk enable %true : <1024 x 32>
+
+  %k3 = hw.constant 668265263 : i32
+  %hash3 = comb.mul %tick, %k3 : i32
+  %raddr3 = comb.extract %hash3 from 22 : (i32) -> i10
+  %waddr3 = comb.extract %hash3 from 12 : (i32) -> i10
+  %mem3 = seq.firmem 0, 1, undefined, undefined : <1024 x 32>
+  %rdata3 = seq.firmem.read_port %mem3[%raddr3], clock %seq_clk : <1024 x 32>
+  %wdata3 = comb.xor %rdata3, %hash3 : i32
+  seq.firmem.write_port %mem3[%waddr3] = %wdata3, clock %seq_clk enable %true : <1024 x 32>
+
+  %mixed = comb.xor %rdata0, %rdata1, %rdata2, %rdata3, %acc : i32
+  %acc = seq.compreg %mixed, %seq_clk : i32
+  hw.output %acc : i32
+}
+
+func.func @main(%cycles: i64) {
+  %zero = arith.constant 0 : i1
+  %one = arith.constant 1 : i1
+  %lb = arith.constant 0 : index
+  %step = arith.constant 1 : index
+  %ub = arith.index_cast %cycles : i64 to index
+
+  arc.sim.instantiate @Memory as %model {
+    scf.for %i = %lb to %ub step %step {
+      arc.sim.set_input %model, "clk" = %one : i1, !arc.sim.instance<@Memory>
+      arc.sim.step %model : !arc.sim.instance<@Memory>
+      arc.sim.set_input %model, "clk" = %zero : i1, !arc.sim.instance<@Memory>
+      arc.sim.step %model : !arc.sim.instance<@Memory>
+    }
+    %checksum = arc.sim.get_port %model, "checksum" : i32, !arc.sim.instance<@Memory>
+    arc.sim.emit "checksum", %checksum : i32
+  }
+
+  return
+}
@@ -0,0 +1,197 @@
+// RUN: arcilator %s --run --jit-entry=main --args=64 | FileCheck %s
+// REQUIRES: arcilator-jit
+
+// A 32-stage pipeline of registers with a multiply-xorshift mixing step
+// between each stage, representative of deeply pipelined datapaths.
+
+// CHECK: checksum = 76417216508d660f
+
+hw.module @Pipeline(in %clk: i1, out checksum: i64) {
+  %seq_clk = seq.to_clock %clk
+  %c1_i64 = hw.constant 1 : i64
+  %c29_i64 = hw.constant 29 : i64
+  %tick = seq.compreg %tickNext, %seq_clk : i64
+  %tickNext = comb.add %tick, %c1_i64 : i64
+  %k0 = hw.constant -7046029254386353131 : i64
+  %mul0 = comb.mul %tick, %k0 : i64
+  %shr0 = comb.shru %mul0, %c29_i64 : i64
+  %mix0 = comb.xor %mul0, %shr0 : i64
+  %stage0 = seq.compreg %mix0, %seq_clk : i64
+  %k1 = hw.constant -2691343689449507777 : i64
+  %mul1 = comb.mul %stage0, %k1 : i64
+  %shr1 = comb.shru %mul1, %c29_i64 : i64
+  %mix1 = comb.xor %mul1, %shr1 : i64
+  %stage1 = seq.compreg %mix1, %seq_clk : i64
+  %k2 = hw.constant 1663341875487337577 : i64
+  %mul2 = comb.mul %stage1, %k2 : i64
+  %shr2 = comb.shru %mul2, %c29_i64 : i64
+  %mix2 = comb.xor %mul2, %shr2 : i64
+  %stage2 = seq.compreg %mix2, %seq_clk : i64
+  %k3 = hw.constant 6018027440424182931 : i64
+  %mul3 = comb.mul %stage2, %k3 : i64
+  %shr3 = comb.shru %mul3, %c29_i64 : i64
+  %mix3 = comb.xor %mul3, %shr3 : i64
+  %stage3 = seq.compreg %mix3, %seq_clk : i64
+  %k4 = hw.constant -8074031068348523331 : i64
+  %mul4 = comb.mul %stage3, %k4 : i64
+  %shr4 = comb.shru %mul4, %c29_i64 : i64
+  %mix4 = comb.xor %mul4, %shr4 : i64
+  %stage4 = seq.compreg %mix4, %seq_clk : i64
+  %k5 = hw.constant -3719345503411677977 : i64
+  %mul5 = comb.mul %stage4, %k5 : i64
+  %shr5 = comb.shru %mul5, %c29_i64 : i64
+  %mix5 = comb.xor %mul5, %shr5 : i64
+  %stage5 = seq.compreg %mix5, %seq_clk : i64
+  %k6 = hw.constant 635340061525167377 : i64
+  %mul6 = comb.mul %stage5, %k6 : i64
+  %shr6 = comb.shru %mul6, %c29_i64 : i64
+  %mix6 = comb.xor %mul6, %shr6 : i64
+  %stage6 = seq.compreg %mix6, %seq_clk : i64
+  %k7 = hw.constant 4990025626462012731 : i64
+  %mul7 = comb.mul %stage6, %k7 : i64
+  %shr7 = comb.shru %mul7, %c29_i64 : i64
+  %mix7 = comb.xor %mul7, %shr7 : i64
+  %stage7 = seq.compreg %mix7, %seq_clk : i64
+  %k8 = hw.constant -9102032882310693531 : i64
+  %mul8 = comb.mul %stage7, %k8 : i64
+  %shr8 = comb.shru %mul8, %c29_i64 : i64
+  %mix8 = comb.xor %mul8, %shr8 : i64
+  %stage8 = seq.compreg %mix8, %seq_clk : i64
+  %k9 = hw.constant -4747347317373848177 : i64
+  %mul9 = comb.mul %stage8, %k9 : i64
+  %shr9 = comb.shru %mul9, %c29_i64 : i64
+  %mix9 = comb.xor %mul9, %shr9 : i64
+  %stage9 = seq.compreg %mix9, %seq_clk : i64
+  %k10 = hw.constant -392661752437002823 : i64
+  %mul10 = comb.mul %stage9, %k10 : i64
+  %shr10 = comb.shru %mul10, %c29_i64 : i64
+  %mix10 = comb.xor %mul10, %shr10 : i64
+  %stage10 = seq.compreg %mix10, %seq_clk : i64
+  %k11 = hw.constant 3962023812499842531 : i64
+  %mul11 = comb.mul %stage10, %k11 : i64
+  %shr11 = comb.shru %mul11, %c29_i64 : i64
+  %mix11 = comb.xor %mul11, %shr11 : i64
+  %stage11 = seq.compreg %mix11, %seq_clk : i64
+  %k12 = hw.constant 8316709377436687885 : i64
+  %mul12 = comb.mul %stage11, %k12 : i64
+  %shr12 = comb.shru %mul12, %c29_i64 : i64
+  %mix12 = comb.xor %mul12, %shr12 : i64
+  %stage12 = seq.compreg %mix12, %seq_clk : i64
+  %k13 = hw.constant -5775349131336018377 : i64
+  %mul13 = comb.mul %stage12, %k13 : i64
+  %shr13 = comb.shru %mul13, %c29_i64 : i64
+  %mix13 = comb.xor %mul13, %shr13 : i64
+  %stage13 = seq.compreg %mix13, %seq_clk : i64
+  %k14 = hw.constant -1420663566399173023 : i64
+  %mul14 = comb.mul %stage13, %k14 : i64
+  %shr14 = comb.shru %mul14, %c29_i64 : i64
+  %mix14 = comb.xor %mul14, %shr14 : i64
+  %stage14 = seq.compreg %mix14, %seq_clk : i64
+  %k15 = hw.constant 2934021998537672331 : i64
+  %mul15 = comb.mul %stage14, %k15 : i64
+  %shr15 = comb.shru %mul15, %c29_i64 : i64
+  %mix15 = comb.xor %mul15, %shr15 : i64
+  %stage15 = seq.compreg %mix15, %seq_clk : i64
+  %k16 = hw.constant 7288707563474517685 : i64
+  %mul16 = comb.mul %stage15, %k16 : i64
+  %shr16 = comb.shru %mul16, %c29_i64 : i64
+  %mix16 = comb.xor %mul16, %shr16 : i64
+  %stage16 = seq.compreg %mix16, %seq_clk : i64
+  %k17 = hw.constant -6803350945298188577 : i64
+  %mul17 = comb.mul %stage16, %k17 : i64
+  %shr17 = comb.shru %mul17, %c29_i64 : i64
+  %mix17 = comb.xor %mul17, %shr17 : i64
+  %stage17 = seq.compreg %mix17, %seq_clk : i64
+  %k18 = hw.constant -2448665380361343223 : i64
+  %mul18 = comb.mul %stage17, %k18 : i64
+  %shr18 = comb.shru %mul18, %c29_i64 : i64
+  %mix18 = comb.xor %mul18, %shr18 : i64
+  %stage18 = seq.compreg %mix18, %seq_clk : i64
+  %k19 = hw.constant 1906020184575502131 : i64
+  %mul19 = comb.mul %stage18, %k19 : i64
+  %shr19 = comb.shru %mul19, %c29_i64 : i64
+  %mix19 = comb.xor %mul19, %shr19 : i64
+  %stage19 = seq.compreg %mix19, %seq_clk : i64
+  %k20 = hw.constant 6260705749512347485 : i64
+  %mul20 = comb.mul %stage19, %k20 : i64
+  %shr20 = comb.shru %mul20, %c29_i64 : i64
+  %mix20 = comb.xor %mul20, %shr20 : i64
+  %stage20 = seq.compreg %mix20, %seq_clk : i64
+  %k21 = hw.constant -7831352759260358777 : i64
+  %mul21 = comb.mul %stage20, %k21 : i64
+  %shr21 = comb.shru %mul21, %c29_i64 : i64
+  %mix21 = comb.xor %mul21, %shr21 : i64
+  %stage21 = seq.compreg %mix21, %seq_clk : i64
+  %k22 = hw.constant -3476667194323513423 : i64
+  %mul22 = comb.mul %stage21, %k22 : i64
+  %shr22 = comb.shru %mul22, %c29_i64 : i64
+  %mix22 = comb.xor %mul22, %shr22 : i64
+  %stage22 = seq.compreg %mix22, %seq_clk : i64
+  %k23 = hw.constant 878018370613331931 : i64
+  %mul23 = comb.mul %stage22, %k23 : i64
+  %shr23 = comb.shru %mul23, %c29_i64 : i64
+  %mix23 = comb.xor %mul23, %shr23 : i64
+  %stage23 = seq.compreg %mix23, %seq_clk : i64
+  %k24 = hw.constant 5232703935550177285 : i64
+  %mul24 = comb.mul %stage23, %k24 : i64
+  %shr24 = comb.shru %mul24, %c29_i64 : i64
+  %mix24 = comb.xor %mul24, %shr24 : i64
+  %stage24 = seq.compreg %mix24, %seq_clk : i64
+  %k25 = hw.constant -8859354573222528977 : i64
+  %mul25 = comb.mul %stage24, %k25 : i64
+  %shr25 = comb.shru %mul25, %c29_i64 : i64
+  %mix25 = comb.xor %mul25, %shr25 : i64
+  %stage25 = seq.compreg %mix25, %seq_clk : i64
+  %k26 = hw.constant -4504669008285683623 : i64
+  %mul26 = comb.mul %stage25, %k26 : i64
+  %shr26 = comb.shru %mul26, %c29_i64 : i64
+  %mix26 = comb.xor %mul26, %shr26 : i64
+  %stage26 = seq.compreg %mix26, %seq_clk : i64
+  %k27 = hw.constant -149983443348838269 : i64
+  %mul27 = comb.mul %stage26, %k27 : i64
+  %shr27 = comb.shru %mul27, %c29_i64 : i64
+  %mix27 = comb.xor %mul27, %shr27 : i64
+  %stage27 = seq.compreg %mix27, %seq_clk : i64
+  %k28 = hw.constant 4204702121588007085 : i64
+  %mul28 = comb.mul %stage27, %k28 : i64
+  %shr28 = comb.shru %mul28, %c29_i64 : i64
+  %mix28 = comb.xor %mul28, %shr28 : i64
+  %stage28 = seq.compreg %mix28, %seq_clk : i64
+  %k29 = hw.constant 8559387686524852439 : i64
+  %mul29 = comb.mul %stage28, %k29 : i64
+  %shr29 = comb.shru %mul29, %c29_i64 : i64
+  %mix29 = comb.xor %mul29, %shr29 : i64
+  %stage29 = seq.compreg %mix29, %seq_clk : i64
+  %k30 = hw.constant -5532670822247853823 : i64
+  %mul30 = comb.mul %stage29, %k30 : i64
+  %shr30 = comb.shru %mul30, %c29_i64 : i64
+  %mix30 = comb.xor %mul30, %shr30 : i64
+  %stage30 = seq.compreg %mix30, %seq_clk : i64
+  %k31 = hw.constant -1177985257311008469 : i64
+  %mul31 = comb.mul %stage30, %k31 : i64
+  %shr31 = comb.shru %mul31, %c29_i64 : i64
+  %mix31 = comb.xor %mul31, %shr31 : i64
+  %stage31 = seq.compreg %mix31, %seq_clk : i64
+  hw.output %stage31 : i64
+}
+
+func.func @main(%cycles: i64) {
+  %zero = arith.constant 0 : i1
+  %one = arith.constant 1 : i1
+  %lb = arith.constant 0 : index
+  %step = arith.constant 1 : index
+  %ub = arith.index_cast %cycles : i64 to index
+
+  arc.sim.instantiate @Pipeline as %model {
+    scf.for %i = %lb to %ub step %step {
+      arc.sim.set_input %model, "clk" = %one : i1, !arc.sim.instance<@Pipeline>
+      arc.sim.step %model : !arc.sim.instance<@Pipeline>
+      arc.sim.set_input %model, "clk" = %zero : i1, !arc.sim.instance<@Pipeline>
+      arc.sim.step %model : !arc.sim.instance<@Pipeline>
+    }
+    %checksum = arc.sim.get_port %model, "checksum" : i64, !arc.sim.instance<@Pipeline>
+    arc.sim.emit "checksum", %checksum : i64
+  }
+
+  return
+}
@@ -0,0 +1,61 @@
+// RUN: arcilator %s --run --jit-entry=main --args=64 | FileCheck %s
+// REQUIRES: arcilator-jit
+
+// A 1024-bit datapath that adds, rotates, and xors two wide registers every
+// cycle, stressing the lowering of wide integer arithmetic.
+
+// CHECK: checksum = eaa72999eee68326
+
+hw.module @WideDatapath(in %clk: i1, out checksum: i64) {
+  %seq_clk = seq.to_clock %clk
+  %c1_i1024 = hw.constant 1 : i1024
+  %a = seq.compreg %aNext, %seq_clk : i1024
+  %b = seq.compreg %bNext, %seq_clk : i1024
+  %sum = comb.add %a, %b, %c1_i1024 : i1024
+  %sumLo = comb.extract %sum from 0 : (i1024) -> i1011
+  %sumHi = comb.extract %sum from 1011 : (i1024) -> i13
+  %aNext = comb.concat %sumLo, %sumHi : i1011, i13
+  %aLo = comb.extract %a from 0 : (i1024) -> i37
+  %aHi = comb.extract %a from 37 : (i1024) -> i987
+  %aRot = comb.concat %aLo, %aHi : i37, i987
+  %bNext = comb.xor %b, %aRot, %sum : i1024
+  %part0 = comb.extract %bNext from 0 : (i1024) -> i64
+  %part1 = comb.extract %bNext from 64 : (i1024) -> i64
+  %part2 = comb.extract %bNext from 128 : (i1024) -> i64
+  %part3 = comb.extract %bNext from 192 : (i1024) -> i64
+  %part4 = comb.extract %bNext from 256 : (i1024) -> i64
+  %part5 = comb.extract %bNext from 320 : (i1024) -> i64
+  %part6 = comb.extract %bNext from 384 : (i1024) -> i64
+  %part7 = comb.extract %bNext from 448 : (i1024) -> i64
+  %part8 = comb.extract %bNext from 512 : (i1024) -> i64
+  %part9 = comb.extract %bNext from 576 : (i1024) -> i64
+  %part10 = comb.extract %bNext from 640 : (i1024) -> i64
+  %part11 = comb.extract %bNext from 704 : (i1024) -> i64
+  %part12 = comb.extract %bNext from 768 : (i1024) -> i64
+  %part13 = comb.extract %bNext from 832 : (i1024) -> i64
+  %part14 = comb.extract %bNext from 896 : (i1024) -> i64
+  %part15 = comb.extract %bNext from 960 : (i1024) -> i64
+  %checksum = comb.xor %part0, %part1, %part2, %part3, %part4, %part5, %part6, %part7, %part8, %part9, %part10, %part11, %part12, %part13, %part14, %part15 : i64
+  hw.output %checksum : i64
+}
+
+func.func @main(%cycles: i64) {
+  %zero = arith.constant 0 : i1
+  %one = arith.constant 1 : i1
+  %lb = arith.constant 0 : index
+  %step = arith.constant 1 : index
+  %ub = arith.index_cast %cycles : i64 to index
+
+  arc.sim.instantiate @WideDatapath as %model {
+    scf.for %i = %lb to %ub step %step {
+      arc.sim.set_input %model, "clk" = %one : i1, !arc.sim.instance<@WideDatapath>
+      arc.sim.step %model : !arc.sim.instance<@WideDatapath>
+      arc.sim.set_input %model, "clk" = %zero : i1, !arc.sim.instance<@WideDatapath>
+      arc.sim.step %model : !arc.sim.instance<@WideDatapath>
+    }
+    %checksum = arc.sim.get_port %model, "checksum" : i64, !arc.sim.instance<@WideDatapath>
+    arc.sim.emit "checksum", %checksum : i64
+  }
+
+  return
+}
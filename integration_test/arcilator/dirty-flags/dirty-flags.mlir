@@ -0,0 +1,45 @@
+// REQUIRES: python, jinja2
+// RUN: rm -rf %t && mkdir -p %t/plain %t/dirty
+// RUN: arcilator %s --state-file=%t/plain.json -o %t/plain.ll
+// RUN: arcilator %s --dirty-flags --state-file=%t/dirty.json -o %t/dirty.ll
+// RUN: %PYTHON% %circt-tools-dir/arcilator-header-cpp.py %t/plain.json > %t/plain/model.h
+// RUN: %PYTHON% %circt-tools-dir/arcilator-header-cpp.py %t/dirty.json > %t/dirty/model.h
+// RUN: llc -O2 -filetype=obj -relocation-model=pic %t/plain.ll -o %t/plain.o
+// RUN: llc -O2 -filetype=obj -relocation-model=pic %t/dirty.ll -o %t/dirty.o
+// RUN: %host_cxx -std=c++17 -I%circt-tools-dir -I%t/plain %S/driver.cpp %t/plain.o -o %t/plain.exe
+// RUN: %host_cxx -std=c++17 -I%circt-tools-dir -I%t/dirty %S/driver.cpp %t/dirty.o -o %t/dirty.exe
+// RUN: %t/plain.exe > %t/plain.vcd
+// RUN: %t/dirty.exe full > %t/full.vcd
+// RUN: %t/dirty.exe > %t/dirty.vcd
+// RUN: diff %t/plain.vcd %t/full.vcd
+// RUN: diff %t/full.vcd %t/dirty.vcd
+// RUN: FileCheck %s --input-file=%t/dirty.vcd
+
+// Dumping only the signals whose dirty flag is set must produce exactly the
+// same VCD as comparing every signal on every timestep, both for the model
+// compiled with dirty flags and for one compiled without them.
+
+// CHECK:      $enddefinitions $end
+// CHECK:      $dumpvars
+// CHECK:      #1
+// CHECK:      #80
+
+hw.module @Dirty(in %clk: i1, in %en: i1, in %data: i8, out count: i8, out delayed: i8) {
+  %seq_clk = seq.to_clock %clk
+  %c1_i8 = hw.constant 1 : i8
+  %count = seq.compreg %count_next, %seq_clk : i8
+  %count_next = comb.add %count, %c1_i8 : i8
+  // Only changes on the cycles on which it is enabled.
+  %slow = seq.compreg %slow_next, %seq_clk : i8
+  %slow_next = comb.mux %en, %data, %slow : i8
+  %addr = comb.extract %count from 0 : (i8) -> i2
+  %mem = seq.firmem 0, 1, undefined, undefined : <4 x 8>
+  seq.firmem.write_port %mem[%addr] = %data, clock %seq_clk enable %en : <4 x 8>
+  %child.q = hw.instance "child" @Child(clk: %seq_clk: !seq.clock, d: %slow: i8) -> (q: i8)
+  hw.output %count, %child.q : i8, i8
+}
+
+hw.module @Child(in %clk: !seq.clock, in %d: i8, out q: i8) {
+  %delayed = seq.compreg %d, %clk : i8
+  hw.output %delayed : i8
+}
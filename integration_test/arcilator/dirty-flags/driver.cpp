@@ -0,0 +1,32 @@
+#include "model.h"
+
+#include <cstring>
+#include <iostream>
+
+constexpr unsigned numCycles = 40;
+
+// Dump by comparing every signal on every timestep, ignoring any dirty flags.
+static ValueChangeDump<DirtyLayout> fullCompareVcd(Dirty &model) {
+  const uint8_t *state = model.state;
+  ValueChangeDump<DirtyLayout> vcd(std::cout, state);
+  vcd.writeHeader();
+  vcd.writeDumpvars();
+  return vcd;
+}
+
+int main(int argc, char **argv) {
+  bool full = argc > 1 && std::strcmp(argv[1], "full") == 0;
+  Dirty model;
+  auto vcd = full ? fullCompareVcd(model) : model.vcd(std::cout);
+  for (unsigned cycle = 0; cycle < numCycles; ++cycle) {
+    model.view.en = cycle % 5 == 0;
+    model.view.data = cycle * 7;
+    model.view.clk = 1;
+    model.eval();
+    vcd.writeTimestep(1);
+    model.view.clk = 0;
+    model.eval();
+    vcd.writeTimestep(1);
+  }
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include "model.h"
+
+#include <cstdio>
+
+constexpr unsigned numInstances = 4;
+constexpr unsigned numCycles = 50;
+
+static uint32_t getSeed(unsigned instance, unsigned cycle) {
+  return (instance + 1) * 0x9e3779b9u ^ cycle * 0x85ebca6bu;
+}
+
+int main() {
+  uint32_t values[numInstances][numCycles];
+
+#ifdef LANES
+  // Drive all instances through the lanes of one batched model.
+  Lanes model;
+  for (unsigned cycle = 0; cycle < numCycles; ++cycle) {
+    for (unsigned lane = 0; lane < numInstances; ++lane) {
+      auto view = model.laneView(lane);
+      view.seed = getSeed(lane, cycle);
+      view.clk = 1;
+    }
+    model.eval();
+    for (unsigned lane = 0; lane < numInstances; ++lane)
+      model.laneView(lane).clk = 0;
+    model.eval();
+    for (unsigned lane = 0; lane < numInstances; ++lane)
+      values[lane][cycle] = model.laneView(lane).value;
+  }
+#else
+  // Simulate each instance on its own.
+  for (unsigned instance = 0; instance < numInstances; ++instance) {
+    Lanes model;
+    for (unsigned cycle = 0; cycle < numCycles; ++cycle) {
+      model.view.seed = getSeed(instance, cycle);
+      model.view.clk = 1;
+      model.eval();
+      model.view.clk = 0;
+      model.eval();
+      values[instance][cycle] = model.view.value;
+    }
+  }
+#endif
+
+  for (unsigned instance = 0; instance < numInstances; ++instance) {
+    std::printf("instance %u:", instance);
+    for (unsigned cycle = 0; cycle < numCycles; ++cycle)
+      std::printf(" %08x", values[instance][cycle]);
+    std::printf("\n");
+  }
+  return 0;
+}
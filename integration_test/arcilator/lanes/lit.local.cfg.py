@@ -0,0 +1 @@
+config.excludes.add('driver.cpp')
@@ -255,3 +255,10 @@ try:
   config.available_features.add('cocotb')
 except ImportError:
   pass
+
+# jinja2 availability, needed to generate arcilator model headers
+try:
+  import jinja2
+  config.available_features.add('jinja2')
+except ImportError:
+  pass
@@ -18,8 +18,7 @@
 using namespace circt;
 using namespace analysis;
 
-OpCountAnalysis::OpCountAnalysis(Operation *moduleOp,
-                                 mlir::AnalysisManager &am) {
+OpCountAnalysis::OpCountAnalysis(Operation *moduleOp) {
   moduleOp->walk([&](Operation *op) {
     auto opName = op->getName();
     // Update opCounts
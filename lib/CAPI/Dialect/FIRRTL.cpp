@@ -447,18 +447,19 @@ FIRRTLValueFlow firrtlValueFoldFlow(MlirValue value, FIRRTLValueFlow flow) {
 bool firrtlImportAnnotationsFromJSONRaw(
     MlirContext ctx, MlirStringRef annotationsStr,
     MlirAttribute *importedAnnotationsArray) {
-  auto annotations = json::parse(unwrap(annotationsStr));
-  if (!annotations) {
-    return false;
-  }
-
   auto *ctxUnwrapped = unwrap(ctx);
-
-  json::Path::Root root;
   SmallVector<Attribute> annos;
-  if (!importAnnotationsFromJSONRaw(annotations.get(), annos, root,
-                                    ctxUnwrapped)) {
-    return false;
+  // The DOM based import handles a few unusual inputs which the direct one
+  // doesn't, like duplicate keys.
+  if (!importAnnotationsFromJSONString(unwrap(annotationsStr), annos,
+                                       ctxUnwrapped)) {
+    auto annotations = json::parse(unwrap(annotationsStr));
+    if (!annotations)
+      return false;
+    json::Path::Root root;
+    if (!importAnnotationsFromJSONRaw(annotations.get(), annos, root,
+                                      ctxUnwrapped))
+      return false;
   }
 
   *importedAnnotationsArray = wrap(ArrayAttr::get(ctxUnwrapped, annos));
@@ -184,20 +184,25 @@ struct StorageGetOpLowering : public OpConversionPattern<arc::StorageGetOp> {
 
 struct MemoryAccess {
   Value ptr;
+  /// Whether the address is within bounds. Null if the address type cannot
+  /// represent any address beyond the end of the memory.
   Value withinBounds;
 };
 
 static MemoryAccess prepareMemoryAccess(Location loc, Value memory,
                                         Value address, MemoryType type,
                                         ConversionPatternRewriter &rewriter) {
-  auto zextAddrType = rewriter.getIntegerType(
-      cast<IntegerType>(address.getType()).getWidth() + 1);
+  auto addrWidth = cast<IntegerType>(address.getType()).getWidth();
+  auto zextAddrType = rewriter.getIntegerType(addrWidth + 1);
   Value addr = LLVM::ZExtOp::create(rewriter, loc, zextAddrType, address);
-  Value addrLimit =
-      LLVM::ConstantOp::create(rewriter, loc, zextAddrType,
-                               rewriter.getI32IntegerAttr(type.getNumWords()));
-  Value withinBounds = LLVM::ICmpOp::create(
-      rewriter, loc, LLVM::ICmpPredicate::ult, addr, addrLimit);
+  Value withinBounds;
+  if (addrWidth >= 32 || (1ULL << addrWidth) > type.getNumWords()) {
+    Value addrLimit = LLVM::ConstantOp::create(
+        rewriter, loc, zextAddrType,
+        rewriter.getI32IntegerAttr(type.getNumWords()));
+    withinBounds = LLVM::ICmpOp::create(
+        rewriter, loc, LLVM::ICmpPredicate::ult, addr, addrLimit);
+  }
   Value ptr = LLVM::GEPOp::create(
       rewriter, loc, LLVM::LLVMPointerType::get(memory.getContext()),
       rewriter.getIntegerType(type.getStride() * 8), memory, ValueRange{addr});
@@ -215,6 +220,12 @@ struct MemoryReadOpLowering : public OpConversionPattern<arc::MemoryReadOp> {
         prepareMemoryAccess(op.getLoc(), adaptor.getMemory(),
                             adaptor.getAddress(), memoryType, rewriter);
 
+    if (!access.withinBounds) {
+      rewriter.replaceOpWithNewOp<LLVM::LoadOp>(op, memoryType.getWordType(),
+                                                access.ptr);
+      return success();
+    }
+
     // Only attempt to read the memory if the address is within bounds,
     // otherwise produce a zero value.
     rewriter.replaceOpWithNewOp<scf::IfOp>(
@@ -242,9 +253,16 @@ struct MemoryWriteOpLowering : public OpConversionPattern<arc::MemoryWriteOp> {
         op.getLoc(), adaptor.getMemory(), adaptor.getAddress(),
         cast<MemoryType>(op.getMemory().getType()), rewriter);
     auto enable = access.withinBounds;
-    if (adaptor.getEnable())
+    if (adaptor.getEnable() && enable)
       enable = LLVM::AndOp::create(rewriter, op.getLoc(), adaptor.getEnable(),
                                    enable);
+    else if (adaptor.getEnable())
+      enable = adaptor.getEnable();
+    if (!enable) {
+      rewriter.replaceOpWithNewOp<LLVM::StoreOp>(op, adaptor.getData(),
+                                                 access.ptr);
+      return success();
+    }
 
     // Only attempt to write the memory if the address is within bounds.
     rewriter.replaceOpWithNewOp<scf::IfOp>(
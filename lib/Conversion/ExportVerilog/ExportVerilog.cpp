@@ -50,11 +50,16 @@
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/SaveAndRestore.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <condition_variable>
+#include <mutex>
+
 namespace circt {
 #define GEN_PASS_DEF_EXPORTSPLITVERILOG
 #define GEN_PASS_DEF_EXPORTVERILOG
@@ -7064,18 +7069,11 @@ void SharedEmitterState::emitOps(EmissionList &thingsToEmit,
   }
 
   // If we are parallelizing emission, we emit each independent operation to a
-  // string buffer in parallel, then concat at the end.
-  parallelForEach(context, thingsToEmit, [&](StringOrOpToEmit &stringOrOp) {
-    auto *op = stringOrOp.getOperation();
-    if (!op)
-      return; // Ignore things that are already strings.
-
-    // BindOp emission reaches into the hw.module of the instance, and that
-    // body may be being transformed by its own emission.  Defer their
-    // emission to the serial phase.  They are speedy to emit anyway.
-    if (isa<BindOp>(op) || modulesContainingBinds.count(op))
-      return;
-
+  // string buffer in parallel, and stream the buffers to the output in order as
+  // soon as they are ready. Workers may only run a bounded window of entries
+  // ahead of the output, so the text held in memory is bounded by the window
+  // rather than by the size of the design.
+  auto emitToString = [&](StringOrOpToEmit &stringOrOp) {
     SmallString<256> buffer;
     llvm::raw_svector_ostream tmpStream(buffer);
     llvm::formatted_raw_ostream rs(tmpStream);
@@ -7084,33 +7082,123 @@ void SharedEmitterState::emitOps(EmissionList &thingsToEmit,
     VerilogEmitterState state(designOp, *this, options, symbolCache,
                               globalNames, fileMapping, rs, fileName,
                               stringOrOp.verilogLocs);
-    emitOperation(state, op);
+    emitOperation(state, stringOrOp.getOperation());
     stringOrOp.setString(buffer);
-  });
+  };
+
+  // Decide up front who emits each entry. Workers replace the ops of the
+  // entries they emit with strings, so nobody else may look at an entry
+  // before it is ready.
+  enum class EmittedBy : char { None, Worker, Writer };
+  size_t numEntries = thingsToEmit.size();
+  std::vector<EmittedBy> emittedBy(numEntries, EmittedBy::None);
+  for (size_t i = 0; i < numEntries; ++i) {
+    auto *op = thingsToEmit[i].getOperation();
+    if (!op)
+      continue;
+    // BindOp emission reaches into the hw.module of the instance, and that
+    // body may be being transformed by its own emission.  Emit them from the
+    // writer while no worker is running.  They are speedy to emit anyway.
+    emittedBy[i] = isa<BindOp>(op) || modulesContainingBinds.count(op)
+                       ? EmittedBy::Writer
+                       : EmittedBy::Worker;
+  }
+
+  auto &threadPool = context->getThreadPool();
+  size_t window = 4 * threadPool.getMaxConcurrency();
+
+  // The state shared by the workers and the writer, guarded by `mutex`.
+  std::mutex mutex;
+  std::condition_variable cv;
+  // The next entry to hand out, and the next entry to write to the output.
+  size_t nextToEmit = 0, nextToWrite = 0;
+  // The number of entries currently being emitted by workers.
+  size_t numInFlight = 0;
+  // Set while the writer waits for the workers to emit a bind.
+  bool paused = false;
+  // Whether each entry is ready to be written.
+  std::vector<char> isReady(numEntries, false);
+
+  auto worker = [&] {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&] {
+        return nextToEmit == numEntries ||
+               (!paused && nextToEmit < nextToWrite + window);
+      });
+      if (nextToEmit == numEntries)
+        return;
+      size_t index = nextToEmit++;
+      if (emittedBy[index] == EmittedBy::Worker) {
+        ++numInFlight;
+        lock.unlock();
+        emitToString(thingsToEmit[index]);
+        lock.lock();
+        --numInFlight;
+      }
+      isReady[index] = true;
+      cv.notify_all();
+    }
+  };
+
+  llvm::ThreadPoolTaskGroup workers(threadPool);
+  for (size_t i = 0, e = std::min(threadPool.getMaxConcurrency(), numEntries);
+       i < e; ++i)
+    workers.async(worker);
+
+  // The line each entry starts at. Recording the Verilog locations in the IR
+  // mutates it, so that is only done once the workers are finished.
+  std::vector<unsigned> lineOffsets(numEntries, 0);
+  for (size_t i = 0; i < numEntries; ++i) {
+    auto &entry = thingsToEmit[i];
+    bool isBind = emittedBy[i] == EmittedBy::Writer;
+    bool emitHere = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      // Take the entry if no worker has picked it up yet. This guarantees
+      // progress even if the thread pool is busy with other work.
+      if (nextToEmit == i) {
+        ++nextToEmit;
+        emitHere = emittedBy[i] == EmittedBy::Worker;
+      } else {
+        cv.wait(lock, [&] { return isReady[i]; });
+      }
+      if (isBind) {
+        paused = true;
+        cv.wait(lock, [&] { return numInFlight == 0; });
+      }
+    }
+    if (emitHere)
+      emitToString(entry);
 
-  // Finally emit each entry now that we know it is a string.
-  for (auto &entry : thingsToEmit) {
     // Almost everything is lowered to a string, just concat the strings onto
     // the output stream.
-    auto *op = entry.getOperation();
-    if (!op) {
-      auto lineOffset = os.getLine() + 1;
+    if (!isBind) {
+      // Each `entry` was exported in parallel onto independent string
+      // streams, hence the line numbers in its map need to be offset by the
+      // line it starts at in the current stream.
+      lineOffsets[i] = os.getLine() + 1;
       os << entry.getStringData();
-      // Ensure the line numbers are offset properly in the map. Each `entry`
-      // was exported in parallel onto independent string streams, hence the
-      // line numbers need to be updated with the offset in the current stream.
-      entry.verilogLocs.updateIRWithLoc(lineOffset, fileName, context);
-      continue;
+      entry.releaseString();
+    } else {
+      // Binds are emitted directly, now that no worker is running.
+      entry.verilogLocs.setStream(os);
+      VerilogEmitterState state(designOp, *this, options, symbolCache,
+                                globalNames, fileMapping, os, fileName,
+                                entry.verilogLocs);
+      emitOperation(state, entry.getOperation());
     }
-    entry.verilogLocs.setStream(os);
 
-    // If this wasn't emitted to a string (e.g. it is a bind) do so now.
-    VerilogEmitterState state(designOp, *this, options, symbolCache,
-                              globalNames, fileMapping, os, fileName,
-                              entry.verilogLocs);
-    emitOperation(state, op);
-    state.addVerilogLocToOps(0, fileName);
+    std::scoped_lock<std::mutex> lock(mutex);
+    nextToWrite = i + 1;
+    paused = false;
+    cv.notify_all();
   }
+  workers.wait();
+
+  for (size_t i = 0; i < numEntries; ++i)
+    thingsToEmit[i].verilogLocs.updateIRWithLoc(lineOffsets[i], fileName,
+                                                context);
 }
 
 //===----------------------------------------------------------------------===//
@@ -7255,15 +7343,43 @@ createOutputFile(StringRef fileName, StringRef dirname,
 
 static void createSplitOutputFile(StringAttr fileName, FileInfo &file,
                                   StringRef dirname,
-                                  SharedEmitterState &emitter) {
-  auto output = createOutputFile(fileName, dirname, emitter);
-  if (!output)
-    return;
-
+                                  SharedEmitterState &emitter,
+                                  bool writeIfChanged) {
   SharedEmitterState::EmissionList list;
   emitter.collectOpsForFile(file, list,
                             emitter.options.emitReplicatedOpsToHeader);
 
+  // Emit into a buffer first and leave the file alone if it already has these
+  // contents, so that it keeps its timestamp and downstream tools can skip it.
+  if (writeIfChanged) {
+    SmallString<128> outputFilename(dirname);
+    appendPossiblyAbsolutePath(outputFilename, fileName.getValue());
+    std::string contents;
+    {
+      llvm::raw_string_ostream os(contents);
+      llvm::formatted_raw_ostream rs(os);
+      emitter.emitOps(list, rs,
+                      StringAttr::get(fileName.getContext(), outputFilename),
+                      /*parallelize=*/false);
+    }
+    auto existing =
+        llvm::MemoryBuffer::getFile(outputFilename, /*IsText=*/false,
+                                    /*RequiresNullTerminator=*/false);
+    if (existing && (*existing)->getBuffer() == contents)
+      return;
+
+    auto output = createOutputFile(fileName, dirname, emitter);
+    if (!output)
+      return;
+    output->os() << contents;
+    output->keep();
+    return;
+  }
+
+  auto output = createOutputFile(fileName, dirname, emitter);
+  if (!output)
+    return;
+
   llvm::formatted_raw_ostream rs(output->os());
   // Emit the file, copying the global options into the individual module
   // state.  Don't parallelize emission of the ops within this file - we
@@ -7275,8 +7391,8 @@ static void createSplitOutputFile(StringAttr fileName, FileInfo &file,
   output->keep();
 }
 
-static LogicalResult exportSplitVerilogImpl(ModuleOp module,
-                                            StringRef dirname) {
+static LogicalResult exportSplitVerilogImpl(ModuleOp module, StringRef dirname,
+                                            bool writeIfChanged = false) {
   // Prepare the ops in the module for emission and legalize the names that will
   // end up in the output.
   LoweringOptions options(module);
@@ -7306,7 +7422,7 @@ static LogicalResult exportSplitVerilogImpl(ModuleOp module,
   parallelForEach(module->getContext(), emitter.files.begin(),
                   emitter.files.end(), [&](auto &it) {
                     createSplitOutputFile(it.first, it.second, dirname,
-                                          emitter);
+                                          emitter, writeIfChanged);
                   });
 
   // Write the file list.
@@ -7358,8 +7474,9 @@ namespace {
 
 struct ExportSplitVerilogPass
     : public circt::impl::ExportSplitVerilogBase<ExportSplitVerilogPass> {
-  ExportSplitVerilogPass(StringRef directory) {
+  ExportSplitVerilogPass(StringRef directory, bool writeIfChanged) {
     directoryName = directory.str();
+    this->writeIfChanged = writeIfChanged;
   }
   void runOnOperation() override {
     // Prepare the ops in the module for emission.
@@ -7371,13 +7488,14 @@ struct ExportSplitVerilogPass
     if (failed(runPipeline(preparePM, getOperation())))
       return signalPassFailure();
 
-    if (failed(exportSplitVerilogImpl(getOperation(), directoryName)))
+    if (failed(exportSplitVerilogImpl(getOperation(), directoryName,
+                                      writeIfChanged)))
       return signalPassFailure();
   }
 };
 } // end anonymous namespace
 
 std::unique_ptr<mlir::Pass>
-circt::createExportSplitVerilogPass(StringRef directory) {
-  return std::make_unique<ExportSplitVerilogPass>(directory);
+circt::createExportSplitVerilogPass(StringRef directory, bool writeIfChanged) {
+  return std::make_unique<ExportSplitVerilogPass>(directory, writeIfChanged);
 }
@@ -317,6 +317,14 @@ public:
     pointerData = (const void *)data;
   }
 
+  /// Free the string once it has been written out.
+  void releaseString() {
+    if (const void *ptr = pointerData.dyn_cast<const void *>())
+      free(const_cast<void *>(ptr));
+    pointerData = (const void *)nullptr;
+    length = 0;
+  }
+
   // These move just fine.
   StringOrOpToEmit(StringOrOpToEmit &&rhs)
       : pointerData(rhs.pointerData), length(rhs.length) {
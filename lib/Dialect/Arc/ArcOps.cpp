@@ -325,6 +325,32 @@ LogicalResult ModelOp::verifySymbolUses(SymbolTableCollection &symbolTable) {
       return diag;
     }
   }
+
+  if (auto phases = getEvalPartitionsAttr()) {
+    for (auto phase : phases) {
+      auto phaseAttr = dyn_cast<ArrayAttr>(phase);
+      if (!phaseAttr)
+        return emitOpError("partitions must be a list of phases");
+      for (auto partition : phaseAttr) {
+        auto fnAttr = dyn_cast<FlatSymbolRefAttr>(partition);
+        if (!fnAttr)
+          return emitOpError("partition phases must be lists of symbols");
+        auto fn =
+            symbolTable.lookupNearestSymbolFrom<func::FuncOp>(*this, fnAttr);
+        if (!fn)
+          return emitOpError() << "partition '" << fnAttr.getValue()
+                               << "' does not reference a valid function";
+        if (!llvm::equal(fn.getArgumentTypes(), getBody().getArgumentTypes()) ||
+            fn.getNumResults() != 0) {
+          auto diag = emitError()
+                      << "partition '" << fnAttr.getValue()
+                      << "' must take the model arguments and return nothing";
+          diag.attachNote(fn.getLoc()) << "partition declared here:";
+          return diag;
+        }
+      }
+    }
+  }
   return success();
 }
 
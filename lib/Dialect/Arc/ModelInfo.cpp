@@ -12,6 +12,7 @@
 
 #include "circt/Dialect/Arc/ModelInfo.h"
 #include "circt/Dialect/Arc/ArcOps.h"
+#include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/JSON.h"
 
 using namespace mlir;
@@ -76,6 +77,8 @@ LogicalResult circt::arc::collectStates(Value storage, unsigned offset,
           "without allocated offset; run state allocation first");
 
     StateInfo stateInfo;
+    if (auto dirtyOffset = op->getAttrOfType<IntegerAttr>("dirty_offset"))
+      stateInfo.dirtyOffset = dirtyOffset.getValue().getZExtValue() + offset;
     if (isa<AllocStateOp, RootInputOp, RootOutputOp>(op)) {
       auto result = op->getResult(0);
       stateInfo.type = StateInfo::Register;
@@ -104,6 +107,19 @@ LogicalResult circt::arc::collectStates(Value storage, unsigned offset,
       auto memType = memOp.getType();
       auto intType = memType.getWordType();
       stateInfo.type = StateInfo::Memory;
+      // States batched into lanes keep reporting their original kind.
+      if (auto laneState = op->getAttrOfType<StringAttr>("lane_state")) {
+        auto type = llvm::StringSwitch<std::optional<StateInfo::Type>>(
+                        laneState.getValue())
+                        .Case("input", StateInfo::Input)
+                        .Case("output", StateInfo::Output)
+                        .Case("register", StateInfo::Register)
+                        .Case("wire", StateInfo::Wire)
+                        .Default(std::nullopt);
+        if (!type)
+          return op->emitOpError("with unknown lane state kind ") << laneState;
+        stateInfo.type = *type;
+      }
       stateInfo.offset = opOffset.getValue().getZExtValue() + offset;
       stateInfo.numBits = intType.getWidth();
       stateInfo.memoryStride = stride.getValue().getZExtValue();
@@ -133,7 +149,9 @@ LogicalResult circt::arc::collectModels(mlir::ModuleOp module,
 
     models.emplace_back(std::string(modelOp.getName()), storageType.getSize(),
                         std::move(states), modelOp.getInitialFnAttr(),
-                        modelOp.getFinalFnAttr());
+                        modelOp.getFinalFnAttr(),
+                        modelOp.getEvalPartitionsAttr(),
+                        modelOp.getLanes().value_or(1));
   }
 
   return success();
@@ -153,6 +171,17 @@ void circt::arc::serializeModelInfoToJson(llvm::raw_ostream &outputStream,
                                            : model.initialFnSym.getValue());
         json.attribute("finalFnSym",
                        !model.finalFnSym ? "" : model.finalFnSym.getValue());
+        if (model.evalPartitions) {
+          json.attributeArray("evalPartitions", [&] {
+            for (auto phase : model.evalPartitions.getAsRange<ArrayAttr>())
+              json.array([&] {
+                for (auto fn : phase.getAsRange<FlatSymbolRefAttr>())
+                  json.value(fn.getValue());
+              });
+          });
+        }
+        if (model.numLanes != 1)
+          json.attribute("lanes", model.numLanes);
         json.attributeArray("states", [&] {
           for (const auto &state : model.states) {
             json.object([&] {
@@ -175,10 +204,12 @@ void circt::arc::serializeModelInfoToJson(llvm::raw_ostream &outputStream,
                 return "";
               };
               json.attribute("type", typeStr(state.type));
-              if (state.type == StateInfo::Memory) {
+              if (state.type == StateInfo::Memory || state.memoryDepth != 0) {
                 json.attribute("stride", state.memoryStride);
                 json.attribute("depth", state.memoryDepth);
               }
+              if (state.dirtyOffset)
+                json.attribute("dirtyOffset", *state.dirtyOffset);
             });
           }
         });
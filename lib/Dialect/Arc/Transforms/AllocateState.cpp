@@ -8,6 +8,7 @@
 
 #include "circt/Dialect/Arc/ArcOps.h"
 #include "circt/Dialect/Arc/ArcPasses.h"
+#include "circt/Dialect/HW/HWOps.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
 #include "mlir/Pass/Pass.h"
 #include "llvm/Support/Debug.h"
@@ -27,6 +28,20 @@ using namespace arc;
 
 using llvm::SmallMapVector;
 
+/// Check whether a state or memory has a name and is therefore visible to the
+/// user, e.g. in waveform dumps.
+static bool isObservable(Operation *op) {
+  if (auto name = op->getAttrOfType<StringAttr>("name"))
+    if (!name.getValue().empty())
+      return true;
+  if (auto names = op->getAttrOfType<ArrayAttr>("names"))
+    for (auto attr : names)
+      if (auto name = dyn_cast<StringAttr>(attr))
+        if (!name.getValue().empty())
+          return true;
+  return false;
+}
+
 //===----------------------------------------------------------------------===//
 // Pass Implementation
 //===----------------------------------------------------------------------===//
@@ -34,6 +49,8 @@ using llvm::SmallMapVector;
 namespace {
 struct AllocateStatePass
     : public arc::impl::AllocateStateBase<AllocateStatePass> {
+  using AllocateStateBase::AllocateStateBase;
+
   void runOnOperation() override;
   void allocateBlock(Block *block);
   void allocateOps(Value storage, Block *block, ArrayRef<Operation *> ops);
@@ -119,12 +136,47 @@ void AllocateStatePass::allocateOps(Value storage, Block *block,
     assert("unsupported op for allocation" && false);
   }
 
+  // Allocate the dirty flags of observable states after all states, such that
+  // the flags of a storage are contiguous, and set them after every write.
+  SmallVector<StorageGetOp> getters;
+  if (dirtyFlags) {
+    for (auto *op : ops) {
+      if (!isa<AllocStateOp, RootOutputOp, AllocMemoryOp>(op) ||
+          !isObservable(op))
+        continue;
+      auto offset = builder.getI32IntegerAttr(allocBytes(1));
+      op->setAttr("dirty_offset", offset);
+      auto result = op->getResult(0);
+      for (auto *user : result.getUsers()) {
+        Value condition;
+        if (auto writeOp = dyn_cast<StateWriteOp>(user)) {
+          if (writeOp.getState() != result)
+            continue;
+          condition = writeOp.getCondition();
+        } else if (auto writeOp = dyn_cast<MemoryWriteOp>(user)) {
+          if (writeOp.getMemory() != result)
+            continue;
+          condition = writeOp.getEnable();
+        } else {
+          continue;
+        }
+        ImplicitLocOpBuilder builder(user->getLoc(), user->getBlock(),
+                                     std::next(Block::iterator(user)));
+        auto flag = StorageGetOp::create(
+            builder, StateType::get(builder.getI1Type()), storage, offset);
+        auto trueValue =
+            hw::ConstantOp::create(builder, builder.getI1Type(), 1);
+        StateWriteOp::create(builder, flag, trueValue, condition);
+        getters.push_back(flag);
+      }
+    }
+  }
+
   // For every user of the alloc op, create a local `StorageGetOp`.
   // First, create an ordering of operations to avoid a very expensive
   // combination of isBeforeInBlock and moveBefore calls (which can be O(n²))
   DenseMap<Operation *, unsigned> opOrder;
   block->walk([&](Operation *op) { opOrder.insert({op, opOrder.size()}); });
-  SmallVector<StorageGetOp> getters;
   for (auto [result, storage, offset] : gettersToCreate) {
     SmallDenseMap<Block *, StorageGetOp> getterForBlock;
     for (auto *user : llvm::make_early_inc_range(result.getUsers())) {
@@ -164,6 +216,7 @@ void AllocateStatePass::allocateOps(Value storage, Block *block,
   }
 }
 
-std::unique_ptr<Pass> arc::createAllocateStatePass() {
-  return std::make_unique<AllocateStatePass>();
+std::unique_ptr<Pass>
+arc::createAllocateStatePass(const AllocateStateOptions &options) {
+  return std::make_unique<AllocateStatePass>(options);
 }
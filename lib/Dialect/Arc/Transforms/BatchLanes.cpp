@@ -0,0 +1,307 @@
+//===- BatchLanes.cpp -----------------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/Arc/ArcOps.h"
+#include "circt/Dialect/Arc/ArcPasses.h"
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "arc-batch-lanes"
+
+namespace circt {
+namespace arc {
+#define GEN_PASS_DEF_BATCHLANES
+#include "circt/Dialect/Arc/ArcPasses.h.inc"
+} // namespace arc
+} // namespace circt
+
+using namespace mlir;
+using namespace circt;
+using namespace arc;
+
+//===----------------------------------------------------------------------===//
+// Pass Implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct BatchLanesPass : public arc::impl::BatchLanesBase<BatchLanesPass> {
+  using BatchLanesBase::BatchLanesBase;
+
+  void runOnOperation() override;
+  LogicalResult wrapInLaneLoop(Block &block);
+  void flattenIf(scf::IfOp ifOp);
+  LogicalResult convertState(Operation *op);
+  LogicalResult convertMemory(AllocMemoryOp op);
+  Value getLane(Operation *user);
+
+  /// The lane index within each of the lane loops.
+  DenseMap<Operation *, Value> laneIndices;
+  IntegerType laneType;
+};
+} // namespace
+
+void BatchLanesPass::runOnOperation() {
+  ModelOp modelOp = getOperation();
+  if (numLanes < 2)
+    return;
+  LLVM_DEBUG(llvm::dbgs() << "Batching `" << modelOp.getName() << "` into "
+                          << numLanes << " lanes\n");
+  laneIndices.clear();
+  laneType = IntegerType::get(&getContext(),
+                              std::max(1U, llvm::Log2_32_Ceil(numLanes)));
+
+  // Wrap the model body and the initial and final regions in loops over all
+  // lanes.
+  auto &bodyBlock = modelOp.getBodyBlock();
+  if (failed(wrapInLaneLoop(bodyBlock)))
+    return signalPassFailure();
+  for (auto &op : bodyBlock)
+    if (isa<InitialOp, FinalOp>(op))
+      if (failed(wrapInLaneLoop(op.getRegion(0).front())))
+        return signalPassFailure();
+
+  // Turn the clock edge checks and other conditionals within the lane loops
+  // into straight-line code. The walk visits nested ifs before their parents.
+  SmallVector<scf::IfOp> ifOps;
+  for (auto *loopOp : llvm::make_first_range(laneIndices))
+    loopOp->walk([&](scf::IfOp ifOp) { ifOps.push_back(ifOp); });
+  for (auto ifOp : ifOps)
+    flattenIf(ifOp);
+
+  // Replace the states and memories with per-lane memories.
+  for (auto &op : llvm::make_early_inc_range(bodyBlock)) {
+    LogicalResult result =
+        TypeSwitch<Operation *, LogicalResult>(&op)
+            .Case<AllocStateOp, RootInputOp, RootOutputOp>(
+                [&](auto op) { return convertState(op); })
+            .Case<AllocMemoryOp>([&](auto op) { return convertMemory(op); })
+            .Case<AllocStorageOp>([&](auto op) {
+              return op.emitOpError("cannot be batched; run lane batching "
+                                    "before state allocation");
+            })
+            .Default([](auto) { return success(); });
+    if (failed(result))
+      return signalPassFailure();
+  }
+
+  modelOp.setLanesAttr(OpBuilder(modelOp).getI32IntegerAttr(numLanes));
+}
+
+/// Move all operations in a block other than allocations, constants, and the
+/// initial and final regions into an `scf.for` loop over all lanes.
+LogicalResult BatchLanesPass::wrapInLaneLoop(Block &block) {
+  SmallVector<Operation *> opsToMove;
+  for (auto &op : block)
+    if (!isa<AllocStateOp, AllocMemoryOp, AllocStorageOp, RootInputOp,
+             RootOutputOp, InitialOp, FinalOp>(op) &&
+        !op.hasTrait<OpTrait::ConstantLike>())
+      opsToMove.push_back(&op);
+  if (opsToMove.empty())
+    return success();
+
+  auto builder = ImplicitLocOpBuilder::atBlockEnd(opsToMove[0]->getLoc(),
+                                                  &block);
+  auto lowerBound = arith::ConstantIndexOp::create(builder, 0);
+  auto upperBound = arith::ConstantIndexOp::create(builder, numLanes);
+  auto step = arith::ConstantIndexOp::create(builder, 1);
+  auto forOp = scf::ForOp::create(builder, lowerBound, upperBound, step);
+  auto *loopBody = forOp.getBody();
+  builder.setInsertionPointToStart(loopBody);
+  auto lane = arith::IndexCastUIOp::create(builder, laneType,
+                                           forOp.getInductionVar());
+  laneIndices.insert({forOp, lane});
+
+  for (auto *op : opsToMove)
+    op->moveBefore(loopBody->getTerminator());
+
+  for (auto *op : opsToMove)
+    for (auto result : op->getResults())
+      for (auto *user : result.getUsers())
+        if (!forOp->isProperAncestor(user))
+          return user->emitOpError("uses a value that is computed separately "
+                                   "for each lane");
+  return success();
+}
+
+/// Inline the regions of an `scf.if` into the surrounding block, such that the
+/// loop over all lanes does not branch on a lane's values. Writes within the
+/// regions are predicated on the condition, and the results are selected with
+/// a mux. Ifs containing operations that cannot be executed unconditionally,
+/// such as calls with side effects, are left untouched.
+void BatchLanesPass::flattenIf(scf::IfOp ifOp) {
+  for (auto &region : ifOp->getRegions())
+    for (auto &op : region.getOps())
+      if (!isa<scf::YieldOp, StateReadOp, StateWriteOp, MemoryReadOp,
+               MemoryWriteOp>(op) &&
+          !isMemoryEffectFree(&op))
+        return;
+
+  ImplicitLocOpBuilder builder(ifOp.getLoc(), ifOp);
+  auto inlineRegion = [&](Region &region, Value enable) -> ValueRange {
+    if (region.empty())
+      return {};
+    auto *block = &region.front();
+    for (auto &op : block->without_terminator()) {
+      builder.setInsertionPoint(&op);
+      if (auto writeOp = dyn_cast<StateWriteOp>(&op)) {
+        Value condition = enable;
+        if (writeOp.getCondition())
+          condition = comb::AndOp::create(builder, writeOp.getCondition(),
+                                          enable, true);
+        writeOp.getConditionMutable().assign(condition);
+      } else if (auto writeOp = dyn_cast<MemoryWriteOp>(&op)) {
+        Value condition = enable;
+        if (writeOp.getEnable())
+          condition =
+              comb::AndOp::create(builder, writeOp.getEnable(), enable, true);
+        writeOp.getEnableMutable().assign(condition);
+      }
+    }
+    ifOp->getBlock()->getOperations().splice(
+        ifOp->getIterator(), block->getOperations(), block->begin(),
+        std::prev(block->end()));
+    return block->getTerminator()->getOperands();
+  };
+
+  Value condition = ifOp.getCondition();
+  Value notCondition;
+  if (!ifOp.getElseRegion().empty())
+    notCondition = comb::createOrFoldNot(condition, builder, true);
+  auto thenValues = inlineRegion(ifOp.getThenRegion(), condition);
+  auto elseValues = inlineRegion(ifOp.getElseRegion(), notCondition);
+
+  builder.setInsertionPoint(ifOp);
+  for (auto [result, thenValue, elseValue] :
+       llvm::zip(ifOp.getResults(), thenValues, elseValues))
+    result.replaceAllUsesWith(
+        comb::MuxOp::create(builder, condition, thenValue, elseValue, true));
+  ifOp.erase();
+}
+
+/// Get the lane index for an operation nested within a lane loop.
+Value BatchLanesPass::getLane(Operation *user) {
+  for (auto *op = user->getParentOp(); op; op = op->getParentOp())
+    if (auto lane = laneIndices.lookup(op))
+      return lane;
+  return {};
+}
+
+/// Replace a state with a memory holding the state of every lane.
+LogicalResult BatchLanesPass::convertState(Operation *op) {
+  auto state = op->getResult(0);
+  auto valueType = cast<StateType>(state.getType()).getType();
+  auto bitWidth = hw::getBitWidth(valueType);
+  if (bitWidth <= 0)
+    return op->emitOpError("with type ")
+           << valueType << " cannot be batched into lanes";
+  auto wordType = IntegerType::get(&getContext(), bitWidth);
+
+  StringRef kind = "register";
+  if (isa<RootInputOp>(op))
+    kind = "input";
+  else if (isa<RootOutputOp>(op))
+    kind = "output";
+  else if (cast<AllocStateOp>(op).getTap())
+    kind = "wire";
+
+  OpBuilder builder(op);
+  auto memOp = AllocMemoryOp::create(
+      builder, op->getLoc(), MemoryType::get(&getContext(), numLanes, wordType,
+                                             laneType),
+      op->getOperand(0));
+  for (auto attr : op->getDiscardableAttrs())
+    memOp->setAttr(attr.getName(), attr.getValue());
+  if (auto name = op->getAttrOfType<StringAttr>("name"))
+    memOp->setAttr("name", name);
+  memOp->setAttr("lane_state", builder.getStringAttr(kind));
+
+  for (auto *user : llvm::make_early_inc_range(state.getUsers())) {
+    auto lane = getLane(user);
+    if (!lane)
+      return user->emitOpError("accesses state outside of a lane loop");
+    ImplicitLocOpBuilder builder(user->getLoc(), user);
+    if (auto readOp = dyn_cast<StateReadOp>(user)) {
+      Value value = MemoryReadOp::create(builder, memOp, lane);
+      if (value.getType() != valueType)
+        value = hw::BitcastOp::create(builder, valueType, value);
+      readOp.replaceAllUsesWith(value);
+      readOp.erase();
+      continue;
+    }
+    if (auto writeOp = dyn_cast<StateWriteOp>(user)) {
+      Value value = writeOp.getValue();
+      if (value.getType() != wordType)
+        value = hw::BitcastOp::create(builder, wordType, value);
+      // Select between the new and the old value instead of skipping the
+      // write, such that the lane loop does not branch.
+      if (auto condition = writeOp.getCondition()) {
+        Value oldValue = MemoryReadOp::create(builder, memOp, lane);
+        value = comb::MuxOp::create(builder, condition, value, oldValue, true);
+      }
+      MemoryWriteOp::create(builder, memOp, lane, Value{}, value);
+      writeOp.erase();
+      continue;
+    }
+    return user->emitOpError("cannot be batched into lanes");
+  }
+  op->erase();
+  return success();
+}
+
+/// Widen a memory to hold the words of every lane, interleaving the lanes such
+/// that the same word of all lanes is stored contiguously.
+LogicalResult BatchLanesPass::convertMemory(AllocMemoryOp op) {
+  auto memType = op.getType();
+  auto addressType = memType.getAddressType();
+  auto newAddressType = IntegerType::get(
+      &getContext(), addressType.getWidth() + laneType.getWidth());
+  op.getResult().setType(
+      MemoryType::get(&getContext(), memType.getNumWords() * numLanes,
+                      memType.getWordType(), newAddressType));
+
+  // The widened address cannot overflow, such that out-of-bounds accesses of a
+  // lane remain out of bounds of the widened memory.
+  for (auto *user : llvm::to_vector(op->getUsers())) {
+    if (!isa<MemoryReadOp, MemoryWriteOp>(user))
+      return user->emitOpError("cannot be batched into lanes");
+    auto lane = getLane(user);
+    if (!lane)
+      return user->emitOpError("accesses memory outside of a lane loop");
+    ImplicitLocOpBuilder builder(user->getLoc(), user);
+    auto &addressOperand = user->getOpOperand(1);
+    Value address = comb::createZExt(builder, builder.getLoc(),
+                                     addressOperand.get(),
+                                     newAddressType.getWidth());
+    auto numLanesValue = hw::ConstantOp::create(builder, newAddressType,
+                                                numLanes);
+    address = comb::MulOp::create(builder, address, numLanesValue);
+    Value laneIndex = comb::createZExt(builder, builder.getLoc(), lane,
+                                       newAddressType.getWidth());
+    address = comb::AddOp::create(builder, address, laneIndex);
+    addressOperand.set(address);
+
+    // Write back the old word if the write is disabled, such that the lane
+    // loop does not branch.
+    if (auto writeOp = dyn_cast<MemoryWriteOp>(user)) {
+      if (auto enable = writeOp.getEnable()) {
+        Value oldData = MemoryReadOp::create(builder, op, address);
+        writeOp.getDataMutable().assign(comb::MuxOp::create(
+            builder, enable, writeOp.getData(), oldData, true));
+        writeOp.getEnableMutable().clear();
+      }
+    }
+  }
+  return success();
+}
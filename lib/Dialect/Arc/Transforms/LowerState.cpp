@@ -192,7 +192,8 @@ LogicalResult ModuleLowering::run() {
   auto modelOp =
       ModelOp::create(builder, moduleOp.getLoc(), moduleOp.getModuleNameAttr(),
                       TypeAttr::get(moduleOp.getModuleType()),
-                      FlatSymbolRefAttr{}, FlatSymbolRefAttr{});
+                      FlatSymbolRefAttr{}, FlatSymbolRefAttr{}, ArrayAttr{},
+                      IntegerAttr{});
   auto &modelBlock = modelOp.getBody().emplaceBlock();
   storageArg = modelBlock.addArgument(
       StorageType::get(builder.getContext(), {}), modelOp.getLoc());
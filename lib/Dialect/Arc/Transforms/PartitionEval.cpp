@@ -0,0 +1,534 @@
+//===- PartitionEval.cpp --------------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/Arc/ArcCostModel.h"
+#include "circt/Dialect/Arc/ArcOps.h"
+#include "circt/Dialect/Arc/ArcPasses.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/Interfaces/CallInterfaces.h"
+#include "mlir/Interfaces/FunctionInterfaces.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/Debug.h"
+#include <functional>
+
+#define DEBUG_TYPE "arc-partition-eval"
+
+namespace circt {
+namespace arc {
+#define GEN_PASS_DEF_PARTITIONEVAL
+#include "circt/Dialect/Arc/ArcPasses.h.inc"
+} // namespace arc
+} // namespace circt
+
+using namespace mlir;
+using namespace circt;
+using namespace arc;
+
+//===----------------------------------------------------------------------===//
+// Utilities
+//===----------------------------------------------------------------------===//
+
+/// Check whether an operation in the model body only computes a constant or an
+/// address, such that it can be duplicated into every partition using it.
+static bool isCloneable(Operation *op) {
+  if (auto allocOp = dyn_cast<AllocStorageOp>(op))
+    return allocOp.getOffset().has_value();
+  return op->hasTrait<OpTrait::ConstantLike>() || isa<StorageGetOp>(op);
+}
+
+/// Resolve a state, memory, or storage value to its byte offset within the
+/// model storage `storageArg`.
+static std::optional<uint64_t> getStorageOffset(Value value,
+                                                Value storageArg) {
+  uint64_t offset = 0;
+  while (value != storageArg) {
+    if (auto getOp = value.getDefiningOp<StorageGetOp>()) {
+      offset += getOp.getOffset();
+      value = getOp.getStorage();
+      continue;
+    }
+    if (auto allocOp = value.getDefiningOp<AllocStorageOp>()) {
+      if (!allocOp.getOffset())
+        return {};
+      offset += *allocOp.getOffset();
+      value = allocOp.getInput();
+      continue;
+    }
+    return {};
+  }
+  return offset;
+}
+
+//===----------------------------------------------------------------------===//
+// Pass Implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct PartitionEvalPass
+    : public arc::impl::PartitionEvalBase<PartitionEvalPass> {
+  using PartitionEvalBase::PartitionEvalBase;
+
+  void runOnOperation() override;
+  LogicalResult partitionModel(ModelOp modelOp);
+  bool isPureOp(Operation *op);
+  bool isPureCallee(Operation *callee);
+
+  SymbolTable *symbolTable;
+  /// Whether a called function is known to not access any memory.
+  DenseMap<Operation *, bool> pureCallees;
+};
+
+/// A value computed in one partition and used in other partitions of a later
+/// phase. It is passed through a dedicated slot in the model storage.
+struct SpilledValue {
+  Value value;
+  unsigned offset;
+  llvm::SmallSetVector<unsigned, 2> consumers;
+};
+} // namespace
+
+void PartitionEvalPass::runOnOperation() {
+  symbolTable = &getAnalysis<SymbolTable>();
+  pureCallees.clear();
+  for (auto modelOp : getOperation().getOps<ModelOp>())
+    if (failed(partitionModel(modelOp)))
+      return signalPassFailure();
+}
+
+/// Check whether an op neither reads nor writes memory. Ops with nested regions
+/// are only checked for their own effects; the caller is expected to visit the
+/// nested ops separately.
+bool PartitionEvalPass::isPureOp(Operation *op) {
+  if (auto callOp = dyn_cast<CallOpInterface>(op)) {
+    auto callee =
+        llvm::dyn_cast_if_present<SymbolRefAttr>(callOp.getCallableForCallee());
+    if (!callee)
+      return false;
+    return isPureCallee(symbolTable->lookup(callee.getRootReference()));
+  }
+  if (op->hasTrait<OpTrait::HasRecursiveMemoryEffects>())
+    return true;
+  return isMemoryEffectFree(op);
+}
+
+/// Check whether calling the given function has no side effects. This is the
+/// case for arcs that have been lowered to functions.
+bool PartitionEvalPass::isPureCallee(Operation *callee) {
+  auto funcOp = dyn_cast_or_null<FunctionOpInterface>(callee);
+  if (!funcOp || funcOp.isExternal())
+    return false;
+  if (auto it = pureCallees.find(callee); it != pureCallees.end())
+    return it->second;
+
+  // Conservatively treat recursive calls as impure.
+  pureCallees[callee] = false;
+  bool isPure = !funcOp->walk([&](Operation *op) {
+                         if (op == callee || isPureOp(op))
+                           return WalkResult::advance();
+                         return WalkResult::interrupt();
+                       })
+                     .wasInterrupted();
+  pureCallees[callee] = isPure;
+  return isPure;
+}
+
+LogicalResult PartitionEvalPass::partitionModel(ModelOp modelOp) {
+  LLVM_DEBUG(llvm::dbgs() << "Partitioning `" << modelOp.getName() << "`\n");
+  Block &bodyBlock = modelOp.getBodyBlock();
+  Value storageArg = bodyBlock.getArgument(0);
+
+  // Collect the operations to be distributed across partitions. Allocations
+  // stay in the model body, and constants and storage accessors are copied
+  // into every partition that uses them.
+  SmallVector<Operation *> nodes;
+  DenseMap<Operation *, unsigned> nodeIds;
+  for (auto &op : bodyBlock) {
+    if (isa<InitialOp, FinalOp>(op))
+      return op.emitOpError("must be lowered before partitioning the model");
+    if (isa<AllocStateOp, AllocMemoryOp, RootInputOp, RootOutputOp>(op) ||
+        isCloneable(&op))
+      continue;
+    nodeIds.insert({&op, nodes.size()});
+    nodes.push_back(&op);
+  }
+  if (nodes.size() < 2 || numPartitions < 2)
+    return success();
+
+  // Group operations that access the same state, if any of them writes to it.
+  // Operations with side effects we cannot reason about are all grouped
+  // together such that they execute in their original order.
+  llvm::EquivalenceClasses<unsigned> groups;
+  for (unsigned id = 0; id < nodes.size(); ++id)
+    groups.insert(id);
+
+  DenseMap<uint64_t, SmallVector<unsigned, 2>> stateAccessors;
+  DenseSet<uint64_t> writtenStates;
+  std::optional<unsigned> firstOpaqueId;
+  for (unsigned id = 0; id < nodes.size(); ++id) {
+    bool isOpaque = false;
+    auto addAccess = [&](Value state, bool isWrite) {
+      auto offset = getStorageOffset(state, storageArg);
+      if (!offset) {
+        isOpaque = true;
+        return;
+      }
+      auto &accessors = stateAccessors[*offset];
+      if (accessors.empty() || accessors.back() != id)
+        accessors.push_back(id);
+      if (isWrite)
+        writtenStates.insert(*offset);
+    };
+    nodes[id]->walk([&](Operation *op) {
+      TypeSwitch<Operation *, void>(op)
+          .Case<StateReadOp>([&](auto op) { addAccess(op.getState(), false); })
+          .Case<StateWriteOp>([&](auto op) { addAccess(op.getState(), true); })
+          .Case<MemoryReadOp>(
+              [&](auto op) { addAccess(op.getMemory(), false); })
+          .Case<MemoryWriteOp>(
+              [&](auto op) { addAccess(op.getMemory(), true); })
+          .Default([&](auto *op) {
+            if (!isPureOp(op))
+              isOpaque = true;
+          });
+    });
+    if (!isOpaque)
+      continue;
+    if (firstOpaqueId)
+      groups.unionSets(*firstOpaqueId, id);
+    else
+      firstOpaqueId = id;
+  }
+  for (auto &[offset, accessors] : stateAccessors)
+    if (writtenStates.contains(offset))
+      for (auto id : ArrayRef(accessors).drop_front())
+        groups.unionSets(accessors.front(), id);
+
+  // Collect the users of each operation. Values that cannot be passed through
+  // storage force the user into the same group as the definition.
+  SmallVector<SmallVector<unsigned, 2>> users(nodes.size());
+  for (auto [id, node] : llvm::enumerate(nodes)) {
+    for (auto result : node->getResults()) {
+      for (auto *user : result.getUsers()) {
+        auto it = nodeIds.find(bodyBlock.findAncestorOpInBlock(*user));
+        if (it == nodeIds.end())
+          return node->emitOpError("result used outside of the model body");
+        if (it->second == id)
+          continue;
+        if (!isa<IntegerType>(result.getType()))
+          groups.unionSets(id, it->second);
+        else
+          users[id].push_back(it->second);
+      }
+    }
+  }
+
+  // Merge operations into the group of their users if all users are in the
+  // same group. This leaves values that fan out into multiple groups, such as
+  // clock edges, as the only values crossing group boundaries. Visiting the
+  // operations in reverse collapses chains of operations in one sweep.
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (unsigned id = nodes.size(); id-- > 0;) {
+      auto leader = groups.getLeaderValue(id);
+      std::optional<unsigned> userLeader;
+      bool hasMultipleUserGroups = false;
+      for (auto userId : users[id]) {
+        auto otherLeader = groups.getLeaderValue(userId);
+        if (otherLeader == leader)
+          continue;
+        if (userLeader && *userLeader != otherLeader) {
+          hasMultipleUserGroups = true;
+          break;
+        }
+        userLeader = otherLeader;
+      }
+      if (!userLeader || hasMultipleUserGroups)
+        continue;
+      groups.unionSets(id, *userLeader);
+      changed = true;
+    }
+  }
+
+  // Order the groups into phases, such that each group runs in a later phase
+  // than the groups it uses values from. Groups that depend on each other
+  // cyclically, and all groups depending on them, are merged and the ordering
+  // is recomputed.
+  SmallVector<unsigned> nodeGroups(nodes.size());
+  SmallVector<unsigned> groupPhases;
+  unsigned numGroups = 0;
+  while (true) {
+    DenseMap<unsigned, unsigned> groupIds;
+    for (unsigned id = 0; id < nodes.size(); ++id)
+      nodeGroups[id] =
+          groupIds.insert({groups.getLeaderValue(id), groupIds.size()})
+              .first->second;
+    numGroups = groupIds.size();
+
+    SmallVector<llvm::SmallSetVector<unsigned, 4>> groupUsers(numGroups);
+    SmallVector<unsigned> numPending(numGroups, 0);
+    for (unsigned id = 0; id < nodes.size(); ++id)
+      for (auto userId : users[id])
+        if (nodeGroups[id] != nodeGroups[userId] &&
+            groupUsers[nodeGroups[id]].insert(nodeGroups[userId]))
+          ++numPending[nodeGroups[userId]];
+
+    groupPhases.assign(numGroups, 0);
+    SmallVector<unsigned> worklist;
+    for (unsigned group = 0; group < numGroups; ++group)
+      if (numPending[group] == 0)
+        worklist.push_back(group);
+    unsigned numOrdered = 0;
+    while (!worklist.empty()) {
+      auto group = worklist.pop_back_val();
+      ++numOrdered;
+      for (auto user : groupUsers[group]) {
+        groupPhases[user] = std::max(groupPhases[user], groupPhases[group] + 1);
+        if (--numPending[user] == 0)
+          worklist.push_back(user);
+      }
+    }
+    if (numOrdered == numGroups)
+      break;
+
+    std::optional<unsigned> firstCyclicId;
+    for (unsigned id = 0; id < nodes.size(); ++id) {
+      if (numPending[nodeGroups[id]] == 0)
+        continue;
+      if (firstCyclicId)
+        groups.unionSets(*firstCyclicId, id);
+      else
+        firstCyclicId = id;
+    }
+  }
+  unsigned numPhases = *llvm::max_element(groupPhases) + 1;
+  LLVM_DEBUG(llvm::dbgs() << "- Found " << numGroups << " groups in "
+                          << numPhases << " phases\n");
+
+  // Estimate the cost of each group.
+  ArcCostModel costModel;
+  SmallVector<size_t> groupCosts(numGroups, 0);
+  for (unsigned id = 0; id < nodes.size(); ++id) {
+    auto &cost = groupCosts[nodeGroups[id]];
+    nodes[id]->walk(
+        [&](Operation *op) { cost += costModel.getCost(op).totalCost(); });
+  }
+
+  // Distribute the groups of each phase across partitions, placing the most
+  // expensive groups first into the least loaded partition.
+  SmallVector<SmallVector<unsigned>> phasePartitions(numPhases);
+  SmallVector<unsigned> groupPartitions(numGroups);
+  unsigned numTotalPartitions = 0;
+  bool hasConcurrentPartitions = false;
+  for (unsigned phase = 0; phase < numPhases; ++phase) {
+    SmallVector<unsigned> phaseGroups;
+    for (unsigned group = 0; group < numGroups; ++group)
+      if (groupPhases[group] == phase)
+        phaseGroups.push_back(group);
+    llvm::stable_sort(phaseGroups, [&](unsigned a, unsigned b) {
+      return groupCosts[a] > groupCosts[b];
+    });
+    unsigned numBins = std::min<unsigned>(numPartitions, phaseGroups.size());
+    SmallVector<size_t> binCosts(numBins, 0);
+    for (auto group : phaseGroups) {
+      auto *bin = llvm::min_element(binCosts);
+      *bin += groupCosts[group];
+      groupPartitions[group] = numTotalPartitions + (bin - binCosts.begin());
+    }
+    for (unsigned bin = 0; bin < numBins; ++bin)
+      phasePartitions[phase].push_back(numTotalPartitions + bin);
+    numTotalPartitions += numBins;
+    hasConcurrentPartitions |= numBins > 1;
+  }
+  if (!hasConcurrentPartitions)
+    return success();
+
+  // Allocate storage for the values crossing partition boundaries. The values
+  // produced by a partition start on their own cache line to avoid false
+  // sharing between partitions running concurrently.
+  SmallVector<SmallVector<SpilledValue>> partitionSpills(numTotalPartitions);
+  for (auto [id, node] : llvm::enumerate(nodes)) {
+    auto partition = groupPartitions[nodeGroups[id]];
+    for (auto result : node->getResults()) {
+      SpilledValue spill{result, 0, {}};
+      for (auto *user : result.getUsers()) {
+        auto userId = nodeIds.lookup(bodyBlock.findAncestorOpInBlock(*user));
+        auto userPartition = groupPartitions[nodeGroups[userId]];
+        if (userPartition != partition)
+          spill.consumers.insert(userPartition);
+      }
+      if (!spill.consumers.empty())
+        partitionSpills[partition].push_back(std::move(spill));
+    }
+  }
+
+  unsigned oldStorageSize = cast<StorageType>(storageArg.getType()).getSize();
+  unsigned currentByte = oldStorageSize;
+  for (auto &spills : partitionSpills) {
+    if (spills.empty())
+      continue;
+    currentByte = llvm::alignTo(currentByte, 64);
+    for (auto &spill : spills) {
+      unsigned numBytes = StateType::get(spill.value.getType()).getByteWidth();
+      currentByte = llvm::alignToPowerOf2(
+          currentByte, llvm::bit_ceil(std::min(numBytes, 16U)));
+      spill.offset = currentByte;
+      currentByte += numBytes;
+      ++numValuesSpilled;
+    }
+  }
+
+  // Grow the model storage to hold the spilled values, and update the
+  // functions that receive the storage accordingly.
+  Type storageType = StorageType::get(&getContext(), currentByte);
+  if (currentByte != oldStorageSize) {
+    storageArg.setType(storageType);
+    for (auto fnAttr : {modelOp.getInitialFnAttr(), modelOp.getFinalFnAttr()}) {
+      if (!fnAttr)
+        continue;
+      auto funcOp = symbolTable->lookup<func::FuncOp>(fnAttr.getValue());
+      if (!funcOp)
+        continue;
+      funcOp.setFunctionType(FunctionType::get(&getContext(), {storageType},
+                                               funcOp.getResultTypes()));
+      if (!funcOp.isExternal())
+        funcOp.getArgument(0).setType(storageType);
+    }
+  }
+
+  // Create the partition functions and move the operations into them.
+  OpBuilder funcBuilder(modelOp);
+  SmallVector<func::FuncOp> partitionFuncs;
+  for (unsigned partition = 0; partition < numTotalPartitions; ++partition) {
+    SmallString<32> funcName;
+    funcName.append(modelOp.getName());
+    funcName.append("_eval_part");
+    funcName.append(std::to_string(partition));
+    auto funcOp = func::FuncOp::create(
+        funcBuilder, modelOp.getLoc(), funcName,
+        funcBuilder.getFunctionType({storageType}, {}));
+    symbolTable->insert(funcOp); // uniquifies the name
+    funcOp.addEntryBlock();
+    partitionFuncs.push_back(funcOp);
+    ++numPartitionsCreated;
+  }
+  numPhasesCreated += numPhases;
+
+  for (auto [id, node] : llvm::enumerate(nodes)) {
+    auto &block = partitionFuncs[groupPartitions[nodeGroups[id]]].front();
+    node->moveBefore(&block, block.end());
+  }
+
+  // Write the spilled values to storage in the producing partition, and read
+  // them back at the start of each consuming partition.
+  for (auto &spills : partitionSpills) {
+    for (auto &spill : spills) {
+      auto loc = spill.value.getLoc();
+      auto stateType = StateType::get(spill.value.getType());
+      OpBuilder builder(&getContext());
+      builder.setInsertionPointAfterValue(spill.value);
+      auto state =
+          StorageGetOp::create(builder, loc, stateType, storageArg,
+                               builder.getI32IntegerAttr(spill.offset));
+      StateWriteOp::create(builder, loc, state, spill.value, Value{});
+
+      for (auto consumer : spill.consumers) {
+        auto funcOp = partitionFuncs[consumer];
+        builder.setInsertionPointToStart(&funcOp.front());
+        auto state =
+            StorageGetOp::create(builder, loc, stateType, storageArg,
+                                 builder.getI32IntegerAttr(spill.offset));
+        auto value = StateReadOp::create(builder, loc, state);
+        spill.value.replaceUsesWithIf(value, [&](OpOperand &use) {
+          return funcOp->isProperAncestor(use.getOwner());
+        });
+      }
+    }
+  }
+
+  // Isolate the partition functions by replacing uses of the model storage
+  // with the function argument, and copying constants and storage accessors
+  // into the functions.
+  for (auto funcOp : partitionFuncs) {
+    auto &block = funcOp.front();
+    auto builder = OpBuilder::atBlockBegin(&block);
+    DenseMap<Value, Value> mapping;
+    mapping.insert({storageArg, block.getArgument(0)});
+
+    std::function<Value(Value)> materialize = [&](Value value) -> Value {
+      if (auto mapped = mapping.lookup(value))
+        return mapped;
+      auto *defOp = value.getDefiningOp();
+      if (!defOp || defOp->getBlock() != &bodyBlock || !isCloneable(defOp))
+        return {};
+      IRMapping cloneMapping;
+      for (auto operand : defOp->getOperands()) {
+        auto mappedOperand = materialize(operand);
+        if (!mappedOperand)
+          return {};
+        cloneMapping.map(operand, mappedOperand);
+      }
+      auto *clonedOp = builder.clone(*defOp, cloneMapping);
+      for (auto [oldResult, newResult] :
+           llvm::zip(defOp->getResults(), clonedOp->getResults()))
+        mapping.insert({oldResult, newResult});
+      return mapping.lookup(value);
+    };
+
+    // Keep copied ops in front of all other ops in the function.
+    builder.setInsertionPoint(&block, block.begin());
+    auto result = funcOp.walk([&](Operation *op) {
+      for (auto &operand : op->getOpOperands()) {
+        if (funcOp.getBody().isAncestor(operand.get().getParentRegion()))
+          continue;
+        auto value = materialize(operand.get());
+        if (!value) {
+          auto d = op->emitError("operation uses value that cannot be moved "
+                                 "into a partition");
+          d.attachNote(modelOp.getLoc()) << "while partitioning model:";
+          return WalkResult::interrupt();
+        }
+        operand.set(value);
+      }
+      return WalkResult::advance();
+    });
+    if (result.wasInterrupted())
+      return failure();
+
+    builder.setInsertionPointToEnd(&block);
+    func::ReturnOp::create(builder, modelOp.getLoc());
+  }
+
+  // Remove constants and accessors that are no longer used in the model body,
+  // and replace the moved operations with calls to the partitions.
+  for (auto &op : llvm::make_early_inc_range(llvm::reverse(bodyBlock)))
+    if ((isa<StorageGetOp>(op) || op.hasTrait<OpTrait::ConstantLike>()) &&
+        op.use_empty())
+      op.erase();
+
+  auto builder = OpBuilder::atBlockEnd(&bodyBlock);
+  SmallVector<Attribute> phaseAttrs;
+  for (auto &partitions : phasePartitions) {
+    SmallVector<Attribute> partitionAttrs;
+    for (auto partition : partitions) {
+      auto funcOp = partitionFuncs[partition];
+      func::CallOp::create(builder, modelOp.getLoc(), funcOp,
+                           ValueRange{storageArg});
+      partitionAttrs.push_back(FlatSymbolRefAttr::get(funcOp.getSymNameAttr()));
+    }
+    phaseAttrs.push_back(builder.getArrayAttr(partitionAttrs));
+  }
+  modelOp.setEvalPartitionsAttr(builder.getArrayAttr(phaseAttrs));
+
+  return success();
+}
@@ -0,0 +1,157 @@
+//===- SkipUnchangedStates.cpp --------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/Arc/ArcOps.h"
+#include "circt/Dialect/Arc/ArcPasses.h"
+#include "circt/Dialect/Comb/CombOps.h"
+#include "circt/Dialect/HW/HWOps.h"
+#include "circt/Support/Namespace.h"
+#include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "arc-skip-unchanged-states"
+
+namespace circt {
+namespace arc {
+#define GEN_PASS_DEF_SKIPUNCHANGEDSTATES
+#include "circt/Dialect/Arc/ArcPasses.h.inc"
+} // namespace arc
+} // namespace circt
+
+using namespace mlir;
+using namespace circt;
+using namespace arc;
+
+//===----------------------------------------------------------------------===//
+// Pass Implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct SkipUnchangedStatesPass
+    : public arc::impl::SkipUnchangedStatesBase<SkipUnchangedStatesPass> {
+  using SkipUnchangedStatesBase::SkipUnchangedStatesBase;
+
+  void runOnOperation() override;
+  bool shouldGuard(StateOp stateOp, DefineOp defOp);
+  DefineOp getGuardArc(DefineOp defOp);
+  void guardState(StateOp stateOp, DefineOp guardArc);
+
+  Namespace arcNamespace;
+  /// The arcs recording the inputs of each guarded arc, created on demand.
+  DenseMap<DefineOp, DefineOp> guardArcs;
+  /// The number of ops in each arc, computed on demand.
+  DenseMap<DefineOp, unsigned> arcSizes;
+};
+} // namespace
+
+void SkipUnchangedStatesPass::runOnOperation() {
+  arcNamespace.clear();
+  guardArcs.clear();
+  arcSizes.clear();
+
+  SymbolTable symbolTable(getOperation());
+  for (auto defOp : getOperation().getOps<DefineOp>())
+    arcNamespace.newName(defOp.getSymName());
+
+  SmallVector<StateOp> stateOps;
+  getOperation().walk([&](StateOp stateOp) { stateOps.push_back(stateOp); });
+  for (auto stateOp : stateOps) {
+    auto defOp = symbolTable.lookup<DefineOp>(stateOp.getArc());
+    if (!defOp || !shouldGuard(stateOp, defOp))
+      continue;
+    guardState(stateOp, getGuardArc(defOp));
+    ++numGuardedStates;
+  }
+}
+
+/// Check whether the arc of a state is worth skipping when the state's inputs
+/// have not changed.
+bool SkipUnchangedStatesPass::shouldGuard(StateOp stateOp, DefineOp defOp) {
+  if (!stateOp.getClock() || stateOp.getLatency() != 1 ||
+      stateOp.getInputs().empty())
+    return false;
+
+  // States that feed back into themselves are updated on almost every clock
+  // edge, which makes the comparison pure overhead.
+  for (auto input : stateOp.getInputs()) {
+    if (input.getDefiningOp() == stateOp)
+      return false;
+    if (hw::getBitWidth(input.getType()) <= 0)
+      return false;
+  }
+
+  auto &size = arcSizes[defOp];
+  if (size == 0)
+    defOp.getBodyBlock().walk([&](Operation *op) {
+      if (!isa<arc::OutputOp>(op))
+        ++size;
+    });
+  return size >= minArcOps;
+}
+
+/// Get or create the arc for a state recording the inputs of the given arc,
+/// together with a bit indicating that the record is valid.
+DefineOp SkipUnchangedStatesPass::getGuardArc(DefineOp defOp) {
+  auto &guardArc = guardArcs[defOp];
+  if (guardArc)
+    return guardArc;
+
+  ImplicitLocOpBuilder builder(defOp.getLoc(), defOp);
+  auto inputTypes = defOp.getArgumentTypes();
+  SmallVector<Type> resultTypes;
+  resultTypes.push_back(builder.getI1Type());
+  resultTypes.append(inputTypes.begin(), inputTypes.end());
+  guardArc = DefineOp::create(
+      builder, arcNamespace.newName(defOp.getSymName() + "_inputs"),
+      builder.getFunctionType(inputTypes, resultTypes));
+
+  auto *block = builder.createBlock(&guardArc.getBody());
+  SmallVector<Value> results;
+  results.push_back(hw::ConstantOp::create(builder, builder.getI1Type(), 1));
+  for (auto type : inputTypes)
+    results.push_back(block->addArgument(type, defOp.getLoc()));
+  arc::OutputOp::create(builder, results);
+  return guardArc;
+}
+
+/// Add a companion state that records the inputs of the given state, and
+/// only enable the state if its inputs differ from the recorded ones.
+void SkipUnchangedStatesPass::guardState(StateOp stateOp, DefineOp guardArc) {
+  LLVM_DEBUG(llvm::dbgs() << "Guarding " << stateOp << "\n");
+  ImplicitLocOpBuilder builder(stateOp.getLoc(), stateOp);
+  auto guardOp =
+      StateOp::create(builder, guardArc, stateOp.getClock(), Value{},
+                      /*latency=*/1, stateOp.getInputs());
+  if (auto reset = stateOp.getReset())
+    guardOp.getResetMutable().assign(reset);
+
+  // The arc has to be evaluated if the recorded inputs are invalid, or any of
+  // the inputs has changed since.
+  SmallVector<Value> changed;
+  changed.push_back(comb::createOrFoldNot(guardOp.getResult(0), builder,
+                                          /*twoState=*/true));
+  for (auto [input, recorded] :
+       llvm::zip(stateOp.getInputs(), guardOp.getResults().drop_front())) {
+    Value lhs = input, rhs = recorded;
+    if (!isa<IntegerType>(lhs.getType())) {
+      auto intType = builder.getIntegerType(hw::getBitWidth(lhs.getType()));
+      lhs = hw::BitcastOp::create(builder, intType, lhs);
+      rhs = hw::BitcastOp::create(builder, intType, rhs);
+    }
+    changed.push_back(comb::ICmpOp::create(builder, comb::ICmpPredicate::ne,
+                                           lhs, rhs, /*twoState=*/true));
+  }
+  Value enable = comb::OrOp::create(builder, changed, /*twoState=*/true);
+  if (auto oldEnable = stateOp.getEnable())
+    enable = comb::AndOp::create(builder, oldEnable, enable, /*twoState=*/true);
+
+  stateOp.getEnableMutable().assign(enable);
+  guardOp.getEnableMutable().assign(enable);
+}
@@ -7,7 +7,8 @@
 //===----------------------------------------------------------------------===//
 //
 // Cosim DPI function implementations. Mostly C-C++ gaskets to the C++
-// RpcServer.
+// RpcServer, or the ShmServer when the COSIM_SHM environment variable names a
+// shared memory segment to use instead.
 //
 // These function signatures were generated by an HW simulator (see dpi.h) so
 // we don't change them to be more rational here. The resulting code gets
@@ -20,6 +21,9 @@
 #include "esi/Context.h"
 #include "esi/Ports.h"
 #include "esi/backends/RpcServer.h"
+#ifdef ESI_COSIM_SHM
+#include "esi/backends/ShmServer.h"
+#endif
 
 #include <algorithm>
 #include <cassert>
@@ -36,8 +40,20 @@ static FILE *logFile;
 // and then let's hope for static object teardown order determinism :).
 static std::unique_ptr<Context> context = nullptr;
 static std::unique_ptr<RpcServer> server = nullptr;
+#ifdef ESI_COSIM_SHM
+static std::unique_ptr<backends::shm::ShmServer> shmServer = nullptr;
+#endif
 static std::mutex serverMutex;
 
+/// Check whether either of the servers is running.
+static bool serverRunning() {
+#ifdef ESI_COSIM_SHM
+  if (shmServer != nullptr)
+    return true;
+#endif
+  return server != nullptr;
+}
+
 /// Get the logger from the context.
 static Logger &getLogger() {
   static ConsoleLogger fallbackLogger(Logger::Level::Debug);
@@ -85,6 +101,17 @@ static int findPort() {
   return std::strtoull(portEnv, nullptr, 10);
 }
 
+#ifdef ESI_COSIM_SHM
+/// Get a size in bytes from an environment variable, or the default if it
+/// isn't set.
+static size_t getEnvSize(const char *name, size_t defaultSize) {
+  const char *sizeEnv = getenv(name);
+  if (sizeEnv == nullptr)
+    return defaultSize;
+  return std::strtoull(sizeEnv, nullptr, 10);
+}
+#endif
+
 /// Check that an array is an array of bytes and has some size.
 // NOLINTNEXTLINE(misc-misplaced-const)
 static int validateSvOpenArray(const svOpenArrayHandle data,
@@ -127,6 +154,42 @@ static int validateSvOpenArray(const svOpenArrayHandle data,
 std::map<std::string, ReadChannelPort &> readPorts;
 std::map<ReadChannelPort *, std::future<MessageData>> readFutures;
 std::map<std::string, WriteChannelPort &> writePorts;
+#ifdef ESI_COSIM_SHM
+std::map<std::string, backends::shm::ShmServer::Channel &> shmReadPorts;
+std::map<std::string, backends::shm::ShmServer::Channel &> shmWritePorts;
+#endif
+
+/// Poll for a message from the client. Returns 0 and sets `gotMsg` on
+/// success, negative if the endpoint isn't registered.
+static int pollMessage(char *endpointId, MessageData &msg, bool &gotMsg) {
+  gotMsg = false;
+#ifdef ESI_COSIM_SHM
+  if (shmServer != nullptr) {
+    // Since the simulator polls every tick, use the opportunity to move along
+    // messages which couldn't be sent to the client earlier.
+    shmServer->flush();
+    auto portIt = shmReadPorts.find(endpointId);
+    if (portIt == shmReadPorts.end())
+      return -4;
+    gotMsg = portIt->second.tryRead(msg);
+    return 0;
+  }
+#endif
+
+  auto portIt = readPorts.find(endpointId);
+  if (portIt == readPorts.end())
+    return -4;
+
+  ReadChannelPort &port = portIt->second;
+  std::future<MessageData> &f = readFutures.at(&port);
+  // Poll for a message.
+  if (f.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready)
+    return 0;
+  msg = f.get();
+  f = port.readAsync();
+  gotMsg = true;
+  return 0;
+}
 
 // Register simulated device endpoints.
 // - return 0 on success, non-zero on failure (duplicate EP registered).
@@ -150,6 +213,22 @@ DPI int sv2cCosimserverEpRegister(char *endpointId, char *fromHostTypeIdC,
     return -3;
   }
 
+#ifdef ESI_COSIM_SHM
+  if (shmServer != nullptr) {
+    if (shmReadPorts.contains(endpointId)) {
+      getLogger().error("cosim", "Endpoint already registered!");
+      return -3;
+    }
+    if (!fromHostTypeId.empty())
+      shmReadPorts.emplace(endpointId, shmServer->registerReadPort(
+                                           endpointId, fromHostTypeId));
+    else
+      shmWritePorts.emplace(endpointId, shmServer->registerWritePort(
+                                            endpointId, toHostTypeId));
+    return 0;
+  }
+#endif
+
   if (!fromHostTypeId.empty()) {
     ReadChannelPort &port =
         server->registerReadPort(endpointId, fromHostTypeId);
@@ -177,25 +256,20 @@ DPI int sv2cCosimserverEpTryGet(char *endpointId,
                                 // NOLINTNEXTLINE(misc-misplaced-const)
                                 const svOpenArrayHandle data,
                                 unsigned int *dataSize) {
-  if (server == nullptr)
+  if (!serverRunning())
     return -1;
 
-  auto portIt = readPorts.find(endpointId);
-  if (portIt == readPorts.end()) {
+  MessageData msg;
+  bool gotMsg;
+  if (int rc = pollMessage(endpointId, msg, gotMsg)) {
     getLogger().error("cosim", "Endpoint not found in registry!");
-    return -4;
+    return rc;
   }
-
-  ReadChannelPort &port = portIt->second;
-  std::future<MessageData> &f = readFutures.at(&port);
-  // Poll for a message.
-  if (f.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+  if (!gotMsg) {
     // No message.
     *dataSize = 0;
     return 0;
   }
-  MessageData msg = f.get();
-  f = port.readAsync();
   log(endpointId, false, msg);
 
   // Do the validation only if there's a message available. Since the
@@ -248,7 +322,7 @@ DPI int sv2cCosimserverEpTryGet(char *endpointId,
 DPI int sv2cCosimserverEpTryPut(char *endpointId,
                                 // NOLINTNEXTLINE(misc-misplaced-const)
                                 const svOpenArrayHandle data, int dataSize) {
-  if (server == nullptr)
+  if (!serverRunning())
     return -1;
 
   if (validateSvOpenArray(data, sizeof(int8_t)) != 0) {
@@ -270,11 +344,25 @@ DPI int sv2cCosimserverEpTryPut(char *endpointId,
   }
 
   // Copy the message data into 'blob'.
-  std::vector<uint8_t> dataVec(dataSize);
+  auto blob =
+      std::make_unique<esi::MessageData>(MessageData::allocate(dataSize));
+  uint8_t *blobBytes = blob->getMutableBytes();
   for (int i = 0; i < dataSize; ++i) {
-    dataVec[i] = *(char *)svGetArrElemPtr1(data, i);
+    blobBytes[i] = *(char *)svGetArrElemPtr1(data, i);
   }
-  auto blob = std::make_unique<esi::MessageData>(dataVec);
+
+#ifdef ESI_COSIM_SHM
+  if (shmServer != nullptr) {
+    auto portIt = shmWritePorts.find(endpointId);
+    if (portIt == shmWritePorts.end()) {
+      getLogger().error("cosim", "Endpoint not found in registry!");
+      return -4;
+    }
+    log(endpointId, true, *blob);
+    portIt->second.write(*blob);
+    return 0;
+  }
+#endif
 
   // Queue the blob.
   auto portIt = writePorts.find(endpointId);
@@ -293,10 +381,19 @@ DPI int sv2cCosimserverEpTryPut(char *endpointId,
 DPI void sv2cCosimserverFinish() {
   std::lock_guard<std::mutex> g(serverMutex);
   getLogger().info("cosim", "Tearing down RPC server.");
+#ifdef ESI_COSIM_SHM
+  if (shmServer != nullptr) {
+    shmServer->stop();
+    shmServer = nullptr;
+    shmReadPorts.clear();
+    shmWritePorts.clear();
+  }
+#endif
   if (server != nullptr) {
     server->stop();
     server = nullptr;
-
+  }
+  if (logFile) {
     fclose(logFile);
     logFile = nullptr;
   }
@@ -309,7 +406,7 @@ DPI int sv2cCosimserverInit() {
   if (context == nullptr)
     context = Context::withLogger<ConsoleLogger>(Logger::Level::Debug);
 
-  if (server == nullptr) {
+  if (!serverRunning()) {
     // Open log file if requested.
     const char *logFN = getenv("COSIM_DEBUG_FILE");
     if (logFN != nullptr) {
@@ -317,6 +414,21 @@ DPI int sv2cCosimserverInit() {
       logFile = fopen(logFN, "w");
     }
 
+#ifdef ESI_COSIM_SHM
+    // Use shared memory instead of RPC if a segment name is given.
+    if (const char *shmName = getenv("COSIM_SHM")) {
+      std::string name = shmName;
+      if (!name.starts_with("/"))
+        name = "/" + name;
+      getLogger().info("cosim", "Starting shared memory server.");
+      shmServer = std::make_unique<backends::shm::ShmServer>(*context);
+      shmServer->run(name, getEnvSize("COSIM_SHM_SIZE", 256 << 20),
+                     getEnvSize("COSIM_SHM_RING_SIZE", 1 << 20),
+                     getEnvSize("COSIM_SHM_BACKLOG", 1024));
+      return 0;
+    }
+#endif
+
     // Find the port and run.
     getLogger().info("cosim", "Starting RPC server.");
     server = std::make_unique<RpcServer>(*context);
@@ -330,7 +442,7 @@ DPI int sv2cCosimserverInit() {
 DPI void
 sv2cCosimserverSetManifest(int esiVersion,
                            const svOpenArrayHandle compressedManifest) {
-  if (server == nullptr)
+  if (!serverRunning())
     sv2cCosimserverInit();
 
   if (validateSvOpenArray(compressedManifest, sizeof(int8_t)) != 0) {
@@ -349,6 +461,12 @@ sv2cCosimserverSetManifest(int esiVersion,
   getLogger().info("cosim",
                    std::format("Setting manifest (esiVersion={}, size={})",
                                esiVersion, size));
+#ifdef ESI_COSIM_SHM
+  if (shmServer != nullptr) {
+    shmServer->setManifest(esiVersion, blob);
+    return;
+  }
+#endif
   server->setManifest(esiVersion, blob);
 }
 
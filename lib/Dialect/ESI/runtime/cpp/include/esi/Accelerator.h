@@ -25,9 +25,12 @@
 #include "esi/Design.h"
 #include "esi/Engines.h"
 #include "esi/Manifest.h"
+#include "esi/Metrics.h"
 #include "esi/Ports.h"
 #include "esi/Services.h"
+#include "esi/backends/TraceFormat.h"
 
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
@@ -67,6 +70,10 @@ public:
               std::vector<services::Service *> services,
               std::vector<std::unique_ptr<BundlePort>> &&ports)
       : HWModule(info, std::move(children), services, std::move(ports)) {}
+  Accelerator(std::optional<ModuleInfo> info, ChildBuilder buildChildren,
+              std::vector<services::Service *> services,
+              std::vector<std::unique_ptr<BundlePort>> &&ports)
+      : HWModule(info, std::move(buildChildren), services, std::move(ports)) {}
 };
 
 //===----------------------------------------------------------------------===//
@@ -126,6 +133,26 @@ public:
     return clientEngines[id];
   }
 
+  /// Start recording throughput and latency metrics on the channel ports.
+  /// Only ports created afterwards are instrumented, so this should be called
+  /// before building the accelerator. Returns the existing metrics if they are
+  /// already enabled.
+  Metrics &enableMetrics();
+  /// Get the metrics, or null if they aren't enabled.
+  Metrics *getMetrics() const { return metrics.get(); }
+
+  /// Start recording the messages on all the channel ports and the MMIO
+  /// accesses into a binary trace at `path`, which the trace backend can
+  /// replay. Works with any backend. Like metrics, only ports and services
+  /// created afterwards are recorded, so this should be called before building
+  /// the accelerator. Throws if a trace is already being recorded.
+  backends::trace::BinaryTraceWriter &
+  recordTrace(const std::filesystem::path &path);
+  /// Get the trace being recorded, or null if there is none.
+  backends::trace::BinaryTraceWriter *getTraceRecorder() const {
+    return traceRecorder.get();
+  }
+
   Accelerator &getAccelerator() {
     if (!ownedAccelerator)
       throw std::runtime_error(
@@ -147,6 +174,12 @@ protected:
                                  const ServiceImplDetails &details,
                                  const HWClientDetails &clients) = 0;
 
+  /// Port metrics, if enabled. Declared before the engines so that it outlives
+  /// the ports which record into it.
+  std::unique_ptr<Metrics> metrics;
+  /// Trace being recorded, if any. Also outlives the ports.
+  std::unique_ptr<backends::trace::BinaryTraceWriter> traceRecorder;
+
   /// Collection of owned engines.
   std::map<AppIDPath, std::unique_ptr<Engine>> ownedEngines;
   /// Mapping of clients to their servicing engines.
@@ -192,7 +225,9 @@ struct RegisterAccelerator {
 } // namespace registry
 
 /// Background thread which services various requests. Currently, it listens on
-/// ports and calls callbacks for incoming messages on said ports.
+/// ports and calls callbacks for incoming messages on said ports. The thread
+/// sleeps until a port signals that data is available, waking up periodically
+/// only if there are modules to poll.
 class AcceleratorServiceThread {
 public:
   AcceleratorServiceThread();
@@ -207,6 +242,16 @@ public:
   /// Poll this module.
   void addPoll(HWModule &module);
 
+  /// Set how long the thread sleeps between polls of the modules when none of
+  /// them made progress.
+  void setPollInterval(std::chrono::microseconds interval);
+
+  /// Run the listener callbacks on a pool of `numWorkers` threads instead of
+  /// on the service thread, such that a slow callback does not stall the other
+  /// ports. Callbacks for the same port are still called one at a time and in
+  /// order. Can only be called once.
+  void startCallbackWorkers(unsigned numWorkers);
+
   /// Instruct the service thread to stop running.
   void stop();
 
@@ -21,8 +21,11 @@
 #define ESI_CLI_H
 
 #include "CLI/CLI.hpp"
+#include "esi/Accelerator.h"
 #include "esi/Context.h"
 
+#include <ostream>
+
 namespace esi {
 
 /// Common options and code for ESI runtime tools.
@@ -39,6 +42,16 @@ public:
     add_flag("--trace", trace, "Enable trace logging");
 #endif
     add_flag("-v,--verbose", verbose, "Enable verbose (info) logging");
+    add_flag("--metrics", metrics,
+             "Record channel throughput and latency metrics and print them "
+             "as JSON on exit");
+    add_option("--record-trace", traceFile,
+               "Record a binary trace of the session, which the trace backend "
+               "can replay");
+    add_flag("--lazy-manifest", manifestOptions.lazy,
+             "Parse the manifest and build the design hierarchy lazily");
+    add_option("--manifest-cache-dir", manifestCacheDir,
+               "Cache the lazy manifest index in this directory");
     require_subcommand(0, 1);
   }
 
@@ -53,11 +66,26 @@ public:
       ctxt = Context::withLogger<ConsoleLogger>(Logger::Level::Info);
     else
       ctxt = Context::withLogger<ConsoleLogger>(Logger::Level::Warning);
+    manifestOptions.indexCacheDir = manifestCacheDir;
+    ctxt->setManifestOptions(manifestOptions);
     return 0;
   }
 
   /// Connect to the accelerator using the specified backend and connection.
-  AcceleratorConnection *connect() { return ctxt->connect(backend, connStr); }
+  AcceleratorConnection *connect() {
+    AcceleratorConnection *conn = ctxt->connect(backend, connStr);
+    if (metrics)
+      conn->enableMetrics();
+    if (!traceFile.empty())
+      conn->recordTrace(traceFile);
+    return conn;
+  }
+
+  /// Print the metrics recorded on `conn` if they were requested.
+  void printMetrics(std::ostream &os, AcceleratorConnection &conn) const {
+    if (metrics && conn.getMetrics())
+      os << conn.getMetrics()->toJson() << std::endl;
+  }
 
   /// Get the context.
   Context &getContext() { return *ctxt; }
@@ -70,6 +98,10 @@ protected:
   bool trace = false;
   bool debug = false;
   bool verbose = false;
+  bool metrics = false;
+  std::string traceFile;
+  ManifestOptions manifestOptions;
+  std::string manifestCacheDir;
 };
 
 } // namespace esi
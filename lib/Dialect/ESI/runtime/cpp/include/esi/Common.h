@@ -17,7 +17,9 @@
 #define ESI_COMMON_H
 
 #include <any>
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <optional>
 #include <span>
@@ -107,50 +109,129 @@ struct HWClientDetail {
 using HWClientDetails = std::vector<HWClientDetail>;
 using ServiceImplDetails = std::map<std::string, std::any>;
 
-/// A logical chunk of data representing serialized data. Currently, just a
-/// wrapper for a vector of bytes, which is not efficient in terms of memory
-/// copying. This will change in the future as will the API.
+/// Reference counted storage for the bytes of one or more MessageData objects.
+/// Buffers are either allocated from a pool, adopt a std::vector, or wrap
+/// externally owned memory (e.g. DMA regions or mmapped files).
+class MessageBuffer {
+public:
+  MessageBuffer(const MessageBuffer &) = delete;
+  MessageBuffer &operator=(const MessageBuffer &) = delete;
+
+  void retain() { refs.fetch_add(1, std::memory_order_relaxed); }
+  void release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      destroy();
+  }
+  /// Returns true if there is exactly one reference to this buffer.
+  bool isUnique() const { return refs.load(std::memory_order_acquire) == 1; }
+
+  uint8_t *getData() const { return data; }
+  size_t getCapacity() const { return capacity; }
+
+  /// Allocate a buffer of at least `size` bytes from the global buffer pool.
+  /// The buffer is returned to the pool once the last reference is dropped.
+  static MessageBuffer *allocate(size_t size);
+  /// Adopt the storage of a vector.
+  static MessageBuffer *adopt(std::vector<uint8_t> &&data);
+  /// Wrap memory owned by someone else. `release` is called once the last
+  /// reference to the buffer is dropped.
+  static MessageBuffer *wrap(uint8_t *data, size_t size,
+                             std::function<void()> release);
+
+protected:
+  MessageBuffer(uint8_t *data, size_t capacity)
+      : data(data), capacity(capacity) {}
+  virtual ~MessageBuffer() = default;
+  /// Called when the last reference is dropped.
+  virtual void destroy() { delete this; }
+
+  std::atomic<uint32_t> refs = 1;
+  uint8_t *data;
+  size_t capacity;
+};
+
+/// A logical chunk of data representing serialized data. The bytes live in a
+/// reference counted MessageBuffer, so copying a MessageData or taking a slice
+/// of it does not copy the data. The data is immutable while shared.
 class MessageData {
 public:
-  /// Adopts the data vector buffer.
   MessageData() = default;
+  /// Copy the data into a buffer from the pool.
   MessageData(std::span<const uint8_t> data)
-      : data(data.data(), data.data() + data.size()) {}
-  MessageData(std::vector<uint8_t> &data) : data(std::move(data)) {}
-  MessageData(std::vector<uint8_t> &&data) : data(std::move(data)) {}
-  MessageData(const uint8_t *data, size_t size) : data(data, data + size) {}
-  ~MessageData() = default;
+      : MessageData(data.data(), data.size()) {}
+  MessageData(const uint8_t *data, size_t size);
+  /// Adopts the data vector buffer.
+  MessageData(std::vector<uint8_t> &data) : MessageData(std::move(data)) {}
+  MessageData(std::vector<uint8_t> &&data);
+  ~MessageData() { reset(); }
 
-  const uint8_t *getBytes() const { return data.data(); }
+  MessageData(const MessageData &other)
+      : buffer(other.buffer), bytes(other.bytes), length(other.length) {
+    if (buffer)
+      buffer->retain();
+  }
+  MessageData(MessageData &&other) noexcept
+      : buffer(other.buffer), bytes(other.bytes), length(other.length) {
+    other.buffer = nullptr;
+    other.bytes = nullptr;
+    other.length = 0;
+  }
+  MessageData &operator=(MessageData other) noexcept {
+    std::swap(buffer, other.buffer);
+    std::swap(bytes, other.bytes);
+    std::swap(length, other.length);
+    return *this;
+  }
+
+  /// Allocate an uninitialized message of `size` bytes from the buffer pool,
+  /// to be filled in through `getMutableBytes()`.
+  static MessageData allocate(size_t size);
+  /// Wrap memory owned by someone else without copying it. `release` is
+  /// called once the message and all of its copies and slices are destroyed.
+  static MessageData wrap(const uint8_t *data, size_t size,
+                          std::function<void()> release = nullptr);
+
+  const uint8_t *getBytes() const { return bytes; }
 
-  /// Get the data as a vector of bytes.
-  const std::vector<uint8_t> &getData() const { return data; }
+  /// Get writable access to the data. Copies the data first if the buffer is
+  /// shared with other messages or not owned by the runtime.
+  uint8_t *getMutableBytes();
+
+  /// Get a message referring to `size` bytes starting at `offset` in this one,
+  /// sharing the underlying buffer.
+  MessageData slice(size_t offset, size_t size) const;
+
+  /// Get a view of the data. Valid as long as this message is alive.
+  std::span<const uint8_t> getData() const { return {bytes, length}; }
 
   /// Implicit conversion to a vector/span of bytes, to play nice with other
-  /// APIs that accept bytearray-like things.
-  operator const std::vector<uint8_t> &() const { return data; }
-  operator std::span<const uint8_t>() const { return data; }
+  /// APIs that accept bytearray-like things. The vector is a copy.
+  operator std::vector<uint8_t>() const {
+    return std::vector<uint8_t>(bytes, bytes + length);
+  }
+  operator std::span<const uint8_t>() const { return getData(); }
 
-  /// Move the data out of this object.
-  std::vector<uint8_t> takeData() { return std::move(data); }
+  /// Move the data out of this object. Only avoids the copy if the data was
+  /// adopted from a vector and is not shared.
+  std::vector<uint8_t> takeData();
 
   /// Get the size of the data in bytes.
-  size_t getSize() const { return data.size(); }
+  size_t getSize() const { return length; }
   size_t size() const { return getSize(); }
 
   /// Returns true if this message contains no data.
-  bool empty() const { return data.empty(); }
+  bool empty() const { return length == 0; }
 
   /// Cast to a type. Throws if the size of the data does not match the size of
   /// the message. The lifetime of the resulting pointer is tied to the lifetime
   /// of this object.
   template <typename T>
   const T *as() const {
-    if (data.size() != sizeof(T))
+    if (length != sizeof(T))
       throw std::runtime_error("Data size does not match type size. Size is " +
-                               std::to_string(data.size()) + ", expected " +
+                               std::to_string(length) + ", expected " +
                                std::to_string(sizeof(T)) + ".");
-    return reinterpret_cast<const T *>(data.data());
+    return reinterpret_cast<const T *>(bytes);
   }
 
   /// Cast from a type to its raw bytes.
@@ -163,7 +244,17 @@ public:
   std::string toHex() const;
 
 private:
-  std::vector<uint8_t> data;
+  MessageData(MessageBuffer *buffer, const uint8_t *bytes, size_t length)
+      : buffer(buffer), bytes(bytes), length(length) {}
+  void reset() {
+    if (buffer)
+      buffer->release();
+    buffer = nullptr;
+  }
+
+  MessageBuffer *buffer = nullptr;
+  const uint8_t *bytes = nullptr;
+  size_t length = 0;
 };
 
 } // namespace esi
@@ -20,6 +20,7 @@
 #include "esi/Types.h"
 
 #include <exception>
+#include <filesystem>
 #include <map>
 #include <memory>
 #include <vector>
@@ -27,6 +28,20 @@
 namespace esi {
 class AcceleratorConnection;
 
+/// Options controlling how manifests are parsed.
+struct ManifestOptions {
+  /// Parse the types, module metadata, and instances only when they are first
+  /// used rather than all up front. Instances build their children (and
+  /// request the children's services and ports) when the children are first
+  /// accessed, on whichever thread accesses them. Speeds up connecting to
+  /// large designs considerably.
+  bool lazy = false;
+  /// Lazy manifests index the manifest's JSON so that the parts can be parsed
+  /// individually. If set, the index is cached in this directory (typically
+  /// the one containing the manifest) and reused for identical manifests.
+  std::filesystem::path indexCacheDir;
+};
+
 /// AcceleratorConnections, Accelerators, and Manifests must all share a
 /// context. It owns all the types, uniquifying them. It also owns the
 /// connections (which own the Accelerators). When it is destroyed, all
@@ -60,6 +75,12 @@ public:
   /// returns a non-owning pointer.
   AcceleratorConnection *connect(std::string backend, std::string connection);
 
+  /// Set the options for manifests which are parsed without explicit ones.
+  void setManifestOptions(ManifestOptions options) {
+    manifestOptions = std::move(options);
+  }
+  const ManifestOptions &getManifestOptions() const { return manifestOptions; }
+
   /// Register a logger with the accelerator. Assumes ownership of the logger.
   void setLogger(std::unique_ptr<Logger> logger) {
     if (!logger)
@@ -71,6 +92,7 @@ public:
 private:
   std::unique_ptr<Logger> logger;
   std::vector<std::unique_ptr<AcceleratorConnection>> connections;
+  ManifestOptions manifestOptions;
 
 private:
   using TypeCache = std::map<Type::ID, std::unique_ptr<Type>>;
@@ -34,6 +34,9 @@
 #include "esi/Ports.h"
 #include "esi/Services.h"
 
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <string>
 
 namespace esi {
@@ -49,11 +52,17 @@ public:
   HWModule(const HWModule &) = delete;
   HWModule &operator=(const HWModule &) = delete;
 
+  /// Builds the children of a module the first time they are accessed.
+  using ChildBuilder = std::function<std::vector<std::unique_ptr<Instance>>()>;
+
 protected:
   HWModule(std::optional<ModuleInfo> info,
            std::vector<std::unique_ptr<Instance>> children,
            std::vector<services::Service *> services,
            std::vector<std::unique_ptr<BundlePort>> &&ports);
+  HWModule(std::optional<ModuleInfo> info, ChildBuilder buildChildren,
+           std::vector<services::Service *> services,
+           std::vector<std::unique_ptr<BundlePort>> &&ports);
 
 public:
   virtual ~HWModule() = default;
@@ -62,13 +71,17 @@ public:
   std::optional<ModuleInfo> getInfo() const { return info; }
   /// Get a vector of the module's children in a deterministic order.
   std::vector<const Instance *> getChildrenOrdered() const {
+    buildChildren();
     std::vector<const Instance *> ret;
     for (const auto &c : children)
       ret.push_back(c.get());
     return ret;
   }
   /// Access the module's children by ID.
-  const std::map<AppID, Instance *> &getChildren() const { return childIndex; }
+  const std::map<AppID, Instance *> &getChildren() const {
+    buildChildren();
+    return childIndex;
+  }
   /// Get the module's ports in a deterministic order.
   std::vector<std::reference_wrapper<BundlePort>> getPortsOrdered() const {
     std::vector<std::reference_wrapper<BundlePort>> ret;
@@ -84,8 +97,8 @@ public:
   }
 
   /// Master poll method. Calls the `poll` method on all locally owned ports and
-  /// the master `poll` method on all of the children. Returns true if any of
-  /// the `poll` calls returns true.
+  /// the master `poll` method on all of the children which have been built.
+  /// Returns true if any of the `poll` calls returns true.
   bool poll();
 
   /// Attempt to resolve a path to a module instance. If a child is not found,
@@ -98,9 +111,18 @@ public:
   BundlePort *resolvePort(const AppIDPath &path, AppIDPath &lastLookup) const;
 
 protected:
+  /// Run the child builder, if any and if it hasn't run yet. Thread safe.
+  void buildChildren() const;
+
   const std::optional<ModuleInfo> info;
-  const std::vector<std::unique_ptr<Instance>> children;
-  const std::map<AppID, Instance *> childIndex;
+  // The children are logically const but may be built lazily.
+  mutable std::vector<std::unique_ptr<Instance>> children;
+  mutable std::map<AppID, Instance *> childIndex;
+  mutable ChildBuilder childBuilder;
+  mutable std::once_flag childrenOnce;
+  /// Set once `children` is complete so that `poll` can skip unbuilt ones
+  /// without taking a lock.
+  mutable std::atomic<bool> childrenBuilt;
   const std::vector<services::Service *> services;
   const std::vector<std::unique_ptr<BundlePort>> ports;
   const std::map<AppID, BundlePort &> portIndex;
@@ -119,6 +141,12 @@ public:
            std::vector<std::unique_ptr<BundlePort>> &&ports)
       : HWModule(info, std::move(children), services, std::move(ports)),
         id(id) {}
+  Instance(AppID id, std::optional<ModuleInfo> info,
+           ChildBuilder buildChildren,
+           std::vector<services::Service *> services,
+           std::vector<std::unique_ptr<BundlePort>> &&ports)
+      : HWModule(info, std::move(buildChildren), services, std::move(ports)),
+        id(id) {}
 
   /// Get the instance's ID, which it will always have.
   AppID getID() const { return id; }
@@ -32,6 +32,7 @@
 
 #include <cassert>
 #include <future>
+#include <mutex>
 
 namespace esi {
 class Accelerator;
@@ -64,6 +65,9 @@ protected:
   AcceleratorConnection &conn;
 
 private:
+  /// Protects `ownedPorts`, since lazily built hierarchies request ports from
+  /// whichever thread first accesses them.
+  std::mutex portsMutex;
   std::map<std::pair<AppIDPath, std::string>, std::unique_ptr<ChannelPort>>
       ownedPorts;
 };
@@ -40,8 +40,13 @@ class Manifest {
 public:
   class Impl;
 
+  using Options = ManifestOptions;
+
   Manifest(const Manifest &) = delete;
+  /// Parse a manifest with the context's manifest options.
   Manifest(Context &ctxt, const std::string &jsonManifest);
+  Manifest(Context &ctxt, const std::string &jsonManifest,
+           const Options &options);
   ~Manifest();
 
   uint32_t getApiVersion() const;
@@ -60,7 +65,9 @@ public:
   const std::vector<const Type *> &getTypeTable() const;
 
 private:
-  Impl *impl;
+  // Shared with the lazily built parts of the design hierarchy, which may
+  // outlive this object.
+  std::shared_ptr<Impl> impl;
 };
 
 } // namespace esi
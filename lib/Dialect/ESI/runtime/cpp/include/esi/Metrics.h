@@ -0,0 +1,148 @@
+//===- Metrics.h - ESI runtime metrics --------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Opt-in throughput and latency instrumentation for channel ports. Metrics are
+// updated with relaxed atomics only, so they can be recorded from any thread
+// without taking locks. Readers get a consistent-enough view for reporting but
+// not an atomic snapshot.
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT (lib/dialect/ESI/runtime/cpp/).
+//
+//===----------------------------------------------------------------------===//
+
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef ESI_METRICS_H
+#define ESI_METRICS_H
+
+#include "esi/Logging.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace esi {
+
+/// A histogram with logarithmically sized buckets which are each split into
+/// `SubBuckets` linear sub-buckets, in the style of HdrHistogram. Values below
+/// `SubBuckets` are recorded exactly; larger values are recorded with a
+/// relative error of at most 1/`SubBuckets`. Covers the full 64-bit range.
+class LatencyHistogram {
+public:
+  static constexpr unsigned SubBucketBits = 4;
+  static constexpr uint64_t SubBuckets = 1ull << SubBucketBits;
+  static constexpr size_t NumBuckets = (64 - SubBucketBits + 1) * SubBuckets;
+
+  LatencyHistogram() { reset(); }
+  LatencyHistogram(const LatencyHistogram &) = delete;
+
+  /// Record a value (typically nanoseconds).
+  void record(uint64_t value);
+
+  uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+  uint64_t getMin() const;
+  uint64_t getMax() const { return max.load(std::memory_order_relaxed); }
+  double getMean() const;
+  /// Get the value below which `percentile` percent (0-100) of the recorded
+  /// values fall. Returns 0 if nothing has been recorded.
+  uint64_t getPercentile(double percentile) const;
+
+  void reset();
+
+  /// Get the bucket a value falls into, and the largest value in a bucket.
+  static size_t getBucket(uint64_t value);
+  static uint64_t getBucketMax(size_t bucket);
+
+private:
+  std::array<std::atomic<uint64_t>, NumBuckets> buckets;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> min;
+  std::atomic<uint64_t> max;
+};
+
+/// Metrics for one channel port. For write ports, the latency is the time
+/// spent in blocking write calls. For read ports, it is the time between a
+/// read being requested and the data being handed to the reader (in polling
+/// mode, only for reads which had to wait) or the time spent in the callback
+/// (in callback mode).
+class ChannelMetrics {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Count messages which passed through the port.
+  void addMessages(uint64_t numMessages, uint64_t numBytes);
+  /// Record the latency of one operation.
+  void addLatency(Clock::duration latency) {
+    latencies.record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+  }
+  /// Record the depth of the port's queue, keeping the high water mark.
+  void addQueueDepth(uint64_t depth);
+
+  uint64_t getMessages() const {
+    return messages.load(std::memory_order_relaxed);
+  }
+  uint64_t getBytes() const { return bytes.load(std::memory_order_relaxed); }
+  uint64_t getMaxQueueDepth() const {
+    return maxQueueDepth.load(std::memory_order_relaxed);
+  }
+  /// Latencies in nanoseconds.
+  const LatencyHistogram &getLatency() const { return latencies; }
+  /// Get the throughput in bytes per second between the first and the last
+  /// message. Returns 0 if fewer than two batches of messages were seen.
+  double getThroughput() const;
+
+  void reset();
+  /// Write the metrics as a JSON object.
+  void writeJson(std::ostream &os) const;
+
+private:
+  std::atomic<uint64_t> messages = 0;
+  std::atomic<uint64_t> bytes = 0;
+  std::atomic<uint64_t> maxQueueDepth = 0;
+  /// Nanoseconds since the clock's epoch of the first and last messages.
+  std::atomic<int64_t> firstTime = 0;
+  std::atomic<int64_t> lastTime = 0;
+  LatencyHistogram latencies;
+};
+
+/// The metrics for all the instrumented ports of an accelerator connection,
+/// keyed by the port's AppID path and channel name.
+class Metrics {
+public:
+  /// Get or create the metrics for a channel. The returned reference is valid
+  /// for the lifetime of this object.
+  ChannelMetrics &getChannel(const std::string &name);
+  /// Get the metrics for a channel. Returns null if there are none.
+  const ChannelMetrics *findChannel(const std::string &name) const;
+
+  /// Reset all the counters and histograms.
+  void reset();
+
+  /// Write all the metrics as a JSON object keyed by channel name.
+  void writeJson(std::ostream &os) const;
+  std::string toJson() const;
+  /// Log the metrics as JSON through the logger.
+  void log(Logger &logger, Logger::Level level = Logger::Level::Info) const;
+
+private:
+  mutable std::mutex m;
+  std::map<std::string, std::unique_ptr<ChannelMetrics>> channels;
+};
+
+} // namespace esi
+
+#endif // ESI_METRICS_H
@@ -17,6 +17,7 @@
 #define ESI_PORTS_H
 
 #include "esi/Common.h"
+#include "esi/Metrics.h"
 #include "esi/Types.h"
 #include "esi/Utils.h"
 
@@ -24,6 +25,9 @@
 #include <future>
 
 namespace esi {
+namespace backends::trace {
+class BinaryTraceWriter;
+} // namespace backends::trace
 
 class ChannelPort;
 using PortMap = std::map<std::string, ChannelPort &>;
@@ -129,8 +133,31 @@ public:
 
   const Type *getType() const { return type; }
 
+  /// Record throughput and latency metrics for this port into `metrics`. Must
+  /// be called before the port is connected. Pass null to stop recording.
+  void setMetrics(ChannelMetrics *metrics) { this->metrics = metrics; }
+  /// Get the metrics for this port. Returns null if it isn't instrumented.
+  ChannelMetrics *getMetrics() const { return metrics; }
+
+  /// Record the data this port exchanges with the backend into `recorder`, as
+  /// the messages of `channel`. Windowed types are recorded frame by frame, as
+  /// they go over the wire, so the trace can be replayed with any options.
+  /// Must be called before the port is connected. Pass null to stop recording.
+  void setTraceRecorder(backends::trace::BinaryTraceWriter *recorder,
+                        uint32_t channel) {
+    traceRecorder = recorder;
+    traceChannel = channel;
+  }
+
 protected:
   const Type *type;
+  /// Not owned. Null unless metrics are enabled.
+  ChannelMetrics *metrics = nullptr;
+  /// Not owned. Null unless the connection is recording a trace.
+  backends::trace::BinaryTraceWriter *traceRecorder = nullptr;
+  uint32_t traceChannel = 0;
+  /// Record messages exchanged with the backend into the trace.
+  void recordTrace(std::span<const MessageData> data);
 
   /// Instructions for translating windowed types. Precomputes and optimizes a
   /// list of copy operations.
@@ -220,16 +247,49 @@ public:
   /// A very basic blocking write API. Will likely change for performance
   /// reasons.
   void write(const MessageData &data) {
+    ChannelMetrics::Clock::time_point start;
+    if (metrics)
+      start = ChannelMetrics::Clock::now();
     if (translateMessages) {
       assert(translationBuffer.empty() &&
              "Cannot call write() with pending translated messages");
       translateOutgoing(data);
-      for (auto &msg : translationBuffer)
-        writeImpl(msg);
+      writeBatchImpl(translationBuffer);
+      if (traceRecorder)
+        recordTrace(translationBuffer);
       translationBuffer.clear();
     } else {
       writeImpl(data);
+      if (traceRecorder)
+        recordTrace(std::span(&data, 1));
     }
+    if (metrics)
+      recordWrite(std::span(&data, 1), start);
+  }
+
+  /// Blocking write of several messages. Backends which support it send all
+  /// of them (and all the frames of windowed types) in as few transactions as
+  /// possible.
+  void writeBatch(std::span<const MessageData> data) {
+    ChannelMetrics::Clock::time_point start;
+    if (metrics)
+      start = ChannelMetrics::Clock::now();
+    if (translateMessages) {
+      assert(translationBuffer.empty() &&
+             "Cannot call writeBatch() with pending translated messages");
+      for (const MessageData &msg : data)
+        translateOutgoing(msg);
+      writeBatchImpl(translationBuffer);
+      if (traceRecorder)
+        recordTrace(translationBuffer);
+      translationBuffer.clear();
+    } else {
+      writeBatchImpl(data);
+      if (traceRecorder)
+        recordTrace(data);
+    }
+    if (metrics)
+      recordWrite(data, start);
   }
 
   /// A basic non-blocking write API. Returns true if any of the data was queued
@@ -247,21 +307,53 @@ public:
              "Translation buffer should be empty after successful flush");
       translateOutgoing(data);
       flush();
-      return true;
-    } else {
-      return tryWriteImpl(data);
+    } else if (!tryWriteImpl(data)) {
+      return false;
+    } else if (traceRecorder) {
+      recordTrace(std::span(&data, 1));
+    }
+    if (metrics)
+      metrics->addMessages(1, data.getSize());
+    return true;
+  }
+
+  /// Non-blocking write of several messages. Returns the number of messages
+  /// from the front of `data` which were queued and/or sent. As with
+  /// `tryWrite`, windowed messages may not have been completely written yet.
+  /// Backends without a non-blocking transport, such as cosim, block until
+  /// they have handed off all of the messages.
+  size_t tryWriteBatch(std::span<const MessageData> data) {
+    if (translateMessages) {
+      size_t numWritten = 0;
+      for (const MessageData &msg : data) {
+        if (!tryWrite(msg))
+          break;
+        ++numWritten;
+      }
+      return numWritten;
     }
+    size_t numWritten = tryWriteBatchImpl(data);
+    if (traceRecorder && numWritten > 0)
+      recordTrace(data.first(numWritten));
+    if (metrics && numWritten > 0)
+      recordWrite(data.first(numWritten), std::nullopt);
+    return numWritten;
   }
   /// Flush any buffered data. Returns true if all data was flushed.
   ///
   /// If `translateMessages` is false, calling `flush()` will immediately return
   /// true and perform no action, as there is no buffered data to flush.
   bool flush() {
-    while (translationBufferIdx < translationBuffer.size()) {
-      if (!tryWriteImpl(translationBuffer[translationBufferIdx]))
-        return false;
-      ++translationBufferIdx;
+    if (translationBufferIdx < translationBuffer.size()) {
+      std::span<const MessageData> pending =
+          std::span(translationBuffer).subspan(translationBufferIdx);
+      size_t numWritten = tryWriteBatchImpl(pending);
+      if (traceRecorder && numWritten > 0)
+        recordTrace(pending.first(numWritten));
+      translationBufferIdx += numWritten;
     }
+    if (translationBufferIdx < translationBuffer.size())
+      return false;
     translationBuffer.clear();
     translationBufferIdx = 0;
     return true;
@@ -274,6 +366,27 @@ protected:
   /// Implementation for tryWrite(). Subclasses must implement this.
   virtual bool tryWriteImpl(const MessageData &data) = 0;
 
+  /// Implementation for writeBatch(). Backends which can send several
+  /// messages in one transaction should override this. Defaults to calling
+  /// writeImpl() for each message.
+  virtual void writeBatchImpl(std::span<const MessageData> data) {
+    for (const MessageData &msg : data)
+      writeImpl(msg);
+  }
+
+  /// Implementation for tryWriteBatch(). Returns the number of messages from
+  /// the front of `data` which were written. Defaults to calling
+  /// tryWriteImpl() for each message until one fails.
+  virtual size_t tryWriteBatchImpl(std::span<const MessageData> data) {
+    size_t numWritten = 0;
+    for (const MessageData &msg : data) {
+      if (!tryWriteImpl(msg))
+        break;
+      ++numWritten;
+    }
+    return numWritten;
+  }
+
   /// Whether to translate outgoing data if the port type is a window type. Set
   /// by the connect() method.
   bool translateMessages = false;
@@ -286,6 +399,11 @@ protected:
   /// message 'chunks' to translationBuffer.
   void translateOutgoing(const MessageData &data);
 
+  /// Count written messages and, if `start` is given, record the latency of
+  /// the write which started then.
+  void recordWrite(std::span<const MessageData> data,
+                   std::optional<ChannelMetrics::Clock::time_point> start);
+
 private:
   volatile bool connected = false;
 };
@@ -361,6 +479,10 @@ public:
     outData = std::move(f.get());
   }
 
+  /// Read up to `maxMessages` messages. Blocks until at least one message is
+  /// available, then returns whatever else is available without blocking.
+  std::vector<MessageData> readBatch(size_t maxMessages);
+
   /// Set maximum number of messages to store in the dataQueue. 0 means no
   /// limit. This is only used in polling mode and is set to default of 32 upon
   /// connect. While it may seem redundant to have this and bufferSize, there
@@ -369,6 +491,12 @@ public:
   /// possible.
   void setMaxDataQueueMsgs(uint64_t maxMsgs) { maxDataQueueMsgs = maxMsgs; }
 
+  /// Register a function to be called whenever a message becomes available to
+  /// `readAsync()` in polling mode, so that consumers can sleep instead of
+  /// polling futures. It is called from whichever thread delivers the message,
+  /// so it must be thread safe and must not block. Pass nullptr to unregister.
+  void setDataNotifier(std::function<void()> notifier);
+
 protected:
   /// Indicates the current mode of the channel.
   enum Mode { Disconnected, Callback, Polling };
@@ -390,6 +518,15 @@ protected:
   /// Translate incoming data if the port type is a window type. Returns true if
   /// the message has been completely received.
   bool translateIncoming(MessageData &data);
+  /// Wrap `callback` such that the data it accepts is recorded into the trace.
+  void recordTraceOnCallback();
+
+  /// Backends which can produce messages on demand may override this to
+  /// append up to `maxMessages` (already translated) messages to `out` in one
+  /// go, bypassing the callback. Called by readBatch() once the data queue has
+  /// been drained. Defaults to reading nothing.
+  virtual void readBatchImpl(size_t maxMessages,
+                             std::vector<MessageData> &out) {}
 
   //===--------------------------------------------------------------------===//
   // Polling mode members.
@@ -404,6 +541,11 @@ protected:
   uint64_t maxDataQueueMsgs;
   /// Promises to be fulfilled when data is available.
   std::queue<std::promise<MessageData>> promiseQueue;
+  /// When each promise in promiseQueue was requested. Only kept if the port
+  /// records metrics.
+  std::queue<ChannelMetrics::Clock::time_point> promiseTimes;
+  /// Called when a message is queued or fulfills a promise.
+  std::function<void()> dataNotifier;
 };
 
 /// Instantiated when a backend does not know how to create a read channel.
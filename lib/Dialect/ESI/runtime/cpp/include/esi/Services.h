@@ -24,8 +24,11 @@
 #include "esi/Context.h"
 #include "esi/Ports.h"
 
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <list>
+#include <map>
 
 namespace esi {
 class AcceleratorConnection;
@@ -279,12 +282,34 @@ public:
     using ServicePort::ServicePort;
 
   public:
+    /// Results which can't be matched to a call are reported to `logger`, if
+    /// one is given, and dropped.
     static Function *get(AppID id, BundleType *type, WriteChannelPort &arg,
-                         ReadChannelPort &result);
-
-    void connect();
+                         ReadChannelPort &result, Logger *logger = nullptr);
+
+    /// Extracts the tag from an argument or result message.
+    using TagFn = std::function<uint64_t(const MessageData &)>;
+
+    struct Options {
+      /// The maximum number of calls which can be in flight. `call` blocks
+      /// while this many results are outstanding. 0 means unlimited.
+      unsigned maxInFlight = 0;
+      /// If set, results are matched to calls by tag rather than in order. For
+      /// hardware which completes calls out of order. Either both or neither
+      /// must be set, and the tags of the calls in flight must be unique.
+      TagFn argTag;
+      TagFn resultTag;
+    };
+
+    void connect() { connect(Options()); }
+    void connect(const Options &options);
+    /// Issue a call without waiting for the previous ones to complete. Calls
+    /// are sent in the order in which they were issued.
     std::future<MessageData> call(const MessageData &arg);
 
+    /// Get the number of calls which have been issued but not yet completed.
+    size_t getNumInFlight();
+
     const esi::Type *getArgType() const {
       return dynamic_cast<const ChannelType *>(type->findChannel("arg").first)
           ->getInner();
@@ -305,7 +330,20 @@ public:
     }
 
   private:
+    /// Match a result to its call. Called by the result port, so it must not
+    /// throw.
+    bool deliver(MessageData resultData);
+
+    Options options;
+    Logger *logger = nullptr;
+    /// Serializes the argument writes.
     std::mutex callMutex;
+    /// Protects the outstanding calls.
+    std::mutex pendingMutex;
+    std::condition_variable pendingCV;
+    /// Outstanding calls, in issue order when untagged and by tag otherwise.
+    std::deque<std::promise<MessageData>> pending;
+    std::map<uint64_t, std::promise<MessageData>> pendingTagged;
     WriteChannelPort *arg;
     ReadChannelPort *result;
     bool connected = false;
@@ -332,6 +370,8 @@ public:
              PortMap channels);
 
   public:
+    ~Callback();
+
     static Callback *get(AcceleratorConnection &acc, AppID id,
                          const BundleType *type, WriteChannelPort &result,
                          ReadChannelPort &arg);
@@ -339,9 +379,13 @@ public:
     /// Connect a callback to code which will be executed when the accelerator
     /// invokes the callback. The 'quick' flag indicates that the callback is
     /// sufficiently fast that it could be called in the same thread as the
-    /// port callback.
+    /// port callback. If `numThreads` is non-zero, the callback is instead run
+    /// on a pool of that many threads so that several invocations can execute
+    /// concurrently. The results are still sent in the order of the calls.
+    /// If the callback throws, the error is logged and no result is sent for
+    /// that invocation.
     void connect(std::function<MessageData(const MessageData &)> callback,
-                 bool quick = false);
+                 bool quick = false, unsigned numThreads = 0);
 
     const esi::Type *getArgType() const {
       return dynamic_cast<const ChannelType *>(type->findChannel("arg").first)
@@ -363,9 +407,12 @@ public:
     }
 
   private:
+    class ThreadPool;
+
     ReadChannelPort *arg;
     WriteChannelPort *result;
     AcceleratorConnection &acc;
+    std::unique_ptr<ThreadPool> pool;
   };
 
 private:
@@ -20,6 +20,8 @@
 #include <any>
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <span>
 #include <stdexcept>
 #include <string>
@@ -29,6 +31,7 @@
 #include "esi/Values.h" // For BitVector / Int / UInt
 
 namespace esi {
+class SerializationPlan;
 
 /// Root class of the ESI type system.
 class Type {
@@ -59,7 +62,9 @@ public:
   // MutableBitVector, and proceeds with regular MutableBitVector
   // deserialization.
   std::any deserialize(const MessageData &data) const {
-    auto bv = MutableBitVector(std::vector<uint8_t>(data.getData()));
+    std::span<const uint8_t> bytes = data.getData();
+    auto bv =
+        MutableBitVector(std::vector<uint8_t>(bytes.begin(), bytes.end()));
     return deserialize(bv);
   }
 
@@ -86,8 +91,17 @@ public:
   // Return a textual representation of this type.
   std::string toString(bool oneLine = false) const;
 
+  /// Get the precompiled plan for converting messages of this type to and from
+  /// host structs. Compiled on first use and cached. Throws if the type does
+  /// not have a fixed size.
+  const SerializationPlan &getSerializationPlan() const;
+
 protected:
   ID id;
+
+private:
+  mutable std::once_flag planOnce;
+  mutable std::unique_ptr<SerializationPlan> plan;
 };
 
 /// Bundles represent a collection of channels. Services exclusively expose
@@ -329,6 +343,90 @@ private:
   const Type *elementType;
 };
 
+/// A precompiled plan for converting messages of a fixed-size type between the
+/// wire format and a host struct, avoiding `std::any` and bit-by-bit
+/// BitVector walks. The host struct has C layout: fields in declaration order
+/// (array elements in index order), naturally aligned, with each integer
+/// stored in the smallest of 1, 2, 4, or 8 bytes which fits it. Wider integers
+/// are stored as little-endian byte arrays. Signed integers are sign extended
+/// to fill their storage.
+///
+/// Fields which are byte aligned on the wire are copied with memcpy, and runs
+/// of adjacent fields are merged into a single copy. Bit shifting is only used
+/// for fields which are not byte aligned. Assumes a little-endian host.
+class SerializationPlan {
+public:
+  explicit SerializationPlan(const Type *type);
+
+  /// A leaf (integer or bits) field of the type.
+  struct Field {
+    /// Path to the field, e.g. "a.b[2]". Empty for non-aggregate types.
+    std::string path;
+    const Type *type;
+    /// Offset and size of the field in the host struct, in bytes.
+    size_t hostOffset;
+    size_t hostSize;
+    /// Offset and width of the field in the message, in bits.
+    uint64_t wireBitOffset;
+    uint64_t bitWidth;
+  };
+
+  /// A single step of the conversion.
+  struct CopyOp {
+    size_t hostOffset;
+    size_t hostSize;
+    uint64_t wireBitOffset;
+    uint64_t bitWidth;
+    /// Whether to sign extend the field to fill its host storage.
+    bool signExtend;
+    /// Whether the field can be copied with memcpy.
+    bool byteAligned;
+  };
+
+  const Type *getType() const { return type; }
+  const std::vector<Field> &getFields() const { return fields; }
+  const std::vector<CopyOp> &getCopyOps() const { return ops; }
+  /// Size and alignment of the host struct in bytes.
+  size_t getHostSize() const { return hostSize; }
+  size_t getHostAlignment() const { return hostAlignment; }
+  /// Size of a message in bytes.
+  size_t getWireSize() const { return (wireBitWidth + 7) / 8; }
+
+  /// Pack a host struct into `wire`, which must be `getWireSize()` bytes.
+  void pack(const void *host, uint8_t *wire) const;
+  /// Pack a host struct into a new message.
+  MessageData pack(const void *host) const;
+  /// Unpack a message into a host struct of `getHostSize()` bytes. Throws if
+  /// the message is too small.
+  void unpack(const MessageData &msg, void *host) const;
+
+  /// Typed versions of the above, checking that `T` has the expected size.
+  template <typename T>
+  MessageData pack(const T &value) const {
+    checkHostType(sizeof(T));
+    return pack(static_cast<const void *>(&value));
+  }
+  template <typename T>
+  T unpack(const MessageData &msg) const {
+    checkHostType(sizeof(T));
+    T value;
+    unpack(msg, static_cast<void *>(&value));
+    return value;
+  }
+
+private:
+  void addType(const Type *type, const std::string &path, size_t hostOffset,
+               uint64_t wireBitOffset);
+  void checkHostType(size_t size) const;
+
+  const Type *type;
+  std::vector<Field> fields;
+  std::vector<CopyOp> ops;
+  size_t hostSize = 0;
+  size_t hostAlignment = 1;
+  uint64_t wireBitWidth = 0;
+};
+
 } // namespace esi
 
 #endif // ESI_TYPES_H
@@ -68,6 +68,10 @@ public:
   /// Send a message to a server-bound channel.
   void writeToServer(const std::string &channelName, const MessageData &data);
 
+  /// Send several messages to a server-bound channel in one call.
+  void writeBatchToServer(const std::string &channelName,
+                          std::span<const MessageData> data);
+
   /// Callback type for receiving messages from a client-bound channel.
   /// Return true if the message was consumed, false to retry.
   using ReadCallback = std::function<bool(const MessageData &)>;
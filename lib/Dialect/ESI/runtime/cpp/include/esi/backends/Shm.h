@@ -0,0 +1,70 @@
+//===- Shm.h - ESI shared memory cosim backend ------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This is a specialization of the ESI C++ API (backend) for connection to a
+// simulation running on the same machine through shared memory. It is
+// interchangeable with the 'cosim' backend for simulations started with the
+// COSIM_SHM environment variable set.
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT (lib/dialect/ESI/runtime/cpp/).
+//
+//===----------------------------------------------------------------------===//
+
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef ESI_BACKENDS_SHM_H
+#define ESI_BACKENDS_SHM_H
+
+#include "esi/Accelerator.h"
+
+#include <memory>
+
+namespace esi {
+namespace backends {
+namespace shm {
+
+class ShmEngine;
+class ShmSegment;
+
+/// Connect to an ESI simulation through shared memory.
+class ShmAccelerator : public esi::AcceleratorConnection {
+  friend class ShmEngine;
+
+public:
+  ShmAccelerator(Context &, std::string segmentName);
+  ~ShmAccelerator();
+
+  /// Parse the connection string and instantiate the accelerator. Supports
+  /// the name of the shared memory segment, a path to the 'cosim.cfg' written
+  /// by the simulation, and 'env' to use the ESI_COSIM_SHM environment
+  /// variable.
+  static std::unique_ptr<AcceleratorConnection>
+  connect(Context &, std::string connectionString);
+
+  void createEngine(const std::string &engineTypeName, AppIDPath idPath,
+                    const ServiceImplDetails &details,
+                    const HWClientDetails &clients) override;
+
+protected:
+  virtual Service *createService(Service::Type service, AppIDPath path,
+                                 std::string implName,
+                                 const ServiceImplDetails &details,
+                                 const HWClientDetails &clients) override;
+
+private:
+  // Shared with the ports and services since they may outlive this object and
+  // keep accessing the segment until they get disconnected.
+  std::shared_ptr<ShmSegment> segment;
+};
+
+} // namespace shm
+} // namespace backends
+} // namespace esi
+
+#endif // ESI_BACKENDS_SHM_H
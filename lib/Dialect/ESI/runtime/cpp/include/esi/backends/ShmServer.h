@@ -0,0 +1,101 @@
+//===- ShmServer.h - ESI cosim shared memory server -------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The simulator side of the shared memory cosim transport. Unlike the RPC
+// server, this does not run any threads: the simulator polls the channels
+// directly from its DPI calls.
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT (lib/dialect/ESI/runtime/cpp/).
+//
+//===----------------------------------------------------------------------===//
+
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef ESI_BACKENDS_SHMSERVER_H
+#define ESI_BACKENDS_SHMSERVER_H
+
+#include "esi/Context.h"
+#include "esi/backends/ShmTransport.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace esi {
+namespace backends {
+namespace shm {
+
+class ShmServer {
+public:
+  /// A channel endpoint on the simulator side.
+  class Channel {
+  public:
+    Channel(ShmServer &server, ShmRing ring) : server(server), ring(ring) {}
+
+    /// Receive a message from the client, if there is one.
+    bool tryRead(MessageData &data) { return ring.tryPop(data); }
+    /// Send a message to the client. If the ring is full (e.g. since no client
+    /// is connected) the message is held back until there is space. Once the
+    /// server's backlog limit is reached, this blocks until the client makes
+    /// room, stalling the simulation.
+    void write(const MessageData &data);
+    /// Try to move held back messages into the ring. Returns true if there
+    /// are none left.
+    bool flush();
+
+  private:
+    ShmServer &server;
+    ShmRing ring;
+    std::deque<MessageData> backlog;
+  };
+
+  ShmServer(Context &ctxt);
+  ~ShmServer();
+
+  /// Get the context.
+  Context &getContext() { return ctxt; }
+
+  /// Set the manifest and version.
+  void setManifest(int esiVersion,
+                   const std::vector<uint8_t> &compressedManifest);
+
+  /// Register a channel from the client (read) or to the client (write).
+  Channel &registerReadPort(const std::string &name, const std::string &type);
+  Channel &registerWritePort(const std::string &name, const std::string &type);
+
+  /// Move held back messages on the write channels into their rings. Only
+  /// channels with a backlog are visited.
+  void flush();
+
+  /// Create the segment named `name` and write its name to 'cosim.cfg' for
+  /// clients to find. `size` is the total size of the segment and
+  /// `ringCapacity` the size of each channel's ring buffer. Each write channel
+  /// holds back at most `maxBacklog` messages before writes start blocking.
+  void run(const std::string &name, size_t size, uint64_t ringCapacity,
+           size_t maxBacklog = 1024);
+
+  /// Mark the segment as closed and remove it.
+  void stop();
+
+private:
+  Context &ctxt;
+  std::unique_ptr<ShmSegment> segment;
+  uint64_t ringCapacity = 0;
+  size_t maxBacklog = 0;
+  std::map<std::string, std::unique_ptr<Channel>> readPorts;
+  std::map<std::string, std::unique_ptr<Channel>> writePorts;
+  /// The write channels which have held back messages.
+  std::vector<Channel *> pending;
+};
+
+} // namespace shm
+} // namespace backends
+} // namespace esi
+
+#endif // ESI_BACKENDS_SHMSERVER_H
@@ -0,0 +1,164 @@
+//===- ShmTransport.h - Shared memory cosim transport -----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A transport for cosimulations wherein the simulator and the host software
+// run on the same machine. The simulator creates a POSIX shared memory segment
+// containing the manifest and one single-producer/single-consumer ring buffer
+// per channel. Both sides move messages through the rings without any locks or
+// system calls in the common case, and only sleep on a futex when a ring is
+// empty (consumer) or full (producer).
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT (lib/dialect/ESI/runtime/cpp/).
+//
+//===----------------------------------------------------------------------===//
+
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef ESI_BACKENDS_SHMTRANSPORT_H
+#define ESI_BACKENDS_SHMTRANSPORT_H
+
+#include "esi/Common.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace esi {
+namespace backends {
+namespace shm {
+
+/// A view of a single-producer/single-consumer ring buffer living in a shared
+/// memory segment. Messages are stored as a 32-bit length followed by the
+/// data, padded to 8 bytes. Exactly one thread (in any process) may push and
+/// exactly one thread may pop at any given time.
+class ShmRing {
+public:
+  /// The part of the ring which lives in shared memory. The data follows.
+  struct Header;
+
+  ShmRing(Header *header = nullptr) : header(header) {}
+
+  /// Get the number of bytes in the data area.
+  uint64_t getCapacity() const;
+
+  /// Push a message. Returns false if there isn't enough space. Throws if the
+  /// message is larger than the ring.
+  bool tryPush(const MessageData &data);
+  /// Push as many messages from the front of `data` as fit and wake the
+  /// consumer once. Returns the number of messages pushed. Throws, without
+  /// pushing anything, if any of the messages is larger than the ring.
+  size_t tryPushBatch(std::span<const MessageData> data);
+
+  /// Pop a message. Returns false if the ring is empty.
+  bool tryPop(MessageData &data);
+  /// Pop up to `maxMessages` messages into `out` and wake the producer once.
+  /// Returns the number of messages popped.
+  size_t tryPopBatch(size_t maxMessages, std::vector<MessageData> &out);
+
+  /// Check whether there is anything to pop.
+  bool empty() const;
+
+  /// Sleep until the ring contains data or the timeout expires. Returns true
+  /// if there is data to pop.
+  bool waitForData(std::chrono::microseconds timeout);
+  /// Sleep until a message of `size` bytes fits or the timeout expires.
+  /// Returns true if it fits.
+  bool waitForSpace(size_t size, std::chrono::microseconds timeout);
+
+  /// Get the number of bytes a message of `size` bytes takes in the ring.
+  static uint64_t getRecordSize(size_t size);
+  /// Get the number of bytes of shared memory required for a ring with a
+  /// data area of `capacity` bytes.
+  static uint64_t getAllocSize(uint64_t capacity);
+  /// Initialize a ring in zeroed shared memory.
+  static Header *init(void *mem, uint64_t capacity);
+
+private:
+  uint8_t *getData() const;
+  bool fits(uint64_t head, uint64_t tail, size_t size) const;
+  void wakeConsumer();
+  void wakeProducer();
+
+  Header *header;
+};
+
+/// A shared memory segment holding the manifest and the ring buffers for all
+/// the channels. The server (simulator) creates the segment, publishes the
+/// manifest and adds channels as they get registered; clients open the segment
+/// and look up the channels by name.
+class ShmSegment {
+public:
+  /// Direction of a channel, as seen from the server.
+  enum class Direction : uint32_t { ToServer, ToClient };
+
+  /// Description of a channel in the segment.
+  struct ChannelDesc {
+    std::string name;
+    std::string type;
+    Direction dir;
+    ShmRing ring;
+  };
+
+  /// Create a new segment named `name` (which should start with '/') of
+  /// `size` bytes, replacing any stale segment with the same name. The segment
+  /// is unlinked when the returned object is destroyed.
+  static std::unique_ptr<ShmSegment> create(const std::string &name,
+                                            size_t size);
+  /// Open an existing segment created by a server.
+  static std::unique_ptr<ShmSegment> open(const std::string &name);
+  ~ShmSegment();
+
+  ShmSegment(const ShmSegment &) = delete;
+  ShmSegment &operator=(const ShmSegment &) = delete;
+
+  const std::string &getName() const { return name; }
+
+  /// Server side: publish the manifest.
+  void setManifest(uint32_t esiVersion,
+                   const std::vector<uint8_t> &compressedManifest);
+  /// Get the manifest. Returns false if the server hasn't published it yet.
+  bool getManifest(uint32_t &esiVersion,
+                   std::vector<uint8_t> &compressedManifest) const;
+
+  /// Server side: add a channel with a ring of `capacity` bytes (rounded up to
+  /// a power of two).
+  ShmRing addChannel(const std::string &name, const std::string &type,
+                     Direction dir, uint64_t capacity);
+  /// Look up a channel by name. Returns false if it doesn't exist (yet).
+  bool getChannelDesc(const std::string &name, ChannelDesc &desc) const;
+  /// List all the channels added so far.
+  std::vector<ChannelDesc> listChannels() const;
+
+  /// Server side: mark the segment as closed to tell clients that the
+  /// simulation is gone.
+  void close();
+  bool isClosed() const;
+
+  /// The part of the segment at the very beginning of the shared memory.
+  struct Header;
+
+private:
+  ShmSegment(std::string name, void *base, size_t size, bool owner);
+  uint64_t allocate(uint64_t size);
+
+  std::string name;
+  void *base;
+  size_t size;
+  bool owner;
+};
+
+} // namespace shm
+} // namespace backends
+} // namespace esi
+
+#endif // ESI_BACKENDS_SHMTRANSPORT_H
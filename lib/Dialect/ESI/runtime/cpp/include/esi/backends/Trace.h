@@ -11,6 +11,9 @@
 // trace files recorded from interactions with an actual connection. It also has
 // a mode wherein it will write to a file (for sends) and produce random data
 // (for receives). Both modes are intended for debugging without a simulation.
+// Binary traces (see TraceFormat.h) record both directions and can be replayed
+// at full speed, e.g. for performance testing without hardware. They can be
+// recorded from any backend with `AcceleratorConnection::recordTrace`.
 //
 // DO NOT EDIT!
 // This file is distributed as part of an ESI package. The source for this file
@@ -39,26 +42,31 @@ public:
     // garbage data for reads from the accelerator.
     Write,
 
-    // Sent data to the accelerator is compared against the trace file's record.
-    // Data read from the accelerator is read from the trace file.
-    // TODO: Full trace mode not yet supported.
-    // Read
-
     // Discard all data sent to the accelerator. Disable trace file generation.
     Discard,
+
+    // Like 'Discard', but record a binary trace of both directions, including
+    // the random reads, as if `recordTrace` had been called on the connection.
+    BinaryWrite,
+
+    // Replay a binary trace. Data read from the accelerator (including MMIO
+    // reads) is fed back from the trace file as fast as it gets consumed. Data
+    // sent to the accelerator is discarded.
+    Replay,
   };
 
   /// Create a trace-based accelerator backend.
   /// \param mode The mode of operation. See Mode.
   /// \param manifestJson The path to the manifest JSON file.
-  /// \param traceFile The path to the trace file. For 'Write' mode, this file
-  ///   is opened for writing. For 'Read' mode, this file is opened for reading.
+  /// \param traceFile The path to the trace file. For the write modes, this
+  ///   file is opened for writing. For 'Replay' mode, it is opened for reading.
   TraceAccelerator(Context &, Mode mode, std::filesystem::path manifestJson,
                    std::filesystem::path traceFile);
   ~TraceAccelerator() override;
 
   /// Parse the connection string and instantiate the accelerator. Format is:
-  /// "<mode>:<manifest path>[:<traceFile>]".
+  /// "<mode>:<manifest path>[:<traceFile>]" where mode is 'w' (Write), '-'
+  /// (Discard), 'b' (BinaryWrite) or 'r' (Replay).
   static std::unique_ptr<AcceleratorConnection>
   connect(Context &, std::string connectionString);
 
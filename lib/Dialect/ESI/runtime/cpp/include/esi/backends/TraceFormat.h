@@ -0,0 +1,193 @@
+//===- TraceFormat.h - ESI binary trace format ------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A compact binary format for recording the traffic between the host and an
+// accelerator, and for replaying it later. All integers are little endian.
+//
+//   File:    FileHeader Record* [IndexRecord Trailer]
+//   Record:  RecordHeader payload, padded to a multiple of 8 bytes
+//
+// Each channel is declared once by a ChannelDef record before its first
+// message. The index and trailer are written when the trace is closed; traces
+// which were cut short (e.g. by a crash) can still be read by scanning the
+// records.
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT (lib/dialect/ESI/runtime/cpp/).
+//
+//===----------------------------------------------------------------------===//
+
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef ESI_BACKENDS_TRACEFORMAT_H
+#define ESI_BACKENDS_TRACEFORMAT_H
+
+#include "esi/Common.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace esi {
+namespace backends {
+namespace trace {
+
+/// Layout of the binary trace format.
+namespace format {
+constexpr char fileMagic[8] = {'E', 'S', 'I', 'T', 'R', 'A', 'C', 'E'};
+constexpr char trailerMagic[8] = {'E', 'S', 'I', 'T', 'R', 'I', 'D', 'X'};
+constexpr uint32_t version = 1;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+enum class RecordKind : uint8_t {
+  /// Declare a channel. The payload is a ChannelDef followed by the name.
+  ChannelDef = 1,
+  /// A message on a channel. The payload is the message data.
+  Message = 2,
+  /// MMIO accesses. The payload is an MMIOAccess.
+  MMIORead = 3,
+  MMIOWrite = 4,
+  /// The index. The payload is an IndexEntry for each channel.
+  Index = 5,
+};
+
+struct RecordHeader {
+  RecordKind kind;
+  uint8_t reserved[3];
+  uint32_t channel;
+  /// Nanoseconds since the start of the trace.
+  uint64_t timestamp;
+  /// Size of the payload, without padding.
+  uint64_t size;
+};
+
+/// Direction of a channel, relative to the accelerator.
+enum class Direction : uint8_t { ToAccelerator = 0, FromAccelerator = 1 };
+
+struct ChannelDef {
+  Direction dir;
+  uint8_t reserved[7];
+};
+
+struct MMIOAccess {
+  uint32_t address;
+  uint32_t reserved;
+  uint64_t data;
+};
+
+struct IndexEntry {
+  uint32_t channel;
+  uint32_t reserved;
+  uint64_t numMessages;
+  uint64_t numBytes;
+  /// File offset of the channel's first message record, or 0 if none.
+  uint64_t firstRecord;
+};
+
+struct Trailer {
+  /// File offset of the index record.
+  uint64_t indexOffset;
+  char magic[8];
+};
+} // namespace format
+
+/// Record a binary trace. Safe to call from multiple threads.
+class BinaryTraceWriter {
+public:
+  BinaryTraceWriter(const std::filesystem::path &path);
+  /// Closes the trace if it hasn't been closed yet.
+  ~BinaryTraceWriter();
+
+  /// Declare a channel and get its ID. `name` is typically the AppID path of
+  /// the port followed by the channel name.
+  uint32_t addChannel(const std::string &name, format::Direction dir);
+
+  /// Record one or several messages on a channel.
+  void message(uint32_t channel, const MessageData &data);
+  void messages(uint32_t channel, std::span<const MessageData> data);
+
+  /// Record an MMIO access.
+  void mmioRead(uint32_t address, uint64_t data);
+  void mmioWrite(uint32_t address, uint64_t data);
+
+  /// Write the index and close the file.
+  void close();
+
+private:
+  void writeRecord(format::RecordKind kind, uint32_t channel, const void *data,
+                   uint64_t size);
+  uint64_t getTimestamp() const;
+
+  std::mutex m;
+  std::ofstream os;
+  std::vector<char> osBuffer;
+  std::chrono::steady_clock::time_point start;
+  /// Current file offset.
+  uint64_t offset = 0;
+  std::vector<format::IndexEntry> index;
+};
+
+/// Load a binary trace for replay. Messages are returned as slices of the
+/// loaded file, so they don't involve any copies.
+class BinaryTraceReader {
+public:
+  BinaryTraceReader(const std::filesystem::path &path);
+
+  struct Channel {
+    std::string name;
+    format::Direction dir;
+    /// File offsets of the message records, in order.
+    std::vector<uint64_t> records;
+    uint64_t numBytes = 0;
+  };
+
+  /// Get all the channels, indexed by channel ID.
+  const std::vector<Channel> &getChannels() const { return channels; }
+  /// Find a channel by name and direction. Returns null if there is none.
+  const Channel *findChannel(const std::string &name,
+                             format::Direction dir) const;
+
+  /// Get the message recorded at `recordOffset`.
+  MessageData getMessage(uint64_t recordOffset) const;
+  /// Get the timestamp of the record at `recordOffset`, in nanoseconds since
+  /// the start of the trace.
+  uint64_t getTimestamp(uint64_t recordOffset) const;
+
+  /// Get the recorded MMIO reads, in order, by address.
+  const std::map<uint32_t, std::vector<uint64_t>> &getMMIOReads() const {
+    return mmioReads;
+  }
+
+  /// Check whether the trace was closed properly, i.e. it has an index.
+  bool isComplete() const { return complete; }
+
+private:
+  format::RecordHeader getHeader(uint64_t offset) const;
+
+  MessageData file;
+  std::vector<Channel> channels;
+  std::map<uint32_t, std::vector<uint64_t>> mmioReads;
+  bool complete = false;
+};
+
+} // namespace trace
+} // namespace backends
+} // namespace esi
+
+#endif // ESI_BACKENDS_TRACEFORMAT_H
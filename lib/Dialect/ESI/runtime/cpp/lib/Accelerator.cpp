@@ -14,10 +14,13 @@
 
 #include "esi/Accelerator.h"
 
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstdlib>
 #include <filesystem>
 #include <map>
+#include <queue>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
@@ -45,6 +48,47 @@ AcceleratorServiceThread *AcceleratorConnection::getServiceThread() {
     serviceThread = std::make_unique<AcceleratorServiceThread>();
   return serviceThread.get();
 }
+
+Metrics &AcceleratorConnection::enableMetrics() {
+  if (!metrics)
+    metrics = std::make_unique<Metrics>();
+  return *metrics;
+}
+
+backends::trace::BinaryTraceWriter &
+AcceleratorConnection::recordTrace(const std::filesystem::path &path) {
+  if (traceRecorder)
+    throw std::runtime_error("already recording a trace");
+  traceRecorder = std::make_unique<backends::trace::BinaryTraceWriter>(path);
+  return *traceRecorder;
+}
+
+namespace {
+/// Wraps a backend's MMIO service to record all the accesses into a trace.
+class RecordingMMIO : public MMIO {
+public:
+  RecordingMMIO(std::unique_ptr<MMIO> inner, const AppIDPath &idPath,
+                const HWClientDetails &clients,
+                backends::trace::BinaryTraceWriter &recorder)
+      : MMIO(inner->getConnection(), idPath, clients), inner(std::move(inner)),
+        recorder(recorder) {}
+
+  uint64_t read(uint32_t addr) const override {
+    uint64_t data = inner->read(addr);
+    recorder.mmioRead(addr, data);
+    return data;
+  }
+  void write(uint32_t addr, uint64_t data) override {
+    inner->write(addr, data);
+    recorder.mmioWrite(addr, data);
+  }
+
+private:
+  std::unique_ptr<MMIO> inner;
+  backends::trace::BinaryTraceWriter &recorder;
+};
+} // namespace
+
 void AcceleratorConnection::createEngine(const std::string &engineTypeName,
                                          AppIDPath idPath,
                                          const ServiceImplDetails &details,
@@ -89,6 +133,10 @@ services::Service *AcceleratorConnection::getService(Service::Type svcType,
                                            clients);
     if (!svc)
       return nullptr;
+    if (traceRecorder)
+      if (auto *mmio = dynamic_cast<MMIO *>(svc))
+        svc = new RecordingMMIO(std::unique_ptr<MMIO>(mmio), id, clients,
+                                *traceRecorder);
     cacheEntry = std::unique_ptr<Service>(svc);
   }
   return cacheEntry.get();
@@ -347,39 +395,105 @@ AcceleratorConnection *Context::connect(std::string backend,
 struct AcceleratorServiceThread::Impl {
   Impl() {}
   void start() { me = std::thread(&Impl::loop, this); }
-  void stop() {
-    shutdown = true;
-    me.join();
-  }
+  void stop();
   /// When there's data on any of the listenPorts, call the callback. This
   /// method can be called from any thread.
   void
   addListener(std::initializer_list<ReadChannelPort *> listenPorts,
               std::function<void(ReadChannelPort *, MessageData)> callback);
 
-  void addTask(std::function<void(void)> task) {
-    std::lock_guard<std::mutex> g(m);
-    taskList.push_back(task);
+  void addTask(std::function<bool(void)> task) {
+    {
+      std::lock_guard<std::mutex> g(m);
+      taskList.push_back(task);
+    }
+    notify();
+  }
+
+  void setPollInterval(std::chrono::microseconds interval) {
+    std::lock_guard<std::mutex> g(wakeM);
+    pollInterval = interval;
+  }
+  void startCallbackWorkers(unsigned numWorkers);
+
+  /// Wake up the service thread. Thread safe and non-blocking, such that it
+  /// can be called from the threads delivering messages to read ports.
+  void notify() {
+    {
+      std::lock_guard<std::mutex> g(wakeM);
+      wakeRequested = true;
+    }
+    wakeCV.notify_one();
   }
 
 private:
+  struct Listener {
+    std::function<void(ReadChannelPort *, MessageData)> callback;
+    /// The outstanding read on the port.
+    std::future<MessageData> future;
+    /// Set while a callback for this port is running. Only one message per
+    /// port is in flight at a time, which keeps the callbacks for a port in
+    /// order and leaves backpressure to the port's data queue.
+    bool busy = false;
+  };
+
   void loop();
-  volatile bool shutdown = false;
+  void workerLoop();
+  /// Run the callback for a message, then issue the next read on the port.
+  void runCallback(ReadChannelPort *port,
+                   std::function<void(ReadChannelPort *, MessageData)> &cb,
+                   MessageData data);
+
+  std::atomic<bool> shutdown = false;
   std::thread me;
 
   // Protect the shared data structures.
   std::mutex m;
 
-  // Map of read ports to callbacks.
-  std::map<ReadChannelPort *,
-           std::pair<std::function<void(ReadChannelPort *, MessageData)>,
-                     std::future<MessageData>>>
-      listeners;
-
-  /// Tasks which should be called on every loop iteration.
-  std::vector<std::function<void(void)>> taskList;
+  // Map of read ports to their listeners.
+  std::map<ReadChannelPort *, Listener> listeners;
+
+  /// Tasks which should be called on every loop iteration. Each returns true
+  /// if it made progress, in which case the loop runs again without sleeping.
+  std::vector<std::function<bool(void)>> taskList;
+
+  /// Protects the wake up state. Never held while acquiring another lock.
+  std::mutex wakeM;
+  std::condition_variable wakeCV;
+  bool wakeRequested = false;
+  /// How long to sleep between calls to the tasks when idle.
+  std::chrono::microseconds pollInterval = std::chrono::microseconds(100);
+
+  /// Optional pool of threads running the listener callbacks, such that a slow
+  /// callback does not hold up the other ports.
+  std::vector<std::thread> workers;
+  std::mutex workM;
+  std::condition_variable workCV;
+  std::queue<std::function<void(void)>> workQueue;
 };
 
+void AcceleratorServiceThread::Impl::stop() {
+  {
+    std::lock_guard<std::mutex> g(wakeM);
+    shutdown = true;
+  }
+  wakeCV.notify_one();
+  me.join();
+
+  {
+    std::lock_guard<std::mutex> g(workM);
+  }
+  workCV.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+  workers.clear();
+
+  // The ports may outlive this thread, so make sure they stop notifying it.
+  std::lock_guard<std::mutex> g(m);
+  for (auto &[port, listener] : listeners)
+    port->setDataNotifier(nullptr);
+}
+
 void AcceleratorServiceThread::Impl::loop() {
   // These two variables should logically be in the loop, but this avoids
   // reconstructing them on each iteration.
@@ -387,57 +501,119 @@ void AcceleratorServiceThread::Impl::loop() {
                          std::function<void(ReadChannelPort *, MessageData)>,
                          MessageData>>
       portUnlockWorkList;
-  std::vector<std::function<void(void)>> taskListCopy;
-  MessageData data;
+  std::vector<std::function<bool(void)>> taskListCopy;
+  bool useWorkers;
 
   while (!shutdown) {
-    // Ideally we'd have some wake notification here, but this sufficies for
-    // now.
-    // TODO: investigate better ways to do this. For now, just play nice with
-    // the other processes but don't waste time in between polling intervals.
-    std::this_thread::yield();
-
-    // Check and gather data from all the read ports we are monitoring. Put the
+    // Gather data from all the read ports which signaled readiness. Put the
     // callbacks to be called later so we can release the lock.
     {
       std::lock_guard<std::mutex> g(m);
-      for (auto &[channel, cbfPair] : listeners) {
+      for (auto &[channel, listener] : listeners) {
         assert(channel && "Null channel in listener list");
-        std::future<MessageData> &f = cbfPair.second;
-        if (f.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-          portUnlockWorkList.emplace_back(channel, cbfPair.first, f.get());
-          f = channel->readAsync();
-        }
+        if (listener.busy)
+          continue;
+        std::future<MessageData> &f = listener.future;
+        if (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+          continue;
+        listener.busy = true;
+        portUnlockWorkList.emplace_back(channel, listener.callback, f.get());
       }
+      // Copy the task list so we can release the lock ASAP.
+      taskListCopy = taskList;
+      useWorkers = !workers.empty();
     }
+    bool progress = !portUnlockWorkList.empty();
 
-    // Call the callbacks outside the lock.
-    for (auto [channel, cb, data] : portUnlockWorkList)
-      cb(channel, std::move(data));
+    // Call the callbacks outside the lock, either here or on the workers.
+    if (!useWorkers) {
+      for (auto &[channel, cb, data] : portUnlockWorkList)
+        runCallback(channel, cb, std::move(data));
+    } else {
+      {
+        std::lock_guard<std::mutex> g(workM);
+        for (auto &[channel, cb, data] : portUnlockWorkList)
+          workQueue.push([this, channel = channel, cb = std::move(cb),
+                          data = std::move(data)]() mutable {
+            runCallback(channel, cb, std::move(data));
+          });
+      }
+      workCV.notify_all();
+    }
 
     // Clear the worklist for the next iteration.
     portUnlockWorkList.clear();
 
-    // Call any tasks that have been added. Copy it first so we can release the
-    // lock ASAP.
+    // Call any tasks that have been added.
+    for (auto &task : taskListCopy)
+      progress |= task();
+    if (progress)
+      continue;
+
+    // Sleep until a port has data or a listener or task is added. Tasks poll
+    // the hardware, so if there are any wake up periodically to call them.
+    std::unique_lock<std::mutex> l(wakeM);
+    auto woken = [&]() { return wakeRequested || shutdown; };
+    if (taskListCopy.empty())
+      wakeCV.wait(l, woken);
+    else
+      wakeCV.wait_for(l, pollInterval, woken);
+    wakeRequested = false;
+  }
+}
+
+void AcceleratorServiceThread::Impl::workerLoop() {
+  while (true) {
+    std::function<void(void)> work;
     {
-      std::lock_guard<std::mutex> g(m);
-      taskListCopy = taskList;
+      std::unique_lock<std::mutex> l(workM);
+      workCV.wait(l, [&]() { return !workQueue.empty() || shutdown; });
+      // Drain the queue before shutting down.
+      if (workQueue.empty())
+        return;
+      work = std::move(workQueue.front());
+      workQueue.pop();
     }
-    for (auto &task : taskListCopy)
-      task();
+    work();
   }
 }
 
+void AcceleratorServiceThread::Impl::runCallback(
+    ReadChannelPort *port,
+    std::function<void(ReadChannelPort *, MessageData)> &cb, MessageData data) {
+  cb(port, std::move(data));
+  {
+    std::lock_guard<std::mutex> g(m);
+    Listener &listener = listeners.at(port);
+    listener.future = port->readAsync();
+    listener.busy = false;
+  }
+  // The port may already have had data queued up.
+  notify();
+}
+
+void AcceleratorServiceThread::Impl::startCallbackWorkers(
+    unsigned numWorkers) {
+  std::lock_guard<std::mutex> g(m);
+  if (!workers.empty())
+    throw std::runtime_error("Callback workers already started");
+  for (unsigned i = 0; i < numWorkers; ++i)
+    workers.emplace_back(&Impl::workerLoop, this);
+}
+
 void AcceleratorServiceThread::Impl::addListener(
     std::initializer_list<ReadChannelPort *> listenPorts,
     std::function<void(ReadChannelPort *, MessageData)> callback) {
-  std::lock_guard<std::mutex> g(m);
-  for (auto port : listenPorts) {
-    if (listeners.count(port))
-      throw std::runtime_error("Port already has a listener");
-    listeners[port] = std::make_pair(callback, port->readAsync());
+  {
+    std::lock_guard<std::mutex> g(m);
+    for (auto port : listenPorts) {
+      if (listeners.count(port))
+        throw std::runtime_error("Port already has a listener");
+      port->setDataNotifier([this]() { notify(); });
+      listeners[port] = Listener{callback, port->readAsync()};
+    }
   }
+  notify();
 }
 
 AcceleratorServiceThread::AcceleratorServiceThread()
@@ -453,9 +629,8 @@ void AcceleratorServiceThread::stop() {
   }
 }
 
-// When there's data on any of the listenPorts, call the callback. This is
-// kinda silly now that we have callback port support, especially given the
-// polling loop. Keep the functionality for now.
+// When there's data on any of the listenPorts, call the callback. The service
+// thread is woken up by the ports when data arrives.
 void AcceleratorServiceThread::addListener(
     std::initializer_list<ReadChannelPort *> listenPorts,
     std::function<void(ReadChannelPort *, MessageData)> callback) {
@@ -465,7 +640,18 @@ void AcceleratorServiceThread::addListener(
 
 void AcceleratorServiceThread::addPoll(HWModule &module) {
   assert(impl && "Service thread not running");
-  impl->addTask([&module]() { module.poll(); });
+  impl->addTask([&module]() { return module.poll(); });
+}
+
+void AcceleratorServiceThread::setPollInterval(
+    std::chrono::microseconds interval) {
+  assert(impl && "Service thread not running");
+  impl->setPollInterval(interval);
+}
+
+void AcceleratorServiceThread::startCallbackWorkers(unsigned numWorkers) {
+  assert(impl && "Service thread not running");
+  impl->startCallbackWorkers(numWorkers);
 }
 
 void AcceleratorConnection::disconnect() {
@@ -14,22 +14,224 @@
 
 #include "esi/Common.h"
 
+#include <array>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 using namespace esi;
 
+//===----------------------------------------------------------------------===//
+// Message buffers
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A buffer allocated from the pool. The bytes follow this header in the same
+/// allocation.
+class PooledBuffer : public MessageBuffer {
+public:
+  /// Size class of buffers which are too large to be pooled.
+  static constexpr unsigned Unpooled = ~0u;
+
+  PooledBuffer(unsigned sizeClass, size_t capacity)
+      : MessageBuffer(reinterpret_cast<uint8_t *>(this + 1), capacity),
+        sizeClass(sizeClass) {}
+
+  static PooledBuffer *create(unsigned sizeClass, size_t capacity) {
+    void *mem = ::operator new(sizeof(PooledBuffer) + capacity);
+    return new (mem) PooledBuffer(sizeClass, capacity);
+  }
+  void free() {
+    this->~PooledBuffer();
+    ::operator delete(this);
+  }
+  void reuse() { refs.store(1, std::memory_order_relaxed); }
+
+  const unsigned sizeClass;
+
+protected:
+  void destroy() override;
+};
+
+/// Keeps released buffers around for reuse, bucketed into power of two size
+/// classes. Avoids going through the allocator for every message.
+class BufferPool {
+public:
+  static BufferPool &get() {
+    // Intentionally leaked, since messages may outlive static destructors.
+    static BufferPool *pool = new BufferPool();
+    return *pool;
+  }
+
+  PooledBuffer *allocate(size_t size) {
+    unsigned sizeClass = getSizeClass(size);
+    if (sizeClass >= NumSizeClasses)
+      return PooledBuffer::create(PooledBuffer::Unpooled, size);
+    SizeClass &cls = classes[sizeClass];
+    {
+      std::lock_guard<std::mutex> g(cls.m);
+      if (!cls.free.empty()) {
+        PooledBuffer *buffer = cls.free.back();
+        cls.free.pop_back();
+        buffer->reuse();
+        return buffer;
+      }
+    }
+    return PooledBuffer::create(sizeClass, size_t(1) << (sizeClass + MinLog2));
+  }
+
+  void recycle(PooledBuffer *buffer) {
+    if (buffer->sizeClass == PooledBuffer::Unpooled)
+      return buffer->free();
+    SizeClass &cls = classes[buffer->sizeClass];
+    {
+      std::lock_guard<std::mutex> g(cls.m);
+      if (cls.free.size() * buffer->getCapacity() < MaxCachedBytesPerClass) {
+        cls.free.push_back(buffer);
+        return;
+      }
+    }
+    buffer->free();
+  }
+
+private:
+  /// Buffers range from 64 bytes to 4 MiB. Larger ones are not pooled.
+  static constexpr unsigned MinLog2 = 6;
+  static constexpr unsigned MaxLog2 = 22;
+  static constexpr unsigned NumSizeClasses = MaxLog2 - MinLog2 + 1;
+  /// Upper bound on the memory kept around per size class.
+  static constexpr size_t MaxCachedBytesPerClass = 16 << 20;
+
+  static unsigned getSizeClass(size_t size) {
+    unsigned log2 = MinLog2;
+    while (log2 <= MaxLog2 && (size_t(1) << log2) < size)
+      ++log2;
+    return log2 - MinLog2;
+  }
+
+  struct SizeClass {
+    std::mutex m;
+    std::vector<PooledBuffer *> free;
+  };
+  std::array<SizeClass, NumSizeClasses> classes;
+};
+
+void PooledBuffer::destroy() { BufferPool::get().recycle(this); }
+
+/// A buffer owning the storage of a vector.
+class VectorBuffer : public MessageBuffer {
+public:
+  VectorBuffer(std::vector<uint8_t> &&vec)
+      : MessageBuffer(vec.data(), vec.size()), vec(std::move(vec)) {}
+  std::vector<uint8_t> vec;
+};
+
+/// A buffer wrapping memory owned by someone else.
+class ExternalBuffer : public MessageBuffer {
+public:
+  ExternalBuffer(uint8_t *data, size_t size, std::function<void()> release)
+      : MessageBuffer(data, size), onRelease(std::move(release)) {}
+  ~ExternalBuffer() override {
+    if (onRelease)
+      onRelease();
+  }
+  std::function<void()> onRelease;
+};
+} // namespace
+
+MessageBuffer *MessageBuffer::allocate(size_t size) {
+  return BufferPool::get().allocate(size);
+}
+
+MessageBuffer *MessageBuffer::adopt(std::vector<uint8_t> &&data) {
+  return new VectorBuffer(std::move(data));
+}
+
+MessageBuffer *MessageBuffer::wrap(uint8_t *data, size_t size,
+                                   std::function<void()> release) {
+  return new ExternalBuffer(data, size, std::move(release));
+}
+
+//===----------------------------------------------------------------------===//
+// MessageData
+//===----------------------------------------------------------------------===//
+
+MessageData::MessageData(const uint8_t *data, size_t size) {
+  if (size == 0)
+    return;
+  buffer = MessageBuffer::allocate(size);
+  std::memcpy(buffer->getData(), data, size);
+  bytes = buffer->getData();
+  length = size;
+}
+
+MessageData::MessageData(std::vector<uint8_t> &&data) {
+  if (data.empty())
+    return;
+  length = data.size();
+  buffer = MessageBuffer::adopt(std::move(data));
+  bytes = buffer->getData();
+}
+
+MessageData MessageData::allocate(size_t size) {
+  if (size == 0)
+    return MessageData();
+  MessageBuffer *buffer = MessageBuffer::allocate(size);
+  return MessageData(buffer, buffer->getData(), size);
+}
+
+MessageData MessageData::wrap(const uint8_t *data, size_t size,
+                              std::function<void()> release) {
+  MessageBuffer *buffer = MessageBuffer::wrap(const_cast<uint8_t *>(data),
+                                              size, std::move(release));
+  return MessageData(buffer, data, size);
+}
+
+uint8_t *MessageData::getMutableBytes() {
+  if (!buffer)
+    return nullptr;
+  if (!buffer->isUnique() || dynamic_cast<ExternalBuffer *>(buffer))
+    *this = MessageData(bytes, length);
+  return const_cast<uint8_t *>(bytes);
+}
+
+MessageData MessageData::slice(size_t offset, size_t size) const {
+  if (offset > length || size > length - offset)
+    throw std::runtime_error("Slice [" + std::to_string(offset) + ", " +
+                             std::to_string(offset + size) +
+                             ") is out of bounds of message of size " +
+                             std::to_string(length));
+  if (size == 0)
+    return MessageData();
+  buffer->retain();
+  return MessageData(buffer, bytes + offset, size);
+}
+
+std::vector<uint8_t> MessageData::takeData() {
+  auto *vecBuffer = dynamic_cast<VectorBuffer *>(buffer);
+  if (vecBuffer && vecBuffer->isUnique() && bytes == vecBuffer->vec.data() &&
+      length == vecBuffer->vec.size()) {
+    std::vector<uint8_t> data = std::move(vecBuffer->vec);
+    *this = MessageData();
+    return data;
+  }
+  std::vector<uint8_t> data(bytes, bytes + length);
+  *this = MessageData();
+  return data;
+}
+
 std::string MessageData::toHex() const {
   std::ostringstream ss;
   ss << std::hex;
-  for (size_t i = 0, e = data.size(); i != e; ++i) {
+  for (size_t i = 0, e = length; i != e; ++i) {
     // Add spaces every 8 bytes.
     if (i % 8 == 0 && i != 0)
       ss << ' ';
     // Add an extra space every 64 bytes.
     if (i % 64 == 0 && i != 0)
       ss << ' ';
-    ss << static_cast<unsigned>(data[i]);
+    ss << static_cast<unsigned>(bytes[i]);
   }
   return ss.str();
 }
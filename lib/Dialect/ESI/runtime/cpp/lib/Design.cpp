@@ -44,13 +44,35 @@ HWModule::HWModule(std::optional<ModuleInfo> info,
                    std::vector<services::Service *> services,
                    std::vector<std::unique_ptr<BundlePort>> &&ports)
     : info(info), children(std::move(children)),
-      childIndex(buildIndex(this->children)), services(services),
-      ports(std::move(ports)), portIndex(buildIndex(this->ports)) {}
+      childIndex(buildIndex(this->children)), childrenBuilt(true),
+      services(services), ports(std::move(ports)),
+      portIndex(buildIndex(this->ports)) {}
+
+HWModule::HWModule(std::optional<ModuleInfo> info, ChildBuilder buildChildren,
+                   std::vector<services::Service *> services,
+                   std::vector<std::unique_ptr<BundlePort>> &&ports)
+    : info(info), childBuilder(std::move(buildChildren)), childrenBuilt(false),
+      services(services), ports(std::move(ports)),
+      portIndex(buildIndex(this->ports)) {}
+
+void HWModule::buildChildren() const {
+  if (childrenBuilt.load(std::memory_order_acquire))
+    return;
+  std::call_once(childrenOnce, [this]() {
+    children = childBuilder();
+    childIndex = buildIndex(children);
+    childBuilder = nullptr;
+    childrenBuilt.store(true, std::memory_order_release);
+  });
+}
 
 bool HWModule::poll() {
   bool result = false;
   for (auto &port : ports)
     result |= port->poll();
+  // Children which haven't been built don't have any ports to poll yet.
+  if (!childrenBuilt.load(std::memory_order_acquire))
+    return result;
   for (auto &child : children)
     result |= child->poll();
   return result;
@@ -61,8 +83,9 @@ const HWModule *HWModule::resolveInst(const AppIDPath &path,
   const HWModule *hwmodule = this;
   for (auto &id : path) {
     lastLookup.push_back(id);
-    auto childIter = hwmodule->childIndex.find(id);
-    if (childIter == hwmodule->childIndex.end())
+    const std::map<AppID, Instance *> &childIndex = hwmodule->getChildren();
+    auto childIter = childIndex.find(id);
+    if (childIter == childIndex.end())
       return nullptr;
     hwmodule = childIter->second;
   }
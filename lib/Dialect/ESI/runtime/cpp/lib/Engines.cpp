@@ -457,11 +457,21 @@ REGISTER_ENGINE("OneItemBuffersFromHost", OneItemBuffersFromHost);
 ChannelPort &Engine::requestPort(AppIDPath idPath,
                                  const std::string &channelName,
                                  BundleType::Direction dir, const Type *type) {
+  std::scoped_lock<std::mutex> lock(portsMutex);
   auto portIter = ownedPorts.find(std::make_pair(idPath, channelName));
   if (portIter != ownedPorts.end())
     return *portIter->second;
   std::unique_ptr<ChannelPort> port =
       createPort(idPath, channelName, dir, type);
+  std::string name = idPath.toStr() + "." + channelName;
+  if (Metrics *metrics = conn.getMetrics())
+    port->setMetrics(&metrics->getChannel(name));
+  if (auto *recorder = conn.getTraceRecorder()) {
+    using backends::trace::format::Direction;
+    Direction traceDir = BundlePort::isWrite(dir) ? Direction::ToAccelerator
+                                                  : Direction::FromAccelerator;
+    port->setTraceRecorder(recorder, recorder->addChannel(name, traceDir));
+  }
   ChannelPort &ret = *port;
   ownedPorts.emplace(std::make_pair(idPath, channelName), std::move(port));
   return ret;
@@ -24,23 +24,432 @@
 #if defined(__GNUC__)
 #pragma GCC diagnostic pop
 #endif
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <set>
 #include <sstream>
 
 using namespace ::esi;
 
+//===----------------------------------------------------------------------===//
+// Manifest index for lazy loading.
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A range of bytes in the manifest text.
+struct Range {
+  uint64_t begin = 0;
+  uint64_t end = 0;
+};
+
+/// Finds the extents of JSON values without building a DOM, which is much
+/// faster than parsing. The JSON is assumed to be well formed since every part
+/// which gets used is parsed later by the real parser; this only checks enough
+/// to avoid running off the end of the text.
+class JsonScanner {
+public:
+  JsonScanner(std::string_view text) : text(text) {}
+
+  /// Get the extent of the value starting at `pos`, after any whitespace.
+  Range value(uint64_t pos) const;
+  /// Call `fn(key, member, value)` for each member of the object `obj`, where
+  /// `member` covers both the key and the value.
+  void forEachMember(
+      Range obj,
+      const std::function<void(std::string_view, Range, Range)> &fn) const;
+  /// Call `fn(element)` for each element of the array `array`.
+  void forEachElement(Range array,
+                      const std::function<void(Range)> &fn) const;
+  /// Decode the string `str`.
+  std::string getString(Range str) const;
+
+private:
+  uint64_t skipWhitespace(uint64_t pos) const;
+  /// Skip the string starting at `pos`. Returns the position after it.
+  uint64_t skipString(uint64_t pos) const;
+  [[noreturn]] void error(uint64_t pos) const {
+    throw std::runtime_error("malformed manifest: unexpected JSON at offset " +
+                             std::to_string(pos));
+  }
+
+  std::string_view text;
+};
+
+uint64_t JsonScanner::skipWhitespace(uint64_t pos) const {
+  while (pos < text.size() && std::isspace(static_cast<uint8_t>(text[pos])))
+    ++pos;
+  if (pos >= text.size())
+    error(pos);
+  return pos;
+}
+
+uint64_t JsonScanner::skipString(uint64_t pos) const {
+  for (++pos; pos < text.size(); ++pos) {
+    if (text[pos] == '\\')
+      ++pos;
+    else if (text[pos] == '"')
+      return pos + 1;
+  }
+  error(pos);
+}
+
+Range JsonScanner::value(uint64_t pos) const {
+  pos = skipWhitespace(pos);
+  char c = text[pos];
+  if (c == '"')
+    return {pos, skipString(pos)};
+  if (c == '{' || c == '[') {
+    uint64_t depth = 0;
+    for (uint64_t i = pos; i < text.size();) {
+      switch (text[i]) {
+      case '"':
+        i = skipString(i);
+        continue;
+      case '{':
+      case '[':
+        ++depth;
+        break;
+      case '}':
+      case ']':
+        if (--depth == 0)
+          return {pos, i + 1};
+        break;
+      default:
+        break;
+      }
+      ++i;
+    }
+    error(pos);
+  }
+  // A number, boolean, or null.
+  uint64_t end = pos;
+  while (end < text.size() && !std::strchr(",]} \t\r\n", text[end]))
+    ++end;
+  if (end == pos)
+    error(pos);
+  return {pos, end};
+}
+
+void JsonScanner::forEachMember(
+    Range obj,
+    const std::function<void(std::string_view, Range, Range)> &fn) const {
+  if (text[obj.begin] != '{')
+    error(obj.begin);
+  uint64_t pos = skipWhitespace(obj.begin + 1);
+  while (text[pos] != '}') {
+    if (text[pos] != '"')
+      error(pos);
+    Range key = value(pos);
+    pos = skipWhitespace(key.end);
+    if (text[pos] != ':')
+      error(pos);
+    Range val = value(pos + 1);
+    fn(text.substr(key.begin + 1, key.end - key.begin - 2),
+       {key.begin, val.end}, val);
+    pos = skipWhitespace(val.end);
+    if (text[pos] == ',')
+      pos = skipWhitespace(pos + 1);
+    if (pos >= obj.end)
+      error(pos);
+  }
+}
+
+void JsonScanner::forEachElement(Range array,
+                                 const std::function<void(Range)> &fn) const {
+  if (text[array.begin] != '[')
+    error(array.begin);
+  uint64_t pos = skipWhitespace(array.begin + 1);
+  while (text[pos] != ']') {
+    Range element = value(pos);
+    fn(element);
+    pos = skipWhitespace(element.end);
+    if (text[pos] == ',')
+      pos = skipWhitespace(pos + 1);
+    if (pos >= array.end)
+      error(pos);
+  }
+}
+
+std::string JsonScanner::getString(Range str) const {
+  std::string_view raw = text.substr(str.begin, str.end - str.begin);
+  if (raw.size() < 2 || raw.front() != '"')
+    error(str.begin);
+  if (raw.find('\\') == std::string_view::npos)
+    return std::string(raw.substr(1, raw.size() - 2));
+  return nlohmann::json::parse(raw).get<std::string>();
+}
+
+/// Locates the parts of the manifest which lazy manifests parse individually:
+/// the types, the modules, and the nodes of the design hierarchy. It is small
+/// compared to the manifest and cheap to load, so it gets cached.
+struct ManifestIndex {
+  /// A node in the design hierarchy.
+  struct Node {
+    /// The members of the node's object other than 'children', in
+    /// `nodeMembers`.
+    uint64_t firstMember = 0;
+    uint64_t numMembers = 0;
+    /// The node's children, in `nodeChildren`.
+    uint64_t firstChild = 0;
+    uint64_t numChildren = 0;
+  };
+
+  Range apiVersion;
+  Range serviceDecls;
+  /// The types by ID, in type table order.
+  std::vector<std::pair<std::string, Range>> types;
+  /// The modules by symbol.
+  std::vector<std::pair<std::string, Range>> modules;
+  /// The design hierarchy. The root ('design') is node 0.
+  std::vector<Node> nodes;
+  std::vector<Range> nodeMembers;
+  std::vector<uint64_t> nodeChildren;
+
+  /// Index the manifest.
+  static ManifestIndex build(std::string_view json);
+
+  /// Serialize the index to a file, tagged with the manifest's hash and size.
+  void save(const std::filesystem::path &path, uint64_t hash,
+            uint64_t size) const;
+  /// Load an index saved for a manifest with the given hash and size. Returns
+  /// nullopt if the file doesn't exist, is corrupt, or is for another
+  /// manifest.
+  static std::optional<ManifestIndex> load(const std::filesystem::path &path,
+                                           uint64_t hash, uint64_t size);
+
+private:
+  uint64_t addNode(const JsonScanner &scanner, Range obj);
+};
+
+constexpr char indexMagic[8] = {'E', 'S', 'I', 'M', 'I', 'D', 'X', '\0'};
+constexpr uint32_t indexVersion = 1;
+
+/// FNV-1a, which is plenty to tell manifests apart.
+uint64_t hashManifest(std::string_view text) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : text) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+ManifestIndex ManifestIndex::build(std::string_view json) {
+  JsonScanner scanner(json);
+  ManifestIndex index;
+  Range root = scanner.value(0);
+  Range design;
+  bool hasDesign = false;
+  auto indexTable = [&](Range table, const char *keyName,
+                        std::vector<std::pair<std::string, Range>> &entries) {
+    scanner.forEachElement(table, [&](Range entry) {
+      std::optional<std::string> key;
+      scanner.forEachMember(entry, [&](std::string_view name, Range, Range v) {
+        if (name == keyName)
+          key = scanner.getString(v);
+      });
+      if (!key)
+        throw std::runtime_error(std::string("malformed manifest: missing '") +
+                                 keyName + "'");
+      entries.emplace_back(std::move(*key), entry);
+    });
+  };
+  scanner.forEachMember(root, [&](std::string_view key, Range, Range value) {
+    if (key == "apiVersion")
+      index.apiVersion = value;
+    else if (key == "serviceDeclarations")
+      index.serviceDecls = value;
+    else if (key == "types")
+      indexTable(value, "id", index.types);
+    else if (key == "modules")
+      indexTable(value, "symbol", index.modules);
+    else if (key == "design") {
+      design = value;
+      hasDesign = true;
+    }
+  });
+  if (!hasDesign || index.apiVersion.end == 0 || index.serviceDecls.end == 0)
+    throw std::runtime_error("malformed manifest: missing top level section");
+  index.addNode(scanner, design);
+  return index;
+}
+
+uint64_t ManifestIndex::addNode(const JsonScanner &scanner, Range obj) {
+  uint64_t nodeIdx = nodes.size();
+  nodes.emplace_back();
+  std::vector<Range> members;
+  std::vector<Range> children;
+  scanner.forEachMember(obj, [&](std::string_view key, Range member,
+                                 Range value) {
+    if (key == "children")
+      scanner.forEachElement(value, [&](Range c) { children.push_back(c); });
+    else
+      members.push_back(member);
+  });
+
+  Node node;
+  node.firstMember = nodeMembers.size();
+  node.numMembers = members.size();
+  nodeMembers.insert(nodeMembers.end(), members.begin(), members.end());
+  // Reserve the children's slots first so that they are contiguous.
+  node.firstChild = nodeChildren.size();
+  node.numChildren = children.size();
+  nodeChildren.resize(nodeChildren.size() + children.size());
+  nodes[nodeIdx] = node;
+  for (size_t i = 0, e = children.size(); i < e; ++i) {
+    uint64_t childIdx = addNode(scanner, children[i]);
+    nodeChildren[node.firstChild + i] = childIdx;
+  }
+  return nodeIdx;
+}
+
+/// Write the POD `value`.
+template <typename T>
+void writePOD(std::ostream &os, const T &value) {
+  os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void ManifestIndex::save(const std::filesystem::path &path, uint64_t hash,
+                         uint64_t size) const {
+  // Write to a temporary file and move it into place so that other processes
+  // never see a partially written index.
+  std::filesystem::path tmpPath = path;
+  tmpPath += ".tmp" + std::to_string(hash ^ reinterpret_cast<uintptr_t>(this));
+  {
+    std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!os)
+      throw std::runtime_error("could not write '" + tmpPath.string() + "'");
+    os.write(indexMagic, sizeof(indexMagic));
+    writePOD(os, indexVersion);
+    writePOD(os, uint32_t(0));
+    writePOD(os, hash);
+    writePOD(os, size);
+    writePOD(os, apiVersion);
+    writePOD(os, serviceDecls);
+    for (const auto *table : {&types, &modules}) {
+      writePOD(os, uint64_t(table->size()));
+      for (const auto &[key, range] : *table) {
+        writePOD(os, uint64_t(key.size()));
+        os.write(key.data(), key.size());
+        writePOD(os, range);
+      }
+    }
+    writePOD(os, uint64_t(nodes.size()));
+    os.write(reinterpret_cast<const char *>(nodes.data()),
+             nodes.size() * sizeof(Node));
+    writePOD(os, uint64_t(nodeMembers.size()));
+    os.write(reinterpret_cast<const char *>(nodeMembers.data()),
+             nodeMembers.size() * sizeof(Range));
+    writePOD(os, uint64_t(nodeChildren.size()));
+    os.write(reinterpret_cast<const char *>(nodeChildren.data()),
+             nodeChildren.size() * sizeof(uint64_t));
+    if (!os)
+      throw std::runtime_error("could not write '" + tmpPath.string() + "'");
+  }
+  std::filesystem::rename(tmpPath, path);
+}
+
+std::optional<ManifestIndex>
+ManifestIndex::load(const std::filesystem::path &path, uint64_t hash,
+                    uint64_t size) {
+  std::ifstream is(path, std::ios::binary);
+  if (!is)
+    return std::nullopt;
+  std::string data((std::istreambuf_iterator<char>(is)),
+                   std::istreambuf_iterator<char>());
+
+  // Read from `data`, failing if there isn't enough of it.
+  uint64_t pos = 0;
+  auto read = [&](void *dst, uint64_t bytes) {
+    if (bytes > data.size() - pos)
+      return false;
+    std::memcpy(dst, data.data() + pos, bytes);
+    pos += bytes;
+    return true;
+  };
+  auto readVector = [&](auto &vec) {
+    uint64_t count;
+    if (!read(&count, sizeof(count)) ||
+        count > (data.size() - pos) / sizeof(vec[0]))
+      return false;
+    vec.resize(count);
+    return read(vec.data(), count * sizeof(vec[0]));
+  };
+  auto validRange = [&](Range r) { return r.begin <= r.end && r.end <= size; };
+
+  char magic[sizeof(indexMagic)];
+  uint32_t version, reserved;
+  uint64_t fileHash, fileSize;
+  if (!read(magic, sizeof(magic)) || !read(&version, sizeof(version)) ||
+      !read(&reserved, sizeof(reserved)) ||
+      !read(&fileHash, sizeof(fileHash)) ||
+      !read(&fileSize, sizeof(fileSize)))
+    return std::nullopt;
+  if (std::memcmp(magic, indexMagic, sizeof(magic)) != 0 ||
+      version != indexVersion || fileHash != hash || fileSize != size)
+    return std::nullopt;
+
+  ManifestIndex index;
+  if (!read(&index.apiVersion, sizeof(Range)) ||
+      !read(&index.serviceDecls, sizeof(Range)) ||
+      !validRange(index.apiVersion) || !validRange(index.serviceDecls))
+    return std::nullopt;
+  for (auto *table : {&index.types, &index.modules}) {
+    uint64_t count;
+    if (!read(&count, sizeof(count)))
+      return std::nullopt;
+    for (uint64_t i = 0; i < count; ++i) {
+      uint64_t keySize;
+      if (!read(&keySize, sizeof(keySize)) || keySize > data.size() - pos)
+        return std::nullopt;
+      std::string key(data.data() + pos, keySize);
+      pos += keySize;
+      Range range;
+      if (!read(&range, sizeof(range)) || !validRange(range))
+        return std::nullopt;
+      table->emplace_back(std::move(key), range);
+    }
+  }
+  if (!readVector(index.nodes) || !readVector(index.nodeMembers) ||
+      !readVector(index.nodeChildren) || pos != data.size() ||
+      index.nodes.empty())
+    return std::nullopt;
+  for (uint64_t i = 0, e = index.nodes.size(); i < e; ++i) {
+    const Node &node = index.nodes[i];
+    if (node.firstMember > index.nodeMembers.size() ||
+        node.numMembers > index.nodeMembers.size() - node.firstMember ||
+        node.firstChild > index.nodeChildren.size() ||
+        node.numChildren > index.nodeChildren.size() - node.firstChild)
+      return std::nullopt;
+    // Children always come after their parents, so this also rules out
+    // cycles.
+    for (uint64_t c = 0; c < node.numChildren; ++c) {
+      uint64_t child = index.nodeChildren[node.firstChild + c];
+      if (child <= i || child >= e)
+        return std::nullopt;
+    }
+  }
+  for (Range member : index.nodeMembers)
+    if (!validRange(member))
+      return std::nullopt;
+  return index;
+}
+} // namespace
+
 // This is a proxy class to the manifest JSON. It is used to avoid having to
 // include the JSON parser in the header. Forward references don't work since
 // nlohmann::json is a rather complex template.
 //
 // Plus, it allows us to hide some implementation functions from the header
 // file.
-class Manifest::Impl {
+class Manifest::Impl : public std::enable_shared_from_this<Manifest::Impl> {
   friend class ::esi::Manifest;
 
 public:
-  Impl(Context &ctxt, const std::string &jsonManifest);
+  Impl(Context &ctxt, const std::string &jsonManifest, const Options &options);
 
-  auto at(const std::string &key) const { return manifestJson.at(key); }
+  uint32_t getApiVersion() const;
 
   // Get the module info (if any) for the module instance in 'json'.
   std::optional<ModuleInfo> getModInfo(const nlohmann::json &) const;
@@ -88,39 +497,79 @@ public:
                    ServiceTable activeServices,
                    const nlohmann::json &childJson) const;
 
+  /// Get a function which builds the children of the design node 'node' of a
+  /// lazy manifest. The children's own children are again built lazily.
+  HWModule::ChildBuilder getChildBuilder(AppIDPath idPath,
+                                         AcceleratorConnection &acc,
+                                         ServiceTable activeServices,
+                                         uint64_t node) const;
+
   /// Parse all the types and populate the types table.
   void populateTypes(const nlohmann::json &typesJson);
 
   /// Get the ordered list of types from the manifest.
-  const std::vector<const Type *> &getTypeTable() const { return _typeTable; }
+  const std::vector<const Type *> &getTypeTable() const;
 
   /// Build a dynamic API for the Accelerator connection 'acc' based on the
   /// manifest stored herein.
   std::unique_ptr<Accelerator>
   buildAccelerator(AcceleratorConnection &acc) const;
 
-  const Type *parseType(const nlohmann::json &typeJson);
+  const Type *parseType(const nlohmann::json &typeJson) const;
 
-  const std::map<std::string, const ModuleInfo> &getSymbolInfo() const {
-    return symbolInfoCache;
-  }
+  /// Get the module info of all the modules.
+  const std::map<std::string, const ModuleInfo> &getSymbolInfo() const;
 
 private:
   Context &ctxt;
-  std::vector<const Type *> _typeTable;
+  mutable std::vector<const Type *> _typeTable;
 
-  std::optional<const Type *> getType(Type::ID id) const {
-    return ctxt.getType(id);
-  }
+  /// Look up a type, parsing it first if the manifest is lazy.
+  std::optional<const Type *> getType(Type::ID id) const;
 
   std::any getAny(const nlohmann::json &value) const;
   void parseModuleMetadata(ModuleInfo &info, const nlohmann::json &mod) const;
   void parseModuleConsts(ModuleInfo &info, const nlohmann::json &mod) const;
+  ModuleInfo parseModuleInfo(const nlohmann::json &mod) const;
+  /// Get the module info for a module symbol.
+  std::optional<ModuleInfo> getSymbolInfo(const std::string &symbol) const;
 
-  // The parsed json.
+  // The parsed json. Empty for lazy manifests.
   nlohmann::json manifestJson;
   // Cache the module info for each symbol.
-  std::map<std::string, const ModuleInfo> symbolInfoCache;
+  mutable std::map<std::string, const ModuleInfo> symbolInfoCache;
+
+  //===--------------------------------------------------------------------===//
+  // Lazy manifest support.
+  //===--------------------------------------------------------------------===//
+
+  /// Index the manifest for lazy parsing, loading the index from the cache
+  /// directory if possible.
+  void indexManifest(const std::string &jsonManifest,
+                     const std::filesystem::path &cacheDir);
+  /// Parse a part of a lazy manifest.
+  nlohmann::json parse(Range range) const;
+  /// Parse a node of the design hierarchy of a lazy manifest, except for its
+  /// children.
+  nlohmann::json parseNode(uint64_t node) const;
+  /// Parse the type with the given ID if it hasn't been parsed yet. Returns
+  /// null if there is no such type or it is being parsed.
+  const Type *parseLazyType(const std::string &id) const;
+
+  /// Set for lazy manifests only.
+  struct LazyState {
+    std::string text;
+    ManifestIndex index;
+    std::map<std::string, Range> types;
+    std::map<std::string, Range> modules;
+    /// Types which are currently being parsed.
+    std::set<std::string> parsingTypes;
+    bool allModulesParsed = false;
+  };
+  std::unique_ptr<LazyState> lazy;
+  /// Protects the lazily populated members. Recursive since parsing a type
+  /// parses the types it references.
+  mutable std::recursive_mutex lazyMutex;
 };
 
 //===----------------------------------------------------------------------===//
@@ -255,8 +704,15 @@ void Manifest::Impl::parseModuleConsts(ModuleInfo &info,
 // Manifest::Impl class implementation.
 //===----------------------------------------------------------------------===//
 
-Manifest::Impl::Impl(Context &ctxt, const std::string &manifestStr)
+Manifest::Impl::Impl(Context &ctxt, const std::string &manifestStr,
+                     const Options &options)
     : ctxt(ctxt) {
+  if (options.lazy) {
+    // Types and modules get parsed when they are first looked up.
+    indexManifest(manifestStr, options.indexCacheDir);
+    return;
+  }
+
   manifestJson = nlohmann::ordered_json::parse(manifestStr);
 
   try {
@@ -264,14 +720,8 @@ Manifest::Impl::Impl(Context &ctxt, const std::string &manifestStr)
     populateTypes(manifestJson.at("types"));
 
     // Populate the symbol info cache.
-    for (auto &mod : manifestJson.at("modules")) {
-      ModuleInfo info;
-      if (mod.contains("symInfo"))
-        parseModuleMetadata(info, mod.at("symInfo"));
-      if (mod.contains("symConsts"))
-        parseModuleConsts(info, mod.at("symConsts"));
-      symbolInfoCache.insert(make_pair(mod.at("symbol"), info));
-    }
+    for (auto &mod : manifestJson.at("modules"))
+      symbolInfoCache.insert(make_pair(mod.at("symbol"), parseModuleInfo(mod)));
   } catch (const std::exception &e) {
     std::string msg = "malformed manifest: " + std::string(e.what());
     if (manifestJson.at("apiVersion") == 0)
@@ -280,11 +730,144 @@ Manifest::Impl::Impl(Context &ctxt, const std::string &manifestStr)
   }
 }
 
+void Manifest::Impl::indexManifest(const std::string &manifestStr,
+                                   const std::filesystem::path &cacheDir) {
+  lazy = std::make_unique<LazyState>();
+  lazy->text = manifestStr;
+
+  uint64_t hash = hashManifest(manifestStr);
+  std::filesystem::path cachePath;
+  std::optional<ManifestIndex> index;
+  if (!cacheDir.empty()) {
+    std::ostringstream name;
+    name << "esi_manifest_" << std::hex << hash << ".idx";
+    cachePath = cacheDir / name.str();
+    index = ManifestIndex::load(cachePath, hash, manifestStr.size());
+  }
+  if (index) {
+    ctxt.getLogger().debug("manifest",
+                           "loaded manifest index " + cachePath.string());
+  } else {
+    index = ManifestIndex::build(manifestStr);
+    // The cache is only an optimization, so failing to write it is fine.
+    if (!cachePath.empty()) {
+      try {
+        index->save(cachePath, hash, manifestStr.size());
+      } catch (const std::exception &e) {
+        ctxt.getLogger().warning("manifest",
+                                 "could not cache manifest index: " +
+                                     std::string(e.what()));
+      }
+    }
+  }
+  lazy->index = std::move(*index);
+  for (const auto &[id, range] : lazy->index.types)
+    lazy->types.emplace(id, range);
+  for (const auto &[symbol, range] : lazy->index.modules)
+    lazy->modules.emplace(symbol, range);
+}
+
+nlohmann::json Manifest::Impl::parse(Range range) const {
+  return nlohmann::json::parse(lazy->text.begin() + range.begin,
+                               lazy->text.begin() + range.end);
+}
+
+nlohmann::json Manifest::Impl::parseNode(uint64_t node) const {
+  const ManifestIndex &index = lazy->index;
+  const ManifestIndex::Node &n = index.nodes.at(node);
+  std::string json = "{";
+  for (uint64_t i = 0; i < n.numMembers; ++i) {
+    Range member = index.nodeMembers[n.firstMember + i];
+    if (i > 0)
+      json += ',';
+    json.append(lazy->text, member.begin, member.end - member.begin);
+  }
+  json += '}';
+  return nlohmann::json::parse(json);
+}
+
+const Type *Manifest::Impl::parseLazyType(const std::string &id) const {
+  std::scoped_lock<std::recursive_mutex> lock(lazyMutex);
+  auto f = lazy->types.find(id);
+  if (f == lazy->types.end() || lazy->parsingTypes.contains(id))
+    return nullptr;
+  lazy->parsingTypes.insert(id);
+  const Type *type;
+  try {
+    type = parseType(parse(f->second));
+  } catch (...) {
+    lazy->parsingTypes.erase(id);
+    throw;
+  }
+  lazy->parsingTypes.erase(id);
+  return type;
+}
+
+std::optional<const Type *> Manifest::Impl::getType(Type::ID id) const {
+  if (std::optional<const Type *> type = ctxt.getType(id))
+    return type;
+  if (lazy)
+    if (const Type *type = parseLazyType(id))
+      return type;
+  return std::nullopt;
+}
+
+uint32_t Manifest::Impl::getApiVersion() const {
+  if (lazy)
+    return parse(lazy->index.apiVersion).get<uint32_t>();
+  return manifestJson.at("apiVersion").get<uint32_t>();
+}
+
+const std::vector<const Type *> &Manifest::Impl::getTypeTable() const {
+  std::scoped_lock<std::recursive_mutex> lock(lazyMutex);
+  if (lazy && _typeTable.size() != lazy->index.types.size()) {
+    _typeTable.clear();
+    for (const auto &[id, range] : lazy->index.types)
+      _typeTable.push_back(*getType(id));
+  }
+  return _typeTable;
+}
+
+ModuleInfo Manifest::Impl::parseModuleInfo(const nlohmann::json &mod) const {
+  ModuleInfo info;
+  if (mod.contains("symInfo"))
+    parseModuleMetadata(info, mod.at("symInfo"));
+  if (mod.contains("symConsts"))
+    parseModuleConsts(info, mod.at("symConsts"));
+  return info;
+}
+
+std::optional<ModuleInfo>
+Manifest::Impl::getSymbolInfo(const std::string &symbol) const {
+  std::scoped_lock<std::recursive_mutex> lock(lazyMutex);
+  auto f = symbolInfoCache.find(symbol);
+  if (f != symbolInfoCache.end())
+    return f->second;
+  if (!lazy)
+    return std::nullopt;
+  auto mod = lazy->modules.find(symbol);
+  if (mod == lazy->modules.end())
+    return std::nullopt;
+  return symbolInfoCache.emplace(symbol, parseModuleInfo(parse(mod->second)))
+      .first->second;
+}
+
+const std::map<std::string, const ModuleInfo> &
+Manifest::Impl::getSymbolInfo() const {
+  std::scoped_lock<std::recursive_mutex> lock(lazyMutex);
+  if (lazy && !lazy->allModulesParsed) {
+    for (const auto &[symbol, range] : lazy->modules)
+      getSymbolInfo(symbol);
+    lazy->allModulesParsed = true;
+  }
+  return symbolInfoCache;
+}
+
 std::unique_ptr<Accelerator>
 Manifest::Impl::buildAccelerator(AcceleratorConnection &acc) const {
   ServiceTable activeSvcs;
 
-  auto designJson = manifestJson.at("design");
+  auto designJson = lazy ? parseNode(0) : manifestJson.at("design");
 
   // Create all of the engines at the top level of the design.
   // TODO: support engines at lower levels.
@@ -294,7 +877,8 @@ Manifest::Impl::buildAccelerator(AcceleratorConnection &acc) const {
       createEngine(acc, {}, engineDesc);
 
   // Get the initial active services table. Update it as we descend down.
-  auto svcDecls = manifestJson.at("serviceDeclarations");
+  auto svcDecls = lazy ? parse(lazy->index.serviceDecls)
+                       : manifestJson.at("serviceDeclarations");
   scanServiceDecls(acc, svcDecls, activeSvcs);
 
   // Get the services instantiated at the top level.
@@ -304,21 +888,59 @@ Manifest::Impl::buildAccelerator(AcceleratorConnection &acc) const {
   // Get the ports at the top level.
   auto ports = getBundlePorts(acc, {}, activeSvcs, designJson);
 
+  if (lazy)
+    return std::make_unique<Accelerator>(
+        getModInfo(designJson), getChildBuilder({}, acc, activeSvcs, 0),
+        services, std::move(ports));
   return std::make_unique<Accelerator>(
       getModInfo(designJson),
       getChildInstances({}, acc, activeSvcs, designJson), services,
       std::move(ports));
 }
 
+HWModule::ChildBuilder
+Manifest::Impl::getChildBuilder(AppIDPath idPath, AcceleratorConnection &acc,
+                                ServiceTable activeServices,
+                                uint64_t node) const {
+  // Keep this alive for as long as the design hierarchy needs it.
+  return [self = shared_from_this(), idPath = std::move(idPath), &acc,
+          activeServices = std::move(activeServices), node]() {
+    // Builds request services and ports from the connection, which isn't
+    // thread safe, so only build one part of the hierarchy at a time.
+    std::scoped_lock<std::recursive_mutex> lock(self->lazyMutex);
+    const ManifestIndex &index = self->lazy->index;
+    const ManifestIndex::Node &n = index.nodes[node];
+    std::vector<std::unique_ptr<Instance>> ret;
+    try {
+      for (uint64_t i = 0; i < n.numChildren; ++i) {
+        uint64_t childNode = index.nodeChildren[n.firstChild + i];
+        nlohmann::json child = self->parseNode(childNode);
+        AppIDPath childPath = idPath;
+        childPath.push_back(parseIDChecked(child.at("appID")));
+
+        ServiceTable childServices = activeServices;
+        std::vector<services::Service *> services =
+            self->getServices(childPath, acc, child, childServices);
+        auto ports =
+            self->getBundlePorts(acc, childPath, childServices, child);
+        ret.push_back(std::make_unique<Instance>(
+            childPath.back(), self->getModInfo(child),
+            self->getChildBuilder(childPath, acc, childServices, childNode),
+            services, std::move(ports)));
+      }
+    } catch (const std::exception &e) {
+      throw std::runtime_error("malformed manifest: " + std::string(e.what()));
+    }
+    return ret;
+  };
+}
+
 std::optional<ModuleInfo>
 Manifest::Impl::getModInfo(const nlohmann::json &json) const {
   auto instOfIter = json.find("instOf");
   if (instOfIter == json.end())
     return std::nullopt;
-  auto f = symbolInfoCache.find(instOfIter.value());
-  if (f != symbolInfoCache.end())
-    return f->second;
-  return std::nullopt;
+  return getSymbolInfo(instOfIter.value().get<std::string>());
 }
 
 /// TODO: Hack. This method is a giant hack to reuse the getService method for
@@ -518,9 +1140,27 @@ Manifest::Impl::getBundlePorts(AcceleratorConnection &acc, AppIDPath idPath,
 }
 
 namespace {
-const Type *parseType(const nlohmann::json &typeJson, Context &ctxt);
+/// Parsed types are registered with the context. Lazy manifests set `lookup`
+/// to parse the types which are referenced by ID but haven't been parsed yet.
+struct TypeCache {
+  Context &ctxt;
+  std::function<const Type *(const std::string &)> lookup = nullptr;
+
+  std::optional<const Type *> getType(const Type::ID &id) const {
+    if (std::optional<const Type *> t = ctxt.getType(id))
+      return t;
+    if (lookup)
+      if (const Type *t = lookup(id))
+        return t;
+    return std::nullopt;
+  }
+  void registerType(Type *type) { ctxt.registerType(type); }
+};
+
+const Type *parseType(const nlohmann::json &typeJson, TypeCache &cache);
 
-BundleType *parseBundleType(const nlohmann::json &typeJson, Context &cache) {
+BundleType *parseBundleType(const nlohmann::json &typeJson,
+                            TypeCache &cache) {
   assert(typeJson.at("mnemonic") == "bundle");
 
   std::vector<std::tuple<std::string, BundleType::Direction, const Type *>>
@@ -541,13 +1181,14 @@ BundleType *parseBundleType(const nlohmann::json &typeJson, Context &cache) {
   return new BundleType(typeJson.at("id"), channels);
 }
 
-ChannelType *parseChannelType(const nlohmann::json &typeJson, Context &cache) {
+ChannelType *parseChannelType(const nlohmann::json &typeJson,
+                              TypeCache &cache) {
   assert(typeJson.at("mnemonic") == "channel");
   return new ChannelType(typeJson.at("id"),
                          parseType(typeJson.at("inner"), cache));
 }
 
-Type *parseInt(const nlohmann::json &typeJson, Context &cache) {
+Type *parseInt(const nlohmann::json &typeJson, TypeCache &cache) {
   assert(typeJson.at("mnemonic") == "int");
   std::string sign = typeJson.at("signedness");
   uint64_t width = typeJson.at("hwBitwidth");
@@ -566,7 +1207,7 @@ Type *parseInt(const nlohmann::json &typeJson, Context &cache) {
     throw std::runtime_error("Malformed manifest: unknown sign '" + sign + "'");
 }
 
-StructType *parseStruct(const nlohmann::json &typeJson, Context &cache) {
+StructType *parseStruct(const nlohmann::json &typeJson, TypeCache &cache) {
   assert(typeJson.at("mnemonic") == "struct");
   std::vector<std::pair<std::string, const Type *>> fields;
   for (auto &fieldJson : typeJson["fields"])
@@ -575,14 +1216,14 @@ StructType *parseStruct(const nlohmann::json &typeJson, Context &cache) {
   return new StructType(typeJson.at("id"), fields);
 }
 
-ArrayType *parseArray(const nlohmann::json &typeJson, Context &cache) {
+ArrayType *parseArray(const nlohmann::json &typeJson, TypeCache &cache) {
   assert(typeJson.at("mnemonic") == "array");
   uint64_t size = typeJson.at("size");
   return new ArrayType(typeJson.at("id"),
                        parseType(typeJson.at("element"), cache), size);
 }
 
-WindowType *parseWindow(const nlohmann::json &typeJson, Context &cache) {
+WindowType *parseWindow(const nlohmann::json &typeJson, TypeCache &cache) {
   assert(typeJson.at("mnemonic") == "window");
   std::string name = typeJson.at("name");
   const Type *intoType = parseType(typeJson.at("into"), cache);
@@ -608,18 +1249,20 @@ WindowType *parseWindow(const nlohmann::json &typeJson, Context &cache) {
   return new WindowType(typeJson.at("id"), name, intoType, loweredType, frames);
 }
 
-ListType *parseList(const nlohmann::json &typeJson, Context &cache) {
+ListType *parseList(const nlohmann::json &typeJson, TypeCache &cache) {
   assert(typeJson.at("mnemonic") == "list");
   return new ListType(typeJson.at("id"),
                       parseType(typeJson.at("element"), cache));
 }
 
-using TypeParser = std::function<Type *(const nlohmann::json &, Context &)>;
+using TypeParser = std::function<Type *(const nlohmann::json &, TypeCache &)>;
 const std::map<std::string_view, TypeParser> typeParsers = {
     {"bundle", parseBundleType},
     {"channel", parseChannelType},
-    {"std::any", [](const nlohmann::json &typeJson,
-                    Context &cache) { return new AnyType(typeJson.at("id")); }},
+    {"std::any",
+     [](const nlohmann::json &typeJson, TypeCache &cache) {
+       return new AnyType(typeJson.at("id"));
+     }},
     {"int", parseInt},
     {"struct", parseStruct},
     {"array", parseArray},
@@ -629,7 +1272,7 @@ const std::map<std::string_view, TypeParser> typeParsers = {
 };
 
 // Parse a type if it doesn't already exist in the cache.
-const Type *parseType(const nlohmann::json &typeJson, Context &cache) {
+const Type *parseType(const nlohmann::json &typeJson, TypeCache &cache) {
   std::string id;
   if (typeJson.is_string())
     id = typeJson.get<std::string>();
@@ -655,8 +1298,11 @@ const Type *parseType(const nlohmann::json &typeJson, Context &cache) {
 }
 } // namespace
 
-const Type *Manifest::Impl::parseType(const nlohmann::json &typeJson) {
-  return ::parseType(typeJson, ctxt);
+const Type *Manifest::Impl::parseType(const nlohmann::json &typeJson) const {
+  TypeCache cache{ctxt};
+  if (lazy)
+    cache.lookup = [this](const std::string &id) { return parseLazyType(id); };
+  return ::parseType(typeJson, cache);
 }
 
 void Manifest::Impl::populateTypes(const nlohmann::json &typesJson) {
@@ -669,13 +1315,15 @@ void Manifest::Impl::populateTypes(const nlohmann::json &typesJson) {
 //===----------------------------------------------------------------------===//
 
 Manifest::Manifest(Context &ctxt, const std::string &jsonManifest)
-    : impl(new Impl(ctxt, jsonManifest)) {}
+    : Manifest(ctxt, jsonManifest, ctxt.getManifestOptions()) {}
 
-Manifest::~Manifest() { delete impl; }
+Manifest::Manifest(Context &ctxt, const std::string &jsonManifest,
+                   const Options &options)
+    : impl(std::make_shared<Impl>(ctxt, jsonManifest, options)) {}
 
-uint32_t Manifest::getApiVersion() const {
-  return impl->at("apiVersion").get<uint32_t>();
-}
+Manifest::~Manifest() = default;
+
+uint32_t Manifest::getApiVersion() const { return impl->getApiVersion(); }
 
 std::vector<ModuleInfo> Manifest::getModuleInfos() const {
   std::vector<ModuleInfo> ret;
@@ -0,0 +1,218 @@
+//===- Metrics.cpp - ESI runtime metrics ----------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT (lib/dialect/ESI/runtime/cpp/).
+//
+//===----------------------------------------------------------------------===//
+
+#include "esi/Metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+using namespace esi;
+
+static constexpr auto relaxed = std::memory_order_relaxed;
+
+/// Atomically raise `var` to `value` if it is larger.
+template <typename T>
+static void atomicMax(std::atomic<T> &var, T value) {
+  T current = var.load(relaxed);
+  while (value > current && !var.compare_exchange_weak(current, value, relaxed))
+    ;
+}
+
+/// Atomically lower `var` to `value` if it is smaller.
+template <typename T>
+static void atomicMin(std::atomic<T> &var, T value) {
+  T current = var.load(relaxed);
+  while (value < current && !var.compare_exchange_weak(current, value, relaxed))
+    ;
+}
+
+//===----------------------------------------------------------------------===//
+// LatencyHistogram
+//===----------------------------------------------------------------------===//
+
+size_t LatencyHistogram::getBucket(uint64_t value) {
+  if (value < SubBuckets)
+    return value;
+  // The top `SubBucketBits + 1` bits of the value select the bucket: the
+  // position of the leading one picks the power of two and the bits after it
+  // the linear sub-bucket.
+  unsigned shift = std::bit_width(value) - 1 - SubBucketBits;
+  return ((shift + 1) << SubBucketBits) + ((value >> shift) - SubBuckets);
+}
+
+uint64_t LatencyHistogram::getBucketMax(size_t bucket) {
+  if (bucket < SubBuckets)
+    return bucket;
+  unsigned shift = (bucket >> SubBucketBits) - 1;
+  uint64_t mantissa = (bucket & (SubBuckets - 1)) + SubBuckets;
+  // Wraps around to the largest uint64_t for the last bucket.
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+  buckets[getBucket(value)].fetch_add(1, relaxed);
+  sum.fetch_add(value, relaxed);
+  atomicMin(min, value);
+  atomicMax(max, value);
+  count.fetch_add(1, relaxed);
+}
+
+uint64_t LatencyHistogram::getMin() const {
+  return getCount() == 0 ? 0 : min.load(relaxed);
+}
+
+double LatencyHistogram::getMean() const {
+  uint64_t n = getCount();
+  return n == 0 ? 0.0 : static_cast<double>(sum.load(relaxed)) / n;
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const {
+  uint64_t n = getCount();
+  if (n == 0)
+    return 0;
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  uint64_t target = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * n)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NumBuckets; ++i) {
+    seen += buckets[i].load(relaxed);
+    if (seen >= target)
+      return std::clamp(getBucketMax(i), getMin(), getMax());
+  }
+  // Only reachable if values were recorded while we were reading.
+  return getMax();
+}
+
+void LatencyHistogram::reset() {
+  for (std::atomic<uint64_t> &bucket : buckets)
+    bucket.store(0, relaxed);
+  count.store(0, relaxed);
+  sum.store(0, relaxed);
+  min.store(std::numeric_limits<uint64_t>::max(), relaxed);
+  max.store(0, relaxed);
+}
+
+//===----------------------------------------------------------------------===//
+// ChannelMetrics
+//===----------------------------------------------------------------------===//
+
+void ChannelMetrics::addMessages(uint64_t numMessages, uint64_t numBytes) {
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now().time_since_epoch())
+                    .count();
+  int64_t unset = 0;
+  firstTime.compare_exchange_strong(unset, now, relaxed);
+  atomicMax(lastTime, now);
+  messages.fetch_add(numMessages, relaxed);
+  bytes.fetch_add(numBytes, relaxed);
+}
+
+void ChannelMetrics::addQueueDepth(uint64_t depth) {
+  atomicMax(maxQueueDepth, depth);
+}
+
+double ChannelMetrics::getThroughput() const {
+  int64_t elapsed = lastTime.load(relaxed) - firstTime.load(relaxed);
+  if (elapsed <= 0)
+    return 0.0;
+  return static_cast<double>(getBytes()) * 1e9 / elapsed;
+}
+
+void ChannelMetrics::reset() {
+  messages.store(0, relaxed);
+  bytes.store(0, relaxed);
+  maxQueueDepth.store(0, relaxed);
+  firstTime.store(0, relaxed);
+  lastTime.store(0, relaxed);
+  latencies.reset();
+}
+
+void ChannelMetrics::writeJson(std::ostream &os) const {
+  const LatencyHistogram &lat = getLatency();
+  os << "{\"messages\":" << getMessages() << ",\"bytes\":" << getBytes()
+     << ",\"bytes_per_sec\":" << getThroughput()
+     << ",\"max_queue_depth\":" << getMaxQueueDepth()
+     << ",\"latency_ns\":{\"count\":" << lat.getCount()
+     << ",\"min\":" << lat.getMin() << ",\"mean\":" << lat.getMean()
+     << ",\"p50\":" << lat.getPercentile(50)
+     << ",\"p90\":" << lat.getPercentile(90)
+     << ",\"p99\":" << lat.getPercentile(99)
+     << ",\"p999\":" << lat.getPercentile(99.9) << ",\"max\":" << lat.getMax()
+     << "}}";
+}
+
+//===----------------------------------------------------------------------===//
+// Metrics
+//===----------------------------------------------------------------------===//
+
+ChannelMetrics &Metrics::getChannel(const std::string &name) {
+  std::scoped_lock<std::mutex> lock(m);
+  std::unique_ptr<ChannelMetrics> &channel = channels[name];
+  if (!channel)
+    channel = std::make_unique<ChannelMetrics>();
+  return *channel;
+}
+
+const ChannelMetrics *Metrics::findChannel(const std::string &name) const {
+  std::scoped_lock<std::mutex> lock(m);
+  auto f = channels.find(name);
+  if (f == channels.end())
+    return nullptr;
+  return f->second.get();
+}
+
+void Metrics::reset() {
+  std::scoped_lock<std::mutex> lock(m);
+  for (auto &[name, channel] : channels)
+    channel->reset();
+}
+
+/// Write `str` as a JSON string.
+static void writeJsonString(std::ostream &os, const std::string &str) {
+  os << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\')
+      os << '\\';
+    os << c;
+  }
+  os << '"';
+}
+
+void Metrics::writeJson(std::ostream &os) const {
+  std::scoped_lock<std::mutex> lock(m);
+  os << '{';
+  bool first = true;
+  for (const auto &[name, channel] : channels) {
+    if (!first)
+      os << ',';
+    first = false;
+    writeJsonString(os, name);
+    os << ':';
+    channel->writeJson(os);
+  }
+  os << '}';
+}
+
+std::string Metrics::toJson() const {
+  std::ostringstream os;
+  writeJson(os);
+  return os.str();
+}
+
+void Metrics::log(Logger &logger, Logger::Level level) const {
+  logger.log(level, "metrics", toJson(), nullptr);
+}
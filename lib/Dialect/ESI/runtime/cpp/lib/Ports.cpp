@@ -14,6 +14,7 @@
 
 #include "esi/Ports.h"
 #include "esi/Types.h"
+#include "esi/backends/TraceFormat.h"
 
 #include <algorithm>
 #include <chrono>
@@ -59,6 +60,33 @@ ReadChannelPort &BundlePort::getRawRead(const std::string &name) const {
   return *read;
 }
 
+void ChannelPort::recordTrace(std::span<const MessageData> data) {
+  traceRecorder->messages(traceChannel, data);
+}
+
+void WriteChannelPort::recordWrite(
+    std::span<const MessageData> data,
+    std::optional<ChannelMetrics::Clock::time_point> start) {
+  uint64_t numBytes = 0;
+  for (const MessageData &msg : data)
+    numBytes += msg.getSize();
+  metrics->addMessages(data.size(), numBytes);
+  if (start)
+    metrics->addLatency(ChannelMetrics::Clock::now() - *start);
+}
+
+void ReadChannelPort::recordTraceOnCallback() {
+  this->callback = [this, cb = std::move(this->callback)](MessageData data) {
+    // The callback consumes the data, so hold on to the frame. Only record it
+    // once it's accepted, since the backend delivers rejected data again.
+    MessageData frame = data;
+    if (!cb(std::move(data)))
+      return false;
+    recordTrace(std::span(&frame, 1));
+    return true;
+  };
+}
+
 void ReadChannelPort::resetTranslationState() {
   nextFrameIndex = 0;
   accumulatingListData = false;
@@ -73,6 +101,17 @@ void ReadChannelPort::connect(std::function<bool(MessageData)> callback,
 
   resetTranslationState();
 
+  if (metrics)
+    callback = [metrics = metrics, cb = std::move(callback)](MessageData data) {
+      size_t size = data.getSize();
+      auto start = ChannelMetrics::Clock::now();
+      bool accepted = cb(std::move(data));
+      metrics->addLatency(ChannelMetrics::Clock::now() - start);
+      if (accepted)
+        metrics->addMessages(1, size);
+      return accepted;
+    };
+
   if (options.translateMessage && translationInfo) {
     translationInfo->precomputeFrameInfo();
     this->callback = [this, cb = std::move(callback)](MessageData data) {
@@ -83,6 +122,8 @@ void ReadChannelPort::connect(std::function<bool(MessageData)> callback,
   } else {
     this->callback = callback;
   }
+  if (traceRecorder)
+    recordTraceOnCallback();
   connectImpl(options);
   mode = Mode::Callback;
 }
@@ -106,23 +147,42 @@ void ReadChannelPort::connect(const ConnectOptions &options) {
     assert(!(!promiseQueue.empty() && !dataQueue.empty()) &&
            "Both queues are in use.");
 
+    size_t size = data.getSize();
     if (!promiseQueue.empty()) {
       // If there are promises waiting, fulfill the first one.
       std::promise<MessageData> p = std::move(promiseQueue.front());
       promiseQueue.pop();
       p.set_value(std::move(data));
+      if (metrics) {
+        metrics->addLatency(ChannelMetrics::Clock::now() -
+                            promiseTimes.front());
+        promiseTimes.pop();
+      }
     } else {
       // If not, add it to the data queue, unless the queue is full.
       if (dataQueue.size() >= maxDataQueueMsgs && maxDataQueueMsgs != 0)
         return false;
       dataQueue.push(std::move(data));
+      if (metrics)
+        metrics->addQueueDepth(dataQueue.size());
     }
+    if (metrics)
+      metrics->addMessages(1, size);
+    if (dataNotifier)
+      dataNotifier();
     return true;
   };
+  if (traceRecorder)
+    recordTraceOnCallback();
   connectImpl(options);
   mode = Mode::Polling;
 }
 
+void ReadChannelPort::setDataNotifier(std::function<void()> notifier) {
+  std::scoped_lock<std::mutex> lock(pollingM);
+  dataNotifier = std::move(notifier);
+}
+
 std::future<MessageData> ReadChannelPort::readAsync() {
   if (mode == Mode::Callback)
     throw std::runtime_error(
@@ -139,14 +199,60 @@ std::future<MessageData> ReadChannelPort::readAsync() {
     std::future<MessageData> f = p.get_future();
     p.set_value(std::move(dataQueue.front()));
     dataQueue.pop();
+    // The data was already waiting, so the reader didn't have to. Don't record
+    // a sample, since zeros would drag the percentiles down.
     return f;
   } else {
     // Otherwise, add a promise to the queue and return the future.
     promiseQueue.emplace();
+    if (metrics)
+      promiseTimes.push(ChannelMetrics::Clock::now());
     return promiseQueue.back().get_future();
   }
 }
 
+std::vector<MessageData> ReadChannelPort::readBatch(size_t maxMessages) {
+  if (mode == Mode::Callback)
+    throw std::runtime_error(
+        "Cannot read from a callback channel. `connect()` without a callback "
+        "specified to use polling mode.");
+
+  std::vector<MessageData> messages;
+  auto drainQueue = [&]() {
+    std::scoped_lock<std::mutex> lock(pollingM);
+    while (!dataQueue.empty() && messages.size() < maxMessages) {
+      messages.push_back(std::move(dataQueue.front()));
+      dataQueue.pop();
+    }
+  };
+  if (maxMessages == 0)
+    return messages;
+
+  drainQueue();
+  if (messages.size() < maxMessages) {
+    size_t numQueued = messages.size();
+    readBatchImpl(maxMessages - numQueued, messages);
+    // Messages read directly by the backend bypass the callback, so count
+    // and record them here.
+    if (traceRecorder && messages.size() > numQueued)
+      recordTrace(std::span(messages).subspan(numQueued));
+    if (metrics && messages.size() > numQueued) {
+      uint64_t numBytes = 0;
+      for (size_t i = numQueued, e = messages.size(); i < e; ++i)
+        numBytes += messages[i].getSize();
+      metrics->addMessages(messages.size() - numQueued, numBytes);
+    }
+  }
+  if (messages.empty()) {
+    // Nothing available yet, so block for the first message.
+    MessageData data;
+    read(data);
+    messages.push_back(std::move(data));
+    drainQueue();
+  }
+  return messages;
+}
+
 //===----------------------------------------------------------------------===//
 // Window translation support
 //===----------------------------------------------------------------------===//
@@ -21,6 +21,7 @@
 
 #include <cassert>
 #include <stdexcept>
+#include <thread>
 
 using namespace esi;
 using namespace esi::services;
@@ -200,27 +201,37 @@ FuncService::FuncService(AppIDPath idPath, AcceleratorConnection &conn,
 std::string FuncService::getServiceSymbol() const { return symbol; }
 
 BundlePort *FuncService::getPort(AppIDPath id, const BundleType *type) const {
-  return new Function(id.back(), type,
-                      conn.getEngineMapFor(id).requestPorts(id, type));
+  Function *f = new Function(id.back(), type,
+                             conn.getEngineMapFor(id).requestPorts(id, type));
+  f->logger = &conn.getLogger();
+  return f;
 }
 
 FuncService::Function *FuncService::Function::get(AppID id, BundleType *type,
                                                   WriteChannelPort &arg,
-                                                  ReadChannelPort &result) {
-  return new Function(
+                                                  ReadChannelPort &result,
+                                                  Logger *logger) {
+  Function *f = new Function(
       id, type, {{std::string("arg"), arg}, {std::string("result"), result}});
-  return nullptr;
+  f->logger = logger;
+  return f;
 }
 
-void FuncService::Function::connect() {
+void FuncService::Function::connect(const Options &options) {
   if (connected)
     throw std::runtime_error("Function is already connected");
   if (channels.size() != 2)
     throw std::runtime_error("FuncService must have exactly two channels");
+  if (!options.argTag != !options.resultTag)
+    throw std::runtime_error(
+        "Function needs either both or neither of the tag functions");
+  this->options = options;
   arg = &getRawWrite("arg");
   arg->connect();
   result = &getRawRead("result");
-  result->connect();
+  result->connect([this](MessageData resultData) {
+    return deliver(std::move(resultData));
+  });
   connected = true;
 }
 
@@ -228,9 +239,86 @@ std::future<MessageData>
 FuncService::Function::call(const MessageData &argData) {
   if (!connected)
     throw std::runtime_error("Function must be 'connect'ed before calling");
-  std::scoped_lock<std::mutex> lock(callMutex);
-  arg->write(argData);
-  return result->readAsync();
+  // Hold the call lock while writing so that the calls are sent in the same
+  // order as their promises are queued. The pending lock is not held while
+  // writing since results need it to be delivered.
+  std::scoped_lock<std::mutex> callLock(callMutex);
+  std::promise<MessageData> promise;
+  std::future<MessageData> future = promise.get_future();
+  std::optional<uint64_t> tag;
+  {
+    std::unique_lock<std::mutex> lock(pendingMutex);
+    if (options.maxInFlight > 0)
+      pendingCV.wait(lock, [&] {
+        return pending.size() + pendingTagged.size() < options.maxInFlight;
+      });
+    if (options.argTag) {
+      tag = options.argTag(argData);
+      if (!pendingTagged.emplace(*tag, std::move(promise)).second)
+        throw std::runtime_error("Function call tag " + std::to_string(*tag) +
+                                 " is already in flight");
+    } else {
+      pending.push_back(std::move(promise));
+    }
+  }
+
+  try {
+    arg->write(argData);
+  } catch (...) {
+    std::scoped_lock<std::mutex> lock(pendingMutex);
+    if (tag)
+      pendingTagged.erase(*tag);
+    else
+      pending.pop_back();
+    pendingCV.notify_all();
+    throw;
+  }
+  return future;
+}
+
+bool FuncService::Function::deliver(MessageData resultData) {
+  // Throwing from a port callback would terminate the program, so results
+  // which can't be matched to a call are logged and dropped. Returning false
+  // would only have the port redeliver them.
+  std::promise<MessageData> promise;
+  std::string error;
+  {
+    std::scoped_lock<std::mutex> lock(pendingMutex);
+    if (options.resultTag) {
+      try {
+        uint64_t tag = options.resultTag(resultData);
+        auto f = pendingTagged.find(tag);
+        if (f == pendingTagged.end()) {
+          error = "result tag " + std::to_string(tag) +
+                  " does not match any call";
+        } else {
+          promise = std::move(f->second);
+          pendingTagged.erase(f);
+        }
+      } catch (const std::exception &e) {
+        error = std::string("could not get the result tag: ") + e.what();
+      }
+    } else if (pending.empty()) {
+      error = "result without a call";
+    } else {
+      promise = std::move(pending.front());
+      pending.pop_front();
+    }
+  }
+  if (!error.empty()) {
+    if (logger)
+      logger->error("FuncService", "function " + getID().toString() + ": " +
+                                       error + ", dropping it");
+    return true;
+  }
+  pendingCV.notify_all();
+  promise.set_value(std::move(resultData));
+  return true;
+}
+
+size_t FuncService::Function::getNumInFlight() {
+  std::scoped_lock<std::mutex> lock(pendingMutex);
+  return pending.size() + pendingTagged.size();
 }
 
 CallService::CallService(AcceleratorConnection &acc, AppIDPath idPath,
@@ -248,10 +336,119 @@ BundlePort *CallService::getPort(AppIDPath id, const BundleType *type) const {
                       conn.getEngineMapFor(id).requestPorts(id, type));
 }
 
+/// Run `callback`, logging rather than propagating anything it throws since
+/// it is called from port callbacks and worker threads. Returns nothing if the
+/// callback failed.
+static std::optional<MessageData>
+invokeCallback(const std::function<MessageData(const MessageData &)> &callback,
+               const MessageData &argData, Logger &logger, const AppID &id) {
+  try {
+    return callback(argData);
+  } catch (const std::exception &e) {
+    logger.error("CallService", "callback " + id.toString() +
+                                    " failed: " + e.what() +
+                                    ", sending no result");
+  } catch (...) {
+    logger.error("CallService", "callback " + id.toString() +
+                                    " failed, sending no result");
+  }
+  return std::nullopt;
+}
+
+/// Runs callback invocations concurrently and sends their results in the
+/// order in which the invocations arrived.
+class CallService::Callback::ThreadPool {
+public:
+  ThreadPool(std::function<MessageData(const MessageData &)> callback,
+             WriteChannelPort &result, Logger &logger, AppID id,
+             unsigned numThreads)
+      : callback(std::move(callback)), result(result), logger(logger),
+        id(std::move(id)), maxQueued(2 * numThreads) {
+    for (unsigned i = 0; i < numThreads; ++i)
+      workers.emplace_back([this] { run(); });
+  }
+
+  /// Runs the queued invocations before returning.
+  ~ThreadPool() {
+    {
+      std::scoped_lock<std::mutex> lock(m);
+      shutdown = true;
+    }
+    workCV.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  /// Queue an invocation. Returns false (so the port retries later) if enough
+  /// invocations are already queued.
+  bool push(MessageData argData) {
+    {
+      std::scoped_lock<std::mutex> lock(m);
+      if (work.size() >= maxQueued)
+        return false;
+      work.emplace_back(nextSeq++, std::move(argData));
+    }
+    workCV.notify_one();
+    return true;
+  }
+
+private:
+  void run() {
+    while (true) {
+      std::pair<uint64_t, MessageData> item;
+      {
+        std::unique_lock<std::mutex> lock(m);
+        workCV.wait(lock, [&] { return shutdown || !work.empty(); });
+        if (work.empty())
+          return;
+        item = std::move(work.front());
+        work.pop_front();
+      }
+      std::optional<MessageData> resultData =
+          invokeCallback(callback, item.second, logger, id);
+
+      // Send this result along with any later ones which were waiting on it.
+      // Failed invocations still take their turn so later results aren't held
+      // up forever.
+      std::scoped_lock<std::mutex> lock(resultMutex);
+      done.emplace(item.first, std::move(resultData));
+      for (auto f = done.begin(); f != done.end() && f->first == nextResult;
+           f = done.erase(f), ++nextResult)
+        if (f->second)
+          result.write(*f->second);
+    }
+  }
+
+  std::function<MessageData(const MessageData &)> callback;
+  WriteChannelPort &result;
+  Logger &logger;
+  const AppID id;
+  const size_t maxQueued;
+  std::vector<std::thread> workers;
+
+  /// Protects the work queue.
+  std::mutex m;
+  std::condition_variable workCV;
+  std::deque<std::pair<uint64_t, MessageData>> work;
+  uint64_t nextSeq = 0;
+  bool shutdown = false;
+
+  /// Protects the results which are waiting on earlier ones.
+  std::mutex resultMutex;
+  std::map<uint64_t, std::optional<MessageData>> done;
+  uint64_t nextResult = 0;
+};
+
 CallService::Callback::Callback(AcceleratorConnection &acc, AppID id,
                                 const BundleType *type, PortMap channels)
     : ServicePort(id, type, channels), acc(acc) {}
 
+CallService::Callback::~Callback() {
+  // Stop new invocations from reaching the pool before shutting it down.
+  if (pool)
+    arg->disconnect();
+}
+
 CallService::Callback *CallService::Callback::get(AcceleratorConnection &acc,
                                                   AppID id,
                                                   const BundleType *type,
@@ -261,17 +458,25 @@ CallService::Callback *CallService::Callback::get(AcceleratorConnection &acc,
 }
 
 void CallService::Callback::connect(
-    std::function<MessageData(const MessageData &)> callback, bool quick) {
+    std::function<MessageData(const MessageData &)> callback, bool quick,
+    unsigned numThreads) {
   if (channels.size() != 2)
     throw std::runtime_error("CallService must have exactly two channels");
   result = &getRawWrite("result");
   result->connect();
   arg = &getRawRead("arg");
-  if (quick) {
+  if (numThreads > 0) {
+    pool = std::make_unique<ThreadPool>(std::move(callback), *result,
+                                        acc.getLogger(), getID(), numThreads);
+    arg->connect([this](MessageData argMsg) -> bool {
+      return pool->push(std::move(argMsg));
+    });
+  } else if (quick) {
     // If it's quick, we can just call the callback directly.
     arg->connect([this, callback](MessageData argMsg) -> bool {
-      MessageData resultMsg = callback(std::move(argMsg));
-      this->result->write(std::move(resultMsg));
+      if (std::optional<MessageData> resultMsg =
+              invokeCallback(callback, argMsg, acc.getLogger(), getID()))
+        this->result->write(*resultMsg);
       return true;
     });
   } else {
@@ -279,8 +484,9 @@ void CallService::Callback::connect(
     arg->connect();
     acc.getServiceThread()->addListener(
         {arg}, [this, callback](ReadChannelPort *, MessageData argMsg) -> void {
-          MessageData resultMsg = callback(std::move(argMsg));
-          this->result->write(std::move(resultMsg));
+          if (std::optional<MessageData> resultMsg =
+                  invokeCallback(callback, argMsg, acc.getLogger(), getID()))
+            this->result->write(*resultMsg);
         });
   }
 }
@@ -399,4 +399,246 @@ std::any ArrayType::deserialize(BitVector &data) const {
     std::reverse(result.begin(), result.end());
   return std::any(result);
 }
+
+//===----------------------------------------------------------------------===//
+// Serialization plans
+//===----------------------------------------------------------------------===//
+
+const SerializationPlan &Type::getSerializationPlan() const {
+  std::call_once(planOnce,
+                 [&]() { plan = std::make_unique<SerializationPlan>(this); });
+  return *plan;
+}
+
+static size_t alignTo(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/// Get the size and alignment of the host representation of a type.
+// NOLINTNEXTLINE(misc-no-recursion)
+static std::pair<size_t, size_t> getHostLayout(const Type *type) {
+  if (auto *channelType = dynamic_cast<const ChannelType *>(type))
+    return getHostLayout(channelType->getInner());
+  if (auto *bvType = dynamic_cast<const BitVectorType *>(type)) {
+    uint64_t width = bvType->getWidth();
+    for (size_t size = 1; size <= 8; size *= 2)
+      if (width <= size * 8)
+        return {size, size};
+    return {(width + 7) / 8, 1};
+  }
+  if (auto *structType = dynamic_cast<const StructType *>(type)) {
+    size_t size = 0, alignment = 1;
+    for (const auto &[name, fieldType] : structType->getFields()) {
+      auto [fieldSize, fieldAlignment] = getHostLayout(fieldType);
+      size = alignTo(size, fieldAlignment) + fieldSize;
+      alignment = std::max(alignment, fieldAlignment);
+    }
+    return {alignTo(size, alignment), alignment};
+  }
+  if (auto *arrayType = dynamic_cast<const ArrayType *>(type)) {
+    auto [elementSize, elementAlignment] =
+        getHostLayout(arrayType->getElementType());
+    return {elementSize * arrayType->getSize(), elementAlignment};
+  }
+  throw std::runtime_error(
+      std::format("Cannot compile a serialization plan for type '{}'",
+                  type->getID()));
+}
+
+SerializationPlan::SerializationPlan(const Type *type) : type(type) {
+  std::ptrdiff_t bitWidth = type->getBitWidth();
+  if (bitWidth < 0)
+    throw std::runtime_error(std::format(
+        "Cannot compile a serialization plan for type '{}' without a fixed "
+        "size",
+        type->getID()));
+  wireBitWidth = bitWidth;
+  std::tie(hostSize, hostAlignment) = getHostLayout(type);
+  addType(type, "", 0, 0);
+
+  for (const Field &field : fields) {
+    if (field.bitWidth == 0)
+      continue;
+    CopyOp op;
+    op.hostOffset = field.hostOffset;
+    op.hostSize = field.hostSize;
+    op.wireBitOffset = field.wireBitOffset;
+    op.bitWidth = field.bitWidth;
+    op.signExtend = dynamic_cast<const SIntType *>(field.type) &&
+                    field.hostSize * 8 > field.bitWidth;
+    op.byteAligned = field.wireBitOffset % 8 == 0 && field.bitWidth % 8 == 0;
+    ops.push_back(op);
+  }
+
+  // Merge byte aligned fields which are adjacent both in the host struct and
+  // in the message into a single copy.
+  std::sort(ops.begin(), ops.end(), [](const CopyOp &a, const CopyOp &b) {
+    return a.hostOffset < b.hostOffset;
+  });
+  auto isPlainCopy = [](const CopyOp &op) {
+    return op.byteAligned && !op.signExtend && op.hostSize * 8 == op.bitWidth;
+  };
+  std::vector<CopyOp> mergedOps;
+  for (const CopyOp &op : ops) {
+    if (!mergedOps.empty()) {
+      CopyOp &last = mergedOps.back();
+      if (isPlainCopy(last) && isPlainCopy(op) &&
+          last.hostOffset + last.hostSize == op.hostOffset &&
+          last.wireBitOffset + last.bitWidth == op.wireBitOffset) {
+        last.hostSize += op.hostSize;
+        last.bitWidth += op.bitWidth;
+        continue;
+      }
+    }
+    mergedOps.push_back(op);
+  }
+  ops = std::move(mergedOps);
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void SerializationPlan::addType(const Type *type, const std::string &path,
+                                size_t hostOffset, uint64_t wireBitOffset) {
+  if (auto *channelType = dynamic_cast<const ChannelType *>(type))
+    return addType(channelType->getInner(), path, hostOffset, wireBitOffset);
+
+  if (auto *bvType = dynamic_cast<const BitVectorType *>(type)) {
+    fields.push_back({path, type, hostOffset, getHostLayout(type).first,
+                      wireBitOffset, bvType->getWidth()});
+    return;
+  }
+
+  if (auto *structType = dynamic_cast<const StructType *>(type)) {
+    // Reversed structs (the default) have their last field in the least
+    // significant bits of the message, matching `StructType::serialize`.
+    const auto &structFields = structType->getFields();
+    std::vector<uint64_t> wireOffsets(structFields.size());
+    uint64_t offset = wireBitOffset;
+    for (size_t i = 0, e = structFields.size(); i != e; ++i) {
+      size_t idx = structType->isReverse() ? e - 1 - i : i;
+      wireOffsets[idx] = offset;
+      offset += structFields[idx].second->getBitWidth();
+    }
+    size_t fieldHostOffset = 0;
+    for (size_t i = 0, e = structFields.size(); i != e; ++i) {
+      const auto &[name, fieldType] = structFields[i];
+      auto [fieldSize, fieldAlignment] = getHostLayout(fieldType);
+      fieldHostOffset = alignTo(fieldHostOffset, fieldAlignment);
+      addType(fieldType, path.empty() ? name : path + "." + name,
+              hostOffset + fieldHostOffset, wireOffsets[i]);
+      fieldHostOffset += fieldSize;
+    }
+    return;
+  }
+
+  if (auto *arrayType = dynamic_cast<const ArrayType *>(type)) {
+    // Reversed arrays (the default) have their last element in the least
+    // significant bits of the message, matching `ArrayType::serialize`.
+    const Type *elementType = arrayType->getElementType();
+    uint64_t size = arrayType->getSize();
+    uint64_t elementBits = elementType->getBitWidth();
+    size_t elementSize = getHostLayout(elementType).first;
+    for (uint64_t i = 0; i < size; ++i) {
+      uint64_t wireIdx = arrayType->isReverse() ? size - 1 - i : i;
+      addType(elementType, path + "[" + std::to_string(i) + "]",
+              hostOffset + i * elementSize,
+              wireBitOffset + wireIdx * elementBits);
+    }
+    return;
+  }
+
+  throw std::runtime_error(std::format(
+      "Cannot compile a serialization plan for type '{}'", type->getID()));
+}
+
+/// Read `numBits` (at most 64) bits starting at bit `bitOffset`.
+static uint64_t extractBits(const uint8_t *data, uint64_t bitOffset,
+                            unsigned numBits) {
+  data += bitOffset / 8;
+  unsigned shift = bitOffset % 8;
+  uint64_t value = 0;
+  for (unsigned done = 0; done < numBits; shift = 0, ++data) {
+    unsigned take = std::min(8 - shift, numBits - done);
+    value |= static_cast<uint64_t>((*data >> shift) & ((1u << take) - 1))
+             << done;
+    done += take;
+  }
+  return value;
+}
+
+/// OR the low `numBits` (at most 64) bits of `value` into the data starting
+/// at bit `bitOffset`.
+static void depositBits(uint8_t *data, uint64_t bitOffset, uint64_t value,
+                        unsigned numBits) {
+  data += bitOffset / 8;
+  unsigned shift = bitOffset % 8;
+  for (unsigned done = 0; done < numBits; shift = 0, ++data) {
+    unsigned take = std::min(8 - shift, numBits - done);
+    *data |= static_cast<uint8_t>(((value >> done) & ((1u << take) - 1))
+                                  << shift);
+    done += take;
+  }
+}
+
+/// Copy `numBits` bits between two bit offsets, 64 bits at a time.
+static void copyBits(uint8_t *dst, uint64_t dstBitOffset, const uint8_t *src,
+                     uint64_t srcBitOffset, uint64_t numBits) {
+  for (uint64_t i = 0; i < numBits; i += 64) {
+    unsigned chunk = std::min<uint64_t>(64, numBits - i);
+    depositBits(dst, dstBitOffset + i,
+                extractBits(src, srcBitOffset + i, chunk), chunk);
+  }
+}
+
+void SerializationPlan::pack(const void *host, uint8_t *wire) const {
+  const uint8_t *hostBytes = static_cast<const uint8_t *>(host);
+  std::memset(wire, 0, getWireSize());
+  for (const CopyOp &op : ops) {
+    if (op.byteAligned)
+      std::memcpy(wire + op.wireBitOffset / 8, hostBytes + op.hostOffset,
+                  op.bitWidth / 8);
+    else
+      copyBits(wire, op.wireBitOffset, hostBytes + op.hostOffset, 0,
+               op.bitWidth);
+  }
+}
+
+MessageData SerializationPlan::pack(const void *host) const {
+  MessageData msg = MessageData::allocate(getWireSize());
+  if (!msg.empty())
+    pack(host, msg.getMutableBytes());
+  return msg;
+}
+
+void SerializationPlan::unpack(const MessageData &msg, void *host) const {
+  if (msg.getSize() < getWireSize())
+    throw std::runtime_error(std::format(
+        "Message too small for type '{}': expected {} bytes, got {} bytes",
+        type->getID(), getWireSize(), msg.getSize()));
+  const uint8_t *wire = msg.getBytes();
+  uint8_t *hostBytes = static_cast<uint8_t *>(host);
+  std::memset(hostBytes, 0, hostSize);
+  for (const CopyOp &op : ops) {
+    uint8_t *field = hostBytes + op.hostOffset;
+    if (op.byteAligned)
+      std::memcpy(field, wire + op.wireBitOffset / 8, op.bitWidth / 8);
+    else
+      copyBits(field, 0, wire, op.wireBitOffset, op.bitWidth);
+
+    // Fill the rest of the host storage with the sign bit.
+    if (op.signExtend && extractBits(field, op.bitWidth - 1, 1))
+      for (uint64_t i = op.bitWidth, e = op.hostSize * 8; i < e; i += 64) {
+        unsigned chunk = std::min<uint64_t>(64, e - i);
+        depositBits(field, i, ~uint64_t(0), chunk);
+      }
+  }
+}
+
+void SerializationPlan::checkHostType(size_t size) const {
+  if (size != hostSize)
+    throw std::runtime_error(std::format(
+        "Host type size does not match type '{}': expected {} bytes, got {} "
+        "bytes",
+        type->getID(), hostSize, size));
+}
+
 } // namespace esi
@@ -69,11 +69,36 @@ protected:
     client.writeToServer(name, data);
   }
 
+  // The cosim RPCs have no non-blocking form, so unlike the other backends
+  // the try variants block: the server only completes an RPC once the
+  // simulation's port has room for all of its messages. They always accept
+  // all of the data.
   bool tryWriteImpl(const MessageData &data) override {
     writeImpl(data);
     return true;
   }
 
+  void writeBatchImpl(std::span<const MessageData> data) override {
+    conn.getLogger().trace(
+        [this,
+         &data](std::string &subsystem, std::string &msg,
+                std::unique_ptr<std::map<std::string, std::any>> &details) {
+          subsystem = "cosim_write";
+          msg = "Writing " + std::to_string(data.size()) +
+                " messages to channel '" + name + "'";
+          details = std::make_unique<std::map<std::string, std::any>>();
+          (*details)["channel"] = name;
+          (*details)["num_messages"] = data.size();
+        });
+
+    client.writeBatchToServer(name, data);
+  }
+
+  size_t tryWriteBatchImpl(std::span<const MessageData> data) override {
+    writeBatchImpl(data);
+    return data.size();
+  }
+
 private:
   AcceleratorConnection &conn;
   RpcClient &client;
@@ -271,7 +296,8 @@ public:
         "cosimMMIO", {{"arg", BundleType::Direction::To, cmdType},
                       {"result", BundleType::Direction::From, i64Type}});
     cmdMMIO.reset(FuncService::Function::get(AppID("__cosim_mmio"), bundleType,
-                                             *cmdArgPort, *cmdRespPort));
+                                             *cmdArgPort, *cmdRespPort,
+                                             &conn.getLogger()));
     cmdMMIO->connect();
   }
 
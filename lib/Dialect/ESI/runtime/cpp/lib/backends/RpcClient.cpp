@@ -180,6 +180,24 @@ public:
                                ". Details: " + sendStatus.error_details());
   }
 
+  void writeBatchToServer(const std::string &channelName,
+                          std::span<const MessageData> data) {
+    ClientContext context;
+    ::esi::cosim::AddressedMessageBatch grpcBatch;
+    grpcBatch.set_channel_name(channelName);
+    grpcBatch.mutable_messages()->Reserve(data.size());
+    for (const MessageData &msg : data)
+      grpcBatch.add_messages()->set_data(msg.getBytes(), msg.getSize());
+    ::esi::cosim::VoidMessage response;
+    grpc::Status sendStatus =
+        stub->SendBatchToServer(&context, grpcBatch, &response);
+    if (!sendStatus.ok())
+      throw std::runtime_error("Failed to write to channel '" + channelName +
+                               "': " + std::to_string(sendStatus.error_code()) +
+                               " " + sendStatus.error_message() +
+                               ". Details: " + sendStatus.error_details());
+  }
+
   std::unique_ptr<RpcClient::ReadChannelConnection>
   connectClientReceiver(const std::string &channelName,
                         RpcClient::ReadCallback callback) {
@@ -242,6 +260,11 @@ void RpcClient::writeToServer(const std::string &channelName,
   impl->writeToServer(channelName, data);
 }
 
+void RpcClient::writeBatchToServer(const std::string &channelName,
+                                   std::span<const MessageData> data) {
+  impl->writeBatchToServer(channelName, data);
+}
+
 std::unique_ptr<RpcClient::ReadChannelConnection>
 RpcClient::connectClientReceiver(const std::string &channelName,
                                  ReadCallback callback) {
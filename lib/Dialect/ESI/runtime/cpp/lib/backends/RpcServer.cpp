@@ -89,6 +89,10 @@ public:
   ServerUnaryReactor *SendToServer(CallbackServerContext *context,
                                    const esi::cosim::AddressedMessage *request,
                                    esi::cosim::VoidMessage *response) override;
+  ServerUnaryReactor *
+  SendBatchToServer(CallbackServerContext *context,
+                    const esi::cosim::AddressedMessageBatch *request,
+                    esi::cosim::VoidMessage *response) override;
 
 private:
   Context &ctxt;
@@ -362,6 +366,27 @@ Impl::SendToServer(CallbackServerContext *context,
   return reactor;
 }
 
+ServerUnaryReactor *
+Impl::SendBatchToServer(CallbackServerContext *context,
+                        const esi::cosim::AddressedMessageBatch *request,
+                        esi::cosim::VoidMessage *response) {
+  auto reactor = context->DefaultReactor();
+  auto it = readPorts.find(request->channel_name());
+  if (it == readPorts.end()) {
+    reactor->Finish(Status(StatusCode::NOT_FOUND, "Unknown channel"));
+    return reactor;
+  }
+
+  for (const esi::cosim::Message &msg : request->messages()) {
+    const std::string &msgDataString = msg.data();
+    MessageData data(reinterpret_cast<const uint8_t *>(msgDataString.data()),
+                     msgDataString.size());
+    it->second->push(data);
+  }
+  reactor->Finish(Status::OK);
+  return reactor;
+}
+
 //===----------------------------------------------------------------------===//
 // RpcServer pass throughs to the actual implementations above.
 //===----------------------------------------------------------------------===//
@@ -0,0 +1,407 @@
+//===- Shm.cpp - Connection to ESI simulation via shared memory -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT
+// (lib/dialect/ESI/runtime/cpp/lib/backends/Shm.cpp).
+//
+//===----------------------------------------------------------------------===//
+
+#include "esi/backends/Shm.h"
+#include "esi/Engines.h"
+#include "esi/Ports.h"
+#include "esi/Services.h"
+#include "esi/Utils.h"
+#include "esi/backends/ShmTransport.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+using namespace esi;
+using namespace esi::services;
+using namespace esi::backends::shm;
+
+/// How long to sleep on a ring before checking whether the port got
+/// disconnected or the simulation went away.
+static constexpr std::chrono::milliseconds waitSlice(10);
+
+namespace {
+
+//===----------------------------------------------------------------------===//
+// WriteShmChannelPort
+//===----------------------------------------------------------------------===//
+
+/// Shared memory client implementation of a write channel port.
+class WriteShmChannelPort : public WriteChannelPort {
+public:
+  WriteShmChannelPort(AcceleratorConnection &conn,
+                      std::shared_ptr<const ShmSegment> segment,
+                      const ShmSegment::ChannelDesc &desc, const Type *type,
+                      std::string name)
+      : WriteChannelPort(type), conn(conn), segment(std::move(segment)),
+        desc(desc), name(std::move(name)) {}
+
+  void connectImpl(const ChannelPort::ConnectOptions &options) override {
+    if (desc.dir != ShmSegment::Direction::ToServer)
+      throw std::runtime_error("Channel '" + name +
+                               "' is not a to server channel");
+  }
+
+protected:
+  void writeImpl(const MessageData &data) override {
+    writeBatchImpl(std::span(&data, 1));
+  }
+
+  bool tryWriteImpl(const MessageData &data) override {
+    std::scoped_lock<std::mutex> lock(writeM);
+    return desc.ring.tryPush(data);
+  }
+
+  void writeBatchImpl(std::span<const MessageData> data) override {
+    conn.getLogger().trace(
+        [this,
+         &data](std::string &subsystem, std::string &msg,
+                std::unique_ptr<std::map<std::string, std::any>> &details) {
+          subsystem = "shm_write";
+          msg = "Writing " + std::to_string(data.size()) +
+                " messages to channel '" + name + "'";
+        });
+
+    // Ports may be written from several threads but the ring only supports a
+    // single producer.
+    std::scoped_lock<std::mutex> lock(writeM);
+    while (!data.empty()) {
+      data = data.subspan(desc.ring.tryPushBatch(data));
+      if (data.empty())
+        break;
+      if (segment->isClosed())
+        throw std::runtime_error("Simulation closed channel '" + name + "'");
+      desc.ring.waitForSpace(data.front().getSize(), waitSlice);
+    }
+  }
+
+  size_t tryWriteBatchImpl(std::span<const MessageData> data) override {
+    std::scoped_lock<std::mutex> lock(writeM);
+    return desc.ring.tryPushBatch(data);
+  }
+
+private:
+  AcceleratorConnection &conn;
+  std::shared_ptr<const ShmSegment> segment;
+  ShmSegment::ChannelDesc desc;
+  std::string name;
+  std::mutex writeM;
+};
+
+//===----------------------------------------------------------------------===//
+// ReadShmChannelPort
+//===----------------------------------------------------------------------===//
+
+/// Shared memory client implementation of a read channel port. A thread per
+/// port sleeps on the ring and hands the messages to the callback.
+class ReadShmChannelPort : public ReadChannelPort {
+public:
+  ReadShmChannelPort(AcceleratorConnection &conn,
+                     std::shared_ptr<const ShmSegment> segment,
+                     const ShmSegment::ChannelDesc &desc, const Type *type,
+                     std::string name)
+      : ReadChannelPort(type), conn(conn), segment(std::move(segment)),
+        desc(desc), name(std::move(name)) {}
+  ~ReadShmChannelPort() { disconnect(); }
+
+  void connectImpl(const ChannelPort::ConnectOptions &options) override {
+    if (desc.dir != ShmSegment::Direction::ToClient)
+      throw std::runtime_error("Channel '" + name +
+                               "' is not a to client channel");
+    shutdown = false;
+    readThread = std::thread(&ReadShmChannelPort::readLoop, this);
+  }
+
+  void disconnect() override {
+    if (readThread.joinable()) {
+      conn.getLogger().debug("shm_read", "Disconnecting channel " + name);
+      shutdown = true;
+      readThread.join();
+    }
+    ReadChannelPort::disconnect();
+  }
+
+private:
+  void readLoop();
+
+  AcceleratorConnection &conn;
+  std::shared_ptr<const ShmSegment> segment;
+  ShmSegment::ChannelDesc desc;
+  std::string name;
+  std::thread readThread;
+  std::atomic<bool> shutdown = false;
+};
+} // namespace
+
+void ReadShmChannelPort::readLoop() {
+  std::vector<MessageData> messages;
+  while (!shutdown) {
+    if (desc.ring.tryPopBatch(64, messages) == 0) {
+      desc.ring.waitForData(waitSlice);
+      continue;
+    }
+    for (const MessageData &data : messages) {
+      conn.getLogger().trace(
+          [this, &data](
+              std::string &subsystem, std::string &msg,
+              std::unique_ptr<std::map<std::string, std::any>> &details) {
+            subsystem = "shm_read";
+            msg = "Received message from channel '" + name + "'";
+            details = std::make_unique<std::map<std::string, std::any>>();
+            (*details)["channel"] = name;
+            (*details)["data_size"] = data.getSize();
+          });
+      // The message has already left the ring, so keep offering it until it
+      // gets consumed.
+      while (!callback(data)) {
+        if (shutdown)
+          return;
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+      }
+    }
+    messages.clear();
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// ShmAccelerator
+//===----------------------------------------------------------------------===//
+
+std::unique_ptr<AcceleratorConnection>
+ShmAccelerator::connect(Context &ctxt, std::string connectionString) {
+  std::string name = connectionString;
+  if (connectionString.ends_with("cosim.cfg")) {
+    std::ifstream cfg(connectionString);
+    std::string line;
+    name.clear();
+    while (getline(cfg, line))
+      if (line.starts_with("shm:")) {
+        name = line.substr(4);
+        name.erase(0, name.find_first_not_of(' '));
+      }
+    if (name.empty())
+      throw std::runtime_error("shm line not found in file");
+  } else if (connectionString == "env") {
+    const char *nameEnv = getenv("ESI_COSIM_SHM");
+    if (!nameEnv)
+      throw std::runtime_error("ESI_COSIM_SHM environment variable not set");
+    name = nameEnv;
+  }
+  if (!name.starts_with("/"))
+    name = "/" + name;
+  return std::make_unique<ShmAccelerator>(ctxt, name);
+}
+
+ShmAccelerator::ShmAccelerator(Context &ctxt, std::string segmentName)
+    : AcceleratorConnection(ctxt) {
+  segment = ShmSegment::open(segmentName);
+}
+ShmAccelerator::~ShmAccelerator() { disconnect(); }
+
+namespace {
+class ShmSysInfo : public SysInfo {
+public:
+  ShmSysInfo(ShmAccelerator &conn, std::shared_ptr<const ShmSegment> segment)
+      : SysInfo(conn), segment(std::move(segment)) {}
+
+  uint32_t getEsiVersion() const override {
+    uint32_t esiVersion;
+    std::vector<uint8_t> manifest;
+    waitForManifest(esiVersion, manifest);
+    return esiVersion;
+  }
+
+  std::vector<uint8_t> getCompressedManifest() const override {
+    uint32_t esiVersion;
+    std::vector<uint8_t> manifest;
+    waitForManifest(esiVersion, manifest);
+    return manifest;
+  }
+
+private:
+  /// The simulation publishes the manifest shortly after creating the segment,
+  /// so a client which connects right away may have to wait a bit.
+  void waitForManifest(uint32_t &esiVersion,
+                       std::vector<uint8_t> &manifest) const {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!segment->getManifest(esiVersion, manifest)) {
+      if (segment->isClosed() || std::chrono::steady_clock::now() > deadline)
+        throw std::runtime_error("Simulation did not publish a manifest");
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  std::shared_ptr<const ShmSegment> segment;
+};
+
+class ShmMMIO : public MMIO {
+public:
+  ShmMMIO(ShmAccelerator &conn, Context &ctxt, const AppIDPath &idPath,
+          std::shared_ptr<const ShmSegment> segment,
+          const HWClientDetails &clients)
+      : MMIO(conn, idPath, clients) {
+    // We have to locate the channels ourselves since this service might be used
+    // to retrieve the manifest.
+    ShmSegment::ChannelDesc cmdArg, cmdResp;
+    if (!segment->getChannelDesc("__cosim_mmio_read_write.arg", cmdArg) ||
+        !segment->getChannelDesc("__cosim_mmio_read_write.result", cmdResp))
+      throw std::runtime_error("Could not find MMIO channels");
+
+    const esi::Type *i64Type = getType(ctxt, new UIntType(cmdResp.type, 64));
+    const esi::Type *cmdType = getType(
+        ctxt, new StructType(cmdArg.type, {{"write", new BitsType("i1", 1)},
+                                           {"offset", new UIntType("ui32", 32)},
+                                           {"data", new BitsType("i64", 64)}}));
+
+    // Get ports, create the function, then connect to it.
+    cmdArgPort = std::make_unique<WriteShmChannelPort>(
+        conn, segment, cmdArg, cmdType, "__cosim_mmio_read_write.arg");
+    cmdRespPort = std::make_unique<ReadShmChannelPort>(
+        conn, segment, cmdResp, i64Type, "__cosim_mmio_read_write.result");
+    auto *bundleType = new BundleType(
+        "cosimMMIO", {{"arg", BundleType::Direction::To, cmdType},
+                      {"result", BundleType::Direction::From, i64Type}});
+    cmdMMIO.reset(FuncService::Function::get(AppID("__cosim_mmio"), bundleType,
+                                             *cmdArgPort, *cmdRespPort,
+                                             &conn.getLogger()));
+    cmdMMIO->connect();
+  }
+
+#pragma pack(push, 1)
+  struct MMIOCmd {
+    uint64_t data;
+    uint32_t offset;
+    bool write;
+  };
+#pragma pack(pop)
+
+  uint64_t read(uint32_t addr) const override {
+    MMIOCmd cmd{.data = 0, .offset = addr, .write = false};
+    std::future<MessageData> result = cmdMMIO->call(MessageData::from(cmd));
+    return *result.get().as<uint64_t>();
+  }
+
+  void write(uint32_t addr, uint64_t data) override {
+    MMIOCmd cmd{.data = data, .offset = addr, .write = true};
+    std::future<MessageData> result = cmdMMIO->call(MessageData::from(cmd));
+    result.wait();
+  }
+
+private:
+  const esi::Type *getType(Context &ctxt, esi::Type *type) {
+    if (auto t = ctxt.getType(type->getID())) {
+      delete type;
+      return *t;
+    }
+    ctxt.registerType(type);
+    return type;
+  }
+  std::unique_ptr<WriteShmChannelPort> cmdArgPort;
+  std::unique_ptr<ReadShmChannelPort> cmdRespPort;
+  std::unique_ptr<FuncService::Function> cmdMMIO;
+};
+} // namespace
+
+namespace esi::backends::shm {
+/// Implement the cosim channel communication. The manifest describes these
+/// engines as 'cosim' engines since the simulation doesn't know which transport
+/// will be used.
+class ShmEngine : public Engine {
+public:
+  ShmEngine(ShmAccelerator &conn, AppIDPath idPath,
+            const ServiceImplDetails &details, const HWClientDetails &clients)
+      : Engine(conn), conn(conn) {
+    // Compute our parents idPath path.
+    AppIDPath prefix = std::move(idPath);
+    if (prefix.size() > 0)
+      prefix.pop_back();
+
+    for (auto client : clients) {
+      AppIDPath fullClientPath = prefix + client.relPath;
+      std::map<std::string, std::string> channelAssignments;
+      for (auto assignment : client.channelAssignments)
+        if (assignment.second.type == "cosim")
+          channelAssignments[assignment.first] = std::any_cast<std::string>(
+              assignment.second.implOptions.at("name"));
+      clientChannelAssignments[fullClientPath] = std::move(channelAssignments);
+    }
+  }
+
+  std::unique_ptr<ChannelPort> createPort(AppIDPath idPath,
+                                          const std::string &channelName,
+                                          BundleType::Direction dir,
+                                          const Type *type) override;
+
+private:
+  ShmAccelerator &conn;
+  std::map<AppIDPath, std::map<std::string, std::string>>
+      clientChannelAssignments;
+};
+} // namespace esi::backends::shm
+
+std::unique_ptr<ChannelPort>
+ShmEngine::createPort(AppIDPath idPath, const std::string &channelName,
+                      BundleType::Direction dir, const Type *type) {
+  // Find the client details for the port at 'fullPath'.
+  auto f = clientChannelAssignments.find(idPath);
+  if (f == clientChannelAssignments.end())
+    throw std::runtime_error("Could not find port for '" + idPath.toStr() +
+                             "." + channelName + "'");
+  const std::map<std::string, std::string> &channelAssignments = f->second;
+  auto shmChannelNameIter = channelAssignments.find(channelName);
+  if (shmChannelNameIter == channelAssignments.end())
+    throw std::runtime_error("Could not find channel '" + idPath.toStr() + "." +
+                             channelName + "' in cosimulation");
+
+  ShmSegment::ChannelDesc chDesc;
+  if (!conn.segment->getChannelDesc(shmChannelNameIter->second, chDesc))
+    throw std::runtime_error("Could not find channel '" + idPath.toStr() + "." +
+                             channelName + "' in cosimulation");
+
+  std::string fullChannelName = idPath.toStr() + "." + channelName;
+  if (BundlePort::isWrite(dir))
+    return std::make_unique<WriteShmChannelPort>(conn, conn.segment, chDesc,
+                                                 type, fullChannelName);
+  return std::make_unique<ReadShmChannelPort>(conn, conn.segment, chDesc, type,
+                                              fullChannelName);
+}
+
+void ShmAccelerator::createEngine(const std::string &engineTypeName,
+                                  AppIDPath idPath,
+                                  const ServiceImplDetails &details,
+                                  const HWClientDetails &clients) {
+  std::unique_ptr<Engine> engine = nullptr;
+  if (engineTypeName == "cosim")
+    engine = std::make_unique<ShmEngine>(*this, idPath, details, clients);
+  else
+    engine = ::esi::registry::createEngine(*this, engineTypeName, idPath,
+                                           details, clients);
+  registerEngine(idPath, std::move(engine), clients);
+}
+
+Service *ShmAccelerator::createService(Service::Type svcType, AppIDPath idPath,
+                                       std::string implName,
+                                       const ServiceImplDetails &details,
+                                       const HWClientDetails &clients) {
+  if (svcType == typeid(services::MMIO))
+    return new ShmMMIO(*this, getCtxt(), idPath, segment, clients);
+  if (svcType == typeid(SysInfo))
+    return new ShmSysInfo(*this, segment);
+  return nullptr;
+}
+
+REGISTER_ACCELERATOR("shm", backends::shm::ShmAccelerator);
@@ -0,0 +1,109 @@
+//===- ShmServer.cpp - Run a shared memory cosim server -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "esi/backends/ShmServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+using namespace esi;
+using namespace esi::backends::shm;
+
+/// Write the segment name to a file for clients to find it, mirroring what the
+/// RPC server does with its port.
+static void writeSegmentName(const std::string &name) {
+  FILE *fd = fopen("cosim.cfg", "w");
+  if (!fd)
+    throw std::runtime_error("Could not open cosim.cfg: " +
+                             std::string(strerror(errno)));
+  fprintf(fd, "shm: %s\n", name.c_str());
+  fclose(fd);
+}
+
+void ShmServer::Channel::write(const MessageData &data) {
+  if (backlog.empty() && ring.tryPush(data))
+    return;
+  // Apply backpressure rather than buffering without bound: wait for the
+  // client to drain the ring until there is room in the backlog.
+  while (backlog.size() >= server.maxBacklog && !flush())
+    ring.waitForSpace(backlog.front().getSize(),
+                      std::chrono::milliseconds(100));
+  if (backlog.empty())
+    server.pending.push_back(this);
+  backlog.push_back(data);
+  flush();
+}
+
+bool ShmServer::Channel::flush() {
+  while (!backlog.empty() && ring.tryPush(backlog.front()))
+    backlog.pop_front();
+  return backlog.empty();
+}
+
+ShmServer::ShmServer(Context &ctxt) : ctxt(ctxt) {}
+ShmServer::~ShmServer() {
+  if (segment)
+    stop();
+}
+
+void ShmServer::run(const std::string &name, size_t size,
+                    uint64_t ringCapacity, size_t maxBacklog) {
+  if (segment)
+    throw std::runtime_error("Server already running");
+  segment = ShmSegment::create(name, size);
+  this->ringCapacity = ringCapacity;
+  this->maxBacklog = std::max<size_t>(maxBacklog, 1);
+  writeSegmentName(name);
+  ctxt.getLogger().info("cosim", "Server listening on shared memory segment " +
+                                     name);
+}
+
+void ShmServer::stop() {
+  if (!segment)
+    return;
+  segment->close();
+  segment.reset();
+}
+
+void ShmServer::setManifest(int esiVersion,
+                            const std::vector<uint8_t> &compressedManifest) {
+  if (!segment)
+    throw std::runtime_error("Server not running");
+  segment->setManifest(esiVersion, compressedManifest);
+}
+
+ShmServer::Channel &ShmServer::registerReadPort(const std::string &name,
+                                                const std::string &type) {
+  if (!segment)
+    throw std::runtime_error("Server not running");
+  auto &channel = readPorts[name];
+  channel = std::make_unique<Channel>(
+      *this, segment->addChannel(name, type, ShmSegment::Direction::ToServer,
+                                 ringCapacity));
+  return *channel;
+}
+
+ShmServer::Channel &ShmServer::registerWritePort(const std::string &name,
+                                                 const std::string &type) {
+  if (!segment)
+    throw std::runtime_error("Server not running");
+  auto &channel = writePorts[name];
+  if (channel)
+    std::erase(pending, channel.get());
+  channel = std::make_unique<Channel>(
+      *this, segment->addChannel(name, type, ShmSegment::Direction::ToClient,
+                                 ringCapacity));
+  return *channel;
+}
+
+void ShmServer::flush() {
+  std::erase_if(pending, [](Channel *channel) { return channel->flush(); });
+}
@@ -0,0 +1,480 @@
+//===- ShmTransport.cpp - Shared memory cosim transport -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT
+// (lib/dialect/ESI/runtime/cpp/lib/backends/ShmTransport.cpp).
+//
+//===----------------------------------------------------------------------===//
+
+#include "esi/backends/ShmTransport.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace esi;
+using namespace esi::backends::shm;
+
+//===----------------------------------------------------------------------===//
+// Shared memory layout
+//===----------------------------------------------------------------------===//
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory rings require lock-free atomics");
+
+/// Bump this whenever the layout below changes.
+static constexpr uint32_t layoutVersion = 1;
+static constexpr uint64_t segmentMagic = 0x4d48535f49534500; // "\0ESI_SHM"
+static constexpr uint32_t maxChannels = 1024;
+static constexpr size_t maxNameLength = 256;
+
+/// Producer and consumer state live on separate cache lines to avoid false
+/// sharing. The sequence words are the futex words, incremented when a
+/// sleeping party should wake up.
+struct ShmRing::Header {
+  // Consumer owned.
+  alignas(64) std::atomic<uint64_t> head;
+  std::atomic<uint32_t> spaceSeq;
+  std::atomic<uint32_t> spaceWaiters;
+  // Producer owned.
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> dataSeq;
+  std::atomic<uint32_t> dataWaiters;
+  // Constant after initialization.
+  alignas(64) uint64_t capacity;
+};
+
+namespace {
+struct ChannelEntry {
+  char name[maxNameLength];
+  char type[maxNameLength];
+  uint32_t dir;
+  uint64_t ringOffset;
+};
+} // namespace
+
+struct ShmSegment::Header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t esiVersion;
+  uint64_t size;
+  /// Offset of the next free byte. Only touched by the server.
+  uint64_t allocOffset;
+  /// The manifest is valid once the offset is non-zero.
+  std::atomic<uint64_t> manifestOffset;
+  uint64_t manifestSize;
+  /// Channel entries are valid up to this count.
+  std::atomic<uint32_t> numChannels;
+  std::atomic<uint32_t> closed;
+  ChannelEntry channels[maxChannels];
+};
+
+static uint64_t alignTo(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//===----------------------------------------------------------------------===//
+// Futex wakeups
+//===----------------------------------------------------------------------===//
+
+/// Sleep while `*word == expected`, at most `timeout`. The futexes are shared
+/// between processes so the private flavor of the calls can't be used.
+static void futexWait(std::atomic<uint32_t> &word, uint32_t expected,
+                      std::chrono::microseconds timeout) {
+#ifdef __linux__
+  auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  timespec ts;
+  ts.tv_sec = secs.count();
+  ts.tv_nsec =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - secs)
+          .count();
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected,
+          &ts, nullptr, 0);
+#else
+  // No portable cross-process wait primitive, so fall back to a short nap.
+  if (word.load() == expected)
+    std::this_thread::sleep_for(
+        std::min(timeout, std::chrono::microseconds(50)));
+#endif
+}
+
+static void futexWake(std::atomic<uint32_t> &word) {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+#endif
+}
+
+//===----------------------------------------------------------------------===//
+// ShmRing
+//===----------------------------------------------------------------------===//
+
+// The waiter protocol: a party which wants to sleep first registers itself in
+// the waiters count, then samples the sequence word and re-checks the ring
+// before waiting on the sequence word. The other party updates the ring, then
+// checks the waiters count and only bumps the sequence word and issues the
+// wake system call if somebody is waiting. Sequentially consistent ordering on
+// both sides guarantees that either the waiter sees the update or the updater
+// sees the waiter.
+
+uint64_t ShmRing::getCapacity() const { return header->capacity; }
+uint8_t *ShmRing::getData() const {
+  return reinterpret_cast<uint8_t *>(header) + sizeof(Header);
+}
+
+uint64_t ShmRing::getRecordSize(size_t size) {
+  return alignTo(sizeof(uint32_t) + size, 8);
+}
+uint64_t ShmRing::getAllocSize(uint64_t capacity) {
+  return sizeof(Header) + capacity;
+}
+
+ShmRing::Header *ShmRing::init(void *mem, uint64_t capacity) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    throw std::runtime_error("ring capacity must be a power of two");
+  Header *header = new (mem) Header();
+  header->capacity = capacity;
+  return header;
+}
+
+bool ShmRing::fits(uint64_t head, uint64_t tail, size_t size) const {
+  return header->capacity - (tail - head) >= getRecordSize(size);
+}
+
+bool ShmRing::empty() const {
+  return header->head.load() == header->tail.load();
+}
+
+void ShmRing::wakeConsumer() {
+  if (header->dataWaiters.load() == 0)
+    return;
+  header->dataSeq.fetch_add(1);
+  futexWake(header->dataSeq);
+}
+
+void ShmRing::wakeProducer() {
+  if (header->spaceWaiters.load() == 0)
+    return;
+  header->spaceSeq.fetch_add(1);
+  futexWake(header->spaceSeq);
+}
+
+bool ShmRing::tryPush(const MessageData &data) {
+  return tryPushBatch(std::span(&data, 1)) == 1;
+}
+
+size_t ShmRing::tryPushBatch(std::span<const MessageData> data) {
+  uint64_t capacity = header->capacity;
+  uint64_t mask = capacity - 1;
+  uint8_t *ringData = getData();
+  // Copy `size` bytes to ring position `pos`, wrapping around if necessary.
+  auto copyIn = [&](uint64_t pos, const void *src, size_t size) {
+    uint64_t off = pos & mask;
+    size_t first = std::min<uint64_t>(size, capacity - off);
+    std::memcpy(ringData + off, src, first);
+    std::memcpy(ringData, static_cast<const uint8_t *>(src) + first,
+                size - first);
+  };
+
+  // Reject oversized messages before copying anything so that a throw never
+  // leaves part of the batch written.
+  for (const MessageData &msg : data)
+    if (getRecordSize(msg.getSize()) > capacity)
+      throw std::runtime_error("message of " + std::to_string(msg.getSize()) +
+                               " bytes does not fit in the ring");
+
+  uint64_t head = header->head.load(std::memory_order_acquire);
+  uint64_t tail = header->tail.load(std::memory_order_relaxed);
+  size_t numPushed = 0;
+  for (const MessageData &msg : data) {
+    if (!fits(head, tail, msg.getSize())) {
+      // Refresh our view of the consumer before giving up.
+      head = header->head.load(std::memory_order_acquire);
+      if (!fits(head, tail, msg.getSize()))
+        break;
+    }
+    uint32_t size = msg.getSize();
+    copyIn(tail, &size, sizeof(size));
+    copyIn(tail + sizeof(size), msg.getBytes(), size);
+    tail += getRecordSize(size);
+    ++numPushed;
+  }
+  if (numPushed == 0)
+    return 0;
+  header->tail.store(tail);
+  wakeConsumer();
+  return numPushed;
+}
+
+bool ShmRing::tryPop(MessageData &data) {
+  std::vector<MessageData> out;
+  if (tryPopBatch(1, out) == 0)
+    return false;
+  data = std::move(out.front());
+  return true;
+}
+
+size_t ShmRing::tryPopBatch(size_t maxMessages, std::vector<MessageData> &out) {
+  uint64_t capacity = header->capacity;
+  uint64_t mask = capacity - 1;
+  const uint8_t *ringData = getData();
+  // Copy `size` bytes from ring position `pos`, wrapping around if necessary.
+  auto copyOut = [&](uint64_t pos, void *dst, size_t size) {
+    uint64_t off = pos & mask;
+    size_t first = std::min<uint64_t>(size, capacity - off);
+    std::memcpy(dst, ringData + off, first);
+    std::memcpy(static_cast<uint8_t *>(dst) + first, ringData, size - first);
+  };
+
+  uint64_t tail = header->tail.load(std::memory_order_acquire);
+  uint64_t head = header->head.load(std::memory_order_relaxed);
+  size_t numPopped = 0;
+  while (head != tail && numPopped < maxMessages) {
+    uint32_t size;
+    copyOut(head, &size, sizeof(size));
+    MessageData msg = MessageData::allocate(size);
+    copyOut(head + sizeof(size), msg.getMutableBytes(), size);
+    out.push_back(std::move(msg));
+    head += getRecordSize(size);
+    ++numPopped;
+  }
+  if (numPopped == 0)
+    return 0;
+  header->head.store(head);
+  wakeProducer();
+  return numPopped;
+}
+
+/// Spin a little before going to sleep since the other side is often just
+/// about to update the ring, and a futex round trip costs a few microseconds.
+template <typename Pred>
+static bool spinUntil(Pred pred) {
+  for (int i = 0; i < 256; ++i) {
+    if (pred())
+      return true;
+    std::this_thread::yield();
+  }
+  return false;
+}
+
+bool ShmRing::waitForData(std::chrono::microseconds timeout) {
+  if (spinUntil([&]() { return !empty(); }))
+    return true;
+  header->dataWaiters.fetch_add(1);
+  uint32_t seq = header->dataSeq.load();
+  if (empty())
+    futexWait(header->dataSeq, seq, timeout);
+  header->dataWaiters.fetch_sub(1);
+  return !empty();
+}
+
+bool ShmRing::waitForSpace(size_t size, std::chrono::microseconds timeout) {
+  auto hasSpace = [&]() {
+    return fits(header->head.load(), header->tail.load(), size);
+  };
+  if (spinUntil(hasSpace))
+    return true;
+  header->spaceWaiters.fetch_add(1);
+  uint32_t seq = header->spaceSeq.load();
+  if (!hasSpace())
+    futexWait(header->spaceSeq, seq, timeout);
+  header->spaceWaiters.fetch_sub(1);
+  return hasSpace();
+}
+
+//===----------------------------------------------------------------------===//
+// ShmSegment
+//===----------------------------------------------------------------------===//
+
+ShmSegment::ShmSegment(std::string name, void *base, size_t size, bool owner)
+    : name(std::move(name)), base(base), size(size), owner(owner) {}
+
+ShmSegment::~ShmSegment() {
+  munmap(base, size);
+  if (owner)
+    shm_unlink(name.c_str());
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::create(const std::string &name,
+                                               size_t size) {
+  size = std::max<size_t>(size, alignTo(sizeof(Header), 64));
+  // Remove any segment left behind by a crashed simulation.
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    throw std::runtime_error("could not create shared memory segment '" +
+                             name + "': " + std::strerror(errno));
+  // The file is sparse, so only the pages which actually get used consume
+  // memory.
+  if (ftruncate(fd, size) != 0) {
+    int err = errno;
+    ::close(fd);
+    shm_unlink(name.c_str());
+    throw std::runtime_error("could not size shared memory segment '" + name +
+                             "': " + std::strerror(err));
+  }
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("could not map shared memory segment '" + name +
+                             "'");
+  }
+
+  Header *header = new (base) Header();
+  header->version = layoutVersion;
+  header->size = size;
+  header->allocOffset = alignTo(sizeof(Header), 64);
+  // Publish the magic last so clients don't see a half-initialized header.
+  std::atomic_ref<uint64_t>(header->magic).store(segmentMagic);
+  return std::unique_ptr<ShmSegment>(new ShmSegment(name, base, size, true));
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::open(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0)
+    throw std::runtime_error("could not open shared memory segment '" + name +
+                             "': " + std::strerror(errno));
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error("shared memory segment '" + name +
+                             "' is not an ESI cosim segment");
+  }
+  size_t size = st.st_size;
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED)
+    throw std::runtime_error("could not map shared memory segment '" + name +
+                             "'");
+  auto segment =
+      std::unique_ptr<ShmSegment>(new ShmSegment(name, base, size, false));
+
+  Header *header = static_cast<Header *>(base);
+  if (std::atomic_ref<uint64_t>(header->magic).load() != segmentMagic)
+    throw std::runtime_error("shared memory segment '" + name +
+                             "' is not an ESI cosim segment");
+  if (header->version != layoutVersion)
+    throw std::runtime_error(
+        "shared memory segment '" + name + "' has layout version " +
+        std::to_string(header->version) + ", expected " +
+        std::to_string(layoutVersion));
+  return segment;
+}
+
+uint64_t ShmSegment::allocate(uint64_t allocSize) {
+  Header *header = static_cast<Header *>(base);
+  uint64_t offset = header->allocOffset;
+  if (offset + allocSize > size)
+    throw std::runtime_error("shared memory segment '" + name +
+                             "' is full. Increase its size.");
+  header->allocOffset = alignTo(offset + allocSize, 64);
+  return offset;
+}
+
+void ShmSegment::setManifest(uint32_t esiVersion,
+                             const std::vector<uint8_t> &compressedManifest) {
+  Header *header = static_cast<Header *>(base);
+  if (header->manifestOffset.load() != 0)
+    throw std::runtime_error("manifest already set");
+  uint64_t offset = allocate(compressedManifest.size());
+  std::memcpy(static_cast<uint8_t *>(base) + offset, compressedManifest.data(),
+              compressedManifest.size());
+  header->esiVersion = esiVersion;
+  header->manifestSize = compressedManifest.size();
+  header->manifestOffset.store(offset, std::memory_order_release);
+}
+
+bool ShmSegment::getManifest(uint32_t &esiVersion,
+                             std::vector<uint8_t> &compressedManifest) const {
+  const Header *header = static_cast<const Header *>(base);
+  uint64_t offset = header->manifestOffset.load(std::memory_order_acquire);
+  if (offset == 0)
+    return false;
+  esiVersion = header->esiVersion;
+  const uint8_t *data = static_cast<const uint8_t *>(base) + offset;
+  compressedManifest.assign(data, data + header->manifestSize);
+  return true;
+}
+
+ShmRing ShmSegment::addChannel(const std::string &channelName,
+                               const std::string &type, Direction dir,
+                               uint64_t capacity) {
+  Header *header = static_cast<Header *>(base);
+  uint32_t idx = header->numChannels.load(std::memory_order_relaxed);
+  if (idx >= maxChannels)
+    throw std::runtime_error("too many channels in shared memory segment");
+  if (channelName.size() >= maxNameLength || type.size() >= maxNameLength)
+    throw std::runtime_error("channel name or type of '" + channelName +
+                             "' too long");
+  capacity = std::bit_ceil(std::max<uint64_t>(capacity, 64));
+
+  uint64_t offset = allocate(ShmRing::getAllocSize(capacity));
+  ShmRing::Header *ring =
+      ShmRing::init(static_cast<uint8_t *>(base) + offset, capacity);
+  ChannelEntry &entry = header->channels[idx];
+  std::strncpy(entry.name, channelName.c_str(), maxNameLength);
+  std::strncpy(entry.type, type.c_str(), maxNameLength);
+  entry.dir = static_cast<uint32_t>(dir);
+  entry.ringOffset = offset;
+  header->numChannels.store(idx + 1, std::memory_order_release);
+  return ShmRing(ring);
+}
+
+std::vector<ShmSegment::ChannelDesc> ShmSegment::listChannels() const {
+  const Header *header = static_cast<const Header *>(base);
+  uint32_t numChannels = header->numChannels.load(std::memory_order_acquire);
+  std::vector<ChannelDesc> channels;
+  for (uint32_t i = 0; i < numChannels; ++i) {
+    const ChannelEntry &entry = header->channels[i];
+    auto *ring = reinterpret_cast<ShmRing::Header *>(
+        static_cast<uint8_t *>(base) + entry.ringOffset);
+    channels.push_back(ChannelDesc{entry.name, entry.type,
+                                   static_cast<Direction>(entry.dir),
+                                   ShmRing(ring)});
+  }
+  return channels;
+}
+
+bool ShmSegment::getChannelDesc(const std::string &channelName,
+                                ChannelDesc &desc) const {
+  for (ChannelDesc &channel : listChannels())
+    if (channel.name == channelName) {
+      desc = std::move(channel);
+      return true;
+    }
+  return false;
+}
+
+void ShmSegment::close() {
+  Header *header = static_cast<Header *>(base);
+  header->closed.store(1);
+}
+
+bool ShmSegment::isClosed() const {
+  const Header *header = static_cast<const Header *>(base);
+  return header->closed.load() != 0;
+}
@@ -17,10 +17,14 @@
 #include "esi/Accelerator.h"
 #include "esi/Services.h"
 #include "esi/Utils.h"
+#include "esi/backends/TraceFormat.h"
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <regex>
 #include <sstream>
 
@@ -42,21 +46,25 @@ struct esi::backends::trace::TraceAccelerator::Impl {
   friend class TraceAccelerator;
   Impl(Mode mode, std::filesystem::path manifestJson,
        std::filesystem::path traceFile)
-      : manifestJson(manifestJson), traceFile(traceFile) {
+      : traceWrite(nullptr), manifestJson(manifestJson), traceFile(traceFile) {
     if (!std::filesystem::exists(manifestJson))
       throw std::runtime_error("manifest file '" + manifestJson.string() +
                                "' does not exist");
 
-    if (mode == Write) {
+    switch (mode) {
+    case Write:
       // Open the trace file for writing.
       traceWrite = new std::ofstream(traceFile);
       if (!traceWrite->is_open())
         throw std::runtime_error("failed to open trace file '" +
                                  traceFile.string() + "'");
-    } else if (mode == Discard) {
-      traceWrite = nullptr;
-    } else {
-      assert(false && "not implemented");
+      break;
+    case Discard:
+    case BinaryWrite:
+      break;
+    case Replay:
+      replay = std::make_unique<BinaryTraceReader>(traceFile);
+      break;
     }
   }
 
@@ -75,6 +83,9 @@ struct esi::backends::trace::TraceAccelerator::Impl {
 
   void write(const AppIDPath &id, const std::string &portName, const void *data,
              size_t size, const std::string &prefix = "");
+  void writeBatch(const AppIDPath &id, const std::string &portName,
+                  std::span<const MessageData> data,
+                  const std::string &prefix = "");
   std::ostream &write(std::string service) {
     assert(traceWrite && "traceWrite is null");
     *traceWrite << "[" << service << "] ";
@@ -82,8 +93,17 @@ struct esi::backends::trace::TraceAccelerator::Impl {
   }
   bool isWriteable() { return traceWrite; }
 
+  /// The binary trace being replayed, if any.
+  const BinaryTraceReader *getReplay() { return replay.get(); }
+
+  /// Get the next recorded value of a replayed MMIO read from `addr`.
+  uint64_t replayMMIORead(uint32_t addr);
+
 private:
   std::ofstream *traceWrite;
+  std::unique_ptr<BinaryTraceReader> replay;
+  std::mutex mmioReplayM;
+  std::map<uint32_t, size_t> mmioReplayPos;
   std::filesystem::path manifestJson;
   std::filesystem::path traceFile;
   std::vector<std::unique_ptr<ChannelPort>> channels;
@@ -102,6 +122,36 @@ void TraceAccelerator::Impl::write(const AppIDPath &id,
               << portName << ": " << b64data << std::endl;
 }
 
+void TraceAccelerator::Impl::writeBatch(const AppIDPath &id,
+                                        const std::string &portName,
+                                        std::span<const MessageData> data,
+                                        const std::string &prefix) {
+  if (!isWriteable())
+    return;
+  // Same format as `write`, but only flush once for the whole batch.
+  std::string b64data;
+  for (const MessageData &msg : data) {
+    utils::encodeBase64(msg.getBytes(), msg.getSize(), b64data);
+    *traceWrite << prefix << (prefix.empty() ? "w" : "W") << "rite " << id
+                << '.' << portName << ": " << b64data << '\n';
+  }
+  traceWrite->flush();
+}
+
+uint64_t TraceAccelerator::Impl::replayMMIORead(uint32_t addr) {
+  const auto &reads = replay->getMMIOReads();
+  auto it = reads.find(addr);
+  if (it == reads.end())
+    return 0;
+  // Keep returning the last value once the recorded reads run out, which is
+  // the most sensible thing for status registers.
+  std::scoped_lock<std::mutex> lock(mmioReplayM);
+  size_t &pos = mmioReplayPos[addr];
+  uint64_t data = it->second[std::min(pos, it->second.size() - 1)];
+  ++pos;
+  return data;
+}
+
 std::unique_ptr<AcceleratorConnection>
 TraceAccelerator::connect(Context &ctxt, std::string connectionString) {
   std::string modeStr;
@@ -110,13 +160,13 @@ TraceAccelerator::connect(Context &ctxt, std::string connectionString) {
 
   // Parse the connection std::string.
   // <mode>:<manifest path>[:<traceFile>]
-  std::regex connPattern("([\\w-]):([^:]+)(:(\\w+))?");
+  std::regex connPattern("([\\w-]):([^:]+)(:([^:]+))?");
   std::smatch match;
   if (regex_search(connectionString, match, connPattern)) {
     modeStr = match[1];
     manifestPath = match[2];
     if (match[3].matched)
-      traceFile = match[3];
+      traceFile = match[4];
   } else {
     throw std::runtime_error("connection std::string must be of the form "
                              "'<mode>:<manifest path>[:<traceFile>]'");
@@ -128,6 +178,10 @@ TraceAccelerator::connect(Context &ctxt, std::string connectionString) {
     mode = Write;
   else if (modeStr == "-")
     mode = Discard;
+  else if (modeStr == "b")
+    mode = BinaryWrite;
+  else if (modeStr == "r")
+    mode = Replay;
   else
     throw std::runtime_error("unknown mode '" + modeStr + "'");
 
@@ -141,6 +195,10 @@ TraceAccelerator::TraceAccelerator(Context &ctxt, Mode mode,
                                    std::filesystem::path traceFile)
     : AcceleratorConnection(ctxt) {
   impl = std::make_unique<Impl>(mode, manifestJson, traceFile);
+  // Binary traces are recorded by the ports and services, like for any other
+  // backend.
+  if (mode == BinaryWrite)
+    recordTrace(traceFile);
 }
 TraceAccelerator::~TraceAccelerator() { disconnect(); }
 
@@ -191,6 +249,15 @@ protected:
     return true;
   }
 
+  void writeBatchImpl(std::span<const MessageData> data) override {
+    impl.writeBatch(id, portName, data);
+  }
+
+  size_t tryWriteBatchImpl(std::span<const MessageData> data) override {
+    impl.writeBatch(id, portName, data, "try");
+    return data.size();
+  }
+
   TraceAccelerator::Impl &impl;
   AppIDPath id;
   std::string portName;
@@ -200,11 +267,28 @@ protected:
 namespace {
 class ReadTraceChannelPort : public ReadChannelPort {
 public:
-  ReadTraceChannelPort(TraceAccelerator::Impl &impl, const Type *type)
-      : ReadChannelPort(type) {}
+  ReadTraceChannelPort(TraceAccelerator::Impl &impl, const Type *type,
+                       const AppIDPath &id, const std::string &portName)
+      : ReadChannelPort(type), impl(impl) {
+    if (auto *replay = impl.getReplay())
+      replayChannel = replay->findChannel(id.toStr() + "." + portName,
+                                          format::Direction::FromAccelerator);
+  }
   ~ReadTraceChannelPort() { disconnect(); }
 
 private:
+  /// Get the next message. Returns false if a replayed trace has run out.
+  bool nextMessage(MessageData &data) {
+    if (!impl.getReplay()) {
+      data = genMessage();
+      return true;
+    }
+    if (!replayChannel || replayPos >= replayChannel->records.size())
+      return false;
+    data = impl.getReplay()->getMessage(replayChannel->records[replayPos++]);
+    return true;
+  }
+
   MessageData genMessage() {
     std::ptrdiff_t numBits = getType()->getBitWidth();
     if (numBits < 0)
@@ -213,13 +297,47 @@ private:
                                getType()->getID());
 
     std::ptrdiff_t size = (numBits + 7) / 8;
-    std::vector<uint8_t> bytes(size);
+    MessageData data = MessageData::allocate(size);
+    uint8_t *bytes = data.getMutableBytes();
     for (std::ptrdiff_t i = 0; i < size; ++i)
       bytes[i] = rand() % 256;
-    return MessageData(bytes);
+    return data;
+  }
+
+  bool pollImpl() override {
+    std::scoped_lock<std::mutex> lock(nextM);
+    // Hold on to a message the callback didn't accept so it isn't lost.
+    if (!pending) {
+      MessageData data;
+      if (!nextMessage(data))
+        return false;
+      pending = std::move(data);
+    }
+    if (!callback(*pending))
+      return false;
+    pending.reset();
+    return true;
   }
 
-  bool pollImpl() override { return callback(genMessage()); }
+  void readBatchImpl(size_t maxMessages,
+                     std::vector<MessageData> &out) override {
+    std::scoped_lock<std::mutex> lock(nextM);
+    if (pending && maxMessages > 0) {
+      out.push_back(std::move(*pending));
+      pending.reset();
+      --maxMessages;
+    }
+    MessageData data;
+    for (size_t i = 0; i < maxMessages && nextMessage(data); ++i)
+      out.push_back(std::move(data));
+  }
+
+  TraceAccelerator::Impl &impl;
+  const BinaryTraceReader::Channel *replayChannel = nullptr;
+  /// Protects the replay position and the pending message.
+  std::mutex nextM;
+  size_t replayPos = 0;
+  std::optional<MessageData> pending;
 };
 } // namespace
 
@@ -238,7 +356,8 @@ public:
       port = std::make_unique<WriteTraceChannelPort>(impl, type, idPath,
                                                      channelName);
     else
-      port = std::make_unique<ReadTraceChannelPort>(impl, type);
+      port = std::make_unique<ReadTraceChannelPort>(impl, type, idPath,
+                                                    channelName);
     return port;
   }
 
@@ -262,6 +381,8 @@ public:
       : MMIO(conn, idPath, clients), impl(conn.getImpl()) {}
 
   virtual uint64_t read(uint32_t addr) const override {
+    if (impl.getReplay())
+      return impl.replayMMIORead(addr);
     uint64_t data = rand();
     if (impl.isWriteable())
       impl.write("MMIO") << "[" << std::hex << addr << "] -> " << data
@@ -0,0 +1,250 @@
+//===- TraceFormat.cpp - ESI binary trace format --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// DO NOT EDIT!
+// This file is distributed as part of an ESI package. The source for this file
+// should always be modified within CIRCT (lib/dialect/ESI/runtime/cpp/lib/).
+//
+//===----------------------------------------------------------------------===//
+
+#include "esi/backends/TraceFormat.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace esi;
+using namespace esi::backends::trace;
+using namespace esi::backends::trace::format;
+
+static constexpr uint64_t padTo8(uint64_t size) { return (size + 7) & ~7ull; }
+
+//===----------------------------------------------------------------------===//
+// BinaryTraceWriter
+//===----------------------------------------------------------------------===//
+
+BinaryTraceWriter::BinaryTraceWriter(const std::filesystem::path &path)
+    : osBuffer(1 << 20), start(std::chrono::steady_clock::now()) {
+  // Use a large buffer since traces are written at a high rate.
+  os.rdbuf()->pubsetbuf(osBuffer.data(), osBuffer.size());
+  os.open(path, std::ios::binary | std::ios::trunc);
+  if (!os.is_open())
+    throw std::runtime_error("failed to open trace file '" + path.string() +
+                             "'");
+  FileHeader header{};
+  std::memcpy(header.magic, fileMagic, sizeof(header.magic));
+  header.version = version;
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  offset = sizeof(header);
+}
+
+BinaryTraceWriter::~BinaryTraceWriter() { close(); }
+
+uint64_t BinaryTraceWriter::getTimestamp() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void BinaryTraceWriter::writeRecord(RecordKind kind, uint32_t channel,
+                                    const void *data, uint64_t size) {
+  static constexpr char padding[8] = {};
+  RecordHeader header{};
+  header.kind = kind;
+  header.channel = channel;
+  header.timestamp = getTimestamp();
+  header.size = size;
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  os.write(static_cast<const char *>(data), size);
+  os.write(padding, padTo8(size) - size);
+  offset += sizeof(header) + padTo8(size);
+}
+
+uint32_t BinaryTraceWriter::addChannel(const std::string &name,
+                                       Direction dir) {
+  std::scoped_lock<std::mutex> lock(m);
+  uint32_t channel = index.size();
+  IndexEntry entry{};
+  entry.channel = channel;
+  index.push_back(entry);
+
+  std::vector<char> payload(sizeof(ChannelDef) + name.size());
+  ChannelDef def{};
+  def.dir = dir;
+  std::memcpy(payload.data(), &def, sizeof(def));
+  std::memcpy(payload.data() + sizeof(def), name.data(), name.size());
+  writeRecord(RecordKind::ChannelDef, channel, payload.data(), payload.size());
+  return channel;
+}
+
+void BinaryTraceWriter::message(uint32_t channel, const MessageData &data) {
+  messages(channel, std::span(&data, 1));
+}
+
+void BinaryTraceWriter::messages(uint32_t channel,
+                                 std::span<const MessageData> data) {
+  std::scoped_lock<std::mutex> lock(m);
+  if (!os.is_open())
+    return;
+  IndexEntry &entry = index.at(channel);
+  for (const MessageData &msg : data) {
+    if (entry.firstRecord == 0)
+      entry.firstRecord = offset;
+    ++entry.numMessages;
+    entry.numBytes += msg.getSize();
+    writeRecord(RecordKind::Message, channel, msg.getBytes(), msg.getSize());
+  }
+}
+
+void BinaryTraceWriter::mmioRead(uint32_t address, uint64_t data) {
+  std::scoped_lock<std::mutex> lock(m);
+  MMIOAccess access{address, 0, data};
+  writeRecord(RecordKind::MMIORead, 0, &access, sizeof(access));
+}
+
+void BinaryTraceWriter::mmioWrite(uint32_t address, uint64_t data) {
+  std::scoped_lock<std::mutex> lock(m);
+  MMIOAccess access{address, 0, data};
+  writeRecord(RecordKind::MMIOWrite, 0, &access, sizeof(access));
+}
+
+void BinaryTraceWriter::close() {
+  std::scoped_lock<std::mutex> lock(m);
+  if (!os.is_open())
+    return;
+  Trailer trailer{};
+  trailer.indexOffset = offset;
+  std::memcpy(trailer.magic, trailerMagic, sizeof(trailer.magic));
+  writeRecord(RecordKind::Index, 0, index.data(),
+              index.size() * sizeof(IndexEntry));
+  os.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer));
+  os.close();
+}
+
+//===----------------------------------------------------------------------===//
+// BinaryTraceReader
+//===----------------------------------------------------------------------===//
+
+BinaryTraceReader::BinaryTraceReader(const std::filesystem::path &path) {
+  std::ifstream is(path, std::ios::binary);
+  if (!is.is_open())
+    throw std::runtime_error("failed to open trace file '" + path.string() +
+                             "'");
+  std::vector<uint8_t> contents(std::filesystem::file_size(path));
+  is.read(reinterpret_cast<char *>(contents.data()), contents.size());
+  file = MessageData(std::move(contents));
+
+  FileHeader fileHeader;
+  if (file.getSize() < sizeof(fileHeader))
+    throw std::runtime_error("'" + path.string() + "' is not an ESI trace");
+  std::memcpy(&fileHeader, file.getBytes(), sizeof(fileHeader));
+  if (std::memcmp(fileHeader.magic, fileMagic, sizeof(fileMagic)) != 0)
+    throw std::runtime_error("'" + path.string() + "' is not an ESI trace");
+  if (fileHeader.version != version)
+    throw std::runtime_error("unsupported ESI trace version " +
+                             std::to_string(fileHeader.version));
+
+  // Find the index, if the trace was closed properly. It tells us how many
+  // messages to expect on each channel.
+  uint64_t end = file.getSize();
+  std::vector<IndexEntry> index;
+  Trailer trailer;
+  if (end >= sizeof(fileHeader) + sizeof(trailer)) {
+    std::memcpy(&trailer, file.getBytes() + end - sizeof(trailer),
+                sizeof(trailer));
+    if (std::memcmp(trailer.magic, trailerMagic, sizeof(trailerMagic)) == 0 &&
+        trailer.indexOffset + sizeof(RecordHeader) <= end - sizeof(trailer)) {
+      RecordHeader header = getHeader(trailer.indexOffset);
+      uint64_t indexEnd =
+          trailer.indexOffset + sizeof(header) + padTo8(header.size);
+      if (header.kind != RecordKind::Index ||
+          header.size % sizeof(IndexEntry) != 0 ||
+          indexEnd != end - sizeof(trailer))
+        throw std::runtime_error("malformed index in trace");
+      index.resize(header.size / sizeof(IndexEntry));
+      std::memcpy(index.data(),
+                  file.getBytes() + trailer.indexOffset + sizeof(header),
+                  header.size);
+      complete = true;
+      end = trailer.indexOffset;
+    }
+  }
+
+  // Scan the records. A partially written record at the end of an incomplete
+  // trace is dropped.
+  uint64_t offset = sizeof(fileHeader);
+  while (offset + sizeof(RecordHeader) <= end) {
+    RecordHeader header = getHeader(offset);
+    uint64_t payloadOffset = offset + sizeof(RecordHeader);
+    if (header.size > end - payloadOffset)
+      break;
+    const uint8_t *payload = file.getBytes() + payloadOffset;
+
+    switch (header.kind) {
+    case RecordKind::ChannelDef: {
+      ChannelDef def;
+      if (header.size < sizeof(def) || header.channel != channels.size())
+        throw std::runtime_error("malformed channel definition in trace");
+      std::memcpy(&def, payload, sizeof(def));
+      Channel &channel = channels.emplace_back();
+      channel.dir = def.dir;
+      channel.name.assign(reinterpret_cast<const char *>(payload) + sizeof(def),
+                          header.size - sizeof(def));
+      if (header.channel < index.size())
+        channel.records.reserve(index[header.channel].numMessages);
+      break;
+    }
+    case RecordKind::Message: {
+      if (header.channel >= channels.size())
+        throw std::runtime_error("message on undeclared channel in trace");
+      Channel &channel = channels[header.channel];
+      channel.records.push_back(offset);
+      channel.numBytes += header.size;
+      break;
+    }
+    case RecordKind::MMIORead: {
+      MMIOAccess access;
+      std::memcpy(&access, payload, sizeof(access));
+      mmioReads[access.address].push_back(access.data);
+      break;
+    }
+    default:
+      // Ignore records which replay doesn't care about.
+      break;
+    }
+    offset = payloadOffset + padTo8(header.size);
+  }
+
+  if (complete && index.size() != channels.size())
+    throw std::runtime_error("trace index does not match the trace");
+  for (size_t i = 0, e = index.size(); i < e; ++i)
+    if (channels[i].records.size() != index[i].numMessages)
+      throw std::runtime_error("trace index does not match the trace");
+}
+
+RecordHeader BinaryTraceReader::getHeader(uint64_t offset) const {
+  RecordHeader header;
+  std::memcpy(&header, file.getBytes() + offset, sizeof(header));
+  return header;
+}
+
+const BinaryTraceReader::Channel *
+BinaryTraceReader::findChannel(const std::string &name, Direction dir) const {
+  for (const Channel &channel : channels)
+    if (channel.name == name && channel.dir == dir)
+      return &channel;
+  return nullptr;
+}
+
+MessageData BinaryTraceReader::getMessage(uint64_t recordOffset) const {
+  return file.slice(recordOffset + sizeof(RecordHeader),
+                    getHeader(recordOffset).size);
+}
+
+uint64_t BinaryTraceReader::getTimestamp(uint64_t recordOffset) const {
+  return getHeader(recordOffset).timestamp;
+}
@@ -82,6 +82,7 @@ int main(int argc, const char *argv[]) {
       else
         printTelemetry(std::cout, *acc);
     }
+    cli.printMetrics(std::cout, *acc);
     return 0;
   } catch (std::exception &e) {
     ctxt.getLogger().error("esiquery", e.what());
@@ -101,6 +101,40 @@ static std::string formatBandwidth(double bytesPerSec) {
   return oss.str();
 }
 
+// Helper to format nanoseconds with appropriate units.
+static std::string formatLatency(uint64_t ns) {
+  const char *unit = "ns";
+  double value = ns;
+  if (ns >= 1000000000) {
+    unit = "s";
+    value = ns / 1e9;
+  } else if (ns >= 1000000) {
+    unit = "ms";
+    value = ns / 1e6;
+  } else if (ns >= 1000) {
+    unit = "us";
+    value = ns / 1e3;
+  }
+  std::ostringstream oss;
+  oss.setf(std::ios::fixed);
+  oss.precision(2);
+  oss << value << " " << unit;
+  return oss.str();
+}
+
+// Log the latency percentiles recorded on a port, if it has metrics.
+static void logLatency(Logger &logger, const ChannelPort &port) {
+  const ChannelMetrics *metrics = port.getMetrics();
+  if (!metrics || metrics->getLatency().getCount() == 0)
+    return;
+  const LatencyHistogram &latency = metrics->getLatency();
+  logger.info("esitester",
+              "    latency: p50 " + formatLatency(latency.getPercentile(50)) +
+                  ", p90 " + formatLatency(latency.getPercentile(90)) +
+                  ", p99 " + formatLatency(latency.getPercentile(99)) +
+                  ", max " + formatLatency(latency.getMax()));
+}
+
 // Human-readable size from bytes.
 static std::string humanBytes(uint64_t bytes) {
   const char *units[] = {"B", "KB", "MB", "GB", "TB"};
@@ -282,6 +316,10 @@ int main(int argc, const char *argv[]) {
 
   Context &ctxt = cli.getContext();
   AcceleratorConnection *acc = cli.connect();
+  // The bandwidth tests report latency percentiles from the port metrics,
+  // which have to be enabled before the ports get created.
+  if (*bandwidthSub)
+    acc->enableMetrics();
   try {
     const auto &info = *acc->getService<services::SysInfo>();
     ctxt.getLogger().info("esitester", "Connected to accelerator.");
@@ -317,6 +355,7 @@ int main(int argc, const char *argv[]) {
       coordTranslateTest(acc, accel, coordXTrans, coordYTrans, coordNumItems);
     }
 
+    cli.printMetrics(std::cout, *acc);
     acc->disconnect();
   } catch (std::exception &e) {
     ctxt.getLogger().error("esitester", e.what());
@@ -748,6 +787,7 @@ static void bandwidthReadTest(AcceleratorConnection *conn, Accelerator *acc,
                   std::to_string(width) + " bit transfers in " +
                   std::to_string(duration.count()) + " microseconds");
   logger.info("esitester", "    bandwidth: " + formatBandwidth(bytesPerSec));
+  logLatency(logger, outPort);
 }
 
 static void bandwidthWriteTest(AcceleratorConnection *conn, Accelerator *acc,
@@ -796,6 +836,7 @@ static void bandwidthWriteTest(AcceleratorConnection *conn, Accelerator *acc,
                   std::to_string(width) + " bit transfers in " +
                   std::to_string(duration.count()) + " microseconds");
   logger.info("esitester", "    bandwidth: " + formatBandwidth(bytesPerSec));
+  logLatency(logger, outPort);
 }
 
 static void bandwidthTest(AcceleratorConnection *conn, Accelerator *acc,
@@ -41,6 +41,13 @@ class Context:
   def set_stdio_logger(self, level: cpp.LogLevel):
     self.cpp_ctxt.set_stdio_logger(level)
 
+  def set_manifest_options(self,
+                           lazy: bool = False,
+                           index_cache_dir: Optional[str] = None):
+    """Parse manifests, and build the design hierarchy, lazily. The index used
+    by lazy parsing is cached in `index_cache_dir` if given."""
+    self.cpp_ctxt.set_manifest_options(lazy, index_cache_dir or "")
+
   def connect(self, platform: str,
               connection_str: str) -> "AcceleratorConnection":
     return AcceleratorConnection(
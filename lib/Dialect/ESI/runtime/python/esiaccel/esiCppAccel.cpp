@@ -350,7 +350,14 @@ NB_MODULE(esiCppAccel, m) {
              MessageData data(dataVec);
              return self.call(data);
            })
-      .def("connect", &FuncService::Function::connect);
+      .def(
+          "connect",
+          [](FuncService::Function &self, unsigned maxInFlight) {
+            FuncService::Function::Options options;
+            options.maxInFlight = maxInFlight;
+            self.connect(options);
+          },
+          nb::arg("max_in_flight") = 0);
 
   nb::class_<CallService::Callback, ServicePort>(m, "Callback")
       .def("connect", [](CallService::Callback &self,
@@ -409,9 +416,19 @@ NB_MODULE(esiCppAccel, m) {
       "all accelerator connections are disconnected.")
       .def(nb::init<>(), "Create a context with a default logger.")
       .def("connect", &Context::connect, nb::rv_policy::reference)
-      .def("set_stdio_logger", [](Context &ctxt, Logger::Level level) {
-        ctxt.setLogger(std::make_unique<StreamLogger>(level));
-      });
+      .def("set_stdio_logger",
+           [](Context &ctxt, Logger::Level level) {
+             ctxt.setLogger(std::make_unique<StreamLogger>(level));
+           })
+      .def(
+          "set_manifest_options",
+          [](Context &ctxt, bool lazy, std::string indexCacheDir) {
+            ctxt.setManifestOptions({lazy, indexCacheDir});
+          },
+          nb::arg("lazy") = false, nb::arg("index_cache_dir") = "",
+          "Set the options for parsing manifests. `lazy` parses the manifest "
+          "and builds the design hierarchy on demand, caching the index in "
+          "`index_cache_dir` if given.");
 
   accConn
       .def(
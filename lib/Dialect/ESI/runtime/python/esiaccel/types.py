@@ -484,8 +484,11 @@ class FunctionPort(BundlePort):
     self.result_type = self.read_port("result").type
     self.connected = False
 
-  def connect(self):
-    self.cpp_port.connect()
+  def connect(self, max_in_flight: int = 0):
+    """Connect to the function. Calls are pipelined: `call` returns as soon as
+    the argument is sent. If `max_in_flight` is non-zero, `call` blocks while
+    that many calls are awaiting their results."""
+    self.cpp_port.connect(max_in_flight=max_in_flight)
     self.connected = True
 
   def call(self, *args: Any, **kwargs: Any) -> Future:
@@ -0,0 +1,53 @@
+//===- FieldLayoutCache.cpp - Aggregate field layout cache ----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines FieldLayoutCache, a thread-safe cache of the fields of
+// bundle and vector types.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/FieldLayoutCache.h"
+
+#include <mutex>
+
+using namespace circt;
+using namespace firrtl;
+
+ArrayRef<FieldLayoutEntry>
+firrtl::FieldLayoutCache::getFields(FIRRTLBaseType type) {
+  if (!type_isa<BundleType, FVectorType>(type))
+    return {};
+
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = layouts.find(type);
+    if (it != layouts.end())
+      return *it->second;
+  }
+
+  // Compute the fields without holding the lock. Another thread may compute
+  // the same fields concurrently, in which case the first one wins.
+  auto layout = std::make_unique<Layout>();
+  FIRRTLTypeSwitch<FIRRTLBaseType>(type)
+      .Case<BundleType>([&](BundleType bundle) {
+        layout->reserve(bundle.getNumElements());
+        for (auto [i, element] : llvm::enumerate(bundle.getElements()))
+          layout->push_back({element.type, i, bundle.getFieldID(i),
+                             ("_" + element.name.getValue()).str(),
+                             element.isFlip});
+      })
+      .Case<FVectorType>([&](FVectorType vector) {
+        layout->reserve(vector.getNumElements());
+        for (size_t i = 0, e = vector.getNumElements(); i != e; ++i)
+          layout->push_back({vector.getElementType(), i, vector.getFieldID(i),
+                             "_" + std::to_string(i), false});
+      });
+
+  std::scoped_lock<std::shared_mutex> lock(mutex);
+  return *layouts.try_emplace(type, std::move(layout)).first->second;
+}
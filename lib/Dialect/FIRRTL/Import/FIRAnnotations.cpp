@@ -14,6 +14,10 @@
 #include "circt/Support/JSON.h"
 #include "mlir/IR/BuiltinAttributes.h"
 #include "mlir/IR/OperationSupport.h"
+#include "mlir/IR/Threading.h"
+#include "llvm/ADT/StringExtras.h"
+#include <cerrno>
+#include <cstdlib>
 
 namespace json = llvm::json;
 
@@ -60,3 +64,424 @@ bool circt::firrtl::importAnnotationsFromJSONRaw(
 
   return true;
 }
+
+//===----------------------------------------------------------------------===//
+// Direct JSON Text Import
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Converts JSON text directly to attributes, the same way that
+/// convertJSONToAttribute converts a JSON DOM.  Only checks that the text is
+/// well formed; it is up to the caller to produce diagnostics by parsing the
+/// text with llvm::json if this fails.
+class JSONAttrParser {
+public:
+  JSONAttrParser(MLIRContext *context, StringRef text, unsigned depth = 0)
+      : context(context), text(text), depth(depth) {}
+
+  /// Parse a value which spans all of the text.  Returns null on failure.
+  Attribute parseAll();
+
+  /// Whether the text is valid JSON that this parser does not handle the same
+  /// way as llvm::json.  Failures to unquote strings which contain JSON are
+  /// only benign if this is not set.
+  bool isUnsupported() const { return unsupported; }
+
+  /// Skip over a value without checking that it is well formed.  Used to split
+  /// the text up before parsing it.
+  bool skipValue();
+  void skipWhitespace();
+  bool consume(char c);
+  size_t getPos() const { return pos; }
+  bool atEnd() const { return pos == text.size(); }
+
+private:
+  Attribute parseValue();
+  Attribute parseObject();
+  Attribute parseArray();
+  Attribute parseNumber();
+  Attribute parseLiteral(StringRef literal, Attribute value);
+  Attribute convertString(StringRef str);
+  bool parseString(StringRef &result, std::string &storage);
+  bool parseEscape(std::string &storage);
+  bool parseHex4(uint32_t &result);
+
+  Attribute fail() { return {}; }
+  Attribute failUnsupported() {
+    unsupported = true;
+    return {};
+  }
+
+  /// llvm::json rejects deeply nested values, so do not try to parse them.
+  static constexpr unsigned maxDepth = 1024;
+
+  MLIRContext *context;
+  StringRef text;
+  size_t pos = 0;
+  unsigned depth;
+  bool unsupported = false;
+};
+} // namespace
+
+static bool isWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// NOLINTBEGIN(misc-no-recursion)
+Attribute JSONAttrParser::parseAll() {
+  skipWhitespace();
+  Attribute result = parseValue();
+  if (!result)
+    return {};
+  skipWhitespace();
+  return atEnd() ? result : fail();
+}
+
+void JSONAttrParser::skipWhitespace() {
+  while (!atEnd() && isWhitespace(text[pos]))
+    ++pos;
+}
+
+bool JSONAttrParser::consume(char c) {
+  if (atEnd() || text[pos] != c)
+    return false;
+  ++pos;
+  return true;
+}
+
+bool JSONAttrParser::skipValue() {
+  size_t start = pos;
+  unsigned nesting = 0;
+  while (!atEnd()) {
+    char c = text[pos];
+    if (c == '"') {
+      for (++pos; !atEnd() && text[pos] != '"'; ++pos)
+        if (text[pos] == '\\')
+          ++pos;
+      if (atEnd())
+        return false;
+      ++pos;
+    } else if (c == '{' || c == '[') {
+      ++nesting;
+      ++pos;
+    } else if (c == '}' || c == ']') {
+      if (nesting == 0)
+        break;
+      --nesting;
+      ++pos;
+    } else if (nesting == 0 && (c == ',' || isWhitespace(c))) {
+      break;
+    } else {
+      ++pos;
+    }
+  }
+  return nesting == 0 && pos != start;
+}
+
+Attribute JSONAttrParser::parseValue() {
+  if (atEnd())
+    return fail();
+  switch (text[pos]) {
+  case '{':
+    return parseObject();
+  case '[':
+    return parseArray();
+  case '"': {
+    StringRef str;
+    std::string storage;
+    if (!parseString(str, storage))
+      return fail();
+    return convertString(str);
+  }
+  case 't':
+    return parseLiteral("true", BoolAttr::get(context, true));
+  case 'f':
+    return parseLiteral("false", BoolAttr::get(context, false));
+  case 'n':
+    return parseLiteral("null", mlir::UnitAttr::get(context));
+  default:
+    return parseNumber();
+  }
+}
+
+Attribute JSONAttrParser::parseObject() {
+  if (depth++ == maxDepth)
+    return failUnsupported();
+  ++pos;
+  NamedAttrList metadata;
+  skipWhitespace();
+  if (!consume('}')) {
+    do {
+      skipWhitespace();
+      StringRef key;
+      std::string storage;
+      if (atEnd() || text[pos] != '"' || !parseString(key, storage))
+        return fail();
+      skipWhitespace();
+      if (!consume(':'))
+        return fail();
+      skipWhitespace();
+      Attribute value = parseValue();
+      if (!value)
+        return fail();
+      metadata.append(key, value);
+      skipWhitespace();
+    } while (consume(','));
+    if (!consume('}'))
+      return fail();
+  }
+  --depth;
+  // llvm::json lets later duplicate keys override earlier ones.  This is rare
+  // enough to leave to the DOM.
+  if (metadata.findDuplicate())
+    return failUnsupported();
+  return DictionaryAttr::get(context, metadata);
+}
+
+Attribute JSONAttrParser::parseArray() {
+  if (depth++ == maxDepth)
+    return failUnsupported();
+  ++pos;
+  SmallVector<Attribute> elements;
+  skipWhitespace();
+  if (!consume(']')) {
+    do {
+      skipWhitespace();
+      Attribute element = parseValue();
+      if (!element)
+        return fail();
+      elements.push_back(element);
+      skipWhitespace();
+    } while (consume(','));
+    if (!consume(']'))
+      return fail();
+  }
+  --depth;
+  return ArrayAttr::get(context, elements);
+}
+
+Attribute JSONAttrParser::parseNumber() {
+  // Scan numbers the same way as llvm::json, which is more lenient than the
+  // JSON grammar (e.g., it accepts leading zeros).
+  size_t start = pos;
+  while (!atEnd() && StringRef("0123456789+-.eE").contains(text[pos]))
+    ++pos;
+  if (pos == start)
+    return fail();
+  SmallString<32> number(text.slice(start, pos));
+  const char *end = number.c_str() + number.size();
+  char *numberEnd;
+
+  errno = 0;
+  int64_t integer = std::strtoll(number.c_str(), &numberEnd, 10);
+  if (numberEnd == end && errno != ERANGE)
+    return IntegerAttr::get(IntegerType::get(context, 64), integer);
+  // Integers which only fit in 64 unsigned bits become doubles.
+  if (number.front() != '-') {
+    errno = 0;
+    uint64_t unsignedInteger = std::strtoull(number.c_str(), &numberEnd, 10);
+    if (numberEnd == end && errno != ERANGE)
+      return FloatAttr::get(mlir::Float64Type::get(context),
+                            static_cast<double>(unsignedInteger));
+  }
+  double value = std::strtod(number.c_str(), &numberEnd);
+  if (numberEnd != end)
+    return fail();
+  return FloatAttr::get(mlir::Float64Type::get(context), value);
+}
+
+Attribute JSONAttrParser::parseLiteral(StringRef literal, Attribute value) {
+  if (!text.substr(pos).starts_with(literal))
+    return fail();
+  pos += literal.size();
+  return value;
+}
+
+Attribute JSONAttrParser::convertString(StringRef str) {
+  // Like convertJSONToAttribute, unquote strings which contain JSON, except
+  // for numbers.  Only try this if the string could be such JSON at all.
+  StringRef trimmed = str.ltrim(" \t\n\r");
+  if (!trimmed.empty() && StringRef("{[\"tfn").contains(trimmed.front())) {
+    if (depth == maxDepth)
+      return failUnsupported();
+    JSONAttrParser nested(context, str, depth + 1);
+    if (Attribute result = nested.parseAll())
+      return result;
+    if (nested.isUnsupported())
+      return failUnsupported();
+  }
+  return StringAttr::get(context, str);
+}
+
+bool JSONAttrParser::parseString(StringRef &result, std::string &storage) {
+  size_t start = ++pos;
+  // Strings without escapes refer directly into the text.
+  while (!atEnd() && text[pos] != '"' && text[pos] != '\\' &&
+         static_cast<unsigned char>(text[pos]) >= 0x20)
+    ++pos;
+  if (atEnd() || static_cast<unsigned char>(text[pos]) < 0x20)
+    return false;
+  if (text[pos] == '"') {
+    result = text.slice(start, pos++);
+    return true;
+  }
+
+  storage.assign(text.data() + start, pos - start);
+  while (!atEnd()) {
+    char c = text[pos++];
+    if (c == '"') {
+      result = storage;
+      return true;
+    }
+    if (static_cast<unsigned char>(c) < 0x20)
+      return false;
+    if (c != '\\')
+      storage.push_back(c);
+    else if (!parseEscape(storage))
+      return false;
+  }
+  return false;
+}
+
+bool JSONAttrParser::parseEscape(std::string &storage) {
+  if (atEnd())
+    return false;
+  switch (text[pos++]) {
+  case '"':
+    storage.push_back('"');
+    return true;
+  case '\\':
+    storage.push_back('\\');
+    return true;
+  case '/':
+    storage.push_back('/');
+    return true;
+  case 'b':
+    storage.push_back('\b');
+    return true;
+  case 'f':
+    storage.push_back('\f');
+    return true;
+  case 'n':
+    storage.push_back('\n');
+    return true;
+  case 'r':
+    storage.push_back('\r');
+    return true;
+  case 't':
+    storage.push_back('\t');
+    return true;
+  case 'u':
+    break;
+  default:
+    return false;
+  }
+
+  uint32_t codePoint;
+  if (!parseHex4(codePoint))
+    return false;
+  // Combine surrogate pairs.  Unpaired surrogates become U+FFFD, as in
+  // llvm::json.
+  if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+    uint32_t low;
+    size_t save = pos;
+    if (consume('\\') && consume('u') && parseHex4(low) && low >= 0xDC00 &&
+        low < 0xE000) {
+      codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+    } else {
+      pos = save;
+      codePoint = 0xFFFD;
+    }
+  } else if (codePoint >= 0xDC00 && codePoint < 0xE000) {
+    codePoint = 0xFFFD;
+  }
+
+  if (codePoint < 0x80) {
+    storage.push_back(codePoint);
+  } else if (codePoint < 0x800) {
+    storage.push_back(0xC0 | (codePoint >> 6));
+    storage.push_back(0x80 | (codePoint & 0x3F));
+  } else if (codePoint < 0x10000) {
+    storage.push_back(0xE0 | (codePoint >> 12));
+    storage.push_back(0x80 | ((codePoint >> 6) & 0x3F));
+    storage.push_back(0x80 | (codePoint & 0x3F));
+  } else {
+    storage.push_back(0xF0 | (codePoint >> 18));
+    storage.push_back(0x80 | ((codePoint >> 12) & 0x3F));
+    storage.push_back(0x80 | ((codePoint >> 6) & 0x3F));
+    storage.push_back(0x80 | (codePoint & 0x3F));
+  }
+  return true;
+}
+
+bool JSONAttrParser::parseHex4(uint32_t &result) {
+  if (text.size() - pos < 4)
+    return false;
+  result = 0;
+  for (char c : text.substr(pos, 4)) {
+    unsigned digit = llvm::hexDigitValue(c);
+    if (digit == -1U)
+      return false;
+    result = (result << 4) | digit;
+  }
+  pos += 4;
+  return true;
+}
+// NOLINTEND(misc-no-recursion)
+
+bool circt::firrtl::importAnnotationsFromJSONString(
+    StringRef text, SmallVectorImpl<Attribute> &annotations,
+    MLIRContext *context) {
+  if (!json::isUTF8(text))
+    return false;
+
+  // Find the text of each annotation so that they can be converted
+  // independently.
+  SmallVector<StringRef> elements;
+  JSONAttrParser splitter(context, text);
+  splitter.skipWhitespace();
+  if (!splitter.consume('['))
+    return false;
+  splitter.skipWhitespace();
+  if (!splitter.consume(']')) {
+    do {
+      splitter.skipWhitespace();
+      size_t start = splitter.getPos();
+      if (!splitter.skipValue())
+        return false;
+      elements.push_back(text.slice(start, splitter.getPos()));
+      splitter.skipWhitespace();
+    } while (splitter.consume(','));
+    if (!splitter.consume(']'))
+      return false;
+  }
+  splitter.skipWhitespace();
+  if (!splitter.atEnd())
+    return false;
+
+  // Convert the annotations in shards, keeping them in order.
+  constexpr size_t shardSize = 64;
+  size_t numShards = llvm::divideCeil(elements.size(), shardSize);
+  SmallVector<SmallVector<Attribute, 0>> shards(numShards);
+  auto result = mlir::failableParallelForEachN(
+      context, 0, numShards, [&](size_t shard) -> LogicalResult {
+        size_t begin = shard * shardSize;
+        size_t end = std::min(begin + shardSize, elements.size());
+        for (StringRef element : ArrayRef(elements).slice(begin, end - begin)) {
+          if (!element.starts_with("{"))
+            return failure();
+          Attribute annotation = JSONAttrParser(context, element).parseAll();
+          if (!annotation)
+            return failure();
+          shards[shard].push_back(annotation);
+        }
+        return success();
+      });
+  if (failed(result))
+    return false;
+
+  annotations.reserve(annotations.size() + elements.size());
+  for (auto &shard : shards)
+    annotations.append(shard.begin(), shard.end());
+  return true;
+}
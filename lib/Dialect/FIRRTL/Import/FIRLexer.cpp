@@ -420,10 +420,7 @@ FIRToken FIRLexer::lexIdentifierOrKeyword(const char *tokStart) {
   }
 
   // See if the identifier is a keyword.  By default, it is an identifier.
-  FIRToken::Kind kind = llvm::StringSwitch<FIRToken::Kind>(spelling)
-#define TOK_KEYWORD(SPELLING) .Case(#SPELLING, FIRToken::kw_##SPELLING)
-#include "FIRTokenKinds.def"
-                            .Default(FIRToken::identifier);
+  FIRToken::Kind kind = getKeywordKind(spelling);
 
   // If this has the backticks of a literal identifier and it fell through the
   // above switch, indicating that it was not found to e a keyword, then change
@@ -434,6 +431,13 @@ FIRToken FIRLexer::lexIdentifierOrKeyword(const char *tokStart) {
   return FIRToken(kind, spelling);
 }
 
+FIRToken::Kind FIRLexer::getKeywordKind(StringRef spelling) {
+  return llvm::StringSwitch<FIRToken::Kind>(spelling)
+#define TOK_KEYWORD(SPELLING) .Case(#SPELLING, FIRToken::kw_##SPELLING)
+#include "FIRTokenKinds.def"
+      .Default(FIRToken::identifier);
+}
+
 /// Skip a comment line, starting with a ';' and going to end of line.
 void FIRLexer::skipComment() {
   while (true) {
@@ -117,6 +117,20 @@ public:
   /// Get an opaque pointer into the lexer state that can be restored later.
   FIRLexerCursor getCursor() const;
 
+  /// Move the lexer to the specified position, which must be the start of a
+  /// token or the end of the buffer, and lex the token there.
+  void resetToken(const char *ptr) {
+    curPtr = ptr;
+    lexToken();
+  }
+
+  /// Get the buffer being lexed.
+  StringRef getBuffer() const { return curBuffer; }
+
+  /// Return the keyword with the specified spelling, or identifier if there is
+  /// no such keyword.
+  static FIRToken::Kind getKeywordKind(StringRef spelling);
+
 private:
   FIRToken lexTokenImpl();
 
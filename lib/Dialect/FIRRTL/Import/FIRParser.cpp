@@ -5346,6 +5346,19 @@ private:
 
   ParseResult skipToModuleEnd(unsigned indent);
 
+  /// A line which starts with a keyword that could begin a top-level
+  /// declaration.
+  struct TopLevelDeclStart {
+    const char *ptr;
+    unsigned indent;
+  };
+
+  /// Find the starts of all the top-level declarations after the current
+  /// token, so that skipToModuleEnd does not have to lex the module bodies.
+  void scanTopLevelDecls();
+
+  SmallVector<TopLevelDeclStart, 0> topLevelDeclStarts;
+
   ParseResult parseTypeDecl();
 
   ParseResult parseOptionDecl(CircuitOp circuit);
@@ -5385,6 +5398,11 @@ private:
 ParseResult
 FIRCircuitParser::importAnnotationsRaw(SMLoc loc, StringRef annotationsStr,
                                        SmallVectorImpl<Attribute> &attrs) {
+  // Convert the text directly, which avoids building a (potentially very
+  // large) JSON DOM.  This doesn't produce diagnostics, so use the DOM to find
+  // out what the problem is if it fails.
+  if (importAnnotationsFromJSONString(annotationsStr, attrs, getContext()))
+    return success();
 
   auto annotations = json::parse(annotationsStr);
   if (auto err = annotations.takeError()) {
@@ -5615,42 +5633,105 @@ FIRCircuitParser::parsePortList(SmallVectorImpl<PortInfo> &resultPorts,
   return success();
 }
 
-/// We're going to defer parsing this module, so just skip tokens until we
-/// get to the next module or the end of the file.
+/// Return true if this is a keyword which starts a top-level declaration.
+static bool isTopLevelDeclKeyword(FIRToken::Kind kind) {
+  switch (kind) {
+  case FIRToken::kw_class:
+  case FIRToken::kw_domain:
+  case FIRToken::kw_declgroup:
+  case FIRToken::kw_extclass:
+  case FIRToken::kw_extmodule:
+  case FIRToken::kw_intmodule:
+  case FIRToken::kw_formal:
+  case FIRToken::kw_module:
+  case FIRToken::kw_public:
+  case FIRToken::kw_layer:
+  case FIRToken::kw_option:
+  case FIRToken::kw_simulation:
+  case FIRToken::kw_type:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Find every line which starts with a top-level declaration keyword.  Strings
+/// and comments cannot span lines, so this can be done by looking at the start
+/// of each line without lexing the rest of it.  That lets the file be split
+/// into chunks which are scanned in parallel.
+void FIRCircuitParser::scanTopLevelDecls() {
+  StringRef buffer = getLexer().getBuffer();
+  auto isHorizontalWS = [](char c) { return c == ' ' || c == '\t'; };
+  auto isVerticalWS = [](char c) {
+    return c == '\n' || c == '\r' || c == '\f' || c == '\v';
+  };
+  auto isIdChar = [](char c) {
+    return llvm::isAlnum(c) || c == '_' || c == '$' || c == '-';
+  };
+
+  // Start from the beginning of the line containing the current token.
+  size_t start = getToken().getLoc().getPointer() - buffer.data();
+  while (start > 0 && !isVerticalWS(buffer[start - 1]))
+    --start;
+
+  // Each chunk handles the lines which start within it.
+  constexpr size_t chunkSize = 1 << 20;
+  size_t numChunks = llvm::divideCeil(buffer.size() - start, chunkSize);
+  SmallVector<SmallVector<TopLevelDeclStart, 0>> chunks(numChunks);
+  mlir::parallelFor(getContext(), 0, numChunks, [&](size_t chunk) {
+    size_t pos = start + chunk * chunkSize;
+    size_t end = std::min(pos + chunkSize, buffer.size());
+    // Move to the first line which starts in this chunk.
+    while (pos < end && pos > 0 && !isVerticalWS(buffer[pos - 1]))
+      ++pos;
+    while (pos < end) {
+      size_t lineStart = pos;
+      while (pos < buffer.size() && isHorizontalWS(buffer[pos]))
+        ++pos;
+      size_t wordStart = pos;
+      while (pos < buffer.size() && isIdChar(buffer[pos]))
+        ++pos;
+      if (isTopLevelDeclKeyword(
+              FIRLexer::getKeywordKind(buffer.slice(wordStart, pos))))
+        chunks[chunk].push_back(
+            {buffer.data() + wordStart, unsigned(wordStart - lineStart)});
+      // Move to the start of the next line.
+      while (pos < buffer.size() && !isVerticalWS(buffer[pos]))
+        ++pos;
+      ++pos;
+    }
+  });
+
+  for (auto &chunk : chunks)
+    topLevelDeclStarts.append(chunk.begin(), chunk.end());
+}
+
+/// We're going to defer parsing this module, so skip to the next top-level
+/// declaration at the same indentation or the end of the file.  This uses the
+/// declarations found by scanTopLevelDecls rather than lexing the module body,
+/// which is lexed when the body is parsed.
 ParseResult FIRCircuitParser::skipToModuleEnd(unsigned indent) {
-  while (true) {
-    switch (getToken().getKind()) {
+  // An invalid token will be handled by the outer level.
+  if (getToken().is(FIRToken::error))
+    return success();
 
-    // End of file or invalid token will be handled by outer level.
-    case FIRToken::eof:
-    case FIRToken::error:
+  // All module declarations should have the same indentation level. Use this
+  // fact to differentiate between module declarations and usages of "module"
+  // as identifiers.
+  const char *cur = getToken().getLoc().getPointer();
+  auto *it = llvm::lower_bound(
+      topLevelDeclStarts, cur,
+      [](const TopLevelDeclStart &decl, const char *ptr) {
+        return decl.ptr < ptr;
+      });
+  for (auto *e = topLevelDeclStarts.end(); it != e; ++it) {
+    if (it->indent == indent) {
+      getLexer().resetToken(it->ptr);
       return success();
-
-    // If we got to the next top-level declaration, then we're done.
-    case FIRToken::kw_class:
-    case FIRToken::kw_domain:
-    case FIRToken::kw_declgroup:
-    case FIRToken::kw_extclass:
-    case FIRToken::kw_extmodule:
-    case FIRToken::kw_intmodule:
-    case FIRToken::kw_formal:
-    case FIRToken::kw_module:
-    case FIRToken::kw_public:
-    case FIRToken::kw_layer:
-    case FIRToken::kw_option:
-    case FIRToken::kw_simulation:
-    case FIRToken::kw_type:
-      // All module declarations should have the same indentation
-      // level. Use this fact to differentiate between module
-      // declarations and usages of "module" as identifiers.
-      if (getIndentation() == indent)
-        return success();
-      [[fallthrough]];
-    default:
-      consumeToken();
-      break;
     }
   }
+  getLexer().resetToken(getLexer().getBuffer().end());
+  return success();
 }
 
 /// parameter-list ::= parameter*
@@ -6384,6 +6465,12 @@ ParseResult FIRCircuitParser::parseCircuit(
   if (!annos.empty())
     circuit->setAttr(rawAnnotations, b.getArrayAttr(annos));
 
+  // Find where all the top-level declarations are, so that the module bodies
+  // can be skipped over without being lexed.
+  auto scanTimer = ts.nest("Scan top-level declarations");
+  scanTopLevelDecls();
+  scanTimer.stop();
+
   // A timer to get execution time of module parsing.
   auto parseTimer = ts.nest("Parse modules");
   deferredModules.reserve(16);
@@ -182,11 +182,45 @@ static llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
 }
 
 namespace {
-struct IMConstPropPass
-    : public circt::firrtl::impl::IMConstPropBase<IMConstPropPass> {
+struct ModuleShard;
+
+/// A message to the shard of a module, sent by the shard of another module
+/// and delivered between propagation rounds.
+struct ShardMessage {
+  /// The module is instantiated by `instance`, a live instance in the module
+  /// of the `sender` shard.
+  static ShardMessage instantiate(InstanceOp instance, ModuleShard *sender) {
+    return {instance, sender, {}, {}};
+  }
 
-  void runOnOperation() override;
-  void rewriteModuleBody(FModuleOp module);
+  /// Merge `value` into the lattice value of `field`.
+  static ShardMessage merge(FieldRef field, LatticeValue value) {
+    return {{}, nullptr, field, value};
+  }
+
+  InstanceOp instance;
+  ModuleShard *sender;
+  FieldRef field;
+  LatticeValue value;
+};
+
+/// The lattice state of a single module. Each shard propagates values through
+/// its own module, and sends the values that cross an instance boundary to the
+/// shard on the other side. This lets the shards of all modules run in
+/// parallel, exchanging messages in rounds until no lattice value changes.
+struct ModuleShard {
+  ModuleShard(FModuleOp module, InstanceGraph *instanceGraph,
+              const DenseMap<Operation *, ModuleShard *> &shards)
+      : module(module), instanceGraph(instanceGraph), shards(shards) {}
+
+  /// Process the delivered messages, and propagate the resulting changes
+  /// through the module until it converges.
+  void run();
+
+  /// Send a message to the shard of another module.
+  void send(ModuleShard *shard, ShardMessage message) {
+    outbox.emplace_back(shard, message);
+  }
 
   /// Returns true if the given block is executable.
   bool isBlockExecutable(Block *block) const {
@@ -329,9 +363,14 @@ struct IMConstPropPass
   void visitNode(NodeOp node, FieldRef changedFieldRef);
   void visitOperation(Operation *op, FieldRef changedFieldRef);
 
-private:
+  /// The module whose values this shard tracks.
+  FModuleOp module;
+
   /// This is the current instance graph for the Circuit.
-  InstanceGraph *instanceGraph = nullptr;
+  InstanceGraph *instanceGraph;
+
+  /// The shards of all modules in the circuit.
+  const DenseMap<Operation *, ModuleShard *> &shards;
 
   /// This keeps track of the current state of each tracked value.
   DenseMap<FieldRef, LatticeValue> latticeValues;
@@ -351,33 +390,53 @@ private:
   llvm::DenseMap<Value, FieldRef> valueToFieldRef;
 
   /// This keeps track of users the instance results that correspond to output
-  /// ports.
-  DenseMap<BlockArgument, llvm::TinyPtrVector<Value>>
+  /// ports, and the shards of the modules containing the instances.
+  DenseMap<BlockArgument, SmallVector<std::pair<Value, ModuleShard *>, 1>>
       resultPortToInstanceResultMapping;
 
+  /// The messages delivered to this shard, and the ones it sent to others.
+  SmallVector<ShardMessage> inbox;
+  SmallVector<std::pair<ModuleShard *, ShardMessage>> outbox;
+
 #ifndef NDEBUG
   /// A logger used to emit information during the application process.
   llvm::ScopedPrinter logger{llvm::dbgs()};
 #endif
 };
+
+struct IMConstPropPass
+    : public circt::firrtl::impl::IMConstPropBase<IMConstPropPass> {
+
+  void runOnOperation() override;
+  void rewriteModuleBody(ModuleShard &shard);
+};
 } // end anonymous namespace
 
 // TODO: handle annotations: [[OptimizableExtModuleAnnotation]]
 void IMConstPropPass::runOnOperation() {
   auto circuit = getOperation();
-  LLVM_DEBUG(
-      { logger.startLine() << "IMConstProp : " << circuit.getName() << "\n"; });
+  LLVM_DEBUG(llvm::dbgs() << "IMConstProp : " << circuit.getName() << "\n");
+
+  auto *instanceGraph = &getAnalysis<InstanceGraph>();
 
-  instanceGraph = &getAnalysis<InstanceGraph>();
+  // Shard the lattice state by module.
+  SmallVector<std::unique_ptr<ModuleShard>> moduleShards;
+  DenseMap<Operation *, ModuleShard *> shards;
+  for (auto module : circuit.getOps<FModuleOp>()) {
+    moduleShards.push_back(
+        std::make_unique<ModuleShard>(module, instanceGraph, shards));
+    shards[module] = moduleShards.back().get();
+  }
 
   // Mark input ports as overdefined where appropriate.
   for (auto &op : circuit.getOps()) {
     // Inputs of public modules are overdefined.
     if (auto module = dyn_cast<FModuleOp>(op)) {
       if (module.isPublic()) {
-        markBlockExecutable(module.getBodyBlock());
+        auto *shard = shards[module];
+        shard->markBlockExecutable(module.getBodyBlock());
         for (auto port : module.getBodyBlock()->getArguments())
-          markOverdefined(port);
+          shard->markOverdefined(port);
       }
       continue;
     }
@@ -402,15 +461,82 @@ void IMConstPropPass::runOnOperation() {
                        << "Unknown use of " << module.getModuleNameAttr()
                        << " in " << op.getName()
                        << ", marking inputs as overdefined\n");
-            markBlockExecutable(module.getBodyBlock());
+            auto *shard = shards[module];
+            shard->markBlockExecutable(module.getBodyBlock());
             for (auto port : module.getBodyBlock()->getArguments())
-              markOverdefined(port);
+              shard->markOverdefined(port);
           }
         }
       }
     }
   }
 
+  // Propagate the lattice values through all modules in parallel. Between
+  // rounds, deliver the values crossing instance boundaries to the shards on
+  // the other side, until no shard has anything left to do.
+  SmallVector<ModuleShard *> activeShards;
+  for (auto &shard : moduleShards)
+    activeShards.push_back(shard.get());
+  while (!activeShards.empty()) {
+    ++numRounds;
+    mlir::parallelForEach(circuit.getContext(), activeShards,
+                          [](ModuleShard *shard) { shard->run(); });
+    activeShards.clear();
+    for (auto &shard : moduleShards) {
+      for (auto &[target, message] : shard->outbox) {
+        if (target->inbox.empty())
+          activeShards.push_back(target);
+        target->inbox.push_back(message);
+      }
+      shard->outbox.clear();
+    }
+  }
+
+  // Rewrite any constants in the modules.
+  mlir::parallelForEach(circuit.getContext(), moduleShards,
+                        [&](auto &shard) { rewriteModuleBody(*shard); });
+}
+
+void ModuleShard::run() {
+  for (auto &message : inbox) {
+    if (!message.instance) {
+      mergeLatticeValue(message.field, message.value);
+      continue;
+    }
+
+    // The module is instantiated by a live instance, so it is live too.
+    markBlockExecutable(module.getBodyBlock());
+
+    // Populate resultPortToInstanceResultMapping, and forward any
+    // already-computed values of the output ports to the instance results.
+    for (auto port : module.getArguments()) {
+      // If this is an input to the instance, it will get handled when any
+      // connects to it are processed.
+      if (module.getPortDirection(port.getArgNumber()) == Direction::In)
+        continue;
+
+      Value instancePortVal = message.instance.getResult(port.getArgNumber());
+      resultPortToInstanceResultMapping[port].emplace_back(instancePortVal,
+                                                           message.sender);
+
+      auto forward = [&](uint64_t fieldID) {
+        auto it = latticeValues.find(FieldRef(port, fieldID));
+        if (it != latticeValues.end() && !it->second.isUnknown())
+          send(message.sender,
+               ShardMessage::merge(FieldRef(instancePortVal, fieldID),
+                                   it->second));
+      };
+      // Special-handle PropertyType's, walkGroundTypes doesn't support.
+      auto type = type_dyn_cast<FIRRTLType>(port.getType());
+      if (!type || type_isa<PropertyType>(type))
+        forward(0);
+      else
+        walkGroundTypes(
+            type, [&](uint64_t fieldID, auto, auto) { forward(fieldID); });
+    }
+  }
+  inbox.clear();
+
   // If a value changed lattice state then reprocess any of its users.
   while (!changedLatticeValueWorklist.empty()) {
     FieldRef changedFieldRef = changedLatticeValueWorklist.pop_back_val();
@@ -419,26 +545,12 @@ void IMConstPropPass::runOnOperation() {
         visitOperation(user, changedFieldRef);
     }
   }
-
-  // Rewrite any constants in the modules.
-  mlir::parallelForEach(circuit.getContext(),
-                        circuit.getBodyBlock()->getOps<FModuleOp>(),
-                        [&](auto op) { rewriteModuleBody(op); });
-
-  // Clean up our state for next time.
-  instanceGraph = nullptr;
-  latticeValues.clear();
-  executableBlocks.clear();
-  assert(changedLatticeValueWorklist.empty());
-  fieldRefToUsers.clear();
-  valueToFieldRef.clear();
-  resultPortToInstanceResultMapping.clear();
 }
 
 /// Return the lattice value for the specified SSA value, extended to the width
 /// of the specified destType.  If allowTruncation is true, then this allows
 /// truncating the lattice value to the specified type.
-LatticeValue IMConstPropPass::getExtendedLatticeValue(FieldRef value,
+LatticeValue ModuleShard::getExtendedLatticeValue(FieldRef value,
                                                       FIRRTLType destType,
                                                       bool allowTruncation) {
   // If 'value' hasn't been computed yet, then it is unknown.
@@ -489,7 +601,7 @@ LatticeValue IMConstPropPass::getExtendedLatticeValue(FieldRef value,
 /// Mark a block executable if it isn't already.  This does an initial scan of
 /// the block, processing nullary operations like wires, instances, and
 /// constants that only get processed once.
-void IMConstPropPass::markBlockExecutable(Block *block) {
+void ModuleShard::markBlockExecutable(Block *block) {
   if (!executableBlocks.insert(block).second)
     return; // Already executable.
 
@@ -573,7 +685,7 @@ void IMConstPropPass::markBlockExecutable(Block *block) {
 }
 // NOLINTEND(misc-no-recursion)
 
-void IMConstPropPass::markWireOp(WireOp wire) {
+void ModuleShard::markWireOp(WireOp wire) {
   auto type = type_dyn_cast<FIRRTLType>(wire.getResult().getType());
   if (!type || hasDontTouch(wire.getResult()) || wire.isForceable()) {
     for (auto result : wire.getResults())
@@ -584,23 +696,23 @@ void IMConstPropPass::markWireOp(WireOp wire) {
   // Otherwise, this starts out as unknown and is upgraded by connects.
 }
 
-void IMConstPropPass::markMemOp(MemOp mem) {
+void ModuleShard::markMemOp(MemOp mem) {
   for (auto result : mem.getResults())
     markOverdefined(result);
 }
 
-void IMConstPropPass::markDPICallIntrinsicOp(DPICallIntrinsicOp dpi) {
+void ModuleShard::markDPICallIntrinsicOp(DPICallIntrinsicOp dpi) {
   if (auto result = dpi.getResult())
     markOverdefined(result);
 }
 
 template <typename OpTy>
-void IMConstPropPass::markConstantValueOp(OpTy op) {
+void ModuleShard::markConstantValueOp(OpTy op) {
   mergeLatticeValue(getOrCacheFieldRefFromValue(op),
                     LatticeValue(op.getValueAttr()));
 }
 
-void IMConstPropPass::markAggregateConstantOp(AggregateConstantOp constant) {
+void ModuleShard::markAggregateConstantOp(AggregateConstantOp constant) {
   walkGroundTypes(constant.getType(), [&](uint64_t fieldID, auto, auto) {
     mergeLatticeValue(FieldRef(constant, fieldID),
                       LatticeValue(cast<IntegerAttr>(
@@ -608,13 +720,13 @@ void IMConstPropPass::markAggregateConstantOp(AggregateConstantOp constant) {
   });
 }
 
-void IMConstPropPass::markInvalidValueOp(InvalidValueOp invalid) {
+void ModuleShard::markInvalidValueOp(InvalidValueOp invalid) {
   markOverdefined(invalid.getResult());
 }
 
 /// Instances have no operands, so they are visited exactly once when their
 /// enclosing block is marked live.  This sets up the def-use edges for ports.
-void IMConstPropPass::markInstanceOp(InstanceOp instance) {
+void ModuleShard::markInstanceOp(InstanceOp instance) {
   // Get the module being reference or a null pointer if this is an extmodule.
   Operation *op = instance.getReferencedModule(*instanceGraph);
 
@@ -635,33 +747,12 @@ void IMConstPropPass::markInstanceOp(InstanceOp instance) {
     return;
   }
 
-  // Otherwise this is a defined module.
-  auto fModule = cast<FModuleOp>(op);
-  markBlockExecutable(fModule.getBodyBlock());
-
-  // Ok, it is a normal internal module reference.  Populate
-  // resultPortToInstanceResultMapping, and forward any already-computed values.
-  for (size_t resultNo = 0, e = instance.getNumResults(); resultNo != e;
-       ++resultNo) {
-    auto instancePortVal = instance.getResult(resultNo);
-    // If this is an input to the instance, it will
-    // get handled when any connects to it are processed.
-    if (fModule.getPortDirection(resultNo) == Direction::In)
-      continue;
-
-    // Otherwise we have a result from the instance.  We need to forward results
-    // from the body to this instance result's SSA value, so remember it.
-    BlockArgument modulePortVal = fModule.getArgument(resultNo);
-
-    resultPortToInstanceResultMapping[modulePortVal].push_back(instancePortVal);
-
-    // If there is already a value known for modulePortVal make sure to forward
-    // it here.
-    mergeLatticeValue(instancePortVal, modulePortVal);
-  }
+  // Otherwise this is a defined module. Its shard marks it executable and
+  // forwards the values of its output ports to the instance results.
+  send(shards.lookup(op), ShardMessage::instantiate(instance, this));
 }
 
-void IMConstPropPass::markObjectOp(ObjectOp obj) {
+void ModuleShard::markObjectOp(ObjectOp obj) {
   // Mark overdefined for now, not supported.
   markOverdefined(obj);
 }
@@ -680,7 +771,7 @@ getFieldIDOffset(FieldRef changedFieldRef, Type connectionType,
   return {};
 }
 
-void IMConstPropPass::mergeOnlyChangedLatticeValue(Value dest, Value src,
+void ModuleShard::mergeOnlyChangedLatticeValue(Value dest, Value src,
                                                    FieldRef changedFieldRef) {
 
   // Operate on inner type for refs.
@@ -712,7 +803,7 @@ void IMConstPropPass::mergeOnlyChangedLatticeValue(Value dest, Value src,
                       fieldRefSrc.getSubField(*destOffset));
 }
 
-void IMConstPropPass::visitConnectLike(FConnectLike connect,
+void ModuleShard::visitConnectLike(FConnectLike connect,
                                        FieldRef changedFieldRef) {
   // Operate on inner type for refs.
   auto destType = connect.getDest().getType();
@@ -752,10 +843,12 @@ void IMConstPropPass::visitConnectLike(FConnectLike connect,
     // Driving result ports propagates the value to each instance using the
     // module.
     if (auto blockArg = dyn_cast<BlockArgument>(fieldRefDest.getValue())) {
-      for (auto userOfResultPort : resultPortToInstanceResultMapping[blockArg])
-        mergeLatticeValue(
-            FieldRef(userOfResultPort, fieldRefDestConnected.getFieldID()),
-            srcValue);
+      for (auto [userOfResultPort, shard] :
+           resultPortToInstanceResultMapping[blockArg])
+        send(shard, ShardMessage::merge(FieldRef(userOfResultPort,
+                                                 fieldRefDestConnected
+                                                     .getFieldID()),
+                                        srcValue));
       // Output ports are wire-like and may have users.
       return mergeLatticeValue(fieldRefDestConnected, srcValue);
     }
@@ -778,9 +871,11 @@ void IMConstPropPass::visitConnectLike(FConnectLike connect,
 
       BlockArgument modulePortVal = mod.getArgument(dest.getResultNumber());
 
-      return mergeLatticeValue(
-          FieldRef(modulePortVal, fieldRefDestConnected.getFieldID()),
-          srcValue);
+      return send(
+          shards.lookup(mod),
+          ShardMessage::merge(
+              FieldRef(modulePortVal, fieldRefDestConnected.getFieldID()),
+              srcValue));
     }
 
     // Driving a memory result is ignored because these are always treated
@@ -811,13 +906,13 @@ void IMConstPropPass::visitConnectLike(FConnectLike connect,
             hw::FieldIdImpl::getFinalTypeByFieldID(destType, *relativeDest)));
 }
 
-void IMConstPropPass::visitRefSend(RefSendOp send, FieldRef changedFieldRef) {
+void ModuleShard::visitRefSend(RefSendOp send, FieldRef changedFieldRef) {
   // Send connects the base value (source) to the result (dest).
   return mergeOnlyChangedLatticeValue(send.getResult(), send.getBase(),
                                       changedFieldRef);
 }
 
-void IMConstPropPass::visitRefResolve(RefResolveOp resolve,
+void ModuleShard::visitRefResolve(RefResolveOp resolve,
                                       FieldRef changedFieldRef) {
   // Resolve connects the ref value (source) to result (dest).
   // If writes are ever supported, this will need to work differently!
@@ -825,7 +920,7 @@ void IMConstPropPass::visitRefResolve(RefResolveOp resolve,
                                       changedFieldRef);
 }
 
-void IMConstPropPass::visitNode(NodeOp node, FieldRef changedFieldRef) {
+void ModuleShard::visitNode(NodeOp node, FieldRef changedFieldRef) {
   if (hasDontTouch(node.getResult()) || node.isForceable()) {
     for (auto result : node.getResults())
       markOverdefined(result);
@@ -842,7 +937,7 @@ void IMConstPropPass::visitNode(NodeOp node, FieldRef changedFieldRef) {
 ///
 /// This should update the lattice value state for any result values.
 ///
-void IMConstPropPass::visitOperation(Operation *op, FieldRef changedField) {
+void ModuleShard::visitOperation(Operation *op, FieldRef changedField) {
   // If this is a operation with special handling, handle it specially.
   if (auto connectLikeOp = dyn_cast<FConnectLike>(op))
     return visitConnectLike(connectLikeOp, changedField);
@@ -966,10 +1061,11 @@ void IMConstPropPass::visitOperation(Operation *op, FieldRef changedField) {
   }
 }
 
-void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
+void IMConstPropPass::rewriteModuleBody(ModuleShard &shard) {
+  auto module = shard.module;
   auto *body = module.getBodyBlock();
   // If a module is unreachable, just ignore it.
-  if (!executableBlocks.count(body))
+  if (!shard.isBlockExecutable(body))
     return;
 
   auto builder = OpBuilder::atBlockBegin(body);
@@ -1025,8 +1121,8 @@ void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
     };
 
     // TODO: Replace entire aggregate.
-    auto it = latticeValues.find(getFieldRefFromValue(value));
-    if (it == latticeValues.end() || it->second.isOverdefined() ||
+    auto it = shard.latticeValues.find(getFieldRefFromValue(value));
+    if (it == shard.latticeValues.end() || it->second.isOverdefined() ||
         it->second.isUnknown())
       return false;
 
@@ -1060,8 +1156,9 @@ void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
         auto dropIfDead = [&](Operation *op, const Twine &debugPrefix) {
           if (op->use_empty() &&
               (wouldOpBeTriviallyDead(op) || isDeletableWireOrRegOrNode(op))) {
-            LLVM_DEBUG(
-                { logger.getOStream() << debugPrefix << " : " << op << "\n"; });
+            LLVM_DEBUG({
+              shard.logger.getOStream() << debugPrefix << " : " << op << "\n";
+            });
             ++numErasedOp;
             op->erase();
             return true;
@@ -1084,7 +1181,8 @@ void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
         // Connects to values that we found to be constant can be dropped.
         if (auto connect = dyn_cast<FConnectLike>(op)) {
           if (auto *destOp = connect.getDest().getDefiningOp()) {
-            auto fieldRef = getOrCacheFieldRefFromValue(connect.getDest());
+            auto fieldRef =
+                shard.getOrCacheFieldRefFromValue(connect.getDest());
             // Don't remove a field-level connection even if the src value is
             // constant. If other elements of the aggregate value are not
             // constant, the aggregate value cannot be replaced. We can forward
@@ -1097,7 +1195,7 @@ void IMConstPropPass::rewriteModuleBody(FModuleOp module) {
             if (baseType && !baseType.isGround())
               return WalkResult::advance();
             if (isDeletableWireOrRegOrNode(destOp) &&
-                !isOverdefined(fieldRef)) {
+                !shard.isOverdefined(fieldRef)) {
               connect.erase();
               ++numErasedOp;
             }
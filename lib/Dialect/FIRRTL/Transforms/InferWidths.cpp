@@ -10,6 +10,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "circt/Dialect/FIRRTL/FIRRTLInstanceGraph.h"
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
 #include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
 #include "circt/Dialect/FIRRTL/FIRRTLUtils.h"
@@ -20,6 +21,7 @@
 #include "mlir/Pass/Pass.h"
 #include "llvm/ADT/APSInt.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Support/Debug.h"
@@ -1212,7 +1214,7 @@ public:
                    hw::InnerSymbolTableCollection &istc)
       : solver(solver), symtbl(symtbl), irn{symtbl, istc} {}
 
-  LogicalResult map(CircuitOp op);
+  LogicalResult map(ArrayRef<FModuleOp> modules);
   bool allWidthsKnown(Operation *op);
   LogicalResult mapOperation(Operation *op);
 
@@ -1258,14 +1260,6 @@ public:
   /// Set the expr associated with a specific field in a value.
   void setExpr(FieldRef fieldRef, Expr *expr);
 
-  /// Return whether a module was skipped due to being fully inferred already.
-  bool isModuleSkipped(FModuleOp module) const {
-    return skippedModules.count(module);
-  }
-
-  /// Return whether all modules in the mapping were fully inferred.
-  bool areAllModulesSkipped() const { return allModulesSkipped; }
-
 private:
   /// The constraint solver into which we emit variables and constraints.
   ConstraintSolver &solver;
@@ -1273,10 +1267,6 @@ private:
   /// The constraint exprs for each result type of an operation.
   DenseMap<FieldRef, Expr *> opExprs;
 
-  /// The fully inferred modules that were skipped entirely.
-  SmallPtrSet<Operation *, 16> skippedModules;
-  bool allModulesSkipped = true;
-
   /// Cache of module symbols
   SymbolTable &symtbl;
 
@@ -1295,43 +1285,43 @@ static bool hasUninferredWidth(Type type) {
       .Default([](auto) { return false; });
 }
 
-LogicalResult InferenceMapping::map(CircuitOp op) {
+/// Check if a module contains any uninferred widths, in its ports or body.
+static bool hasUninferredWidths(FModuleOp module) {
+  for (auto arg : module.getArguments())
+    if (hasUninferredWidth(arg.getType()))
+      return true;
+  return module
+      .walk([&](Operation *op) {
+        for (auto type : op->getResultTypes())
+          if (hasUninferredWidth(type))
+            return WalkResult::interrupt();
+        return WalkResult::advance();
+      })
+      .wasInterrupted();
+}
+
+/// Check if any port of a module has an uninferred width.
+static bool hasUninferredPortWidths(FModuleOp module) {
+  return llvm::any_of(module.getArguments(), [](auto arg) {
+    return hasUninferredWidth(arg.getType());
+  });
+}
+
+/// Map a set of modules to constraints. The modules must contain uninferred
+/// widths, and every module with uninferred port widths they instantiate must
+/// be part of the set.
+LogicalResult InferenceMapping::map(ArrayRef<FModuleOp> modules) {
   LLVM_DEBUG(llvm::dbgs()
              << "\n===----- Mapping ops to constraint exprs -----===\n\n");
 
   // Ensure we have constraint variables established for all module ports.
-  for (auto module : op.getOps<FModuleOp>())
+  for (auto module : modules)
     for (auto arg : module.getArguments()) {
       solver.setCurrentContextInfo(FieldRef(arg, 0));
       declareVars(arg);
     }
 
-  for (auto module : op.getOps<FModuleOp>()) {
-    // Check if the module contains *any* uninferred widths. This allows us to
-    // do an early skip if the module is already fully inferred.
-    bool anyUninferred = false;
-    for (auto arg : module.getArguments()) {
-      anyUninferred |= hasUninferredWidth(arg.getType());
-      if (anyUninferred)
-        break;
-    }
-    module.walk([&](Operation *op) {
-      for (auto type : op->getResultTypes())
-        anyUninferred |= hasUninferredWidth(type);
-      if (anyUninferred)
-        return WalkResult::interrupt();
-      return WalkResult::advance();
-    });
-
-    if (!anyUninferred) {
-      LLVM_DEBUG(llvm::dbgs() << "Skipping fully-inferred module '"
-                              << module.getName() << "'\n");
-      skippedModules.insert(module);
-      continue;
-    }
-
-    allModulesSkipped = false;
-
+  for (auto module : modules) {
     // Go through operations in the module, creating type variables for results,
     // and generating constraints.
     auto result = module.getBodyBlock()->walk(
@@ -2038,7 +2028,7 @@ class InferenceTypeUpdate {
 public:
   InferenceTypeUpdate(InferenceMapping &mapping) : mapping(mapping) {}
 
-  LogicalResult update(CircuitOp op);
+  LogicalResult update(FModuleOp op);
   FailureOr<bool> updateOperation(Operation *op);
   FailureOr<bool> updateValue(Value value);
   FIRRTLBaseType updateType(FieldRef fieldRef, FIRRTLBaseType type);
@@ -2049,25 +2039,14 @@ private:
 
 } // namespace
 
-/// Update the types throughout a circuit.
-LogicalResult InferenceTypeUpdate::update(CircuitOp op) {
-  LLVM_DEBUG({
-    llvm::dbgs() << "\n";
-    debugHeader("Update types") << "\n\n";
-  });
-  return mlir::failableParallelForEach(
-      op.getContext(), op.getOps<FModuleOp>(), [&](FModuleOp op) {
-        // Skip this module if it had no widths to be
-        // inferred at all.
-        if (mapping.isModuleSkipped(op))
-          return success();
-        auto isFailed = op.walk<WalkOrder::PreOrder>([&](Operation *op) {
-                            if (failed(updateOperation(op)))
-                              return WalkResult::interrupt();
-                            return WalkResult::advance();
-                          }).wasInterrupted();
-        return failure(isFailed);
-      });
+/// Update the types throughout a module.
+LogicalResult InferenceTypeUpdate::update(FModuleOp op) {
+  auto isFailed = op.walk<WalkOrder::PreOrder>([&](Operation *op) {
+                      if (failed(updateOperation(op)))
+                        return WalkResult::interrupt();
+                      return WalkResult::advance();
+                    }).wasInterrupted();
+  return failure(isFailed);
 }
 
 /// Update the result types of an operation.
@@ -2284,22 +2263,91 @@ class InferWidthsPass
 } // namespace
 
 void InferWidthsPass::runOnOperation() {
-  // Collect variables and constraints
-  ConstraintSolver solver;
-  InferenceMapping mapping(solver, getAnalysis<SymbolTable>(),
-                           getAnalysis<hw::InnerSymbolTableCollection>());
-  if (failed(mapping.map(getOperation())))
-    return signalPassFailure();
+  auto circuit = getOperation();
+  auto &instanceGraph = getAnalysis<InstanceGraph>();
+  auto &symtbl = getAnalysis<SymbolTable>();
+  auto &istc = getAnalysis<hw::InnerSymbolTableCollection>();
+
+  // Find the modules which have widths to infer. Fully inferred modules are
+  // skipped entirely.
+  SmallVector<FModuleOp> modules(circuit.getOps<FModuleOp>());
+  SmallVector<bool> uninferred(modules.size());
+  mlir::parallelFor(&getContext(), 0, modules.size(), [&](size_t i) {
+    uninferred[i] = hasUninferredWidths(modules[i]);
+  });
+
+  // Width constraints only cross module boundaries through the ports of
+  // instances. Split the modules into partitions connected by instances of
+  // modules with uninferred port widths; each partition is an independent
+  // constraint problem.
+  llvm::EquivalenceClasses<Operation *> classes;
+  for (auto [module, hasUninferred] : llvm::zip(modules, uninferred)) {
+    if (!hasUninferred) {
+      LLVM_DEBUG(llvm::dbgs() << "Skipping fully-inferred module '"
+                              << module.getName() << "'\n");
+      continue;
+    }
+    classes.insert(module);
+    for (auto *record : *instanceGraph.lookup(module)) {
+      auto child = dyn_cast<FModuleOp>(
+          record->getTarget()->getModule().getOperation());
+      if (child && hasUninferredPortWidths(child))
+        classes.unionSets(module, child);
+    }
+  }
+
+  SmallVector<SmallVector<FModuleOp>> partitions;
+  DenseMap<Operation *, unsigned> partitionIndices;
+  for (auto [module, hasUninferred] : llvm::zip(modules, uninferred)) {
+    if (!hasUninferred)
+      continue;
+    auto [it, inserted] = partitionIndices.try_emplace(
+        classes.getLeaderValue(module), partitions.size());
+    if (inserted)
+      partitions.emplace_back();
+    partitions[it->second].push_back(module);
+  }
 
   // fast path if no inferrable widths are around
-  if (mapping.areAllModulesSkipped())
+  if (partitions.empty())
     return markAllAnalysesPreserved();
 
-  // Solve the constraints.
-  if (failed(solver.solve()))
+  LLVM_DEBUG(llvm::dbgs() << "Inferring widths in " << partitions.size()
+                          << " independent partitions\n");
+
+  // Collect variables and constraints, and solve them, for each partition in
+  // parallel. All partitions are processed even if one fails, to report their
+  // errors deterministically.
+  SmallVector<std::unique_ptr<ConstraintSolver>> solvers;
+  SmallVector<std::unique_ptr<InferenceMapping>> mappings;
+  for (size_t i = 0, e = partitions.size(); i < e; ++i) {
+    solvers.push_back(std::make_unique<ConstraintSolver>());
+    mappings.push_back(
+        std::make_unique<InferenceMapping>(*solvers.back(), symtbl, istc));
+  }
+  std::atomic<bool> anyFailed = false;
+  mlir::parallelFor(&getContext(), 0, partitions.size(), [&](size_t i) {
+    if (failed(mappings[i]->map(partitions[i])) || failed(solvers[i]->solve()))
+      anyFailed = true;
+  });
+  if (anyFailed)
     return signalPassFailure();
 
   // Update the types with the inferred widths.
-  if (failed(InferenceTypeUpdate(mapping).update(getOperation())))
+  LLVM_DEBUG({
+    llvm::dbgs() << "\n";
+    debugHeader("Update types") << "\n\n";
+  });
+  SmallVector<std::pair<FModuleOp, InferenceMapping *>> updates;
+  for (auto [partition, mapping] : llvm::zip(partitions, mappings))
+    for (auto module : partition)
+      updates.emplace_back(module, mapping.get());
+  if (failed(mlir::failableParallelForEach(
+          &getContext(), updates, [](auto update) {
+            return InferenceTypeUpdate(*update.second).update(update.first);
+          })))
     return signalPassFailure();
+
+  // Only types change, the instances and modules are the same.
+  markAnalysesPreserved<InstanceGraph>();
 }
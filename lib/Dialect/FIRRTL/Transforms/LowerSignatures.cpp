@@ -16,6 +16,7 @@
 #include "circt/Dialect/FIRRTL/FIRRTLOps.h"
 #include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
 #include "circt/Dialect/FIRRTL/FIRRTLUtils.h"
+#include "circt/Dialect/FIRRTL/FieldLayoutCache.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Dialect/HW/HWAttributes.h"
 #include "circt/Support/Debug.h"
@@ -141,7 +142,8 @@ computeLoweringImpl(FModuleLike mod, PortConversion &newPorts, Convention conv,
                     size_t portID, const PortInfo &port, bool isFlip,
                     Twine name, FIRRTLType type, uint64_t fieldID,
                     const FieldIDSearch<hw::InnerSymAttr> &syms,
-                    const FieldIDSearch<AnnotationSet> &annos) {
+                    const FieldIDSearch<AnnotationSet> &annos,
+                    FieldLayoutCache &layouts) {
   auto *ctx = type.getContext();
   return FIRRTLTypeSwitch<FIRRTLType, LogicalResult>(type)
       .Case<BundleType>([&](BundleType bundle) -> LogicalResult {
@@ -159,11 +161,11 @@ computeLoweringImpl(FModuleLike mod, PortConversion &newPorts, Convention conv,
                newPorts.size(),
                fieldID});
         } else {
-          for (auto [idx, elem] : llvm::enumerate(bundle.getElements())) {
+          for (auto &field : layouts.getFields(bundle)) {
             if (failed(computeLoweringImpl(
-                    mod, newPorts, conv, portID, port, isFlip ^ elem.isFlip,
-                    name + "_" + elem.name.getValue(), elem.type,
-                    fieldID + bundle.getFieldID(idx), syms, annos)))
+                    mod, newPorts, conv, portID, port, isFlip ^ field.isFlip,
+                    name + field.suffix, field.type, fieldID + field.fieldID,
+                    syms, annos, layouts)))
               return failure();
             if (!syms.empty(fieldID, fieldID))
               return mod.emitError("Port [")
@@ -202,11 +204,11 @@ computeLoweringImpl(FModuleLike mod, PortConversion &newPorts, Convention conv,
                newPorts.size(),
                fieldID});
         } else {
-          for (size_t i = 0, e = vector.getNumElements(); i < e; ++i) {
+          for (auto &field : layouts.getFields(vector)) {
             if (failed(computeLoweringImpl(
                     mod, newPorts, conv, portID, port, isFlip,
-                    name + "_" + Twine(i), vector.getElementType(),
-                    fieldID + vector.getFieldID(i), syms, annos)))
+                    name + field.suffix, field.type, fieldID + field.fieldID,
+                    syms, annos, layouts)))
               return failure();
             if (!syms.empty(fieldID, fieldID))
               return mod.emitError("Port [")
@@ -248,13 +250,14 @@ computeLoweringImpl(FModuleLike mod, PortConversion &newPorts, Convention conv,
 // compute a new moduletype from an old module type and lowering convention.
 // Also compute a fieldID map from port, fieldID -> port
 static LogicalResult computeLowering(FModuleLike mod, Convention conv,
-                                     PortConversion &newPorts) {
+                                     PortConversion &newPorts,
+                                     FieldLayoutCache &layouts) {
   for (auto [idx, port] : llvm::enumerate(mod.getPorts())) {
     if (failed(computeLoweringImpl(
             mod, newPorts, conv, idx, port, port.direction == Direction::Out,
             port.name.getValue(), type_cast<FIRRTLType>(port.type), 0,
             FieldIDSearch<hw::InnerSymAttr>(port.sym),
-            FieldIDSearch<AnnotationSet>(port.annotations))))
+            FieldIDSearch<AnnotationSet>(port.annotations), layouts)))
       return failure();
   }
   return success();
@@ -262,9 +265,10 @@ static LogicalResult computeLowering(FModuleLike mod, Convention conv,
 
 static LogicalResult lowerModuleSignature(FModuleLike module, Convention conv,
                                           AttrCache &cache,
+                                          FieldLayoutCache &layouts,
                                           PortConversion &newPorts) {
   ImplicitLocOpBuilder theBuilder(module.getLoc(), module.getContext());
-  if (computeLowering(module, conv, newPorts).failed())
+  if (computeLowering(module, conv, newPorts, layouts).failed())
     return failure();
   if (auto mod = dyn_cast<FModuleOp>(module.getOperation())) {
     Block *body = mod.getBodyBlock();
@@ -460,12 +464,14 @@ void LowerSignaturesPass::runOnOperation() {
 
   // Cached attr
   AttrCache cache(&getContext());
+  // Cached fields of aggregate types
+  FieldLayoutCache layouts;
 
   DenseMap<StringAttr, PortConversion> portMap;
   auto circuit = getOperation();
 
   for (auto mod : circuit.getOps<FModuleLike>()) {
-    if (lowerModuleSignature(mod, mod.getConvention(), cache,
+    if (lowerModuleSignature(mod, mod.getConvention(), cache, layouts,
                              portMap[mod.getNameAttr()])
             .failed())
       return signalPassFailure();
@@ -32,6 +32,7 @@
 #include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
 #include "circt/Dialect/FIRRTL/FIRRTLUtils.h"
 #include "circt/Dialect/FIRRTL/FIRRTLVisitors.h"
+#include "circt/Dialect/FIRRTL/FieldLayoutCache.h"
 #include "circt/Dialect/FIRRTL/Passes.h"
 #include "circt/Dialect/HW/HWAttributes.h"
 #include "circt/Dialect/HW/HWOpInterfaces.h"
@@ -65,15 +66,15 @@ struct FlatBundleFieldEntry {
   size_t index;
   /// The fieldID
   unsigned fieldID;
-  /// This is a suffix to add to the field name to make it unique.
-  SmallString<16> suffix;
+  /// This is a suffix to add to the field name to make it unique.  It is owned
+  /// by the FieldLayoutCache the entry came from.
+  StringRef suffix;
   /// This indicates whether the field was flipped to be an output.
   bool isOutput;
 
-  FlatBundleFieldEntry(const FIRRTLBaseType &type, size_t index,
-                       unsigned fieldID, StringRef suffix, bool isOutput)
-      : type(type), index(index), fieldID(fieldID), suffix(suffix),
-        isOutput(isOutput) {}
+  FlatBundleFieldEntry(const FieldLayoutEntry &field)
+      : type(field.type), index(field.index), fieldID(field.fieldID),
+        suffix(field.suffix), isOutput(field.isFlip) {}
 
   void dump() const {
     llvm::errs() << "FBFE{" << type << " index<" << index << "> fieldID<"
@@ -161,7 +162,8 @@ static bool isPreservableAggregateType(Type type,
 /// Peel one layer of an aggregate type into its components.  Type may be
 /// complex, but empty, in which case fields is empty, but the return is true.
 static bool peelType(Type type, SmallVectorImpl<FlatBundleFieldEntry> &fields,
-                     PreserveAggregate::PreserveMode mode) {
+                     PreserveAggregate::PreserveMode mode,
+                     FieldLayoutCache &layouts) {
   // If the aggregate preservation is enabled and the type is preservable,
   // then just return.
   if (isPreservableAggregateType(type, mode))
@@ -169,30 +171,13 @@ static bool peelType(Type type, SmallVectorImpl<FlatBundleFieldEntry> &fields,
 
   if (auto refType = type_dyn_cast<RefType>(type))
     type = refType.getType();
-  return FIRRTLTypeSwitch<Type, bool>(type)
-      .Case<BundleType>([&](auto bundle) {
-        SmallString<16> tmpSuffix;
-        // Otherwise, we have a bundle type.  Break it down.
-        for (size_t i = 0, e = bundle.getNumElements(); i < e; ++i) {
-          auto elt = bundle.getElement(i);
-          // Construct the suffix to pass down.
-          tmpSuffix.resize(0);
-          tmpSuffix.push_back('_');
-          tmpSuffix.append(elt.name.getValue());
-          fields.emplace_back(elt.type, i, bundle.getFieldID(i), tmpSuffix,
-                              elt.isFlip);
-        }
-        return true;
-      })
-      .Case<FVectorType>([&](auto vector) {
-        // Increment the field ID to point to the first element.
-        for (size_t i = 0, e = vector.getNumElements(); i != e; ++i) {
-          fields.emplace_back(vector.getElementType(), i, vector.getFieldID(i),
-                              "_" + std::to_string(i), false);
-        }
-        return true;
-      })
-      .Default([](auto op) { return false; });
+  if (!type_isa<BundleType, FVectorType>(type))
+    return false;
+  // The fields of the same aggregate type are needed in every module which
+  // uses it, so they are shared by all the modules lowered in parallel.
+  auto layout = layouts.getFields(type_cast<FIRRTLBaseType>(type));
+  fields.append(layout.begin(), layout.end());
+  return true;
 }
 
 /// Return if something is not a normal subaccess.  Non-normal includes
@@ -330,11 +315,11 @@ struct TypeLoweringVisitor : public FIRRTLVisitor<TypeLoweringVisitor, bool> {
       MLIRContext *context, PreserveAggregate::PreserveMode preserveAggregate,
       Convention bodyConvention,
       PreserveAggregate::PreserveMode memoryPreservationMode,
-      SymbolTable &symTbl, const AttrCache &cache,
+      SymbolTable &symTbl, const AttrCache &cache, FieldLayoutCache &layouts,
       const llvm::DenseMap<FModuleLike, Convention> &conventionTable)
       : context(context), defaultAggregatePreservationMode(preserveAggregate),
         memoryPreservationMode(memoryPreservationMode), symTbl(symTbl),
-        cache(cache), conventionTable(conventionTable) {
+        cache(cache), layouts(layouts), conventionTable(conventionTable) {
     bodyAggregatePreservationMode = bodyConvention == Convention::Scalarized
                                         ? PreserveAggregate::None
                                         : defaultAggregatePreservationMode;
@@ -448,6 +433,9 @@ private:
   // Cache some attributes
   const AttrCache &cache;
 
+  // The fields of aggregate types, shared by all modules.
+  FieldLayoutCache &layouts;
+
   const llvm::DenseMap<FModuleLike, Convention> &conventionTable;
 
   // Set true if the lowering failed.
@@ -638,7 +626,7 @@ bool TypeLoweringVisitor::lowerProducer(
     return false;
   SmallVector<FlatBundleFieldEntry, 8> fieldTypes;
 
-  if (!peelType(srcFType, fieldTypes, bodyAggregatePreservationMode))
+  if (!peelType(srcFType, fieldTypes, bodyAggregatePreservationMode, layouts))
     return false;
 
   SmallVector<Value> lowered;
@@ -805,7 +793,8 @@ bool TypeLoweringVisitor::lowerArg(FModuleLike module, size_t argIndex,
   // Flatten any bundle types.
   SmallVector<FlatBundleFieldEntry> fieldTypes;
   auto srcType = type_cast<FIRRTLType>(newArgs[argIndex].type);
-  if (!peelType(srcType, fieldTypes, getPreservationModeForPorts(module)))
+  if (!peelType(srcType, fieldTypes, getPreservationModeForPorts(module),
+                layouts))
     return false;
 
   SmallVector<hw::InnerSymAttr> fieldSyms(fieldTypes.size());
@@ -875,7 +864,8 @@ bool TypeLoweringVisitor::visitStmt(ConnectOp op) {
   SmallVector<FlatBundleFieldEntry> fields;
 
   // We have to expand connections even if the aggregate preservation is true.
-  if (!peelType(op.getDest().getType(), fields, PreserveAggregate::None))
+  if (!peelType(op.getDest().getType(), fields, PreserveAggregate::None,
+                layouts))
     return false;
 
   // Loop over the leaf aggregates.
@@ -898,7 +888,8 @@ bool TypeLoweringVisitor::visitStmt(MatchingConnectOp op) {
   SmallVector<FlatBundleFieldEntry> fields;
 
   // We have to expand connections even if the aggregate preservation is true.
-  if (!peelType(op.getDest().getType(), fields, PreserveAggregate::None))
+  if (!peelType(op.getDest().getType(), fields, PreserveAggregate::None,
+                layouts))
     return false;
 
   // Loop over the leaf aggregates.
@@ -917,7 +908,8 @@ bool TypeLoweringVisitor::visitStmt(RefDefineOp op) {
   // Attempt to get the bundle types.
   SmallVector<FlatBundleFieldEntry> fields;
 
-  if (!peelType(op.getDest().getType(), fields, bodyAggregatePreservationMode))
+  if (!peelType(op.getDest().getType(), fields, bodyAggregatePreservationMode,
+                layouts))
     return false;
 
   // Loop over the leaf aggregates.
@@ -957,7 +949,7 @@ bool TypeLoweringVisitor::visitDecl(MemOp op) {
   SmallVector<FlatBundleFieldEntry> fields;
 
   // MemOp should have ground types so we can't preserve aggregates.
-  if (!peelType(op.getDataType(), fields, memoryPreservationMode))
+  if (!peelType(op.getDataType(), fields, memoryPreservationMode, layouts))
     return false;
 
   if (op.getInnerSym()) {
@@ -1337,7 +1329,8 @@ bool TypeLoweringVisitor::visitExpr(BitCastOp op) {
   // UInt type result. That is, first bitcast the aggregate type to a UInt.
   // Attempt to get the bundle types.
   SmallVector<FlatBundleFieldEntry> fields;
-  if (peelType(op.getInput().getType(), fields, PreserveAggregate::None)) {
+  if (peelType(op.getInput().getType(), fields, PreserveAggregate::None,
+               layouts)) {
     size_t uptoBits = 0;
     // Loop over the leaf aggregates and concat each of them to get a UInt.
     // Bitcast the fields to handle nested aggregate types.
@@ -1462,7 +1455,7 @@ bool TypeLoweringVisitor::visitDecl(InstanceOp op) {
 
     // Flatten any nested bundle types the usual way.
     SmallVector<FlatBundleFieldEntry, 8> fieldTypes;
-    if (!peelType(srcType, fieldTypes, mode)) {
+    if (!peelType(srcType, fieldTypes, mode, layouts)) {
       newDirs.push_back(op.getPortDirection(i));
       newNames.push_back(op.getPortNameAttr(i));
       newDomains.push_back(builder->getArrayAttr({}));
@@ -1646,6 +1639,8 @@ void LowerTypesPass::runOnOperation() {
   auto &symTbl = getAnalysis<SymbolTable>();
   // Cached attr
   AttrCache cache(&getContext());
+  // Cached fields of aggregate types
+  FieldLayoutCache layouts;
 
   DenseMap<FModuleLike, Convention> conventionTable;
   auto circuit = getOperation();
@@ -1662,9 +1657,9 @@ void LowerTypesPass::runOnOperation() {
             op->getDiscardableAttr("body_type_lowering")))
       convention = conventionAttr.getValue();
 
-    auto tl =
-        TypeLoweringVisitor(&getContext(), preserveAggregate, convention,
-                            preserveMemories, symTbl, cache, conventionTable);
+    auto tl = TypeLoweringVisitor(&getContext(), preserveAggregate, convention,
+                                  preserveMemories, symTbl, cache, layouts,
+                                  conventionTable);
     tl.lowerModule(op);
 
     return LogicalResult::failure(tl.isFailed());
@@ -434,7 +434,8 @@ LogicalResult firtool::populateExportSplitVerilog(mlir::PassManager &pm,
   if (failed(::detail::populatePrepareForExportVerilog(pm, opt)))
     return failure();
 
-  pm.addPass(createExportSplitVerilogPass(directory));
+  pm.addPass(
+      createExportSplitVerilogPass(directory, opt.shouldWriteIfChanged()));
   return success();
 }
 
@@ -771,6 +772,12 @@ struct FirtoolCmdOptions {
       "inline-input-only-modules", llvm::cl::desc("Inline input-only modules"),
       llvm::cl::init(false)};
 
+  llvm::cl::opt<bool> writeIfChanged{
+      "write-if-changed",
+      llvm::cl::desc("When emitting split Verilog, only write the files whose "
+                     "contents changed"),
+      llvm::cl::init(false)};
+
   //===----------------------------------------------------------------------===
   // Lint options
   //===----------------------------------------------------------------------===
@@ -823,7 +830,7 @@ circt::firtool::FirtoolOptions::FirtoolOptions()
       symbolicValueLowering(verif::SymbolicValueLowering::ExtModule),
       disableWireElimination(false), lintStaticAsserts(true),
       lintXmrsInDesign(true), emitAllBindFiles(false),
-      inlineInputOnlyModules(false) {
+      inlineInputOnlyModules(false), writeIfChanged(false) {
   if (!clOptions.isConstructed())
     return;
   outputFilename = clOptions->outputFilename;
@@ -877,4 +884,5 @@ circt::firtool::FirtoolOptions::FirtoolOptions()
   lintXmrsInDesign = clOptions->lintXmrsInDesign;
   emitAllBindFiles = clOptions->emitAllBindFiles;
   inlineInputOnlyModules = clOptions->inlineInputOnlyModules;
+  writeIfChanged = clOptions->writeIfChanged;
 }
@@ -0,0 +1,199 @@
+//===- PassReport.cpp - Per-pass resource report --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Firtool/PassReport.h"
+#include "circt/Analysis/OpCountAnalysis.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+
+#ifdef LLVM_ON_UNIX
+#include <sys/resource.h>
+#endif
+
+using namespace circt;
+using namespace firtool;
+
+//===----------------------------------------------------------------------===//
+// Budgets
+//===----------------------------------------------------------------------===//
+
+llvm::Expected<PassBudgets> firtool::parsePassBudgets(StringRef json) {
+  auto value = llvm::json::parse(json);
+  if (!value)
+    return value.takeError();
+
+  auto error = [](const Twine &message) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+  };
+  auto *passes = value->getAsObject();
+  if (!passes)
+    return error("pass budgets must be a JSON object");
+
+  PassBudgets budgets;
+  for (auto &[name, limits] : *passes) {
+    auto *object = limits.getAsObject();
+    if (!object)
+      return error("budget of pass '" + name + "' must be a JSON object");
+    PassBudget &budget = budgets[name];
+    for (auto &[key, limit] : *object) {
+      auto number = limit.getAsNumber();
+      if (!number || *number < 0)
+        return error("'" + key + "' of pass '" + name +
+                     "' must be a non-negative number");
+      if (key == "wall_time")
+        budget.wallTime = *number;
+      else if (key == "cpu_time")
+        budget.cpuTime = *number;
+      else if (key == "peak_rss_delta")
+        budget.peakRSSDelta = *number;
+      else
+        return error("unknown budget '" + key + "' for pass '" + name + "'");
+    }
+  }
+  return budgets;
+}
+
+//===----------------------------------------------------------------------===//
+// PassReportInstrumentation
+//===----------------------------------------------------------------------===//
+
+/// Get the peak resident set size of the process in bytes, or zero if it is
+/// not known on this platform.
+static uint64_t getPeakRSS() {
+#ifdef LLVM_ON_UNIX
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+/// Get the CPU time used by all threads of the process so far.
+static std::chrono::nanoseconds getCPUTime() {
+  llvm::sys::TimePoint<> elapsed;
+  std::chrono::nanoseconds user, sys;
+  llvm::sys::Process::GetTimeUsage(elapsed, user, sys);
+  return user + sys;
+}
+
+static size_t countOps(Operation *op) {
+  analysis::OpCountAnalysis counts(op);
+  size_t total = 0;
+  for (auto name : counts.getFoundOpNames())
+    total += counts.getOpCount(name);
+  return total;
+}
+
+void PassReportInstrumentation::runBeforePass(Pass *pass, Operation *op) {
+  if (!filter(op))
+    return;
+  // Count the ops first, so that it doesn't count against the pass.
+  size_t ops = countOps(op);
+  running.push_back(
+      {std::chrono::steady_clock::now(), getCPUTime(), getPeakRSS(), ops});
+}
+
+void PassReportInstrumentation::runAfterPass(Pass *pass, Operation *op) {
+  finishPass(pass, op, /*failed=*/false);
+}
+
+void PassReportInstrumentation::runAfterPassFailed(Pass *pass, Operation *op) {
+  finishPass(pass, op, /*failed=*/true);
+}
+
+void PassReportInstrumentation::finishPass(Pass *pass, Operation *op,
+                                           bool failed) {
+  if (!filter(op))
+    return;
+  auto wallTime = std::chrono::steady_clock::now();
+  auto cpuTime = getCPUTime();
+  auto peakRSS = getPeakRSS();
+  Start start = running.pop_back_val();
+
+  Record &record = records.emplace_back();
+  record.name = pass->getArgument().empty() ? pass->getName().str()
+                                            : pass->getArgument().str();
+  record.depth = running.size();
+  record.wallTime =
+      std::chrono::duration<double>(wallTime - start.wallTime).count();
+  record.cpuTime =
+      std::chrono::duration<double>(cpuTime - start.cpuTime).count();
+  record.peakRSSDelta = peakRSS - start.peakRSS;
+  record.opsBefore = start.ops;
+  record.opsAfter = countOps(op);
+  record.failed = failed;
+
+  // Don't count the time spent counting the ops against the enclosing passes.
+  auto countTime = std::chrono::steady_clock::now() - wallTime;
+  auto countCPUTime = getCPUTime() - cpuTime;
+  for (Start &outer : running) {
+    outer.wallTime += countTime;
+    outer.cpuTime += countCPUTime;
+  }
+}
+
+void PassReportInstrumentation::writeJSON(raw_ostream &os) const {
+  llvm::json::OStream json(os, /*IndentSize=*/2);
+  json.object([&] {
+    json.attributeArray("passes", [&] {
+      for (const Record &record : records) {
+        json.object([&] {
+          json.attribute("name", record.name);
+          json.attribute("depth", record.depth);
+          json.attribute("wall_time", record.wallTime);
+          json.attribute("cpu_time", record.cpuTime);
+          // The average number of threads busy while the pass ran.
+          json.attribute("parallelism", record.wallTime > 0
+                                            ? record.cpuTime / record.wallTime
+                                            : 0.0);
+          json.attribute("peak_rss_delta", record.peakRSSDelta);
+          json.attribute("ops_before", record.opsBefore);
+          json.attribute("ops_after", record.opsAfter);
+          if (record.failed)
+            json.attribute("failed", true);
+        });
+      }
+    });
+    json.attribute("peak_rss", getPeakRSS());
+  });
+  os << '\n';
+}
+
+LogicalResult
+PassReportInstrumentation::checkBudgets(const PassBudgets &budgets,
+                                        Operation *op) const {
+  bool exceeded = false;
+  auto check = [&](const Record &record, StringRef what, auto used,
+                   const auto &limit, StringRef unit) {
+    if (!limit || used <= *limit)
+      return;
+    op->emitError() << "pass '" << record.name << "' exceeded its " << what
+                    << " budget: used " << used << unit << ", budget is "
+                    << *limit << unit;
+    exceeded = true;
+  };
+  for (const Record &record : records) {
+    auto it = budgets.find(record.name);
+    if (it == budgets.end())
+      continue;
+    const PassBudget &budget = it->second;
+    check(record, "wall time", record.wallTime, budget.wallTime, "s");
+    check(record, "CPU time", record.cpuTime, budget.cpuTime, "s");
+    check(record, "peak RSS", record.peakRSSDelta, budget.peakRSSDelta,
+          " bytes");
+  }
+  return failure(exceeded);
+}
@@ -90,6 +90,10 @@ void circt::populateArcOptimizationPipeline(
     pm.addPass(arc::createMakeTablesPass());
   pm.addPass(createCSEPass());
   pm.addPass(arc::createArcCanonicalizerPass());
+  if (options.shouldSkipUnchanged) {
+    pm.addPass(arc::createSkipUnchangedStates());
+    pm.addPass(createCSEPass());
+  }
 
   // Now some arguments may be unused because reset conditions are not passed as
   // inputs anymore pm.addPass(arc::createRemoveUnusedArcArgumentsPass());
@@ -124,10 +128,18 @@ void circt::populateArcStateLoweringPipeline(
 
 void circt::populateArcStateAllocationPipeline(
     OpPassManager &pm, const ArcStateAllocationOptions &options) {
+  if (options.numLanes > 1)
+    pm.nest<arc::ModelOp>().addPass(arc::createBatchLanes({options.numLanes}));
   pm.addPass(arc::createLowerArcsToFuncsPass());
-  pm.nest<arc::ModelOp>().addPass(arc::createAllocateStatePass());
+  {
+    arc::AllocateStateOptions opts;
+    opts.dirtyFlags = options.dirtyFlags;
+    pm.nest<arc::ModelOp>().addPass(arc::createAllocateStatePass(opts));
+  }
   pm.addPass(arc::createLowerClocksToFuncsPass()); // no CSE between state alloc
                                                    // and clock func lowering
+  if (options.numEvalPartitions > 1)
+    pm.addPass(arc::createPartitionEval({options.numEvalPartitions}));
   if (options.splitFuncsThreshold.getNumOccurrences()) {
     pm.addPass(arc::createSplitFuncs({options.splitFuncsThreshold}));
   }
@@ -139,6 +139,33 @@ func.func @MemoryUpdates(%arg0: !arc.storage<24>, %enable: i1) {
 }
 // CHECK-NEXT: }
 
+// Accesses need no bounds check if every address is within the memory.
+
+// CHECK-LABEL: llvm.func @MemoryUpdatesInBounds(
+// CHECK-SAME:    %arg0: !llvm.ptr, %arg1: i1, %arg2: i2) {
+func.func @MemoryUpdatesInBounds(%arg0: !arc.storage<24>, %enable: i1, %addr: i2) {
+  %0 = arc.alloc_memory %arg0 {offset = 0, stride = 6} : (!arc.storage<24>) -> !arc.memory<4 x i42, i2>
+  // CHECK-NEXT: [[PTR:%.+]] = llvm.getelementptr %arg0[0]
+
+  %1 = arc.memory_read %0[%addr] : <4 x i42, i2>
+  // CHECK-NEXT: [[ADDR:%.+]] = llvm.zext %arg2 : i2 to i3
+  // CHECK-NEXT: [[GEP:%.+]] = llvm.getelementptr [[PTR]][[[ADDR]]] : (!llvm.ptr, i3) -> !llvm.ptr, i64
+  // CHECK-NEXT: [[LOADED:%.+]] = llvm.load [[GEP]] : !llvm.ptr -> i42
+
+  arc.memory_write %0[%addr], %1 : <4 x i42, i2>
+  // CHECK-NEXT: [[ADDR:%.+]] = llvm.zext %arg2 : i2 to i3
+  // CHECK-NEXT: [[GEP:%.+]] = llvm.getelementptr [[PTR]][[[ADDR]]] : (!llvm.ptr, i3) -> !llvm.ptr, i64
+  // CHECK-NEXT: llvm.store [[LOADED]], [[GEP]] : i42, !llvm.ptr
+
+  arc.memory_write %0[%addr], %1 if %enable : <4 x i42, i2>
+  // CHECK-NEXT: [[ADDR:%.+]] = llvm.zext %arg2 : i2 to i3
+  // CHECK-NEXT: [[GEP:%.+]] = llvm.getelementptr [[PTR]][[[ADDR]]] : (!llvm.ptr, i3) -> !llvm.ptr, i64
+  // CHECK-NEXT: llvm.cond_br %arg1, [[BB_STORE:\^.+]], [[BB_RESUME:\^.+]]
+  // CHECK-NEXT: [[BB_STORE]]:
+  // CHECK-NEXT: llvm.store [[LOADED]], [[GEP]] : i42, !llvm.ptr
+  return
+}
+
 // CHECK-LABEL: llvm.func @zeroCount(
 func.func @zeroCount(%arg0 : i32) {
   // CHECK-NEXT: "llvm.intr.ctlz"(%arg0) <{is_zero_poison = true}> : (i32) -> i32
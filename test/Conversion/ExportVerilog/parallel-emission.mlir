@@ -0,0 +1,102 @@
+// Check that emitting a design spread over several files in parallel produces
+// exactly the same output as emitting it serially. The design has more modules
+// than the window the workers may run ahead of the output, with binds, which
+// are emitted by the writer, interleaved with the other operations.
+
+// RUN: circt-opt %s --export-verilog --mlir-disable-threading -o /dev/null > %t.serial.sv
+// RUN: circt-opt %s --export-verilog -o /dev/null > %t.parallel.sv
+// RUN: diff %t.serial.sv %t.parallel.sv
+// RUN: FileCheck %s < %t.parallel.sv
+
+// CHECK-LABEL: FILE "a.sv"
+// CHECK:       module Leaf0(
+// CHECK:       module Leaf1(
+// CHECK:       module Leaf2(
+// CHECK:       module Leaf3(
+// CHECK-LABEL: FILE "b.sv"
+// CHECK:       module Mid0(
+// CHECK:       module Mid1(
+// CHECK:       module Mid2(
+// CHECK:       module Mid3(
+// CHECK-LABEL: FILE "binds.sv"
+// CHECK:       bind Top0 Checker checker_0 (
+// CHECK:       bind Top1 Checker checker_1 (
+// CHECK-LABEL: FILE "c.sv"
+// CHECK:       module Top0(
+// CHECK:       module Top1(
+// CHECK:       module Top2(
+// CHECK:       module Top3(
+
+#a = #hw.output_file<"a.sv">
+#b = #hw.output_file<"b.sv">
+#c = #hw.output_file<"c.sv">
+#binds = #hw.output_file<"binds.sv">
+
+hw.module @Leaf0(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #a} {
+  %0 = comb.add %a, %b : i8
+  hw.output %0 : i8
+}
+hw.module @Leaf1(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #a} {
+  %0 = comb.xor %a, %b : i8
+  hw.output %0 : i8
+}
+hw.module @Leaf2(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #a} {
+  %0 = comb.mul %a, %b : i8
+  hw.output %0 : i8
+}
+hw.module @Leaf3(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #a} {
+  %0 = comb.and %a, %b : i8
+  hw.output %0 : i8
+}
+
+hw.module @Mid0(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #b} {
+  %l0.y = hw.instance "l0" @Leaf0(a: %a: i8, b: %b: i8) -> (y: i8)
+  %l1.y = hw.instance "l1" @Leaf1(a: %l0.y: i8, b: %b: i8) -> (y: i8)
+  hw.output %l1.y : i8
+}
+hw.module @Mid1(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #b} {
+  %l2.y = hw.instance "l2" @Leaf2(a: %a: i8, b: %b: i8) -> (y: i8)
+  %l3.y = hw.instance "l3" @Leaf3(a: %l2.y: i8, b: %b: i8) -> (y: i8)
+  hw.output %l3.y : i8
+}
+hw.module @Mid2(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #b} {
+  %0 = comb.sub %a, %b : i8
+  %l0.y = hw.instance "l0" @Leaf0(a: %0: i8, b: %b: i8) -> (y: i8)
+  hw.output %l0.y : i8
+}
+hw.module @Mid3(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #b} {
+  %0 = comb.or %a, %b : i8
+  %l3.y = hw.instance "l3" @Leaf3(a: %0: i8, b: %a: i8) -> (y: i8)
+  hw.output %l3.y : i8
+}
+
+hw.module @Checker(in %a: i8, in %y: i8) attributes {output_file = #binds} {
+  hw.output
+}
+
+sv.bind #hw.innerNameRef<@Top0::@checker_0> {output_file = #binds}
+sv.bind #hw.innerNameRef<@Top1::@checker_1> {output_file = #binds}
+
+hw.module @Top0(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #c} {
+  %m0.y = hw.instance "m0" @Mid0(a: %a: i8, b: %b: i8) -> (y: i8)
+  %m1.y = hw.instance "m1" @Mid1(a: %m0.y: i8, b: %b: i8) -> (y: i8)
+  hw.instance "checker_0" sym @checker_0 @Checker(a: %a: i8, y: %m1.y: i8) -> () {doNotPrint}
+  hw.output %m1.y : i8
+}
+hw.module @Top1(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #c} {
+  %m2.y = hw.instance "m2" @Mid2(a: %a: i8, b: %b: i8) -> (y: i8)
+  %m3.y = hw.instance "m3" @Mid3(a: %m2.y: i8, b: %b: i8) -> (y: i8)
+  hw.instance "checker_1" sym @checker_1 @Checker(a: %a: i8, y: %m3.y: i8) -> () {doNotPrint}
+  hw.output %m3.y : i8
+}
+hw.module @Top2(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #c} {
+  %t0.y = hw.instance "t0" @Top0(a: %a: i8, b: %b: i8) -> (y: i8)
+  %t1.y = hw.instance "t1" @Top1(a: %t0.y: i8, b: %b: i8) -> (y: i8)
+  hw.output %t1.y : i8
+}
+hw.module @Top3(in %a: i8, in %b: i8, out y: i8) attributes {output_file = #c} {
+  %t2.y = hw.instance "t2" @Top2(a: %a: i8, b: %b: i8) -> (y: i8)
+  %0 = comb.shl %a, %b : i8
+  %t1.y = hw.instance "t1" @Top1(a: %0: i8, b: %t2.y: i8) -> (y: i8)
+  hw.output %t1.y : i8
+}
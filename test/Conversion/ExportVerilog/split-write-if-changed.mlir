@@ -0,0 +1,81 @@
+// Check that split emission with write-if-changed only rewrites the files whose
+// contents changed. Every run reads the same input path, so that locations are
+// stable. Before each rerun the outputs are backdated, so that the files which
+// were written again are the ones newer than a stamp file.
+
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: cp %s %t/in.mlir
+// RUN: circt-opt %t/in.mlir --export-split-verilog='dir-name=%t/out write-if-changed=true' -o %t/out.mlir
+// RUN: FileCheck %s --check-prefix=CHILD < %t/out/Child.sv
+// RUN: FileCheck %s --check-prefix=PARENT < %t/out/Parent.sv
+
+// CHILD-LABEL: module Child(
+// CHILD:         assign y = a ^ b;
+
+// PARENT-LABEL: module Parent(
+// PARENT:         Child c (
+// PARENT-NEXT:      .a (a),
+// PARENT-NEXT:      .b (b),
+// PARENT-NEXT:      .y ({{.+}})
+
+// Nothing changed, so no file is written.
+// RUN: touch -t 200001010000 %t/out/Child.sv %t/out/Parent.sv %t/out/Other.sv
+// RUN: touch -t 200101010000 %t/stamp
+// RUN: circt-opt %t/in.mlir --export-split-verilog='dir-name=%t/out write-if-changed=true' -o %t/out.mlir
+// RUN: find %t/out -name '*.sv' -newer %t/stamp | FileCheck %s --allow-empty --check-prefix=SAME
+
+// SAME-NOT: .sv
+
+// A change to the body of a module only affects its own file.
+// RUN: sed -e 's/comb.xor/comb.and/' %s > %t/in.mlir
+// RUN: touch -t 200001010000 %t/out/Child.sv %t/out/Parent.sv %t/out/Other.sv
+// RUN: circt-opt %t/in.mlir --export-split-verilog='dir-name=%t/out write-if-changed=true' -o %t/out.mlir
+// RUN: find %t/out -name '*.sv' -newer %t/stamp | FileCheck %s --check-prefix=BODY-FILES
+// RUN: FileCheck %s --check-prefix=BODY < %t/out/Child.sv
+
+// BODY-FILES-NOT: Parent.sv
+// BODY-FILES-NOT: Other.sv
+// BODY-FILES:     Child.sv
+// BODY-FILES-NOT: Parent.sv
+// BODY-FILES-NOT: Other.sv
+
+// BODY-LABEL: module Child(
+// BODY:         assign y = a & b;
+
+// A change to the interface of a module also affects its instantiations.
+// RUN: sed -e 's/comb.xor/comb.and/' -e 's/out y: i1/out z: i1/' -e 's/-> (y: i1)/-> (z: i1)/' %s > %t/in.mlir
+// RUN: touch -t 200001010000 %t/out/Child.sv %t/out/Parent.sv %t/out/Other.sv
+// RUN: circt-opt %t/in.mlir --export-split-verilog='dir-name=%t/out write-if-changed=true' -o %t/out.mlir
+// RUN: find %t/out -name '*.sv' -newer %t/stamp | sort | FileCheck %s --check-prefix=IFACE-FILES
+// RUN: FileCheck %s --check-prefix=IFACE < %t/out/Parent.sv
+
+// IFACE-FILES-NOT: Other.sv
+// IFACE-FILES:     Child.sv
+// IFACE-FILES-NEXT: Parent.sv
+// IFACE-FILES-NOT: Other.sv
+
+// IFACE-LABEL: module Parent(
+// IFACE:         Child c (
+// IFACE:           .z ({{.+}})
+
+// A file whose contents were changed behind our back is written again.
+// RUN: echo "// clobbered" > %t/out/Other.sv
+// RUN: circt-opt %t/in.mlir --export-split-verilog='dir-name=%t/out write-if-changed=true' -o %t/out.mlir
+// RUN: FileCheck %s --check-prefix=RESTORED < %t/out/Other.sv
+
+// RESTORED-NOT: clobbered
+// RESTORED:     module Other(
+
+hw.module @Child(in %a: i1, in %b: i1, out y: i1) {
+  %0 = comb.xor %a, %b : i1
+  hw.output %0 : i1
+}
+
+hw.module @Parent(in %a: i1, in %b: i1, out o: i1) {
+  %c.y = hw.instance "c" @Child(a: %a: i1, b: %b: i1) -> (y: i1)
+  hw.output %c.y : i1
+}
+
+hw.module @Other(in %a: i1, out b: i1) {
+  hw.output %a : i1
+}
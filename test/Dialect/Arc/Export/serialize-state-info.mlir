@@ -54,3 +54,40 @@ arc.model @Alpha io !hw.modty<> initializer @AlphaInitialize finalizer @AlphaFin
 
 func.func private @AlphaInitialize(!arc.storage<1>)
 func.func private @AlphaFinalize(!arc.storage<1>)
+
+// CHECK-LABEL: "name": "Beta"
+// CHECK:      "evalPartitions": [
+// CHECK-NEXT:   [
+// CHECK-NEXT:     "BetaPart0"
+// CHECK-NEXT:   ],
+// CHECK-NEXT:   [
+// CHECK-NEXT:     "BetaPart1",
+// CHECK-NEXT:     "BetaPart2"
+// CHECK-NEXT:   ]
+// CHECK-NEXT: ]
+arc.model @Beta io !hw.modty<> partitions [[@BetaPart0], [@BetaPart1, @BetaPart2]] {
+^bb0(%arg0: !arc.storage<1>):
+}
+
+func.func private @BetaPart0(!arc.storage<1>)
+func.func private @BetaPart1(!arc.storage<1>)
+func.func private @BetaPart2(!arc.storage<1>)
+
+// CHECK-LABEL: "name": "Gamma"
+arc.model @Gamma io !hw.modty<> {
+^bb0(%arg0: !arc.storage<16>):
+  // CHECK:      "name": "x"
+  // CHECK-NEXT: "offset": 0
+  // CHECK-NEXT: "numBits": 8
+  // CHECK-NEXT: "type": "register"
+  // CHECK-NEXT: "dirtyOffset": 9
+  arc.alloc_state %arg0 {name = "x", offset = 0, dirty_offset = 9} : (!arc.storage<16>) -> !arc.state<i8>
+
+  // CHECK:      "name": "y"
+  // CHECK-NEXT: "offset": 12
+  // CHECK-NEXT: "numBits": 8
+  // CHECK-NEXT: "type": "register"
+  // CHECK-NEXT: "dirtyOffset": 14
+  %0 = arc.alloc_storage %arg0[10] : (!arc.storage<16>) -> !arc.storage<5>
+  arc.alloc_state %0 {name = "y", offset = 2, dirty_offset = 4} : (!arc.storage<5>) -> !arc.state<i8>
+}
@@ -0,0 +1,59 @@
+// RUN: circt-opt %s --arc-allocate-state=dirty-flags | FileCheck %s
+
+// CHECK-LABEL: arc.model @Foo
+arc.model @Foo io !hw.modty<input a : i8, output b : i8> {
+^bb0(%arg0: !arc.storage):
+  // CHECK-NEXT: ^bb0(%arg0: !arc.storage<15>):
+  // CHECK-NEXT: arc.root_input "a", %arg0 {offset = 0 : i32}
+  // CHECK-NEXT: arc.root_output "b", %arg0 {dirty_offset = 12 : i32, offset = 1 : i32}
+  // CHECK-NEXT: arc.alloc_state %arg0 {dirty_offset = 13 : i32, name = "r", offset = 2 : i32}
+  // CHECK-NEXT: arc.alloc_state %arg0 {offset = 4 : i32}
+  // CHECK-NEXT: arc.alloc_memory %arg0 {dirty_offset = 14 : i32, name = "m", offset = 8 : i32, stride = 1 : i32}
+  %a = arc.root_input "a", %arg0 : (!arc.storage) -> !arc.state<i8>
+  %b = arc.root_output "b", %arg0 : (!arc.storage) -> !arc.state<i8>
+  %r = arc.alloc_state %arg0 {name = "r"} : (!arc.storage) -> !arc.state<i16>
+  %t = arc.alloc_state %arg0 : (!arc.storage) -> !arc.state<i8>
+  %m = arc.alloc_memory %arg0 {name = "m"} : (!arc.storage) -> !arc.memory<4 x i8, i2>
+
+  // CHECK-NEXT: [[A:%.+]] = arc.storage.get %arg0[0]
+  // CHECK-NEXT: [[V:%.+]] = arc.state_read [[A]]
+  // CHECK-NEXT: [[EN:%.+]] = comb.extract [[V]] from 0
+  // CHECK-NEXT: [[ADDR:%.+]] = comb.extract [[V]] from 1
+  %0 = arc.state_read %a : <i8>
+  %1 = comb.extract %0 from 0 : (i8) -> i1
+  %2 = comb.extract %0 from 1 : (i8) -> i2
+
+  // Unnamed states have no dirty flag.
+  // CHECK-NEXT: [[T:%.+]] = arc.storage.get %arg0[4]
+  // CHECK-NEXT: arc.state_write [[T]] = [[V]] : <i8>
+  arc.state_write %t = %0 : <i8>
+
+  // CHECK-NEXT: [[B:%.+]] = arc.storage.get %arg0[1]
+  // CHECK-NEXT: arc.state_write [[B]] = [[V]] : <i8>
+  // CHECK-NEXT: [[FLAG:%.+]] = arc.storage.get %arg0[12] : !arc.storage<15> -> !arc.state<i1>
+  // CHECK-NEXT: [[TRUE:%.+]] = hw.constant true
+  // CHECK-NEXT: arc.state_write [[FLAG]] = [[TRUE]] : <i1>
+  arc.state_write %b = %0 : <i8>
+
+  // CHECK-NEXT: [[TMP:%.+]] = comb.concat
+  // CHECK-NEXT: [[R:%.+]] = arc.storage.get %arg0[2]
+  // CHECK-NEXT: arc.state_write [[R]] = [[TMP]] if [[EN]] : <i16>
+  // CHECK-NEXT: [[FLAG:%.+]] = arc.storage.get %arg0[13] : !arc.storage<15> -> !arc.state<i1>
+  // CHECK-NEXT: [[TRUE:%.+]] = hw.constant true
+  // CHECK-NEXT: arc.state_write [[FLAG]] = [[TRUE]] if [[EN]] : <i1>
+  %3 = comb.concat %0, %0 : i8, i8
+  arc.state_write %r = %3 if %1 : <i16>
+
+  // CHECK-NEXT: [[M:%.+]] = arc.storage.get %arg0[8]
+  // CHECK-NEXT: arc.memory_write [[M]]{{\[}}[[ADDR]]{{\]}}, [[V]] if [[EN]]
+  // CHECK-NEXT: [[FLAG:%.+]] = arc.storage.get %arg0[14] : !arc.storage<15> -> !arc.state<i1>
+  // CHECK-NEXT: [[TRUE:%.+]] = hw.constant true
+  // CHECK-NEXT: arc.state_write [[FLAG]] = [[TRUE]] if [[EN]] : <i1>
+  arc.memory_write %m[%2], %0 if %1 : <4 x i8, i2>
+
+  // Reads do not set the flag.
+  // CHECK-NEXT: [[R:%.+]] = arc.storage.get %arg0[2]
+  // CHECK-NEXT: arc.state_read [[R]]
+  // CHECK-NEXT: }
+  %4 = arc.state_read %r : <i16>
+}
@@ -585,6 +585,26 @@ func.func @Bar(!arc.storage<24>) {
 
 // -----
 
+// expected-error @below {{partition 'Bar' does not reference a valid function}}
+arc.model @Foo io !hw.modty<> partitions [[@Bar]] {
+^bb0(%arg0: !arc.storage<42>):
+}
+
+// -----
+
+// expected-error @below {{partition 'Bar' must take the model arguments and return nothing}}
+arc.model @Foo io !hw.modty<> partitions [[@Bar]] {
+^bb0(%arg0: !arc.storage<42>):
+}
+
+// expected-note @below {{partition declared here:}}
+func.func @Bar(!arc.storage<24>) {
+^bb0(%arg0: !arc.storage<24>):
+  return
+}
+
+// -----
+
 hw.module @InvalidInitType(in %clock: !seq.clock, in %input: i7) {
   %cst = hw.constant 0 : i8
   // expected-error @below {{failed to verify that types of initial arguments match result types}}
@@ -0,0 +1,121 @@
+// RUN: circt-opt %s --arc-batch-lanes=lanes=4 | FileCheck %s
+
+// CHECK-LABEL: arc.model @Foo io !hw.modty<input a : i8, output b : i8> lanes 4 {
+arc.model @Foo io !hw.modty<input a : i8, output b : i8> {
+^bb0(%arg0: !arc.storage):
+  // CHECK-DAG: [[A:%.+]] = arc.alloc_memory %arg0 {lane_state = "input", name = "a"} : (!arc.storage) -> !arc.memory<4 x i8, i2>
+  // CHECK-DAG: [[B:%.+]] = arc.alloc_memory %arg0 {lane_state = "output", name = "b"} : (!arc.storage) -> !arc.memory<4 x i8, i2>
+  // CHECK-DAG: [[R:%.+]] = arc.alloc_memory %arg0 {lane_state = "register", name = "r"} : (!arc.storage) -> !arc.memory<4 x i8, i2>
+  // CHECK-DAG: [[W:%.+]] = arc.alloc_memory %arg0 {lane_state = "wire", names = ["w"]} : (!arc.storage) -> !arc.memory<4 x i8, i2>
+  // CHECK-DAG: [[M:%.+]] = arc.alloc_memory %arg0 {name = "m"} : (!arc.storage) -> !arc.memory<16 x i8, i4>
+  %a = arc.root_input "a", %arg0 : (!arc.storage) -> !arc.state<i8>
+  %b = arc.root_output "b", %arg0 : (!arc.storage) -> !arc.state<i8>
+  %r = arc.alloc_state %arg0 {name = "r"} : (!arc.storage) -> !arc.state<i8>
+  %w = arc.alloc_state %arg0 tap {names = ["w"]} : (!arc.storage) -> !arc.state<i8>
+  %m = arc.alloc_memory %arg0 {name = "m"} : (!arc.storage) -> !arc.memory<4 x i8, i2>
+
+  // CHECK: scf.for [[I:%.+]] = %c0 to %c4 step %c1 {
+  // CHECK-NEXT: [[LANE:%.+]] = arith.index_castui [[I]] : index to i2
+  // CHECK-NEXT: [[V:%.+]] = arc.memory_read [[A]]{{\[}}[[LANE]]{{\]}} : <4 x i8, i2>
+  // CHECK-NEXT: [[ADDR:%.+]] = comb.extract [[V]] from 0
+  // CHECK-NEXT: [[EN:%.+]] = comb.extract [[V]] from 2
+  %0 = arc.state_read %a : <i8>
+  %1 = comb.extract %0 from 0 : (i8) -> i2
+  %2 = comb.extract %0 from 2 : (i8) -> i1
+
+  // Conditional writes select between the new and the old value.
+  // CHECK-NEXT: [[OLD:%.+]] = arc.memory_read [[R]]{{\[}}[[LANE]]{{\]}}
+  // CHECK-NEXT: [[NEW:%.+]] = comb.mux bin [[EN]], [[V]], [[OLD]] : i8
+  // CHECK-NEXT: arc.memory_write [[R]]{{\[}}[[LANE]]{{\]}}, [[NEW]] : <4 x i8, i2>
+  arc.state_write %r = %0 if %2 : <i8>
+  // CHECK-NEXT: [[RV:%.+]] = arc.memory_read [[R]]{{\[}}[[LANE]]{{\]}}
+  // CHECK-NEXT: arc.memory_write [[W]]{{\[}}[[LANE]]{{\]}}, [[RV]] : <4 x i8, i2>
+  %3 = arc.state_read %r : <i8>
+  arc.state_write %w = %3 : <i8>
+
+  // Memory addresses interleave the lanes.
+  // CHECK-NEXT: [[ZERO:%.+]] = hw.constant 0 : i2
+  // CHECK-NEXT: [[TMP1:%.+]] = comb.concat [[ZERO]], [[ADDR]] : i2, i2
+  // CHECK-NEXT: [[FOUR:%.+]] = hw.constant 4 : i4
+  // CHECK-NEXT: [[TMP2:%.+]] = comb.mul [[TMP1]], [[FOUR]] : i4
+  // CHECK-NEXT: [[ZERO:%.+]] = hw.constant 0 : i2
+  // CHECK-NEXT: [[TMP3:%.+]] = comb.concat [[ZERO]], [[LANE]] : i2, i2
+  // CHECK-NEXT: [[IDX:%.+]] = comb.add [[TMP2]], [[TMP3]] : i4
+  // CHECK-NEXT: [[MV:%.+]] = arc.memory_read [[M]]{{\[}}[[IDX]]{{\]}} : <16 x i8, i4>
+  // CHECK-NEXT: arc.memory_write [[B]]{{\[}}[[LANE]]{{\]}}, [[MV]] : <4 x i8, i2>
+  // CHECK-NEXT: }
+  %4 = arc.memory_read %m[%1] : <4 x i8, i2>
+  arc.state_write %b = %4 : <i8>
+}
+
+// Non-integer states are bitcast to and from the memory word type.
+
+// CHECK-LABEL: arc.model @Bar io !hw.modty<> lanes 4 {
+arc.model @Bar io !hw.modty<> {
+^bb0(%arg0: !arc.storage):
+  // CHECK: [[S:%.+]] = arc.alloc_memory %arg0 {lane_state = "register"} : (!arc.storage) -> !arc.memory<4 x i8, i2>
+  %s = arc.alloc_state %arg0 : (!arc.storage) -> !arc.state<!hw.array<2xi4>>
+  // CHECK: scf.for
+  // CHECK-NEXT: [[LANE:%.+]] = arith.index_castui
+  // CHECK-NEXT: [[TMP1:%.+]] = arc.memory_read [[S]]{{\[}}[[LANE]]{{\]}}
+  // CHECK-NEXT: [[TMP2:%.+]] = hw.bitcast [[TMP1]] : (i8) -> !hw.array<2xi4>
+  // CHECK-NEXT: [[TMP3:%.+]] = hw.bitcast [[TMP2]] : (!hw.array<2xi4>) -> i8
+  // CHECK-NEXT: arc.memory_write [[S]]{{\[}}[[LANE]]{{\]}}, [[TMP3]]
+  %0 = arc.state_read %s : <!hw.array<2xi4>>
+  arc.state_write %s = %0 : <!hw.array<2xi4>>
+}
+
+// Ifs within the lane loop are turned into straight-line code, with writes
+// predicated on the condition. Ifs with side effects that cannot be predicated
+// are kept.
+
+func.func private @Effect()
+
+// CHECK-LABEL: arc.model @Ifs io !hw.modty<input a : i8> lanes 4 {
+arc.model @Ifs io !hw.modty<input a : i8> {
+^bb0(%arg0: !arc.storage):
+  // CHECK-DAG: [[A:%.+]] = arc.alloc_memory %arg0 {lane_state = "input", name = "a"}
+  // CHECK-DAG: [[R:%.+]] = arc.alloc_memory %arg0 {lane_state = "register", name = "r"}
+  // CHECK-DAG: [[M:%.+]] = arc.alloc_memory %arg0 {name = "m"} : (!arc.storage) -> !arc.memory<16 x i8, i4>
+  %a = arc.root_input "a", %arg0 : (!arc.storage) -> !arc.state<i8>
+  %r = arc.alloc_state %arg0 {name = "r"} : (!arc.storage) -> !arc.state<i8>
+  %m = arc.alloc_memory %arg0 {name = "m"} : (!arc.storage) -> !arc.memory<4 x i8, i2>
+
+  // CHECK: scf.for
+  // CHECK-NEXT: [[LANE:%.+]] = arith.index_castui
+  // CHECK-NEXT: [[V:%.+]] = arc.memory_read [[A]]{{\[}}[[LANE]]{{\]}}
+  // CHECK-NEXT: [[C:%.+]] = comb.extract [[V]] from 0
+  // CHECK-NEXT: [[ADDR:%.+]] = comb.extract [[V]] from 1
+  %0 = arc.state_read %a : <i8>
+  %1 = comb.extract %0 from 0 : (i8) -> i1
+  %2 = comb.extract %0 from 1 : (i8) -> i2
+
+  // CHECK-NOT: scf.if
+  // CHECK:      [[NOTC:%.+]] = comb.xor bin [[C]], %true
+  // CHECK-NEXT: [[ADD:%.+]] = comb.add [[V]], [[V]]
+  // CHECK-NEXT: [[OLD:%.+]] = arc.memory_read [[R]]{{\[}}[[LANE]]{{\]}}
+  // CHECK-NEXT: [[NEW:%.+]] = comb.mux bin [[C]], [[ADD]], [[OLD]] : i8
+  // CHECK-NEXT: arc.memory_write [[R]]{{\[}}[[LANE]]{{\]}}, [[NEW]] : <4 x i8, i2>
+  // CHECK:      [[IDX:%.+]] = comb.add
+  // CHECK-NEXT: [[OLD:%.+]] = arc.memory_read [[M]]{{\[}}[[IDX]]{{\]}}
+  // CHECK-NEXT: [[NEW:%.+]] = comb.mux bin [[NOTC]], [[V]], [[OLD]] : i8
+  // CHECK-NEXT: arc.memory_write [[M]]{{\[}}[[IDX]]{{\]}}, [[NEW]] : <16 x i8, i4>
+  // CHECK-NEXT: [[SEL:%.+]] = comb.mux bin [[C]], [[ADD]], [[V]] : i8
+  // CHECK-NEXT: scf.if [[C]] {
+  // CHECK-NEXT:   func.call @Effect()
+  // CHECK-NEXT: }
+  // CHECK-NEXT: arc.memory_write [[R]]{{\[}}[[LANE]]{{\]}}, [[SEL]] : <4 x i8, i2>
+  // CHECK-NEXT: }
+  %3 = scf.if %1 -> i8 {
+    %4 = comb.add %0, %0 : i8
+    arc.state_write %r = %4 : <i8>
+    scf.yield %4 : i8
+  } else {
+    arc.memory_write %m[%2], %0 : <4 x i8, i2>
+    scf.yield %0 : i8
+  }
+  scf.if %1 {
+    func.call @Effect() : () -> ()
+  }
+  arc.state_write %r = %3 : <i8>
+}
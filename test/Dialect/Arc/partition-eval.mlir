@@ -0,0 +1,90 @@
+// RUN: circt-opt %s --arc-partition-eval=num-partitions=2 | FileCheck %s
+
+// CHECK-LABEL: func.func @Foo_eval_part0(%arg0: !arc.storage<65>) {
+// CHECK-DAG:     [[CLK:%.+]] = arc.storage.get %arg0[0] : !arc.storage<65> -> !arc.state<i1>
+// CHECK-DAG:     [[OLD:%.+]] = arc.storage.get %arg0[1] : !arc.storage<65> -> !arc.state<i1>
+// CHECK:         [[TMP1:%.+]] = arc.state_read [[CLK]]
+// CHECK:         [[TMP2:%.+]] = arc.state_read [[OLD]]
+// CHECK:         arc.state_write [[OLD]] = [[TMP1]]
+// CHECK:         [[TMP3:%.+]] = comb.xor [[TMP2]]
+// CHECK:         [[EDGE:%.+]] = comb.and [[TMP1]], [[TMP3]]
+// CHECK-NEXT:    [[SPILL:%.+]] = arc.storage.get %arg0[64] : !arc.storage<65> -> !arc.state<i1>
+// CHECK-NEXT:    arc.state_write [[SPILL]] = [[EDGE]]
+// CHECK-NEXT:    return
+// CHECK-NEXT:  }
+
+// CHECK-LABEL: func.func @Foo_eval_part1(%arg0: !arc.storage<65>) {
+// CHECK:         [[SPILL:%.+]] = arc.storage.get %arg0[64]
+// CHECK-NEXT:    [[EDGE:%.+]] = arc.state_read [[SPILL]]
+// CHECK-NEXT:    scf.if [[EDGE]] {
+// CHECK:           arc.state_write {{%.+}} = {{%.+}} {a} :
+// CHECK:         }
+// CHECK:         arc.state_write {{%.+}} = {{%.+}} {x} :
+// CHECK-NEXT:    return
+// CHECK-NEXT:  }
+
+// CHECK-LABEL: func.func @Foo_eval_part2(%arg0: !arc.storage<65>) {
+// CHECK:         [[SPILL:%.+]] = arc.storage.get %arg0[64]
+// CHECK-NEXT:    [[EDGE:%.+]] = arc.state_read [[SPILL]]
+// CHECK-NEXT:    scf.if [[EDGE]] {
+// CHECK:           arc.state_write {{%.+}} = {{%.+}} {b} :
+// CHECK:         }
+// CHECK:         arc.state_write {{%.+}} = {{%.+}} {y} :
+// CHECK-NEXT:    return
+// CHECK-NEXT:  }
+
+// CHECK-LABEL: arc.model @Foo
+// CHECK-SAME:    partitions {{\[}}[@Foo_eval_part0], [@Foo_eval_part1, @Foo_eval_part2]]
+// CHECK-NEXT:  ^bb0(%arg0: !arc.storage<65>):
+// CHECK-NEXT:    call @Foo_eval_part0(%arg0)
+// CHECK-NEXT:    call @Foo_eval_part1(%arg0)
+// CHECK-NEXT:    call @Foo_eval_part2(%arg0)
+// CHECK-NEXT:  }
+arc.model @Foo io !hw.modty<> {
+^bb0(%arg0: !arc.storage<8>):
+  %true = hw.constant true
+  %clk = arc.storage.get %arg0[0] : !arc.storage<8> -> !arc.state<i1>
+  %old = arc.storage.get %arg0[1] : !arc.storage<8> -> !arc.state<i1>
+  %a = arc.storage.get %arg0[2] : !arc.storage<8> -> !arc.state<i1>
+  %b = arc.storage.get %arg0[3] : !arc.storage<8> -> !arc.state<i1>
+  %ra = arc.storage.get %arg0[4] : !arc.storage<8> -> !arc.state<i1>
+  %rb = arc.storage.get %arg0[5] : !arc.storage<8> -> !arc.state<i1>
+  %x = arc.storage.get %arg0[6] : !arc.storage<8> -> !arc.state<i1>
+  %y = arc.storage.get %arg0[7] : !arc.storage<8> -> !arc.state<i1>
+  %0 = arc.state_read %clk : <i1>
+  %1 = arc.state_read %old : <i1>
+  arc.state_write %old = %0 : <i1>
+  %2 = comb.xor %1, %true : i1
+  %3 = comb.and %0, %2 : i1
+  scf.if %3 {
+    %4 = arc.state_read %a : <i1>
+    arc.state_write %ra = %4 {a} : <i1>
+  }
+  scf.if %3 {
+    %4 = arc.state_read %b : <i1>
+    arc.state_write %rb = %4 {b} : <i1>
+  }
+  %5 = arc.state_read %ra : <i1>
+  arc.state_write %x = %5 {x} : <i1>
+  %6 = arc.state_read %rb : <i1>
+  arc.state_write %y = %6 {y} : <i1>
+}
+
+// Models with only a single group of operations are left untouched.
+
+// CHECK-LABEL: arc.model @Bar io !hw.modty<> {
+// CHECK-NEXT:  ^bb0(%arg0: !arc.storage<2>):
+// CHECK-NEXT:    hw.constant
+// CHECK-NEXT:    arc.storage.get
+// CHECK-NEXT:    arc.state_read
+// CHECK-NEXT:    comb.xor
+// CHECK-NEXT:    arc.state_write
+// CHECK-NEXT:  }
+arc.model @Bar io !hw.modty<> {
+^bb0(%arg0: !arc.storage<2>):
+  %true = hw.constant true
+  %0 = arc.storage.get %arg0[0] : !arc.storage<2> -> !arc.state<i1>
+  %1 = arc.state_read %0 : <i1>
+  %2 = comb.xor %1, %true : i1
+  arc.state_write %0 = %2 : <i1>
+}
@@ -0,0 +1,49 @@
+// RUN: circt-opt %s --arc-skip-unchanged-states=min-arc-ops=2 | FileCheck %s
+
+// CHECK-LABEL: arc.define @Large_inputs(%arg0: i4, %arg1: !hw.array<2xi2>) -> (i1, i4, !hw.array<2xi2>) {
+// CHECK-NEXT:    [[TRUE:%.+]] = hw.constant true
+// CHECK-NEXT:    arc.output [[TRUE]], %arg0, %arg1 : i1, i4, !hw.array<2xi2>
+// CHECK-NEXT:  }
+// CHECK-LABEL: arc.define @Large(
+arc.define @Large(%arg0: i4, %arg1: !hw.array<2xi2>) -> i4 {
+  %0 = hw.bitcast %arg1 : (!hw.array<2xi2>) -> i4
+  %1 = comb.add %arg0, %0 : i4
+  %2 = comb.mul %1, %arg0 : i4
+  arc.output %2 : i4
+}
+
+// CHECK-NOT: arc.define @Small_inputs
+// CHECK-LABEL: arc.define @Small(
+arc.define @Small(%arg0: i4) -> i4 {
+  arc.output %arg0 : i4
+}
+
+// CHECK-LABEL: hw.module @Foo
+hw.module @Foo(in %clk: !seq.clock, in %en: i1, in %rst: i1, in %a: i4, in %b: !hw.array<2xi2>) {
+  // CHECK-NEXT: [[G:%.+]]:3 = arc.state @Large_inputs(%a, %b) clock %clk enable [[EN:%.+]] reset %rst latency 1
+  // CHECK-NEXT: [[TRUE:%.+]] = hw.constant true
+  // CHECK-NEXT: [[INVALID:%.+]] = comb.xor bin [[G]]#0, [[TRUE]] : i1
+  // CHECK-NEXT: [[NE0:%.+]] = comb.icmp bin ne %a, [[G]]#1 : i4
+  // CHECK-NEXT: [[B0:%.+]] = hw.bitcast %b : (!hw.array<2xi2>) -> i4
+  // CHECK-NEXT: [[B1:%.+]] = hw.bitcast [[G]]#2 : (!hw.array<2xi2>) -> i4
+  // CHECK-NEXT: [[NE1:%.+]] = comb.icmp bin ne [[B0]], [[B1]] : i4
+  // CHECK-NEXT: [[CHANGED:%.+]] = comb.or bin [[INVALID]], [[NE0]], [[NE1]] : i1
+  // CHECK-NEXT: [[EN]] = comb.and bin %en, [[CHANGED]] : i1
+  // CHECK-NEXT: arc.state @Large(%a, %b) clock %clk enable [[EN]] reset %rst latency 1
+  %0 = arc.state @Large(%a, %b) clock %clk enable %en reset %rst latency 1 : (i4, !hw.array<2xi2>) -> i4
+
+  // Arcs below the size threshold are not guarded.
+  // CHECK-NEXT: arc.state @Small(%a) clock %clk latency 1
+  %1 = arc.state @Small(%a) clock %clk latency 1 : (i4) -> i4
+
+  // States feeding back into themselves are not guarded.
+  // CHECK-NEXT: [[FB:%.+]] = arc.state @Large([[FB]], %b) clock %clk latency 1
+  %2 = arc.state @Large(%2, %b) clock %clk latency 1 : (i4, !hw.array<2xi2>) -> i4
+
+  // Combinational uses of arcs are not guarded.
+  // CHECK-NEXT: arc.call @Large(%a, %b)
+  %3 = arc.call @Large(%a, %b) : (i4, !hw.array<2xi2>) -> i4
+
+  // CHECK-NEXT: hw.output
+  hw.output
+}
@@ -949,3 +949,40 @@ firrtl.circuit "DPICycle" {
       firrtl.matchingconnect %out, %bar : !firrtl.uint<1>
     }
   }
+
+// -----
+
+// Values may cross instance boundaries several times, here from one instance
+// through the parent into the others.
+// CHECK-LABEL: firrtl.circuit "Rounds"
+firrtl.circuit "Rounds" {
+  firrtl.module private @RoundsSource(out %out: !firrtl.uint<4>) {
+    %c5_ui4 = firrtl.constant 5 : !firrtl.uint<4>
+    firrtl.matchingconnect %out, %c5_ui4 : !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module private @RoundsSink
+  firrtl.module private @RoundsSink(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>) {
+    // CHECK-NEXT: %c5_ui4 = firrtl.constant 5 : !firrtl.uint<4>
+    // CHECK-NEXT: firrtl.matchingconnect %out, %c5_ui4
+    firrtl.matchingconnect %out, %in : !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module private @RoundsMixed
+  firrtl.module private @RoundsMixed(in %in: !firrtl.uint<4>, out %out: !firrtl.uint<4>) {
+    // CHECK-NEXT: firrtl.matchingconnect %out, %in
+    firrtl.matchingconnect %out, %in : !firrtl.uint<4>
+  }
+  // CHECK-LABEL: firrtl.module @Rounds
+  firrtl.module @Rounds(in %x: !firrtl.uint<4>, out %a: !firrtl.uint<4>, out %b: !firrtl.uint<4>) {
+    %source_out = firrtl.instance source @RoundsSource(out out: !firrtl.uint<4>)
+    %sink_in, %sink_out = firrtl.instance sink @RoundsSink(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    %mixed0_in, %mixed0_out = firrtl.instance mixed0 @RoundsMixed(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    %mixed1_in, %mixed1_out = firrtl.instance mixed1 @RoundsMixed(in in: !firrtl.uint<4>, out out: !firrtl.uint<4>)
+    firrtl.matchingconnect %sink_in, %source_out : !firrtl.uint<4>
+    firrtl.matchingconnect %mixed0_in, %sink_out : !firrtl.uint<4>
+    firrtl.matchingconnect %mixed1_in, %x : !firrtl.uint<4>
+    // CHECK: firrtl.matchingconnect %a, %c5_ui4
+    firrtl.matchingconnect %a, %sink_out : !firrtl.uint<4>
+    // CHECK: firrtl.matchingconnect %b, %mixed0_out
+    firrtl.matchingconnect %b, %mixed0_out : !firrtl.uint<4>
+  }
+}
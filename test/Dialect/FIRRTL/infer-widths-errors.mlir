@@ -182,3 +182,21 @@ firrtl.circuit "MuxSelTooWide" {
     firrtl.connect %0, %c2_ui2 : !firrtl.uint, !firrtl.uint<2>
   }
 }
+
+// -----
+
+// Independent partitions report their errors even if another one failed.
+firrtl.circuit "Foo" {
+  firrtl.module @Foo(in %clk: !firrtl.clock) {
+    // expected-error @+1 {{'firrtl.reg' op is constrained to be wider than itself}}
+    %0 = firrtl.reg %clk : !firrtl.clock, !firrtl.uint
+    // expected-note @+1 {{constrained width W >= W+1 here}}
+    %1 = firrtl.add %0, %0 : (!firrtl.uint, !firrtl.uint) -> !firrtl.uint
+    // expected-note @+1 {{constrained width W >= W+1 here}}
+    firrtl.connect %0, %1 : !firrtl.uint, !firrtl.uint
+  }
+  firrtl.module @Bar() {
+    // expected-error @+1 {{uninferred width: wire is unconstrained}}
+    %w = firrtl.wire : !firrtl.uint
+  }
+}
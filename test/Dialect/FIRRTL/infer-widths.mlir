@@ -1003,4 +1003,37 @@ firrtl.circuit "Foo" {
   firrtl.module private @NullaryCat() {
     %0 = firrtl.cat : () -> !firrtl.uint<0>
   }
+
+  // Modules are solved in partitions connected by instances of modules with
+  // uninferred port widths. A module with inferred ports ends a partition.
+  // CHECK-LABEL: module private @PartitionLeaf(
+  // CHECK-SAME: in %in: !firrtl.uint<3>
+  // CHECK-SAME: out %out: !firrtl.uint<3>
+  firrtl.module private @PartitionLeaf(in %in: !firrtl.uint,
+                                       out %out: !firrtl.uint) {
+    firrtl.connect %out, %in : !firrtl.uint, !firrtl.uint
+  }
+  // CHECK-LABEL: module private @PartitionMid(
+  // CHECK: %w = firrtl.wire : !firrtl.uint<3>
+  // CHECK: firrtl.instance leaf @PartitionLeaf(in in: !firrtl.uint<3>, out out: !firrtl.uint<3>)
+  firrtl.module private @PartitionMid(in %in: !firrtl.uint<3>,
+                                      out %out: !firrtl.uint<3>) {
+    %w = firrtl.wire : !firrtl.uint
+    firrtl.connect %w, %in : !firrtl.uint, !firrtl.uint<3>
+    %leaf_in, %leaf_out = firrtl.instance leaf @PartitionLeaf(in in: !firrtl.uint, out out: !firrtl.uint)
+    firrtl.connect %leaf_in, %w : !firrtl.uint, !firrtl.uint
+    firrtl.connect %out, %leaf_out : !firrtl.uint<3>, !firrtl.uint
+  }
+  // CHECK-LABEL: module private @PartitionTop(
+  // CHECK: firrtl.instance mid @PartitionMid(in in: !firrtl.uint<3>, out out: !firrtl.uint<3>)
+  // CHECK: %w = firrtl.wire : !firrtl.uint<4>
+  firrtl.module private @PartitionTop(in %in: !firrtl.uint<3>,
+                                      out %out: !firrtl.uint<3>) {
+    %mid_in, %mid_out = firrtl.instance mid @PartitionMid(in in: !firrtl.uint<3>, out out: !firrtl.uint<3>)
+    firrtl.connect %mid_in, %in : !firrtl.uint<3>, !firrtl.uint<3>
+    firrtl.connect %out, %mid_out : !firrtl.uint<3>, !firrtl.uint<3>
+    %c = firrtl.constant 9 : !firrtl.uint<4>
+    %w = firrtl.wire : !firrtl.uint
+    firrtl.connect %w, %c : !firrtl.uint, !firrtl.uint<4>
+  }
 }
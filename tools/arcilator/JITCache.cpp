@@ -0,0 +1,349 @@
+//===- JITCache.cpp - On-disk cache for arcilator JIT compilation ---------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "JITCache.h"
+#include "mlir/ExecutionEngine/OptUtils.h"
+#include "mlir/Target/LLVMIR/Export.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+using namespace circt;
+using namespace arcilator;
+using llvm::Error;
+using llvm::Expected;
+using llvm::StringRef;
+
+static Error makeError(const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+}
+
+/// Add a `_mlir_<name>` wrapper around `func` that takes its arguments as an
+/// array of pointers, matching the calling convention of
+/// `mlir::ExecutionEngine::lookupPacked`.
+static void addPackedWrapper(llvm::Module &module, llvm::Function &func) {
+  llvm::IRBuilder<> builder(module.getContext());
+  auto *ptrType = builder.getPtrTy();
+  auto *wrapper = llvm::Function::Create(
+      llvm::FunctionType::get(builder.getVoidTy(), ptrType, false),
+      llvm::GlobalValue::ExternalLinkage, "_mlir_" + func.getName(), module);
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(module.getContext(), "entry", wrapper));
+  llvm::SmallVector<llvm::Value *> args;
+  for (auto &arg : func.args()) {
+    auto *slot = builder.CreateConstGEP1_64(ptrType, wrapper->getArg(0),
+                                            arg.getArgNo());
+    auto *argPtr = builder.CreateLoad(ptrType, slot);
+    args.push_back(builder.CreateLoad(arg.getType(), argPtr));
+  }
+  builder.CreateCall(&func, args);
+  builder.CreateRetVoid();
+}
+
+/// Check whether a global is a local constant. These are duplicated into every
+/// partition that uses them, such that they remain local to each object file
+/// and the code generator can still see through them.
+static bool isLocalConstant(const llvm::GlobalValue *value) {
+  auto *var = llvm::dyn_cast<llvm::GlobalVariable>(value);
+  return var && var->isConstant() && var->hasLocalLinkage() &&
+         var->hasInitializer();
+}
+
+/// Collect the local constants transitively used by a constant.
+static void
+collectLocalConstants(const llvm::Constant *constant,
+                      llvm::SmallPtrSetImpl<const llvm::GlobalValue *> &used) {
+  if (auto *value = llvm::dyn_cast<llvm::GlobalValue>(constant)) {
+    if (isLocalConstant(value) && used.insert(value).second)
+      collectLocalConstants(
+          llvm::cast<llvm::GlobalVariable>(value)->getInitializer(), used);
+    return;
+  }
+  for (auto &operand : constant->operands())
+    if (auto *nested = llvm::dyn_cast<llvm::Constant>(operand))
+      collectLocalConstants(nested, used);
+}
+
+/// Describe the LLVM version and the host target that code is generated for,
+/// such that cached code is never used on a different machine or by a
+/// different LLVM.
+static const std::string &getHostTargetKey() {
+  static const std::string key = [] {
+    std::string key = LLVM_VERSION_STRING;
+    auto targetBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!targetBuilder) {
+      llvm::consumeError(targetBuilder.takeError());
+      return key;
+    }
+    key += " " + targetBuilder->getTargetTriple().str();
+    key += " " + targetBuilder->getCPU();
+    key += " " + targetBuilder->getFeatures().getString();
+    return key;
+  }();
+  return key;
+}
+
+std::string JITCache::getKey(llvm::ArrayRef<StringRef> parts) {
+  llvm::SHA256 hasher;
+  auto addPart = [&](StringRef part) {
+    auto size = static_cast<uint64_t>(part.size());
+    hasher.update(llvm::ArrayRef<uint8_t>(
+        reinterpret_cast<const uint8_t *>(&size), sizeof(size)));
+    hasher.update(part);
+  };
+  addPart(getHostTargetKey());
+  for (auto part : parts)
+    addPart(part);
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::string JITCache::getPath(StringRef key, StringRef extension) const {
+  llvm::SmallString<128> path(directory);
+  llvm::sys::path::append(path, key + "." + extension);
+  return std::string(path);
+}
+
+std::optional<JITProgram>
+JITCache::load(StringRef key, llvm::ArrayRef<std::string> sharedLibs) {
+  auto manifestBuffer = llvm::MemoryBuffer::getFile(getPath(key, "json"));
+  if (!manifestBuffer)
+    return std::nullopt;
+  auto manifest = llvm::json::parse((*manifestBuffer)->getBuffer());
+  if (!manifest) {
+    llvm::consumeError(manifest.takeError());
+    return std::nullopt;
+  }
+  auto *root = manifest->getAsObject();
+  if (!root)
+    return std::nullopt;
+  auto entryName = root->getString("entry");
+  auto *argWidths = root->getArray("argWidths");
+  auto *objectKeys = root->getArray("objects");
+  auto modelInfo = root->getString("modelInfo");
+  if (!entryName || !argWidths || !objectKeys || !modelInfo)
+    return std::nullopt;
+
+  // Load all object files of the program. A missing object means the cache
+  // has been pruned, in which case the program is compiled again.
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects;
+  for (auto &objectKey : *objectKeys) {
+    auto objectKeyStr = objectKey.getAsString();
+    if (!objectKeyStr)
+      return std::nullopt;
+    auto object = llvm::MemoryBuffer::getFile(getPath(*objectKeyStr, "o"));
+    if (!object)
+      return std::nullopt;
+    objects.push_back(std::move(*object));
+  }
+
+  auto program = link(std::move(objects), *entryName, sharedLibs);
+  if (!program) {
+    llvm::consumeError(program.takeError());
+    return std::nullopt;
+  }
+  for (auto &width : *argWidths) {
+    auto widthInt = width.getAsUINT64();
+    if (!widthInt)
+      return std::nullopt;
+    program->argWidths.push_back(*widthInt);
+  }
+  program->modelInfo = modelInfo->str();
+  return std::move(*program);
+}
+
+Expected<JITProgram> JITCache::compile(mlir::ModuleOp module,
+                                       StringRef entryName,
+                                       llvm::ArrayRef<unsigned> argWidths,
+                                       StringRef modelInfo, StringRef key,
+                                       llvm::ArrayRef<std::string> sharedLibs) {
+  numCompiledFunctions = 0;
+  numCachedFunctions = 0;
+  if (auto ec = llvm::sys::fs::create_directories(directory))
+    return makeError("unable to create JIT cache directory '" + directory +
+                     "': " + ec.message());
+
+  auto targetBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!targetBuilder)
+    return targetBuilder.takeError();
+  targetBuilder->setCodeGenOptLevel(llvm::CodeGenOptLevel::Aggressive);
+  auto targetMachine = targetBuilder->createTargetMachine();
+  if (!targetMachine)
+    return targetMachine.takeError();
+  auto &tm = **targetMachine;
+
+  llvm::LLVMContext llvmContext;
+  auto llvmModule = mlir::translateModuleToLLVMIR(module, llvmContext);
+  if (!llvmModule)
+    return makeError("failed to translate module to LLVM IR");
+  llvmModule->setDataLayout(tm.createDataLayout());
+  llvmModule->setTargetTriple(tm.getTargetTriple());
+
+  auto *entryFunc = llvmModule->getFunction(entryName);
+  if (!entryFunc || entryFunc->isDeclaration())
+    return makeError("entry point not found: '" + entryName + "'");
+  addPackedWrapper(*llvmModule, *entryFunc);
+
+  // Optimize the module as a whole before splitting it up, such that
+  // functions are still inlined into each other. This makes the IR of a
+  // function depend on the functions it inlines, so a change to a callee also
+  // recompiles its callers. The cache only saves the time spent in code
+  // generation.
+  auto optimize = mlir::makeOptimizingTransformer(
+      /*optLevel=*/3, /*sizeLevel=*/0, &tm);
+  if (auto err = optimize(llvmModule.get()))
+    return std::move(err);
+
+  // Make all local symbols other than constants visible to the other
+  // partitions. Partitions refer to each other by name only, so a cached
+  // object stays valid as long as its own IR is unchanged.
+  for (auto &global : llvmModule->global_values()) {
+    if (global.isDeclaration() || !global.hasLocalLinkage() ||
+        isLocalConstant(&global))
+      continue;
+    if (!global.hasName())
+      global.setName("__arc_anon");
+    global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    global.setVisibility(llvm::GlobalValue::HiddenVisibility);
+  }
+
+  llvm::orc::SimpleCompiler compiler(tm);
+
+  // Compile the given partition of the module into an object file, or reuse
+  // the object file from a previous compilation of the same IR.
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects;
+  llvm::json::Array objectKeys;
+  auto compilePartition =
+      [&](llvm::function_ref<bool(const llvm::GlobalValue *)> shouldDefine)
+      -> Error {
+    llvm::ValueToValueMapTy valueMap;
+    auto partition = llvm::CloneModule(*llvmModule, valueMap, shouldDefine);
+    std::string ir;
+    llvm::raw_string_ostream irStream(ir);
+    partition->print(irStream, nullptr);
+    auto objectKey = getKey({ir});
+    auto objectPath = getPath(objectKey, "o");
+    objectKeys.push_back(objectKey);
+
+    if (auto object = llvm::MemoryBuffer::getFile(objectPath)) {
+      objects.push_back(std::move(*object));
+      ++numCachedFunctions;
+      return Error::success();
+    }
+
+    auto object = compiler(*partition);
+    if (!object)
+      return object.takeError();
+    if (auto err = llvm::writeToOutput(objectPath, [&](llvm::raw_ostream &os) {
+          os << (*object)->getBuffer();
+          return Error::success();
+        }))
+      return err;
+    objects.push_back(std::move(*object));
+    ++numCompiledFunctions;
+    return Error::success();
+  };
+
+  // Put all global variables into one partition, and each function into its
+  // own partition together with the constants it uses.
+  if (!llvmModule->global_empty())
+    if (auto err = compilePartition([](const llvm::GlobalValue *value) {
+          return llvm::isa<llvm::GlobalVariable>(value);
+        }))
+      return std::move(err);
+
+  for (auto &func : llvmModule->functions()) {
+    if (func.isDeclaration())
+      continue;
+    llvm::SmallPtrSet<const llvm::GlobalValue *, 8> used;
+    used.insert(&func);
+    for (auto &inst : llvm::instructions(func))
+      for (auto &operand : inst.operands())
+        if (auto *constant = llvm::dyn_cast<llvm::Constant>(operand))
+          collectLocalConstants(constant, used);
+    if (auto err = compilePartition([&](const llvm::GlobalValue *value) {
+          return used.contains(value);
+        }))
+      return std::move(err);
+  }
+
+  // Record the program such that the next run with the same input can skip
+  // straight to linking the object files.
+  if (auto err = llvm::writeToOutput(
+          getPath(key, "json"), [&](llvm::raw_ostream &os) {
+            llvm::json::Object manifest;
+            manifest["entry"] = entryName;
+            manifest["argWidths"] = llvm::json::Array(argWidths);
+            manifest["objects"] = std::move(objectKeys);
+            manifest["modelInfo"] = modelInfo;
+            os << llvm::json::Value(std::move(manifest));
+            return Error::success();
+          }))
+    return std::move(err);
+
+  auto program = link(std::move(objects), entryName, sharedLibs);
+  if (!program)
+    return program.takeError();
+  program->argWidths.assign(argWidths.begin(), argWidths.end());
+  program->modelInfo = modelInfo.str();
+  return program;
+}
+
+Expected<JITProgram>
+JITCache::link(std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects,
+               StringRef entryName, llvm::ArrayRef<std::string> sharedLibs) {
+  auto jit = llvm::orc::LLJITBuilder().create();
+  if (!jit)
+    return jit.takeError();
+  auto &dylib = (*jit)->getMainJITDylib();
+  auto globalPrefix = (*jit)->getDataLayout().getGlobalPrefix();
+
+  // Resolve external symbols against the arcilator process and the shared
+  // libraries requested on the command line.
+  auto processSymbols =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          globalPrefix);
+  if (!processSymbols)
+    return processSymbols.takeError();
+  dylib.addGenerator(std::move(*processSymbols));
+  for (auto &lib : sharedLibs) {
+    auto libSymbols = llvm::orc::DynamicLibrarySearchGenerator::Load(
+        lib.c_str(), globalPrefix);
+    if (!libSymbols)
+      return libSymbols.takeError();
+    dylib.addGenerator(std::move(*libSymbols));
+  }
+
+  for (auto &object : objects)
+    if (auto err = (*jit)->addObjectFile(std::move(object)))
+      return std::move(err);
+  if (auto err = (*jit)->initialize(dylib))
+    return std::move(err);
+
+  auto entry = (*jit)->lookup(("_mlir_" + entryName).str());
+  if (!entry)
+    return entry.takeError();
+
+  JITProgram program;
+  program.entry = entry->toPtr<void (*)(void **)>();
+  program.jit = std::move(*jit);
+  return program;
+}
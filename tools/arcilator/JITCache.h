@@ -0,0 +1,91 @@
+//===- JITCache.h - On-disk cache for arcilator JIT compilation -*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares a content-addressed on-disk cache for the machine code
+// generated by arcilator's JIT. The cache operates at two levels:
+//
+// - Programs are keyed on the input and the options that affect compilation.
+//   A program hit skips the entire lowering pipeline and code generation.
+// - Functions are keyed on their optimized LLVM IR. The module is optimized as
+//   a whole, such that functions are still inlined into each other, and each
+//   function is then compiled into its own object file. A change to a few
+//   modules in the input only generates code for the functions that actually
+//   changed.
+//
+// All keys include the LLVM version and the host target triple, CPU, and
+// features.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TOOLS_ARCILATOR_JITCACHE_H
+#define TOOLS_ARCILATOR_JITCACHE_H
+
+#include "mlir/IR/BuiltinOps.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace circt {
+namespace arcilator {
+
+/// A JIT-compiled program ready for execution.
+struct JITProgram {
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  /// The packed entry point, taking an array of pointers to the arguments.
+  void (*entry)(void **) = nullptr;
+  /// The bit width of each argument of the entry point.
+  llvm::SmallVector<unsigned> argWidths;
+  /// The JSON description of the models, as written to the `--state-file`.
+  std::string modelInfo;
+};
+
+class JITCache {
+public:
+  explicit JITCache(llvm::StringRef directory) : directory(directory) {}
+
+  /// Compute a cache key from a list of strings and the host target.
+  static std::string getKey(llvm::ArrayRef<llvm::StringRef> parts);
+
+  /// Load the program stored under `key`, if it is present and complete.
+  std::optional<JITProgram> load(llvm::StringRef key,
+                                 llvm::ArrayRef<std::string> sharedLibs);
+
+  /// Compile the LLVM dialect `module` function by function, reusing cached
+  /// object files where possible, and store the program under `key`. The
+  /// `modelInfo` is stored alongside, such that a cache hit can reproduce it.
+  llvm::Expected<JITProgram> compile(mlir::ModuleOp module,
+                                     llvm::StringRef entryName,
+                                     llvm::ArrayRef<unsigned> argWidths,
+                                     llvm::StringRef modelInfo,
+                                     llvm::StringRef key,
+                                     llvm::ArrayRef<std::string> sharedLibs);
+
+  /// Number of functions compiled in the last call to `compile`.
+  unsigned numCompiledFunctions = 0;
+  /// Number of functions loaded from the cache in the last call to `compile`.
+  unsigned numCachedFunctions = 0;
+
+private:
+  std::string getPath(llvm::StringRef key, llvm::StringRef extension) const;
+  llvm::Expected<JITProgram>
+  link(std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects,
+       llvm::StringRef entryName, llvm::ArrayRef<std::string> sharedLibs);
+
+  std::string directory;
+};
+
+} // namespace arcilator
+} // namespace circt
+
+#endif // TOOLS_ARCILATOR_JITCACHE_H
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# Run arcilator benchmark designs through the JIT and report compile time,
+# simulation speed in cycles per second, and state size as JSON.
+#
+# Each benchmark is an MLIR file with a `main(%cycles: i64)` entry point that
+# simulates the given number of clock cycles.
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+from typing import *
+
+
+def find_benchmarks(paths: List[str]) -> List[str]:
+  benchmarks = []
+  for path in paths:
+    if os.path.isdir(path):
+      benchmarks += sorted(
+          os.path.join(path, name)
+          for name in os.listdir(path)
+          if name.endswith(".mlir"))
+    else:
+      benchmarks.append(path)
+  return benchmarks
+
+
+def run_benchmark(arcilator: str, path: str, cycles: int,
+                  extra_args: List[str]) -> dict:
+  with tempfile.TemporaryDirectory() as tmp:
+    report_path = os.path.join(tmp, "report.json")
+    cmd = [
+        arcilator, path, "--run", "--jit-entry=main", f"--args={cycles}",
+        f"--jit-report={report_path}"
+    ] + extra_args
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    with open(report_path) as f:
+      return json.load(f)
+
+
+def summarize(path: str, cycles: int, reports: List[dict]) -> dict:
+  # Report the fastest of all repetitions to reduce noise.
+  best = min(reports, key=lambda r: r["executeSeconds"])
+  execute = best["executeSeconds"]
+  return {
+      "name": os.path.splitext(os.path.basename(path))[0],
+      "cycles": cycles,
+      "pipelineSeconds": best["pipelineSeconds"],
+      "jitSeconds": best["jitSeconds"],
+      "compileSeconds": best["compileSeconds"],
+      "executeSeconds": execute,
+      "cyclesPerSecond": cycles / execute if execute > 0 else None,
+      "numStateBytes": sum(m["numStateBytes"] for m in best["models"]),
+  }
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(
+      description="Run arcilator benchmarks and report simulation speed")
+  parser.add_argument("benchmarks",
+                      metavar="BENCHMARK",
+                      nargs="+",
+                      help="benchmark MLIR files or directories of them")
+  parser.add_argument("--arcilator",
+                      default="arcilator",
+                      help="arcilator binary to benchmark")
+  parser.add_argument("--cycles",
+                      type=int,
+                      default=1000000,
+                      help="number of clock cycles to simulate")
+  parser.add_argument("--repeat",
+                      type=int,
+                      default=3,
+                      help="number of runs per benchmark")
+  parser.add_argument("--arcilator-arg",
+                      dest="arcilator_args",
+                      action="append",
+                      default=[],
+                      help="additional option to pass to arcilator")
+  parser.add_argument("-o",
+                      "--output",
+                      metavar="FILE",
+                      help="output JSON file (default: stdout)")
+  args = parser.parse_args()
+
+  results = []
+  for path in find_benchmarks(args.benchmarks):
+    print(f"Running {path}", file=sys.stderr)
+    reports = [
+        run_benchmark(args.arcilator, path, args.cycles, args.arcilator_args)
+        for _ in range(max(args.repeat, 1))
+    ]
+    results.append(summarize(path, args.cycles, reports))
+
+  if args.output:
+    with open(args.output, "w") as f:
+      json.dump(results, f, indent=2)
+      f.write("\n")
+  else:
+    json.dump(results, sys.stdout, indent=2)
+    sys.stdout.write("\n")
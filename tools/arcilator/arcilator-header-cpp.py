@@ -14,6 +14,11 @@ extern "C" {
 void {{ model.name }}_initial(void* state);
 {% endif %}
 void {{ model.name }}_eval(void* state);
+{% for phase in model.evalPartitions %}
+{% for fn in phase %}
+void {{ fn }}(void* state);
+{% endfor %}
+{% endfor %}
 }
 
 class {{ model.name }}Layout {
@@ -21,6 +26,8 @@ public:
   static const char *name;
   static const unsigned numStates;
   static const unsigned numStateBytes;
+  static const uint64_t layoutHash;
+  static const unsigned numLanes;
   static const std::array<Signal, {{ model.io|length }}> io;
   static const Hierarchy hierarchy;
 };
@@ -28,6 +35,8 @@ public:
 const char *{{ model.name }}Layout::name = "{{ model.name }}";
 const unsigned {{ model.name }}Layout::numStates = {{ model.states|length }};
 const unsigned {{ model.name }}Layout::numStateBytes = {{ model.numStateBytes }};
+const uint64_t {{ model.name }}Layout::layoutHash = {{ "0x%016x" % model.layoutHash }}ULL;
+const unsigned {{ model.name }}Layout::numLanes = {{ model.lanes }};
 const std::array<Signal, {{ model.io|length }}> {{ model.name }}Layout::io = {
 {% for io in model.io %}
   {{ format_signal(io) }},
@@ -39,36 +48,78 @@ const Hierarchy {{ model.name }}Layout::hierarchy = {{ indent(format_hierarchy(m
 class {{ model.name }}View {
 public:
 {% for io in model.io %}
-  {{ state_cpp_type(io) }} &{{ io.name }};
+  {{ state_cpp_type(io, model.lanes) }} &{{ io.name }};
 {% endfor %}
-  {{ indent(format_view_hierarchy(model.hierarchy[0], view_depth)) }} {{ model.hierarchy[0].name }};
+  {{ indent(format_view_hierarchy(model.hierarchy[0], view_depth, model.lanes)) }} {{ model.hierarchy[0].name }};
   uint8_t *state;
 
+{% if model.lanes > 1 %}
+  // Models compiled with `arcilator --lanes` store the states of all lanes
+  // interleaved. A view refers to the states of one lane.
+  {{ model.name }}View(uint8_t *state, unsigned lane = 0) :
+{% else %}
   {{ model.name }}View(uint8_t *state) :
+{% endif %}
 {% for io in model.io %}
-    {{ io.name }}({{ state_cpp_ref(io) }}),
+    {{ io.name }}({{ state_cpp_ref(io, model.lanes) }}),
 {% endfor %}
-    {{ model.hierarchy[0].name }}({{ indent(format_view_constructor(model.hierarchy[0], view_depth), 2) }}),
+    {{ model.hierarchy[0].name }}({{ indent(format_view_constructor(model.hierarchy[0], view_depth, model.lanes), 2) }}),
     state(state) {}
 };
 
 class {{ model.name }} {
 public:
   std::vector<uint8_t> storage;
+#ifdef ARCILATOR_HAS_POSIX_IO
+  // The snapshot the model was started from, if any, whose state is used in
+  // place of `storage`.
+  std::unique_ptr<StateSnapshot::Mapping> snapshot;
+#endif
+  uint8_t *state;
   {{ model.name }}View view;
 
-  {{ model.name }}() : storage({{ model.name }}Layout::numStateBytes, 0), view(&storage[0]) {
+  {{ model.name }}() : storage({{ model.name }}Layout::numStateBytes, 0), state(&storage[0]), view(state) {
 {% if model.initialFnSym %}
-    {{ model.initialFnSym }}(&storage[0]);
+    {{ model.initialFnSym }}(state);
 {% endif %}
   }
-  void eval() { {{ model.name }}_eval(&storage[0]); }
+#ifdef ARCILATOR_HAS_POSIX_IO
+  // Start from a snapshot mapped with `StateSnapshot::Mapping::open`.
+  explicit {{ model.name }}(StateSnapshot::Mapping snapshot) :
+    snapshot(std::make_unique<StateSnapshot::Mapping>(std::move(snapshot))),
+    state(this->snapshot->getState()), view(state) {}
+#endif
+  void eval() { {{ model.name }}_eval(state); }
+{% if model.lanes > 1 %}
+  /// Get a view of the states of one lane. `view` refers to the first lane.
+  {{ model.name }}View laneView(unsigned lane) { return {{ model.name }}View(state, lane); }
+{% endif %}
+{% if model.evalPartitions %}
+  void eval(EvalWorkerPool &pool) {
+{% for phase in model.evalPartitions %}
+    static const EvalWorkerPool::PartitionFn phase{{ loop.index0 }}[] = { {{ phase|join(", ") }} };
+    pool.runPhase(phase{{ loop.index0 }}, {{ phase|length }}, state);
+{% endfor %}
+  }
+{% endif %}
   ValueChangeDump<{{ model.name }}Layout> vcd(std::basic_ostream<char> &os) {
-    ValueChangeDump<{{ model.name }}Layout> vcd(os, &storage[0]);
+    ValueChangeDump<{{ model.name }}Layout> vcd(os, state);
     vcd.writeHeader();
     vcd.writeDumpvars();
     return vcd;
   }
+  std::unique_ptr<BinaryTraceWriter<{{ model.name }}Layout>> trace(std::basic_ostream<char> &os) {
+    auto trace = std::make_unique<BinaryTraceWriter<{{ model.name }}Layout>>(os, state);
+    trace->writeHeader();
+    trace->writeDumpvars();
+    return trace;
+  }
+  void saveState(const char *path) const {
+    StateSnapshot::save<{{ model.name }}Layout>(path, state);
+  }
+  void restoreState(const char *path) {
+    StateSnapshot::restore<{{ model.name }}Layout>(path, state);
+  }
 };
 
 #define {{ model.name.upper() }}_PORTS \\
@@ -107,10 +158,11 @@ class StateInfo:
   typ: StateType
   stride: Optional[int]
   depth: Optional[int]
+  dirtyOffset: Optional[int]
 
   def decode(d: dict) -> "StateInfo":
     return StateInfo(d["name"], d["offset"], d["numBits"], StateType(d["type"]),
-                     d.get("stride"), d.get("depth"))
+                     d.get("stride"), d.get("depth"), d.get("dirtyOffset"))
 
 
 @dataclass
@@ -125,15 +177,32 @@ class ModelInfo:
   name: str
   numStateBytes: int
   initialFnSym: str
+  evalPartitions: List[List[str]]
+  layoutHash: int
+  lanes: int
   states: List[StateInfo]
   io: List[StateInfo]
   hierarchy: List[StateHierarchy]
 
   def decode(d: dict) -> "ModelInfo":
     return ModelInfo(d["name"], d["numStateBytes"], d.get("initialFnSym", ""),
+                     d.get("evalPartitions", []), layout_hash(d),
+                     d.get("lanes", 1),
                      [StateInfo.decode(d) for d in d["states"]], list(), list())
 
 
+# Compute a hash of the state layout of a model, used to check that a state
+# snapshot was taken from a model with the same layout.
+def layout_hash(d: dict) -> int:
+  layout = json.dumps([d["name"], d["numStateBytes"], d["states"]],
+                      sort_keys=True,
+                      separators=(",", ":"))
+  result = 0xcbf29ce484222325
+  for byte in layout.encode():
+    result = ((result ^ byte) * 0x100000001b3) & 0xffffffffffffffff
+  return result
+
+
 # Organize the state by hierarchy.
 def group_state_by_hierarchy(
     states: List[StateInfo]) -> Tuple[List[StateInfo], List[StateHierarchy]]:
@@ -182,8 +251,14 @@ def format_signal(state: StateInfo) -> str:
       f"\"{state.name}\"", state.offset, state.numBits,
       f"Signal::{state.typ.value.capitalize()}"
   ]
-  if state.typ == StateType.MEMORY:
+  # States batched into lanes carry a stride and depth as well, with the
+  # signal itself referring to the first lane.
+  if state.depth is not None:
     fields += [state.stride, state.depth]
+  if state.dirtyOffset is not None:
+    if state.depth is None:
+      fields += [0, 0]
+    fields.append(state.dirtyOffset)
   fields = ", ".join((str(f) for f in fields))
   return f"Signal{{{fields}}}"
 
@@ -209,9 +284,12 @@ def state_cpp_type_nonmemory(state: StateInfo) -> str:
   return f"Bytes<{(state.numBits + 7) // 8}>"
 
 
-def state_cpp_type(state: StateInfo) -> str:
+# The states of models batched into lanes are stored with the lanes
+# interleaved. A view of one lane sees a state as a scalar, and a memory as a
+# memory whose words are `lanes` times further apart.
+def state_cpp_type(state: StateInfo, lanes: int) -> str:
   if state.typ == StateType.MEMORY:
-    return f"Memory<{state_cpp_type_nonmemory(state)}, {state.stride}, {state.depth}>"
+    return f"Memory<{state_cpp_type_nonmemory(state)}, {state.stride * lanes}, {state.depth // lanes}>"
   return state_cpp_type_nonmemory(state)
 
 
@@ -236,14 +314,15 @@ def clean_name(name: str) -> str:
   return name
 
 
-def format_view_hierarchy(hierarchy: StateHierarchy, depth: int) -> str:
+def format_view_hierarchy(hierarchy: StateHierarchy, depth: int,
+                          lanes: int) -> str:
   lines = []
   for state in hierarchy.states:
-    lines.append(f"{state_cpp_type(state)} &{clean_name(state.name)};")
+    lines.append(f"{state_cpp_type(state, lanes)} &{clean_name(state.name)};")
   if depth != 0:
     for child in hierarchy.children:
       lines.append(
-          f"{indent(format_view_hierarchy(child, depth - 1))} {clean_name(child.name)};"
+          f"{indent(format_view_hierarchy(child, depth - 1, lanes))} {clean_name(child.name)};"
       )
   lines = "\n  ".join(lines)
   if lines:
@@ -251,18 +330,22 @@ def format_view_hierarchy(hierarchy: StateHierarchy, depth: int) -> str:
   return f"struct {{{lines}}}"
 
 
-def state_cpp_ref(state: StateInfo) -> str:
-  return f"*({state_cpp_type(state)}*)(state+{state.offset})"
+def state_cpp_ref(state: StateInfo, lanes: int) -> str:
+  offset = f"{state.offset}"
+  if lanes > 1:
+    offset += f"+lane*{state.stride}"
+  return f"*({state_cpp_type(state, lanes)}*)(state+{offset})"
 
 
-def format_view_constructor(hierarchy: StateHierarchy, depth: int) -> str:
+def format_view_constructor(hierarchy: StateHierarchy, depth: int,
+                            lanes: int) -> str:
   lines = []
   for state in hierarchy.states:
-    lines.append(f".{clean_name(state.name)} = {state_cpp_ref(state)}")
+    lines.append(f".{clean_name(state.name)} = {state_cpp_ref(state, lanes)}")
   if depth != 0:
     for child in hierarchy.children:
       lines.append(
-          f".{clean_name(child.name)} = {indent(format_view_constructor(child, depth - 1))}"
+          f".{clean_name(child.name)} = {indent(format_view_constructor(child, depth - 1, lanes))}"
       )
   lines = ",\n  ".join(lines)
   if lines:
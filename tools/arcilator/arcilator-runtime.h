@@ -1,12 +1,30 @@
 // NOLINTBEGIN
 #pragma once
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define ARCILATOR_HAS_POSIX_IO 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 struct Signal {
   const char *name;
   unsigned offset;
@@ -15,6 +33,10 @@ struct Signal {
   // for memories:
   unsigned stride;
   unsigned depth;
+  // for models compiled with `arcilator --dirty-flags`:
+  unsigned dirtyOffset = noDirtyFlag;
+
+  static constexpr unsigned noDirtyFlag = ~0U;
 };
 
 struct Hierarchy {
@@ -37,12 +59,319 @@ struct Memory {
   } words[Depth];
 };
 
+/// Saves and restores the full state of a model, including its memories, to
+/// and from a snapshot file. This allows a long warm-up phase to be simulated
+/// once and shared by many runs. A snapshot starts with a header recording the
+/// layout hash and size of the model state, which are checked when restoring,
+/// followed by the raw state buffer at a page-aligned offset. Restoring reads
+/// the state straight into the model's state buffer.
+class StateSnapshot {
+public:
+  static constexpr uint32_t version = 1;
+  static constexpr size_t dataOffset = 4096;
+
+  template <class ModelLayout>
+  static void save(const char *path, const uint8_t *state) {
+    Header header = makeHeader<ModelLayout>();
+
+    // Write to a temporary file and rename it, such that other processes never
+    // observe a partially written snapshot. The temporary file has a unique
+    // name in the same directory, such that concurrent saves of the same
+    // snapshot don't clobber each other and the rename stays atomic.
+#ifdef ARCILATOR_HAS_POSIX_IO
+    static std::atomic<unsigned> counter{0};
+    std::string tmpPath;
+    int fd;
+    do {
+      tmpPath = std::string(path) + "." + std::to_string(::getpid()) + "." +
+                std::to_string(counter++) + ".tmp";
+      // Create the file with the usual mode, such that the umask applies.
+      fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    } while (fd < 0 && errno == EEXIST);
+    if (fd < 0)
+      fail("cannot create snapshot", path);
+    FILE *file = ::fdopen(fd, "wb");
+    if (!file) {
+      ::close(fd);
+      std::remove(tmpPath.c_str());
+      fail("cannot create snapshot", path);
+    }
+#else
+    std::string tmpPath = std::string(path) + ".tmp";
+    FILE *file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file)
+      fail("cannot create snapshot", tmpPath.c_str());
+#endif
+    std::vector<uint8_t> headerBlock(dataOffset, 0);
+    std::memcpy(headerBlock.data(), &header, sizeof(header));
+    bool ok =
+        std::fwrite(headerBlock.data(), 1, dataOffset, file) == dataOffset &&
+        std::fwrite(state, 1, ModelLayout::numStateBytes, file) ==
+            ModelLayout::numStateBytes;
+    ok &= std::fclose(file) == 0;
+    if (!ok || std::rename(tmpPath.c_str(), path) != 0) {
+      std::remove(tmpPath.c_str());
+      fail("cannot write snapshot", path);
+    }
+  }
+
+  template <class ModelLayout>
+  static void restore(const char *path, uint8_t *state) {
+    size_t numBytes = ModelLayout::numStateBytes;
+#ifdef ARCILATOR_HAS_POSIX_IO
+    // Check the header and size first, such that a bad snapshot leaves the
+    // state untouched.
+    int fd = openChecked<ModelLayout>(path);
+    bool ok = true;
+    // Read the state directly into the state buffer. Retry short reads, which
+    // are allowed even for regular files.
+    for (size_t done = 0; ok && done < numBytes;) {
+      ssize_t n = ::pread(fd, state + done, numBytes - done, dataOffset + done);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        ok = false;
+      else
+        done += n;
+    }
+    ::close(fd);
+    if (!ok)
+      fail("cannot read snapshot", path);
+#else
+    FILE *file = std::fopen(path, "rb");
+    if (!file)
+      fail("cannot open snapshot", path);
+    Header expected = makeHeader<ModelLayout>();
+    Header header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              checkHeader(header, expected) &&
+              std::fseek(file, dataOffset, SEEK_SET) == 0 &&
+              std::fread(state, 1, numBytes, file) == numBytes;
+    std::fclose(file);
+    if (!ok)
+      fail("cannot restore snapshot", path);
+#endif
+  }
+
+#ifdef ARCILATOR_HAS_POSIX_IO
+  /// A snapshot mapped into memory copy-on-write, for starting simulations
+  /// from it without reading it first. Pages are loaded on first access and
+  /// shared through the page cache by all the processes mapping the same
+  /// snapshot. A page is only copied once it is written.
+  class Mapping {
+  public:
+    template <class ModelLayout>
+    static Mapping open(const char *path) {
+      int fd = openChecked<ModelLayout>(path);
+      size_t size = dataOffset + ModelLayout::numStateBytes;
+      void *base =
+          ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (base == MAP_FAILED)
+        fail("cannot map snapshot", path);
+      return Mapping(base, size);
+    }
+
+    Mapping(Mapping &&other) : base(other.base), size(other.size) {
+      other.base = nullptr;
+    }
+    Mapping &operator=(Mapping &&) = delete;
+    ~Mapping() {
+      if (base)
+        ::munmap(base, size);
+    }
+
+    /// Get the state buffer, which may be modified freely. Modifications are
+    /// private to this mapping and never written back to the snapshot.
+    uint8_t *getState() const {
+      return static_cast<uint8_t *>(base) + dataOffset;
+    }
+
+  private:
+    Mapping(void *base, size_t size) : base(base), size(size) {}
+
+    void *base;
+    size_t size;
+  };
+#endif // ARCILATOR_HAS_POSIX_IO
+
+private:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t layoutHash;
+    uint64_t numStateBytes;
+  };
+
+  template <class ModelLayout>
+  static Header makeHeader() {
+    Header header;
+    std::memcpy(header.magic, "ARCSNAP", 8);
+    header.version = version;
+    header.reserved = 0;
+    header.layoutHash = ModelLayout::layoutHash;
+    header.numStateBytes = ModelLayout::numStateBytes;
+    return header;
+  }
+
+  static bool checkHeader(const Header &header, const Header &expected) {
+    return std::memcmp(header.magic, expected.magic, 8) == 0 &&
+           header.version == expected.version &&
+           header.layoutHash == expected.layoutHash &&
+           header.numStateBytes == expected.numStateBytes;
+  }
+
+#ifdef ARCILATOR_HAS_POSIX_IO
+  /// Open a snapshot and check that it matches the model and is complete.
+  template <class ModelLayout>
+  static int openChecked(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      fail("cannot open snapshot", path);
+    Header header;
+    if (::pread(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header)) ||
+        !checkHeader(header, makeHeader<ModelLayout>())) {
+      ::close(fd);
+      fail("snapshot does not match the model layout", path);
+    }
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) != 0 ||
+        size_t(fileStat.st_size) < dataOffset + ModelLayout::numStateBytes) {
+      ::close(fd);
+      fail("snapshot is truncated", path);
+    }
+    return fd;
+  }
+#endif // ARCILATOR_HAS_POSIX_IO
+
+  [[noreturn]] static void fail(const char *message, const char *path) {
+    throw std::runtime_error(std::string(message) + ": " + path);
+  }
+};
+
+/// A pool of worker threads that evaluates the partitions of a model, as
+/// produced by `arcilator --eval-partitions`. `runPhase` calls all partition
+/// functions of one phase concurrently and returns once all of them are done,
+/// which acts as the barrier between phases. The calling thread participates
+/// in the work.
+class EvalWorkerPool {
+public:
+  using PartitionFn = void (*)(void *);
+
+  explicit EvalWorkerPool(unsigned numThreads) {
+    for (unsigned i = 1; i < numThreads; ++i)
+      workers.emplace_back([this] { workerLoop(); });
+  }
+
+  ~EvalWorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto &worker : workers)
+      worker.join();
+  }
+
+  void runPhase(const PartitionFn *fns, unsigned numFns, void *state) {
+    if (workers.empty() || numFns < 2) {
+      for (unsigned i = 0; i < numFns; ++i)
+        fns[i](state);
+      return;
+    }
+    uint32_t phase;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      phase = ++generation;
+      phaseFns = fns;
+      phaseNumFns = numFns;
+      phaseState = state;
+      pendingFns = numFns;
+      nextFn.store(uint64_t(phase) << 32);
+    }
+    wakeup.notify_all();
+    runPartitions(phase, fns, numFns, state);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return pendingFns == 0; });
+  }
+
+private:
+  /// Claim the next partition of `phase`. The counter carries the generation
+  /// of the phase in its upper half, such that a worker which only wakes up
+  /// after its phase has finished cannot claim a partition of a later phase.
+  bool claim(uint32_t phase, unsigned numFns, unsigned &index) {
+    uint64_t ticket = nextFn.load();
+    do {
+      if (uint32_t(ticket >> 32) != phase || uint32_t(ticket) >= numFns)
+        return false;
+    } while (!nextFn.compare_exchange_weak(ticket, ticket + 1));
+    index = uint32_t(ticket);
+    return true;
+  }
+
+  void runPartitions(uint32_t phase, const PartitionFn *fns, unsigned numFns,
+                     void *state) {
+    unsigned numRun = 0;
+    for (unsigned i; claim(phase, numFns, i); ++numRun)
+      fns[i](state);
+    if (numRun == 0)
+      return;
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingFns -= numRun;
+    if (pendingFns == 0)
+      done.notify_all();
+  }
+
+  void workerLoop() {
+    uint32_t seenGeneration = 0;
+    while (true) {
+      const PartitionFn *fns;
+      unsigned numFns;
+      void *state;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeup.wait(lock,
+                    [&] { return stopping || generation != seenGeneration; });
+        if (stopping)
+          return;
+        seenGeneration = generation;
+        fns = phaseFns;
+        numFns = phaseNumFns;
+        state = phaseState;
+      }
+      runPartitions(seenGeneration, fns, numFns, state);
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::condition_variable done;
+  /// The generation of the current phase in the upper 32 bits, and the index
+  /// of the next partition to run in the lower 32 bits.
+  std::atomic<uint64_t> nextFn{0};
+  const PartitionFn *phaseFns = nullptr;
+  unsigned phaseNumFns = 0;
+  void *phaseState = nullptr;
+  unsigned pendingFns = 0;
+  uint32_t generation = 0;
+  bool stopping = false;
+};
+
 template <class ModelLayout>
 class ValueChangeDump {
 public:
   ValueChangeDump(std::basic_ostream<char> &os, const uint8_t *state)
       : os(os), state(state) {}
 
+  /// Create a dump that uses the dirty flags of a model compiled with
+  /// `arcilator --dirty-flags`, if present, to only visit the signals written
+  /// since the last timestep. The dump clears the flags as it consumes them.
+  ValueChangeDump(std::basic_ostream<char> &os, uint8_t *state)
+      : os(os), state(state), mutableState(state) {}
+
   void writeHeader(bool withHierarchy = true) {
     os << "$date\n    October 21, 2015\n$end\n";
     os << "$version\n    Some cryptic MLIR magic\n$end\n";
@@ -94,25 +423,42 @@ public:
 
     os << "$upscope $end\n";
     os << "$enddefinitions $end\n";
+    if (mutableState)
+      buildDirtyFlagIndex();
   }
 
   void writeValues(bool includeUnchanged = false) {
-    for (auto &signal : signals) {
-      const uint8_t *valNew = state + signal.offset;
-      uint8_t *valOld = &previousValues[0] + signal.previousOffset;
-      size_t numBytes = (signal.state.numBits + 7) / 8;
-      bool unchanged = std::equal(valNew, valNew + numBytes, valOld);
-      if (unchanged && !includeUnchanged)
+    if (dirtyFlagWords.empty() || includeUnchanged) {
+      for (auto &signal : signals)
+        writeValue(signal, includeUnchanged);
+      for (auto index : flaggedSignals)
+        mutableState[signals[index].state.dirtyOffset] = 0;
+      return;
+    }
+
+    // Signals without a flag, such as inputs, are always compared. For all
+    // others, only visit the ones whose flag is set, eight flags at a time.
+    // The candidates are written in signal order, so that the output is the
+    // same as that of a full comparison.
+    candidates.assign(unflaggedSignals.begin(), unflaggedSignals.end());
+    for (auto &word : dirtyFlagWords) {
+      uint64_t flags = 0;
+      std::memcpy(&flags, mutableState + word.offset, word.numBytes);
+      if ((flags & word.mask) == 0)
         continue;
-      if (signal.state.numBits > 1)
-        os << 'b';
-      for (unsigned n = signal.state.numBits; n > 0; --n)
-        os << (valNew[(n - 1) / 8] & (1 << ((n - 1) % 8)) ? '1' : '0');
-      if (signal.state.numBits > 1)
-        os << ' ';
-      os << signal.abbrev << "\n";
-      std::copy(valNew, valNew + numBytes, valOld);
+      // The words of a memory share one flag, so only clear the flags once
+      // all of them have been looked at.
+      for (unsigned i = word.firstSignal; i < word.lastSignal; ++i)
+        if (mutableState[signals[flaggedSignals[i]].state.dirtyOffset])
+          candidates.push_back(flaggedSignals[i]);
+      for (unsigned i = word.firstSignal; i < word.lastSignal; ++i)
+        mutableState[signals[flaggedSignals[i]].state.dirtyOffset] = 0;
     }
+    auto firstFlagged = candidates.begin() + unflaggedSignals.size();
+    std::sort(firstFlagged, candidates.end());
+    std::inplace_merge(candidates.begin(), firstFlagged, candidates.end());
+    for (auto index : candidates)
+      writeValue(signals[index], false);
   }
 
   void writeDumpvars() {
@@ -136,6 +482,71 @@ private:
     unsigned previousOffset;
   };
 
+  /// A word of the state buffer holding dirty flags, and the range of signals
+  /// in `flaggedSignals` whose flag is in that word.
+  struct DirtyFlagWord {
+    unsigned offset;
+    unsigned numBytes;
+    uint64_t mask;
+    unsigned firstSignal;
+    unsigned lastSignal;
+  };
+
+  void writeValue(VcdSignal &signal, bool includeUnchanged) {
+    const uint8_t *valNew = state + signal.offset;
+    uint8_t *valOld = &previousValues[0] + signal.previousOffset;
+    size_t numBytes = (signal.state.numBits + 7) / 8;
+    bool unchanged = std::equal(valNew, valNew + numBytes, valOld);
+    if (unchanged && !includeUnchanged)
+      return;
+    if (signal.state.numBits > 1)
+      os << 'b';
+    for (unsigned n = signal.state.numBits; n > 0; --n)
+      os << (valNew[(n - 1) / 8] & (1 << ((n - 1) % 8)) ? '1' : '0');
+    if (signal.state.numBits > 1)
+      os << ' ';
+    os << signal.abbrev << "\n";
+    std::copy(valNew, valNew + numBytes, valOld);
+  }
+
+  /// Group the signals by the word of the state buffer holding their dirty
+  /// flag. Does nothing if the model has not been compiled with dirty flags.
+  void buildDirtyFlagIndex() {
+    flaggedSignals.clear();
+    unflaggedSignals.clear();
+    dirtyFlagWords.clear();
+    for (unsigned i = 0; i < signals.size(); ++i) {
+      if (signals[i].state.dirtyOffset == Signal::noDirtyFlag)
+        unflaggedSignals.push_back(i);
+      else
+        flaggedSignals.push_back(i);
+    }
+    if (flaggedSignals.empty())
+      return;
+    std::stable_sort(flaggedSignals.begin(), flaggedSignals.end(),
+                     [&](unsigned a, unsigned b) {
+                       return signals[a].state.dirtyOffset <
+                              signals[b].state.dirtyOffset;
+                     });
+
+    for (unsigned i = 0; i < flaggedSignals.size(); ++i) {
+      unsigned flagOffset = signals[flaggedSignals[i]].state.dirtyOffset;
+      unsigned wordOffset = flagOffset / 8 * 8;
+      if (dirtyFlagWords.empty() ||
+          dirtyFlagWords.back().offset != wordOffset) {
+        unsigned numBytes =
+            std::min(8U, ModelLayout::numStateBytes - wordOffset);
+        dirtyFlagWords.push_back(DirtyFlagWord{wordOffset, numBytes, 0, i, i});
+      }
+      auto &word = dirtyFlagWords.back();
+      uint8_t maskBytes[8];
+      std::memcpy(maskBytes, &word.mask, 8);
+      maskBytes[flagOffset - wordOffset] = 0xff;
+      std::memcpy(&word.mask, maskBytes, 8);
+      word.lastSignal = i + 1;
+    }
+  }
+
   VcdSignal &allocSignal(const Signal &state, unsigned offset,
                          unsigned numBytes) {
     std::string abbrev;
@@ -155,8 +566,352 @@ private:
 
   std::basic_ostream<char> &os;
   const uint8_t *state;
+  uint8_t *mutableState = nullptr;
   std::vector<VcdSignal> signals;
   std::vector<uint8_t> previousValues;
+  std::vector<unsigned> flaggedSignals;
+  std::vector<unsigned> unflaggedSignals;
+  std::vector<DirtyFlagWord> dirtyFlagWords;
+  /// The signals which may have changed in the current timestep.
+  std::vector<unsigned> candidates;
+};
+
+/// A binary, block-compressed alternative to `ValueChangeDump` with the same
+/// interface. Changes are found by comparing the state buffer against a copy
+/// of the previous values one 64-bit word at a time, and values are recorded
+/// as raw bytes instead of one character per bit. Records are collected into
+/// blocks which are compressed and written to the output stream by a
+/// background thread. The stream must not be accessed by anyone else until
+/// `close()` has been called or the writer has been destroyed. Use
+/// `arcilator-trace-to-vcd.py` to convert the trace into a VCD file.
+///
+/// All integers in the format are unsigned LEB128 varints, and strings are
+/// prefixed with their length. The file starts with the magic `ARCTRACE` and
+/// the format version, followed by the header records terminated by a 0:
+///
+///   1 <name>                    begin a scope
+///   2                           end a scope
+///   3 <isReg> <numBits> <name>  declare the next signal
+///
+/// The rest of the file is a sequence of blocks, each consisting of the raw
+/// size, the compressed size, and the compressed data. A decompressed block is
+/// a sequence of timesteps:
+///
+///   <timeDelta> <numChanges> (<signalIndex> <value bytes>)*
+///
+/// Blocks are compressed with a byte-oriented LZ77 scheme, consisting of a
+/// sequence of `<numLiterals> <literals> <matchLength> [<matchDistance>]`
+/// where the distance is omitted if the match length is 0.
+template <class ModelLayout>
+class BinaryTraceWriter {
+public:
+  static constexpr unsigned version = 1;
+
+  BinaryTraceWriter(std::basic_ostream<char> &os, const uint8_t *state,
+                    size_t blockSize = 1 << 20)
+      : os(os), state(state), blockSize(blockSize),
+        previousValues(ModelLayout::numStateBytes, 0),
+        writerThread([this] { writerLoop(); }) {
+    block.reserve(blockSize);
+  }
+
+  BinaryTraceWriter(const BinaryTraceWriter &) = delete;
+  BinaryTraceWriter &operator=(const BinaryTraceWriter &) = delete;
+
+  ~BinaryTraceWriter() { close(); }
+
+  void writeHeader(bool withHierarchy = true) {
+    static const char magic[] = "ARCTRACE";
+    std::vector<uint8_t> header(magic, magic + 8);
+    appendVarInt(header, version);
+
+    auto appendString = [&](const char *str) {
+      size_t length = std::strlen(str);
+      appendVarInt(header, length);
+      header.insert(header.end(), str, str + length);
+    };
+    auto beginScope = [&](const char *name) {
+      header.push_back(1);
+      appendString(name);
+    };
+    auto endScope = [&] { header.push_back(2); };
+    auto declareSignal = [&](const Signal &state, unsigned offset,
+                             const std::string &name) {
+      header.push_back(3);
+      appendVarInt(header, state.type == Signal::Register ||
+                               state.type == Signal::Memory);
+      appendVarInt(header, state.numBits);
+      appendString(name.c_str());
+      signals.push_back(
+          TraceSignal{offset, (state.numBits + 7) / 8, state.numBits});
+    };
+
+    auto writeSignal = [&](const Signal &state) {
+      if (state.type != Signal::Memory) {
+        declareSignal(state, state.offset, state.name);
+        return;
+      }
+      for (unsigned i = 0; i < state.depth; ++i)
+        declareSignal(state, state.offset + i * state.stride,
+                      std::string(state.name) + "[" + std::to_string(i) +
+                          "]");
+    };
+
+    std::function<void(const Hierarchy &)> writeHierarchy =
+        [&](const Hierarchy &hierarchy) {
+          beginScope(hierarchy.name);
+          for (unsigned i = 0; i < hierarchy.numStates; ++i)
+            writeSignal(hierarchy.states[i]);
+          for (unsigned i = 0; i < hierarchy.numChildren; ++i)
+            writeHierarchy(hierarchy.children[i]);
+          endScope();
+        };
+
+    beginScope(ModelLayout::name);
+    for (auto &port : ModelLayout::io)
+      writeSignal(port);
+    if (withHierarchy)
+      writeHierarchy(ModelLayout::hierarchy);
+    endScope();
+    header.push_back(0);
+
+    // The writer thread only touches the stream once the first block has been
+    // queued, so the header can be written directly.
+    os.write(reinterpret_cast<const char *>(header.data()), header.size());
+    buildWordIndex();
+  }
+
+  void writeDumpvars() { writeValues(true); }
+
+  void writeTimestep(size_t timeIncrement) {
+    time += timeIncrement;
+    pendingTimeDelta += timeIncrement;
+    writeValues();
+  }
+
+  /// Write all buffered records to the output stream and stop the background
+  /// thread. No more timesteps can be written afterwards.
+  void close() {
+    if (!writerThread.joinable())
+      return;
+    if (!block.empty())
+      queueBlock();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closing = true;
+    }
+    blockQueued.notify_all();
+    writerThread.join();
+    os.flush();
+  }
+
+  size_t time = 0;
+
+private:
+  struct TraceSignal {
+    unsigned offset;
+    unsigned numBytes;
+    unsigned numBits;
+  };
+
+  /// A word of the state buffer that contains traced signals, and the range of
+  /// signals in `sortedSignals` overlapping it.
+  struct TracedWord {
+    unsigned offset;
+    unsigned firstSignal;
+    unsigned lastSignal;
+  };
+
+  static constexpr size_t maxQueuedBlocks = 4;
+
+  static void appendVarInt(std::vector<uint8_t> &buffer, uint64_t value) {
+    do {
+      uint8_t byte = value & 0x7f;
+      value >>= 7;
+      buffer.push_back(value ? byte | 0x80 : byte);
+    } while (value);
+  }
+
+  /// Determine which words of the state buffer need to be compared in order to
+  /// detect changes of the traced signals.
+  void buildWordIndex() {
+    sortedSignals.resize(signals.size());
+    for (unsigned i = 0; i < signals.size(); ++i)
+      sortedSignals[i] = i;
+    std::stable_sort(sortedSignals.begin(), sortedSignals.end(),
+                     [&](unsigned a, unsigned b) {
+                       return signals[a].offset < signals[b].offset;
+                     });
+
+    tracedWords.clear();
+    for (unsigned i = 0; i < sortedSignals.size(); ++i) {
+      auto &signal = signals[sortedSignals[i]];
+      if (signal.numBytes == 0)
+        continue;
+      unsigned firstWord = signal.offset / 8;
+      unsigned lastWord = (signal.offset + signal.numBytes - 1) / 8;
+      for (unsigned word = firstWord; word <= lastWord; ++word) {
+        if (!tracedWords.empty() && tracedWords.back().offset == word * 8) {
+          tracedWords.back().lastSignal = i + 1;
+          continue;
+        }
+        tracedWords.push_back(TracedWord{word * 8, i, i + 1});
+      }
+    }
+  }
+
+  void writeValues(bool includeUnchanged = false) {
+    changedSignals.clear();
+    if (includeUnchanged) {
+      for (unsigned i = 0; i < signals.size(); ++i)
+        changedSignals.push_back(i);
+      std::copy(state, state + previousValues.size(), previousValues.begin());
+    } else {
+      unsigned nextSignal = 0;
+      for (auto &word : tracedWords) {
+        const uint8_t *valNew = state + word.offset;
+        uint8_t *valOld = &previousValues[0] + word.offset;
+        size_t numBytes = std::min<size_t>(8, previousValues.size() -
+                                                  word.offset);
+        if (numBytes == 8) {
+          uint64_t newWord, oldWord;
+          std::memcpy(&newWord, valNew, 8);
+          std::memcpy(&oldWord, valOld, 8);
+          if (newWord == oldWord)
+            continue;
+        } else if (std::equal(valNew, valNew + numBytes, valOld)) {
+          continue;
+        }
+
+        // Signals spanning multiple words have already been checked if an
+        // earlier word changed.
+        for (unsigned i = std::max(word.firstSignal, nextSignal);
+             i < word.lastSignal; ++i) {
+          auto &signal = signals[sortedSignals[i]];
+          if (!std::equal(state + signal.offset,
+                          state + signal.offset + signal.numBytes,
+                          &previousValues[0] + signal.offset))
+            changedSignals.push_back(sortedSignals[i]);
+        }
+        nextSignal = std::max(nextSignal, word.lastSignal);
+        std::copy(valNew, valNew + numBytes, valOld);
+      }
+    }
+    if (changedSignals.empty())
+      return;
+    std::sort(changedSignals.begin(), changedSignals.end());
+
+    appendVarInt(block, pendingTimeDelta);
+    appendVarInt(block, changedSignals.size());
+    for (auto index : changedSignals) {
+      auto &signal = signals[index];
+      appendVarInt(block, index);
+      block.insert(block.end(), state + signal.offset,
+                   state + signal.offset + signal.numBytes);
+    }
+    pendingTimeDelta = 0;
+    if (block.size() >= blockSize)
+      queueBlock();
+  }
+
+  /// Hand the current block over to the writer thread. Blocks if the writer
+  /// falls too far behind, to bound the memory used by queued blocks.
+  void queueBlock() {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      blockWritten.wait(lock,
+                        [&] { return queuedBlocks.size() < maxQueuedBlocks; });
+      queuedBlocks.push_back(std::move(block));
+    }
+    blockQueued.notify_one();
+    block = std::vector<uint8_t>();
+    block.reserve(blockSize);
+  }
+
+  void writerLoop() {
+    std::vector<uint8_t> compressed;
+    std::vector<uint32_t> hashTable;
+    while (true) {
+      std::vector<uint8_t> rawBlock;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        blockQueued.wait(lock,
+                         [&] { return closing || !queuedBlocks.empty(); });
+        if (queuedBlocks.empty())
+          return;
+        rawBlock = std::move(queuedBlocks.front());
+        queuedBlocks.erase(queuedBlocks.begin());
+      }
+      blockWritten.notify_one();
+
+      compressed.clear();
+      compress(rawBlock, compressed, hashTable);
+      std::vector<uint8_t> blockHeader;
+      appendVarInt(blockHeader, rawBlock.size());
+      appendVarInt(blockHeader, compressed.size());
+      os.write(reinterpret_cast<const char *>(blockHeader.data()),
+               blockHeader.size());
+      os.write(reinterpret_cast<const char *>(compressed.data()),
+               compressed.size());
+    }
+  }
+
+  static void compress(const std::vector<uint8_t> &src,
+                       std::vector<uint8_t> &dst,
+                       std::vector<uint32_t> &hashTable) {
+    constexpr unsigned hashBits = 16;
+    constexpr size_t minMatch = 4;
+    constexpr size_t maxDistance = 1 << 20;
+    hashTable.assign(size_t(1) << hashBits, UINT32_MAX);
+
+    auto emitLiterals = [&](size_t begin, size_t end) {
+      appendVarInt(dst, end - begin);
+      dst.insert(dst.end(), src.begin() + begin, src.begin() + end);
+    };
+
+    size_t pos = 0, literalStart = 0, size = src.size();
+    while (pos + minMatch <= size) {
+      uint32_t key;
+      std::memcpy(&key, &src[pos], sizeof(key));
+      uint32_t hash = (key * 2654435761U) >> (32 - hashBits);
+      uint32_t candidate = hashTable[hash];
+      hashTable[hash] = pos;
+      if (candidate == UINT32_MAX || pos - candidate > maxDistance ||
+          std::memcmp(&src[candidate], &src[pos], minMatch) != 0) {
+        ++pos;
+        continue;
+      }
+      size_t length = minMatch;
+      while (pos + length < size &&
+             src[candidate + length] == src[pos + length])
+        ++length;
+      emitLiterals(literalStart, pos);
+      appendVarInt(dst, length);
+      appendVarInt(dst, pos - candidate);
+      pos += length;
+      literalStart = pos;
+    }
+    emitLiterals(literalStart, size);
+    appendVarInt(dst, 0);
+  }
+
+  std::basic_ostream<char> &os;
+  const uint8_t *state;
+  size_t blockSize;
+  std::vector<TraceSignal> signals;
+  std::vector<unsigned> sortedSignals;
+  std::vector<TracedWord> tracedWords;
+  std::vector<unsigned> changedSignals;
+  std::vector<uint8_t> previousValues;
+  std::vector<uint8_t> block;
+  size_t pendingTimeDelta = 0;
+
+  std::mutex mutex;
+  std::condition_variable blockQueued;
+  std::condition_variable blockWritten;
+  std::vector<std::vector<uint8_t>> queuedBlocks;
+  bool closing = false;
+  std::thread writerThread;
 };
 
 // NOLINTEND
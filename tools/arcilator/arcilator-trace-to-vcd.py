@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+# Convert a binary trace written by `BinaryTraceWriter` in arcilator-runtime.h
+# into a VCD file equivalent to what `ValueChangeDump` would have produced.
+import argparse
+import sys
+from dataclasses import dataclass
+from typing import *
+
+MAGIC = b"ARCTRACE"
+VERSION = 1
+
+
+class Reader:
+
+  def __init__(self, data: bytes):
+    self.data = data
+    self.pos = 0
+
+  def at_end(self) -> bool:
+    return self.pos >= len(self.data)
+
+  def byte(self) -> int:
+    value = self.data[self.pos]
+    self.pos += 1
+    return value
+
+  def bytes(self, n: int) -> bytes:
+    value = self.data[self.pos:self.pos + n]
+    if len(value) != n:
+      raise ValueError("unexpected end of trace")
+    self.pos += n
+    return value
+
+  def varint(self) -> int:
+    value = 0
+    shift = 0
+    while True:
+      byte = self.byte()
+      value |= (byte & 0x7f) << shift
+      shift += 7
+      if not byte & 0x80:
+        return value
+
+  def string(self) -> str:
+    return self.bytes(self.varint()).decode()
+
+
+def decompress(data: bytes, raw_size: int) -> bytes:
+  reader = Reader(data)
+  out = bytearray()
+  while not reader.at_end():
+    out += reader.bytes(reader.varint())
+    length = reader.varint()
+    if length == 0:
+      continue
+    start = len(out) - reader.varint()
+    if start < 0:
+      raise ValueError("invalid match distance in trace block")
+    # Matches may overlap the bytes they produce.
+    for i in range(length):
+      out.append(out[start + i])
+  if len(out) != raw_size:
+    raise ValueError("trace block has unexpected size")
+  return bytes(out)
+
+
+@dataclass
+class TraceSignal:
+  abbrev: str
+  num_bits: int
+  num_bytes: int
+
+
+def vcd_abbrev(index: int) -> str:
+  abbrev = ""
+  rest = index + 1
+  while rest != 0:
+    c = (rest % 84) + 33
+    if c >= ord("0"):
+      c += 10
+    abbrev += chr(c)
+    rest //= 84
+  return abbrev
+
+
+def format_value(signal: TraceSignal, value: bytes) -> str:
+  bits = int.from_bytes(value, "little")
+  if signal.num_bits == 1:
+    return f"{bits & 1}{signal.abbrev}\n"
+  return f"b{bits & ((1 << signal.num_bits) - 1):0{signal.num_bits}b} {signal.abbrev}\n"
+
+
+def convert(data: bytes, out: TextIO):
+  reader = Reader(data)
+  if reader.bytes(len(MAGIC)) != MAGIC:
+    raise ValueError("not an arcilator trace")
+  version = reader.varint()
+  if version != VERSION:
+    raise ValueError(f"unsupported trace version {version}")
+
+  out.write("$date\n    October 21, 2015\n$end\n")
+  out.write("$version\n    Some cryptic MLIR magic\n$end\n")
+  out.write("$timescale 1ns $end\n")
+
+  signals: List[TraceSignal] = []
+  while True:
+    kind = reader.byte()
+    if kind == 0:
+      break
+    if kind == 1:
+      out.write(f"$scope module {reader.string()} $end\n")
+    elif kind == 2:
+      out.write("$upscope $end\n")
+    elif kind == 3:
+      is_reg = reader.varint()
+      num_bits = reader.varint()
+      name = reader.string()
+      signal = TraceSignal(vcd_abbrev(len(signals)), num_bits,
+                           (num_bits + 7) // 8)
+      signals.append(signal)
+      line = f"$var {'reg' if is_reg else 'wire'} {num_bits} {signal.abbrev} {name}"
+      if num_bits > 1:
+        line += f" [{num_bits - 1}:0]"
+      out.write(line + " $end\n")
+    else:
+      raise ValueError(f"invalid header record {kind}")
+  out.write("$enddefinitions $end\n")
+
+  time = 0
+  is_first = True
+  while not reader.at_end():
+    raw_size = reader.varint()
+    block = Reader(decompress(reader.bytes(reader.varint()), raw_size))
+    while not block.at_end():
+      time += block.varint()
+      # The initial values are recorded at time 0 by `writeDumpvars`.
+      if is_first and time == 0:
+        out.write("$dumpvars\n")
+      else:
+        out.write(f"#{time}\n")
+      is_first = False
+      for _ in range(block.varint()):
+        signal = signals[block.varint()]
+        out.write(format_value(signal, block.bytes(signal.num_bytes)))
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(
+      description="Convert an arcilator binary trace into a VCD file")
+  parser.add_argument("trace",
+                      metavar="TRACE",
+                      help="binary trace file to convert")
+  parser.add_argument("-o",
+                      "--output",
+                      metavar="FILE",
+                      help="output VCD file (default: stdout)")
+  args = parser.parse_args()
+
+  with open(args.trace, "rb") as f:
+    data = f.read()
+  if args.output:
+    with open(args.output, "w") as f:
+      convert(data, f)
+  else:
+    convert(data, sys.stdout)
@@ -37,6 +37,9 @@
 #include "circt/Support/Passes.h"
 #include "circt/Support/Version.h"
 #include "circt/Tools/arcilator/pipelines.h"
+#ifdef ARCILATOR_ENABLE_JIT
+#include "JITCache.h"
+#endif // ARCILATOR_ENABLE_JIT
 #include "mlir/Bytecode/BytecodeReader.h"
 #include "mlir/Bytecode/BytecodeWriter.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
@@ -65,16 +68,19 @@
 #include "mlir/Target/LLVMIR/Export.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "mlir/Transforms/Passes.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/ToolOutputFile.h"
 
+#include <chrono>
 #include <optional>
 
 using namespace mlir;
@@ -150,6 +156,12 @@ static llvm::cl::opt<bool>
                    llvm::cl::desc("Optimize arcs into lookup tables"),
                    llvm::cl::init(true), llvm::cl::cat(mainCategory));
 
+static llvm::cl::opt<bool> shouldSkipUnchanged(
+    "skip-unchanged-states",
+    llvm::cl::desc("Skip evaluating states whose inputs have not changed since "
+                   "their last update"),
+    llvm::cl::init(false), llvm::cl::cat(mainCategory));
+
 static llvm::cl::opt<bool>
     printDebugInfo("print-debug-info",
                    llvm::cl::desc("Print debug information"),
@@ -183,6 +195,25 @@ static llvm::cl::opt<unsigned> splitFuncsThreshold(
         "Split large MLIR functions that occur above the given size threshold"),
     llvm::cl::ValueOptional, llvm::cl::cat(mainCategory));
 
+static llvm::cl::opt<unsigned> evalPartitions(
+    "eval-partitions",
+    llvm::cl::desc("Split the model evaluation into up to the given number of "
+                   "partitions that can be evaluated concurrently"),
+    llvm::cl::init(0), llvm::cl::cat(mainCategory));
+
+static llvm::cl::opt<bool> dirtyFlags(
+    "dirty-flags",
+    llvm::cl::desc("Track writes to observable states in dirty flags, such "
+                   "that waveform dumps only visit states that were written"),
+    llvm::cl::init(false), llvm::cl::cat(mainCategory));
+
+static llvm::cl::opt<unsigned>
+    lanes("lanes",
+          llvm::cl::desc("Simulate the given number of model instances in "
+                         "lock-step, storing each state of all instances "
+                         "contiguously"),
+          llvm::cl::init(0), llvm::cl::cat(mainCategory));
+
 // Options to control early-out from pipeline.
 enum Until {
   UntilPreprocessing,
@@ -236,6 +267,23 @@ static llvm::cl::list<std::string>
             llvm::cl::ZeroOrMore, llvm::cl::CommaSeparated,
             llvm::cl::cat(mainCategory));
 
+static llvm::cl::opt<std::string> jitReportFile(
+    "jit-report",
+    llvm::cl::desc("Write the compile time, execution time, and state size "
+                   "of the simulation run to a JSON file"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""),
+    llvm::cl::cat(mainCategory));
+
+static llvm::cl::opt<std::string> jitCacheDir(
+    "jit-cache",
+    llvm::cl::desc("Cache JIT-compiled code in the given directory, skipping "
+                   "compilation of unchanged inputs and functions"),
+    llvm::cl::value_desc("directory"), llvm::cl::init(""),
+    llvm::cl::cat(mainCategory));
+
+/// The command line the tool was invoked with.
+static std::vector<std::string> commandLineArgs;
+
 //===----------------------------------------------------------------------===//
 // Main Tool Logic
 //===----------------------------------------------------------------------===//
@@ -283,6 +331,7 @@ static void populateHwModuleToArcPipeline(PassManager &pm) {
   optimizationOpt.shouldDetectEnables = shouldDetectEnables;
   optimizationOpt.shouldDetectResets = shouldDetectResets;
   optimizationOpt.shouldMakeLUTs = shouldMakeLUTs;
+  optimizationOpt.shouldSkipUnchanged = shouldSkipUnchanged;
   populateArcOptimizationPipeline(pm, optimizationOpt);
 
   // Lower stateful arcs into explicit state reads and writes.
@@ -299,12 +348,274 @@ static void populateHwModuleToArcPipeline(PassManager &pm) {
 
   ArcStateAllocationOptions allocationOpt;
   allocationOpt.splitFuncsThreshold = splitFuncsThreshold;
+  allocationOpt.numEvalPartitions = evalPartitions;
+  allocationOpt.dirtyFlags = dirtyFlags;
+  allocationOpt.numLanes = lanes;
   populateArcStateAllocationPipeline(pm, allocationOpt);
 }
 
+#ifdef ARCILATOR_ENABLE_JIT
+/// Measurements of a JIT simulation run, written to `--jit-report`.
+struct JitReport {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  Clock::time_point pipelineDone, compileDone, executeDone;
+  SmallVector<arc::ModelInfo> models;
+  bool cacheHit = false;
+  unsigned numCompiledFunctions = 0;
+  unsigned numCachedFunctions = 0;
+};
+
+static LogicalResult writeJitReport(const JitReport &report) {
+  std::error_code ec;
+  llvm::ToolOutputFile outputFile(jitReportFile, ec,
+                                  llvm::sys::fs::OpenFlags::OF_None);
+  if (ec) {
+    llvm::errs() << "unable to open JIT report file: " << ec.message() << '\n';
+    return failure();
+  }
+
+  auto seconds = [](JitReport::Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+  };
+  llvm::json::OStream json(outputFile.os(), 2);
+  json.object([&] {
+    json.attribute("pipelineSeconds",
+                   seconds(report.pipelineDone - report.start));
+    json.attribute("jitSeconds",
+                   seconds(report.compileDone - report.pipelineDone));
+    json.attribute("compileSeconds",
+                   seconds(report.compileDone - report.start));
+    json.attribute("executeSeconds",
+                   seconds(report.executeDone - report.compileDone));
+    json.attributeArray("models", [&] {
+      for (auto &model : report.models)
+        json.object([&] {
+          json.attribute("name", model.name);
+          json.attribute("numStateBytes", model.numStateBytes);
+        });
+    });
+    if (!jitCacheDir.empty())
+      json.attributeObject("jitCache", [&] {
+        json.attribute("hit", report.cacheHit);
+        json.attribute("compiledFunctions", report.numCompiledFunctions);
+        json.attribute("cachedFunctions", report.numCachedFunctions);
+      });
+  });
+  outputFile.os() << '\n';
+  outputFile.keep();
+  return success();
+}
+
+/// Check that the `--args` can be split into groups of arguments for an entry
+/// point with `numArgs` arguments.
+static LogicalResult checkJITArgs(unsigned numArgs) {
+  if (numArgs) {
+    if (jitArgs.size() % numArgs != 0) {
+      llvm::errs() << "entry point '" << jitEntryPoint << "' has " << numArgs
+                   << " arguments, but provided " << jitArgs.size()
+                   << " arguments (not a multiple)\n";
+      return failure();
+    }
+    if (jitArgs.empty()) {
+      llvm::errs() << "entry point '" << jitEntryPoint
+                   << "' must have no arguments\n";
+      return failure();
+    }
+  } else if (!jitArgs.empty()) {
+    llvm::errs() << "entry point '" << jitEntryPoint
+                 << "' has no arguments, but provided " << jitArgs.size()
+                 << "arguments\n";
+    return failure();
+  }
+  return success();
+}
+
+/// Call the JIT-compiled entry point once for each group of `--args`, and
+/// write the JIT report if requested.
+static LogicalResult runJITEntry(void (*simulationFunc)(void **),
+                                 ArrayRef<unsigned> argWidths,
+                                 JitReport &report) {
+  unsigned numArgs = argWidths.size();
+  for (unsigned i = 0, e = jitArgs.size(); i < e; i += numArgs) {
+    std::vector<std::vector<uint64_t>> argsStorage;
+    SmallVector<void *> args;
+    argsStorage.reserve(numArgs);
+    args.reserve(numArgs);
+
+    // Repeated args are concatenated, so break apart in groups of multiples
+    // of args.
+    for (auto [val, width] :
+         llvm::zip(llvm::make_range(jitArgs.begin() + i,
+                                    jitArgs.begin() + i + numArgs),
+                   argWidths)) {
+      APInt apVal(width, 0);
+      if (StringRef(val).getAsInteger(0, apVal)) {
+        llvm::errs() << "invalid integer argument: '" << val << "'\n";
+        return failure();
+      }
+      if (apVal.getBitWidth() > width) {
+        llvm::errs() << "integer argument '" << val << "' (required width "
+                     << apVal.getBitWidth() << ") is too large for type 'i"
+                     << width << "'\n";
+        return failure();
+      }
+
+      std::vector<uint64_t> argData;
+      unsigned numWords = apVal.getNumWords();
+      argData.resize(numWords);
+      const uint64_t *rawData = apVal.getRawData();
+      for (unsigned j = 0; j < numWords; ++j)
+        argData[j] = rawData[j];
+
+      argsStorage.push_back(std::move(argData));
+      args.push_back(argsStorage.back().data());
+    }
+
+    (*simulationFunc)(args.data());
+  }
+  // Handle the case without arguments as before.
+  if (jitArgs.empty())
+    (*simulationFunc)(nullptr);
+  report.executeDone = JitReport::Clock::now();
+
+  if (!jitReportFile.empty())
+    return writeJitReport(report);
+  return success();
+}
+
+/// Describe the command line options that affect how the input is compiled,
+/// as part of the key under which a compiled program is cached. This covers
+/// every option given on the command line, looked up in the registered options
+/// to tell their values apart from the input file, whose contents are part of
+/// the key instead. Options that only affect execution or what is reported are
+/// left out, such that they do not prevent cache hits.
+static std::string getJITCacheOptions() {
+  static const llvm::StringSet<> ignoredOptions = {
+      "args", "jit-cache", "jit-report", "o", "shared-libs", "state-file"};
+  auto &registeredOptions = llvm::cl::getRegisteredOptions();
+  std::string options;
+  llvm::raw_string_ostream os(options);
+  for (size_t i = 1, e = commandLineArgs.size(); i < e; ++i) {
+    StringRef arg = commandLineArgs[i];
+    if (!arg.starts_with("-") || arg == "-")
+      continue;
+    auto [name, value] = arg.ltrim('-').split('=');
+    auto *option = registeredOptions.lookup(name);
+    bool hasSeparateValue =
+        option && !arg.contains('=') &&
+        option->getValueExpectedFlag() == llvm::cl::ValueRequired && i + 1 < e;
+    if (!ignoredOptions.contains(name)) {
+      os << arg << '\0';
+      if (hasSeparateValue)
+        os << commandLineArgs[i + 1] << '\0';
+    }
+    if (hasSeparateValue)
+      ++i;
+  }
+  return options;
+}
+
+/// Whether any of the options that inspect or instrument the lowering
+/// pipeline is given. A cached program skips the pipeline, so the program
+/// cache is not used in that case.
+static bool isPipelineInspected() {
+  if (verbosePassExecutions)
+    return true;
+  for (auto &option : llvm::cl::getRegisteredOptions())
+    if (option.getKey().starts_with("mlir-") &&
+        option.getValue()->getNumOccurrences())
+      return true;
+  return false;
+}
+
+/// Write the model description produced by the lowering pipeline to the
+/// `--state-file`.
+static LogicalResult writeStateFile(StringRef modelInfo) {
+  std::error_code ec;
+  llvm::ToolOutputFile outputFile(stateFile, ec,
+                                  llvm::sys::fs::OpenFlags::OF_None);
+  if (ec) {
+    llvm::errs() << "unable to open state file: " << ec.message() << '\n';
+    return failure();
+  }
+  outputFile.os() << modelInfo;
+  outputFile.keep();
+  return success();
+}
+
+/// Recover the models listed in the JIT report from a cached model description.
+static LogicalResult parseCachedModels(StringRef modelInfo,
+                                       SmallVectorImpl<ModelInfo> &models) {
+  auto json = llvm::json::parse(modelInfo);
+  if (!json) {
+    llvm::consumeError(json.takeError());
+    return failure();
+  }
+  auto *array = json->getAsArray();
+  if (!array)
+    return failure();
+  for (auto &value : *array) {
+    auto *object = value.getAsObject();
+    if (!object)
+      return failure();
+    auto name = object->getString("name");
+    auto numStateBytes = object->getInteger("numStateBytes");
+    if (!name || !numStateBytes)
+      return failure();
+    models.emplace_back(name->str(), *numStateBytes,
+                        SmallVector<StateInfo>{}, FlatSymbolRefAttr{},
+                        FlatSymbolRefAttr{});
+  }
+  return success();
+}
+#endif // ARCILATOR_ENABLE_JIT
+
 static LogicalResult processBuffer(
     MLIRContext &context, TimingScope &ts, llvm::SourceMgr &sourceMgr,
     std::optional<std::unique_ptr<llvm::ToolOutputFile>> &outputFile) {
+#ifdef ARCILATOR_ENABLE_JIT
+  JitReport jitReport;
+  std::vector<std::string> sharedLibPaths(sharedLibs.begin(),
+                                          sharedLibs.end());
+
+  if (outputFormat == OutputRunJIT &&
+      (runUntilBefore != UntilEnd || runUntilAfter != UntilEnd)) {
+    llvm::errs() << "full pipeline must be run for JIT execution\n";
+    return failure();
+  }
+
+  // Run a previously compiled program straight from the cache if neither the
+  // input nor the options have changed. The model description is replayed to
+  // the state file and JIT report as if the pipeline had run.
+  std::optional<arcilator::JITCache> jitCache;
+  std::string jitCacheKey;
+  if (outputFormat == OutputRunJIT && !jitCacheDir.empty() &&
+      !isPipelineInspected()) {
+    jitCache.emplace(jitCacheDir);
+    auto input =
+        sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID())->getBuffer();
+    jitCacheKey = arcilator::JITCache::getKey(
+        {getCirctVersion(), getJITCacheOptions(), input});
+    if (auto program = jitCache->load(jitCacheKey, sharedLibPaths)) {
+      if (failed(checkJITArgs(program->argWidths.size())))
+        return failure();
+      if (!stateFile.empty() && failed(writeStateFile(program->modelInfo)))
+        return failure();
+      if (!jitReportFile.empty() &&
+          failed(parseCachedModels(program->modelInfo, jitReport.models))) {
+        llvm::errs() << "failed to read cached model info\n";
+        return failure();
+      }
+      jitReport.cacheHit = true;
+      jitReport.pipelineDone = jitReport.compileDone = JitReport::Clock::now();
+      auto tsJit = ts.nest("JIT");
+      auto tsExecute = tsJit.nest("Execute");
+      return runJITEntry(program->entry, program->argWidths, jitReport);
+    }
+  }
+#endif // ARCILATOR_ENABLE_JIT
+
   mlir::OwningOpRef<mlir::ModuleOp> module;
   {
     auto parserTimer = ts.nest("Parse MLIR input");
@@ -324,22 +635,30 @@ static LogicalResult processBuffer(
   if (failed(pmArc.run(module.get())))
     return failure();
 
-  // Output state info as JSON if requested.
-  if (!stateFile.empty() && !untilReached(UntilStateLowering)) {
-    std::error_code ec;
-    llvm::ToolOutputFile outputFile(stateFile, ec,
-                                    llvm::sys::fs::OpenFlags::OF_None);
-    if (ec) {
-      llvm::errs() << "unable to open state file: " << ec.message() << '\n';
-      return failure();
-    }
-    if (failed(collectAndExportModelInfo(module.get(), outputFile.os()))) {
+  // Output state info as JSON if requested, and capture it for the JIT report
+  // and cache before the models are lowered away.
+  std::string modelInfo;
+  bool needsModelInfo = !stateFile.empty() && !untilReached(UntilStateLowering);
+#ifdef ARCILATOR_ENABLE_JIT
+  needsModelInfo |= jitCache.has_value() ||
+                    (!jitReportFile.empty() && outputFormat == OutputRunJIT);
+#endif // ARCILATOR_ENABLE_JIT
+  if (needsModelInfo) {
+    SmallVector<ModelInfo> models;
+    if (failed(collectModels(module.get(), models))) {
       llvm::errs() << "failed to collect model info\n";
       return failure();
     }
-
-    outputFile.keep();
+    llvm::raw_string_ostream os(modelInfo);
+    serializeModelInfoToJson(os, models);
+#ifdef ARCILATOR_ENABLE_JIT
+    if (!jitReportFile.empty() && outputFormat == OutputRunJIT)
+      jitReport.models = std::move(models);
+#endif // ARCILATOR_ENABLE_JIT
   }
+  if (!stateFile.empty() && !untilReached(UntilStateLowering) &&
+      failed(writeStateFile(modelInfo)))
+    return failure();
 
   // Lower Arc model to LLVM IR.
   PassManager pmLlvm(&context);
@@ -365,12 +684,8 @@ static LogicalResult processBuffer(
 #ifdef ARCILATOR_ENABLE_JIT
   // Handle JIT execution.
   if (outputFormat == OutputRunJIT) {
+    jitReport.pipelineDone = JitReport::Clock::now();
     auto tsJit = ts.nest("JIT");
-    if (runUntilBefore != UntilEnd || runUntilAfter != UntilEnd) {
-      llvm::errs() << "full pipeline must be run for JIT execution\n";
-      return failure();
-    }
-
     Operation *toCall = module->lookupSymbol(jitEntryPoint);
     if (!toCall) {
       llvm::errs() << "entry point not found: '" << jitEntryPoint << "'\n";
@@ -386,24 +701,44 @@ static LogicalResult processBuffer(
       return failure();
     }
 
-    unsigned numArgs = toCallFunc.getNumArguments();
-    if (numArgs) {
-      if (jitArgs.size() % numArgs != 0) {
-        llvm::errs() << "entry point '" << jitEntryPoint << "' has " << numArgs
-                     << " arguments, but provided " << jitArgs.size()
-                     << " arguments (not a multiple)\n";
+    if (failed(checkJITArgs(toCallFunc.getNumArguments())))
+      return failure();
+
+    SmallVector<unsigned> argWidths;
+    for (auto arg : toCallFunc.getArguments()) {
+      auto type = arg.getType();
+      if (!type.isIntOrIndex()) {
+        llvm::errs() << "argument " << arg.getArgNumber()
+                     << " of entry point '" << jitEntryPoint
+                     << "' is not an integer or index type\n";
         return failure();
       }
-      if (jitArgs.empty()) {
-        llvm::errs() << "entry point '" << jitEntryPoint
-                     << "' must have no arguments\n";
+      // TODO: This should probably be checking if DLTI is set on module.
+      argWidths.push_back(type.isIndex() ? 64 : type.getIntOrFloatBitWidth());
+    }
+
+    // Compile through the cache if requested, reusing the object files of
+    // functions that have not changed since a previous run.
+    if (jitCache) {
+      auto tsCompile = tsJit.nest("Compile");
+      auto program =
+          jitCache->compile(module.get(), jitEntryPoint, argWidths, modelInfo,
+                            jitCacheKey, sharedLibPaths);
+      if (!program) {
+        llvm::handleAllErrors(
+            program.takeError(), [](const llvm::ErrorInfoBase &info) {
+              llvm::errs() << "failed to compile simulation: "
+                           << info.message() << "\n";
+            });
         return failure();
       }
-    } else if (!jitArgs.empty()) {
-      llvm::errs() << "entry point '" << jitEntryPoint
-                   << "' has no arguments, but provided " << jitArgs.size()
-                   << "arguments\n";
-      return failure();
+      tsCompile.stop();
+      jitReport.compileDone = JitReport::Clock::now();
+      jitReport.numCompiledFunctions = jitCache->numCompiledFunctions;
+      jitReport.numCachedFunctions = jitCache->numCachedFunctions;
+
+      auto tsExecute = tsJit.nest("Execute");
+      return runJITEntry(program->entry, program->argWidths, jitReport);
     }
 
     SmallVector<StringRef, 4> sharedLibraries(sharedLibs.begin(),
@@ -440,62 +775,10 @@ static LogicalResult processBuffer(
       return failure();
     }
     tsCompile.stop();
+    jitReport.compileDone = JitReport::Clock::now();
 
     auto tsExecute = tsJit.nest("Execute");
-    void (*simulationFunc)(void **) = *expectedFunc;
-
-    for (unsigned i = 0, e = jitArgs.size(); i < e; i += numArgs) {
-      std::vector<std::vector<uint64_t>> argsStorage;
-      SmallVector<void *> args;
-      argsStorage.reserve(numArgs);
-      args.reserve(numArgs);
-
-      // Repeated args are concatenated, so break apart in groups of multiples
-      // of args.
-      for (auto [val, arg] :
-           llvm::zip(llvm::make_range(jitArgs.begin() + i,
-                                      jitArgs.begin() + i + numArgs),
-                     toCallFunc.getArguments())) {
-        auto type = arg.getType();
-        if (!type.isIntOrIndex()) {
-          llvm::errs() << "argument " << arg.getArgNumber()
-                       << " of entry point '" << jitEntryPoint
-                       << "' is not an integer or index type\n";
-          return failure();
-        }
-
-        // TODO: This should probably be checking if DLTI is set on module.
-        unsigned width = type.isIndex() ? 64 : type.getIntOrFloatBitWidth();
-        APInt apVal(width, 0);
-        if (StringRef(val).getAsInteger(0, apVal)) {
-          llvm::errs() << "invalid integer argument: '" << val << "'\n";
-          return failure();
-        }
-        if (apVal.getBitWidth() > width) {
-          llvm::errs() << "integer argument '" << val << "' (required width "
-                       << apVal.getBitWidth() << ") is too large for type '"
-                       << type << "'\n";
-          return failure();
-        }
-
-        std::vector<uint64_t> argData;
-        unsigned numWords = apVal.getNumWords();
-        argData.resize(numWords);
-        const uint64_t *rawData = apVal.getRawData();
-        for (unsigned j = 0; j < numWords; ++j)
-          argData[j] = rawData[j];
-
-        argsStorage.push_back(std::move(argData));
-        args.push_back(argsStorage.back().data());
-      }
-
-      (*simulationFunc)(args.data());
-    }
-    // Handle the case without arguments as before.
-    if (jitArgs.empty())
-      (*simulationFunc)(nullptr);
-
-    return success();
+    return runJITEntry(*expectedFunc, argWidths, jitReport);
   }
 #endif // ARCILATOR_ENABLE_JIT
 
@@ -668,6 +951,18 @@ int main(int argc, char **argv) {
   llvm::cl::ParseCommandLineOptions(argc, argv,
                                     "MLIR-based circuit simulator\n");
 
+  // Keep the command line, with response files expanded, as part of the key
+  // of cached programs.
+  {
+    llvm::BumpPtrAllocator allocator;
+    SmallVector<const char *> args(argv, argv + argc);
+    llvm::cl::ExpansionContext expansion(allocator,
+                                         llvm::cl::TokenizeGNUCommandLine);
+    if (auto err = expansion.expandResponseFiles(args))
+      llvm::consumeError(std::move(err));
+    commandLineArgs.assign(args.begin(), args.end());
+  }
+
   if (outputFormat == OutputRunJIT) {
 #ifdef ARCILATOR_ENABLE_JIT
     llvm::InitializeNativeTarget();
@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "circt/Firtool/Firtool.h"
+#include "circt/Firtool/PassReport.h"
 #include "circt/Conversion/ExportVerilog.h"
 #include "circt/Conversion/Passes.h"
 #include "circt/Dialect/Comb/CombDialect.h"
@@ -226,6 +227,18 @@ static cl::opt<std::string>
                 cl::init(""), cl::value_desc("filename"),
                 cl::cat(mainCategory));
 
+static cl::opt<std::string> passReportFile(
+    "pass-report",
+    cl::desc("Output the wall time, CPU time, peak memory growth and op "
+             "counts of each pass to a JSON file"),
+    cl::init(""), cl::value_desc("filename"), cl::cat(mainCategory));
+
+static cl::opt<std::string> passBudgetsFile(
+    "pass-budgets",
+    cl::desc("Fail if a pass exceeds the wall time, CPU time or peak memory "
+             "growth budgeted for it in a JSON file"),
+    cl::init(""), cl::value_desc("filename"), cl::cat(mainCategory));
+
 static cl::opt<bool> emitHGLDD("emit-hgldd", cl::desc("Emit HGLDD debug info"),
                                cl::init(false), cl::cat(mainCategory));
 
@@ -465,12 +478,60 @@ static LogicalResult processBuffer(
   if (failed(applyPassManagerCLOptions(pm)))
     return failure();
 
+  // Record the resources used by each top-level pass if requested. Passes
+  // nested under a module are accounted for by the adaptor which runs them.
+  firtool::PassReportInstrumentation *passReport = nullptr;
+  firtool::PassBudgets passBudgets;
+  if (!passBudgetsFile.empty()) {
+    std::string error;
+    auto input = openInputFile(passBudgetsFile, &error);
+    if (!input) {
+      llvm::errs() << error << "\n";
+      return failure();
+    }
+    auto budgets = firtool::parsePassBudgets(input->getBuffer());
+    if (!budgets) {
+      llvm::errs() << "invalid pass budgets '" << passBudgetsFile
+                   << "': " << toString(budgets.takeError()) << "\n";
+      return failure();
+    }
+    passBudgets = std::move(*budgets);
+  }
+  if (!passReportFile.empty() || !passBudgetsFile.empty()) {
+    auto instrumentation =
+        std::make_unique<firtool::PassReportInstrumentation>([](Operation *op) {
+          return isa<mlir::ModuleOp, firrtl::CircuitOp>(op);
+        });
+    passReport = instrumentation.get();
+    pm.addInstrumentation(std::move(instrumentation));
+  }
+
+  // Run the pipeline, then write the report and check the budgets.
+  auto runPassManager = [&]() -> LogicalResult {
+    LogicalResult result = pm.run(module.get());
+    if (!passReport)
+      return result;
+    if (!passReportFile.empty()) {
+      std::string error;
+      auto reportFile = openOutputFile(passReportFile, &error);
+      if (!reportFile) {
+        llvm::errs() << error << "\n";
+        return failure();
+      }
+      passReport->writeJSON(reportFile->os());
+      reportFile->keep();
+    }
+    if (failed(passReport->checkBudgets(passBudgets, module.get())))
+      return failure();
+    return result;
+  };
+
   if (failed(firtool::populatePreprocessTransforms(pm, firtoolOptions)))
     return failure();
 
   // If the user asked for --parse-only, stop after running LowerAnnotations.
   if (outputFormat == OutputParseOnly) {
-    if (failed(pm.run(module.get())))
+    if (failed(runPassManager()))
       return failure();
     auto outputTimer = ts.nest("Print .mlir output");
     return printOp(*module, (*outputFile)->os());
@@ -565,7 +626,7 @@ static LogicalResult processBuffer(
     }
   }
 
-  if (failed(pm.run(module.get())))
+  if (failed(runPassManager()))
     return failure();
 
   if (outputFormat == OutputIRFir || outputFormat == OutputIRHW ||
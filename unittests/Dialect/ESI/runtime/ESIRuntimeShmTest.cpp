@@ -0,0 +1,375 @@
+//===- ESIRuntimeShmTest.cpp - ESI shared memory transport tests ----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "esi/Accelerator.h"
+#include "esi/Manifest.h"
+#include "esi/backends/ShmServer.h"
+#include "esi/backends/ShmTransport.h"
+#include "esi/backends/TraceFormat.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace esi;
+using namespace esi::backends::shm;
+
+namespace {
+
+/// A ring living in heap memory rather than a shared memory segment.
+class HeapRing {
+public:
+  HeapRing(uint64_t capacity)
+      : mem(std::aligned_alloc(64, ShmRing::getAllocSize(capacity)),
+            &std::free),
+        ring(ShmRing::init(mem.get(), capacity)) {}
+
+  ShmRing &operator*() { return ring; }
+  ShmRing *operator->() { return &ring; }
+
+private:
+  std::unique_ptr<void, decltype(&std::free)> mem;
+  ShmRing ring;
+};
+
+/// Build a message of `size` bytes whose contents depend on `seed`.
+MessageData makeMessage(size_t size, uint8_t seed) {
+  std::vector<uint8_t> bytes(size);
+  for (size_t i = 0; i < size; ++i)
+    bytes[i] = static_cast<uint8_t>(seed + i * 7);
+  return MessageData(std::move(bytes));
+}
+
+void expectMessage(const MessageData &msg, size_t size, uint8_t seed) {
+  ASSERT_EQ(msg.getSize(), size);
+  for (size_t i = 0; i < size; ++i)
+    EXPECT_EQ(msg.getBytes()[i], static_cast<uint8_t>(seed + i * 7));
+}
+
+/// Get a segment name which doesn't collide with other test processes.
+std::string getSegmentName(const std::string &suffix) {
+  return "/esi-test-" + std::to_string(getpid()) + "-" + suffix;
+}
+
+TEST(ESIShmTest, RingWrapAround) {
+  HeapRing ring(64);
+  // Odd sizes with records not dividing the capacity make both the length
+  // words and the payloads straddle the end of the data area.
+  const size_t sizes[] = {5, 13, 1, 20, 9};
+  uint8_t seed = 0;
+  for (int iter = 0; iter < 50; ++iter) {
+    size_t first = sizes[iter % 5], second = sizes[(iter + 2) % 5];
+    ASSERT_TRUE(ring->tryPush(makeMessage(first, seed)));
+    ASSERT_TRUE(ring->tryPush(makeMessage(second, seed + 1)));
+    MessageData msg;
+    ASSERT_TRUE(ring->tryPop(msg));
+    expectMessage(msg, first, seed);
+    ASSERT_TRUE(ring->tryPop(msg));
+    expectMessage(msg, second, seed + 1);
+    EXPECT_TRUE(ring->empty());
+    seed += 2;
+  }
+  MessageData msg;
+  EXPECT_FALSE(ring->tryPop(msg));
+}
+
+TEST(ESIShmTest, RingFull) {
+  HeapRing ring(64);
+  // Eight byte messages take 16 bytes each, so four of them fill the ring.
+  for (uint8_t i = 0; i < 4; ++i)
+    ASSERT_TRUE(ring->tryPush(makeMessage(8, i)));
+  EXPECT_FALSE(ring->tryPush(makeMessage(8, 4)));
+
+  MessageData msg;
+  ASSERT_TRUE(ring->tryPop(msg));
+  expectMessage(msg, 8, 0);
+  EXPECT_TRUE(ring->tryPush(makeMessage(8, 4)));
+  for (uint8_t i = 1; i < 5; ++i) {
+    ASSERT_TRUE(ring->tryPop(msg));
+    expectMessage(msg, 8, i);
+  }
+
+  // A message which could never fit is an error rather than a full ring.
+  EXPECT_THROW(ring->tryPush(makeMessage(64, 0)), std::runtime_error);
+  EXPECT_THROW(ShmRing::init(nullptr, 100), std::runtime_error);
+}
+
+TEST(ESIShmTest, RingBatch) {
+  HeapRing ring(64);
+  std::vector<MessageData> batch;
+  for (uint8_t i = 0; i < 6; ++i)
+    batch.push_back(makeMessage(8, i));
+
+  // Only the first four fit.
+  EXPECT_EQ(ring->tryPushBatch(batch), 4u);
+  std::vector<MessageData> out;
+  EXPECT_EQ(ring->tryPopBatch(3, out), 3u);
+  EXPECT_EQ(ring->tryPushBatch(std::span(batch).subspan(4)), 2u);
+  EXPECT_EQ(ring->tryPopBatch(10, out), 3u);
+  ASSERT_EQ(out.size(), 6u);
+  for (uint8_t i = 0; i < 6; ++i)
+    expectMessage(out[i], 8, i);
+  EXPECT_EQ(ring->tryPopBatch(10, out), 0u);
+  EXPECT_EQ(ring->tryPushBatch({}), 0u);
+}
+
+TEST(ESIShmTest, RingBatchOversized) {
+  HeapRing ring(64);
+  std::vector<MessageData> batch;
+  batch.push_back(makeMessage(8, 0));
+  batch.push_back(makeMessage(100, 1));
+  // Nothing may be published if the batch is rejected.
+  EXPECT_THROW(ring->tryPushBatch(batch), std::runtime_error);
+  EXPECT_TRUE(ring->empty());
+  EXPECT_TRUE(ring->tryPush(makeMessage(8, 2)));
+  MessageData msg;
+  ASSERT_TRUE(ring->tryPop(msg));
+  expectMessage(msg, 8, 2);
+}
+
+TEST(ESIShmTest, RingWaits) {
+  using namespace std::chrono_literals;
+  HeapRing ring(64);
+  EXPECT_FALSE(ring->waitForData(1ms));
+  EXPECT_TRUE(ring->waitForSpace(8, 1ms));
+
+  // Sleep on an empty ring until another thread pushes.
+  std::thread producer([&]() {
+    std::this_thread::sleep_for(20ms);
+    ring->tryPush(makeMessage(8, 0));
+  });
+  EXPECT_TRUE(ring->waitForData(5s));
+  producer.join();
+
+  for (uint8_t i = 1; i < 4; ++i)
+    ASSERT_TRUE(ring->tryPush(makeMessage(8, i)));
+  EXPECT_FALSE(ring->waitForSpace(8, 1ms));
+
+  // Sleep on a full ring until another thread pops.
+  std::thread consumer([&]() {
+    std::this_thread::sleep_for(20ms);
+    MessageData msg;
+    ring->tryPop(msg);
+  });
+  EXPECT_TRUE(ring->waitForSpace(8, 5s));
+  consumer.join();
+}
+
+TEST(ESISegmentTest, CreateOpen) {
+  std::string name = getSegmentName("segment");
+  auto server = ShmSegment::create(name, 1 << 20);
+  auto client = ShmSegment::open(name);
+
+  uint32_t esiVersion = 0;
+  std::vector<uint8_t> manifest;
+  EXPECT_FALSE(client->getManifest(esiVersion, manifest));
+  server->setManifest(1, {1, 2, 3});
+  ASSERT_TRUE(client->getManifest(esiVersion, manifest));
+  EXPECT_EQ(esiVersion, 1u);
+  EXPECT_EQ(manifest, std::vector<uint8_t>({1, 2, 3}));
+
+  ShmRing toClient = server->addChannel("out", "i8",
+                                        ShmSegment::Direction::ToClient, 100);
+  server->addChannel("in", "i16", ShmSegment::Direction::ToServer, 1);
+  // Capacities are rounded up to a power of two.
+  EXPECT_EQ(toClient.getCapacity(), 128u);
+
+  ShmSegment::ChannelDesc desc;
+  EXPECT_FALSE(client->getChannelDesc("missing", desc));
+  ASSERT_TRUE(client->getChannelDesc("out", desc));
+  EXPECT_EQ(desc.type, "i8");
+  EXPECT_EQ(desc.dir, ShmSegment::Direction::ToClient);
+  ASSERT_EQ(client->listChannels().size(), 2u);
+  EXPECT_EQ(client->listChannels()[1].ring.getCapacity(), 64u);
+
+  // Both sides see the same ring.
+  ASSERT_TRUE(toClient.tryPush(makeMessage(3, 9)));
+  MessageData msg;
+  ASSERT_TRUE(desc.ring.tryPop(msg));
+  expectMessage(msg, 3, 9);
+
+  EXPECT_FALSE(client->isClosed());
+  server->close();
+  EXPECT_TRUE(client->isClosed());
+
+  // The server removes the segment.
+  server.reset();
+  EXPECT_THROW(ShmSegment::open(name), std::runtime_error);
+}
+
+TEST(ESIShmServerTest, WriteBackpressure) {
+  using namespace std::chrono_literals;
+  // The server writes 'cosim.cfg' to the working directory.
+  std::filesystem::path oldCwd = std::filesystem::current_path();
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              ("esi-shm-test-" + std::to_string(getpid()));
+  std::filesystem::create_directories(dir);
+  std::filesystem::current_path(dir);
+
+  auto ctxt = Context::withLogger<NullLogger>();
+  std::string name = getSegmentName("server");
+  ShmServer server(*ctxt);
+  server.run(name, 1 << 20, 64, /*maxBacklog=*/2);
+  ShmServer::Channel &port = server.registerWritePort("out", "i8");
+
+  // The ring holds four messages and the backlog two more, so the last writes
+  // can only complete once the client drains the ring.
+  constexpr uint8_t numMessages = 10;
+  std::atomic<size_t> numPopped = 0;
+  std::thread client([&]() {
+    auto segment = ShmSegment::open(name);
+    ShmSegment::ChannelDesc desc;
+    ASSERT_TRUE(segment->getChannelDesc("out", desc));
+    std::this_thread::sleep_for(20ms);
+    while (numPopped < numMessages) {
+      MessageData msg;
+      if (!desc.ring.tryPop(msg)) {
+        desc.ring.waitForData(1ms);
+        continue;
+      }
+      expectMessage(msg, 8, static_cast<uint8_t>(numPopped));
+      ++numPopped;
+    }
+  });
+
+  for (uint8_t i = 0; i < numMessages; ++i)
+    port.write(makeMessage(8, i));
+  EXPECT_GE(numPopped, 4u);
+  while (numPopped < numMessages) {
+    server.flush();
+    std::this_thread::sleep_for(1ms);
+  }
+  client.join();
+  server.stop();
+
+  std::filesystem::current_path(oldCwd);
+  std::filesystem::remove_all(dir);
+}
+
+const char *loopbackManifest = R"({
+  "apiVersion": 0,
+  "serviceDeclarations": [{"symbol": "Svc", "serviceName": "test.svc"}],
+  "modules": [{"symbol": "Top"}],
+  "types": [
+    {"id": "ui8", "mnemonic": "int", "signedness": "unsigned",
+     "hwBitwidth": 8},
+    {"id": "loopback", "mnemonic": "bundle", "channels": [
+      {"name": "arg", "direction": "to", "type": {
+        "id": "!esi.channel<ui8>", "mnemonic": "channel", "inner": "ui8"}},
+      {"name": "result", "direction": "from", "type": {
+        "id": "!esi.channel<ui8>", "mnemonic": "channel", "inner": "ui8"}}]}
+  ],
+  "design": {
+    "instOf": "Top",
+    "engines": [{"appID": {"name": "engine"}, "serviceImplName": "cosim",
+                 "clientDetails": [
+      {"relAppIDPath": [{"name": "loop"}],
+       "channelAssignments": {
+         "arg": {"type": "cosim", "name": "loop.arg"},
+         "result": {"type": "cosim", "name": "loop.result"}}}]}],
+    "clientPorts": [
+      {"appID": {"name": "loop"}, "typeID": "loopback",
+       "servicePort": {"serviceName": "Svc", "port": "p"}}],
+    "children": []}
+})";
+
+// Test that a session with a real backend can be recorded and then replayed
+// by the trace backend.
+TEST(ESIShmServerTest, RecordAndReplay) {
+  using namespace std::chrono_literals;
+  // The server writes 'cosim.cfg' to the working directory, which also holds
+  // the manifest and the trace since the trace connection string can't contain
+  // colons.
+  std::filesystem::path oldCwd = std::filesystem::current_path();
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              ("esi-shm-replay-" + std::to_string(getpid()));
+  std::filesystem::create_directories(dir);
+  std::filesystem::current_path(dir);
+  std::ofstream("manifest.json") << loopbackManifest;
+
+  constexpr uint8_t numMessages = 5;
+  std::vector<MessageData> received;
+  {
+    auto ctxt = Context::withLogger<NullLogger>();
+    std::string name = getSegmentName("replay");
+    ShmServer server(*ctxt);
+    server.run(name, 1 << 20, 1 << 12);
+    ShmServer::Channel &arg = server.registerReadPort("loop.arg", "ui8");
+    ShmServer::Channel &result =
+        server.registerWritePort("loop.result", "ui8");
+
+    AcceleratorConnection *conn = ctxt->connect("shm", name);
+    conn->recordTrace("session.trace");
+    Manifest manifest(*ctxt, loopbackManifest);
+    Accelerator *accel = manifest.buildAccelerator(*conn);
+    BundlePort &loop = accel->getPorts().at(AppID("loop"));
+    WriteChannelPort &write = loop.getRawWrite("arg");
+    ReadChannelPort &read = loop.getRawRead("result");
+    write.connect();
+    read.connect();
+
+    // The simulation answers each message with a different one.
+    for (uint8_t i = 0; i < numMessages; ++i) {
+      write.write(makeMessage(1, i));
+      MessageData msg;
+      while (!arg.tryRead(msg))
+        std::this_thread::sleep_for(1ms);
+      expectMessage(msg, 1, i);
+      result.write(makeMessage(2, msg.getBytes()[0] + 100));
+      read.read(msg);
+      received.push_back(msg);
+    }
+    conn->disconnect();
+    server.stop();
+  }
+
+  {
+    backends::trace::BinaryTraceReader reader("session.trace");
+    EXPECT_TRUE(reader.isComplete());
+    const auto *arg = reader.findChannel(
+        "loop.arg", backends::trace::format::Direction::ToAccelerator);
+    ASSERT_NE(arg, nullptr);
+    ASSERT_EQ(arg->records.size(), numMessages);
+    for (uint8_t i = 0; i < numMessages; ++i)
+      expectMessage(reader.getMessage(arg->records[i]), 1, i);
+  }
+
+  // Replaying the trace produces the same data without the simulation.
+  {
+    Context ctxt;
+    AcceleratorConnection *conn =
+        ctxt.connect("trace", "r:manifest.json:session.trace");
+    Manifest manifest(ctxt, loopbackManifest);
+    Accelerator *accel = manifest.buildAccelerator(*conn);
+    ReadChannelPort &read =
+        accel->getPorts().at(AppID("loop")).getRawRead("result");
+    read.connect();
+    std::vector<MessageData> replayed;
+    while (replayed.size() < numMessages)
+      for (MessageData &msg : read.readBatch(numMessages - replayed.size()))
+        replayed.push_back(std::move(msg));
+    for (uint8_t i = 0; i < numMessages; ++i)
+      expectMessage(replayed[i], 2, received[i].getBytes()[0]);
+    for (uint8_t i = 0; i < numMessages; ++i)
+      expectMessage(received[i], 2, i + 100);
+  }
+
+  std::filesystem::current_path(oldCwd);
+  std::filesystem::remove_all(dir);
+}
+
+} // namespace
@@ -6,12 +6,28 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "esi/Accelerator.h"
+#include "esi/Context.h"
+#include "esi/Manifest.h"
+#include "esi/Metrics.h"
+#include "esi/Ports.h"
+#include "esi/Services.h"
 #include "esi/Types.h"
 #include "esi/Values.h"
+#include "esi/backends/TraceFormat.h"
 #include "gtest/gtest.h"
 #include <any>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
 #include <map>
+#include <random>
+#include <thread>
 #include <vector>
 
 using namespace esi;
@@ -784,4 +800,867 @@ TEST(ESITypesTest, BitWidthCalculations) {
   EXPECT_EQ(arrayType.getBitWidth(), 40)
       << "ArrayType of 5 uint8 elements should have bit width of 40 (8 * 5)";
 }
+
+// Test that serialization plans agree with the std::any based serialization.
+TEST(ESITypesTest, SerializationPlanStruct) {
+  UIntType uint8Type("uint8", 8);
+  SIntType sint12Type("sint12", 12);
+  UIntType uint4Type("uint4", 4);
+  SIntType sint16Type("sint16", 16);
+  StructType structType("testStruct", {{"a", &uint8Type},
+                                       {"b", &sint12Type},
+                                       {"c", &uint4Type},
+                                       {"d", &sint16Type}});
+
+  struct Host {
+    uint8_t a;
+    int16_t b;
+    uint8_t c;
+    int16_t d;
+  };
+  const SerializationPlan &plan = structType.getSerializationPlan();
+  EXPECT_EQ(&plan, &structType.getSerializationPlan())
+      << "Plans should be cached";
+  EXPECT_EQ(plan.getHostSize(), sizeof(Host));
+  EXPECT_EQ(plan.getHostAlignment(), alignof(Host));
+  EXPECT_EQ(plan.getWireSize(), 5UL);
+  ASSERT_EQ(plan.getFields().size(), 4UL);
+  EXPECT_EQ(plan.getFields()[2].path, "c");
+  EXPECT_EQ(plan.getFields()[2].hostOffset, offsetof(Host, c));
+
+  std::map<std::string, std::any> structValue = {
+      {"a", std::any(static_cast<uint8_t>(0xA5))},
+      {"b", std::any(static_cast<int16_t>(-100))},
+      {"c", std::any(static_cast<uint8_t>(0x9))},
+      {"d", std::any(static_cast<int16_t>(-12345))}};
+  MutableBitVector expected = structType.serialize(std::any(structValue));
+
+  Host host = {0xA5, -100, 0x9, -12345};
+  MessageData packed = plan.pack(host);
+  ASSERT_EQ(packed.getSize(), expected.getSpan().size());
+  for (size_t i = 0; i < packed.getSize(); ++i)
+    EXPECT_EQ(packed.getData()[i], expected.getSpan()[i]) << "byte " << i;
+
+  Host unpacked = plan.unpack<Host>(packed);
+  EXPECT_EQ(unpacked.a, 0xA5);
+  EXPECT_EQ(unpacked.b, -100) << "Signed fields should be sign extended";
+  EXPECT_EQ(unpacked.c, 0x9);
+  EXPECT_EQ(unpacked.d, -12345);
+
+  EXPECT_THROW(plan.pack(uint8_t(0)), std::runtime_error);
+  EXPECT_THROW(plan.unpack(packed.slice(0, 2), &unpacked), std::runtime_error);
+}
+
+// Test that byte aligned fields are copied in as few operations as possible.
+TEST(ESITypesTest, SerializationPlanArray) {
+  UIntType uint8Type("uint8", 8);
+  ArrayType arrayType("arr", &uint8Type, 4, /*reverse=*/false);
+  const SerializationPlan &plan = arrayType.getSerializationPlan();
+  EXPECT_EQ(plan.getCopyOps().size(), 1UL)
+      << "Contiguous byte fields should be merged into one copy";
+
+  uint8_t host[4] = {1, 2, 3, 4};
+  MessageData packed = plan.pack(host);
+  EXPECT_EQ(packed.getData()[0], 1);
+  EXPECT_EQ(packed.getData()[3], 4);
+
+  // Reversed arrays store the last element first.
+  ArrayType reversedType("rarr", &uint8Type, 4);
+  packed = reversedType.getSerializationPlan().pack(host);
+  EXPECT_EQ(packed.getData()[0], 4);
+  EXPECT_EQ(packed.getData()[3], 1);
+
+  ListType listType("list", &uint8Type);
+  EXPECT_THROW(listType.getSerializationPlan(), std::runtime_error);
+}
+
+// Test fields wider than 64 bits which are not byte aligned.
+TEST(ESITypesTest, SerializationPlanWideUnaligned) {
+  UIntType uint4Type("uint4", 4);
+  UIntType uint100Type("uint100", 100);
+  StructType structType("wide",
+                        {{"wide", &uint100Type}, {"nibble", &uint4Type}});
+  const SerializationPlan &plan = structType.getSerializationPlan();
+  EXPECT_EQ(plan.getWireSize(), 13UL);
+  EXPECT_EQ(plan.getHostSize(), 14UL);
+
+  uint8_t host[14];
+  for (size_t i = 0; i < 13; ++i)
+    host[i] = static_cast<uint8_t>(0x11 * (i + 1));
+  host[12] &= 0x0F; // Only 100 bits.
+  host[13] = 0x7;
+  MessageData packed = plan.pack(host);
+  // The nibble is in the least significant bits, followed by the wide field.
+  EXPECT_EQ(packed.getData()[0], (0x11 << 4 | 0x7) & 0xFF);
+
+  uint8_t unpacked[14];
+  plan.unpack(packed, unpacked);
+  for (size_t i = 0; i < 14; ++i)
+    EXPECT_EQ(unpacked[i], host[i]) << "byte " << i;
+}
+
+// Test that copies and slices of messages share the underlying buffer.
+TEST(ESIMessageDataTest, SharedBuffers) {
+  const uint8_t raw[5] = {1, 2, 3, 4, 5};
+  MessageData msg(raw, sizeof(raw));
+  MessageData copy = msg;
+  EXPECT_EQ(copy.getBytes(), msg.getBytes()) << "Copies should not copy data";
+
+  MessageData slice = msg.slice(1, 3);
+  EXPECT_EQ(slice.getBytes(), msg.getBytes() + 1);
+  EXPECT_EQ(slice.getSize(), 3UL);
+  EXPECT_THROW(msg.slice(4, 2), std::runtime_error);
+
+  // Writing to a shared message must not affect the others.
+  uint8_t *bytes = copy.getMutableBytes();
+  EXPECT_NE(bytes, msg.getBytes()) << "Shared data should be copied on write";
+  bytes[0] = 9;
+  EXPECT_EQ(msg.getData()[0], 1);
+  EXPECT_EQ(copy.getData()[0], 9);
+}
+
+// Test adopting vectors and wrapping external memory.
+TEST(ESIMessageDataTest, AdoptAndWrap) {
+  std::vector<uint8_t> vec = {7, 8};
+  const uint8_t *vecData = vec.data();
+  MessageData adopted(std::move(vec));
+  EXPECT_EQ(adopted.getBytes(), vecData) << "Vectors should be adopted";
+  std::vector<uint8_t> taken = adopted.takeData();
+  EXPECT_EQ(taken.data(), vecData) << "Adopted vectors should be moved out";
+  EXPECT_TRUE(adopted.empty());
+
+  uint8_t external[4] = {1, 2, 3, 4};
+  bool released = false;
+  {
+    MessageData wrapped =
+        MessageData::wrap(external, sizeof(external), [&]() {
+          released = true;
+        });
+    EXPECT_EQ(wrapped.getBytes(), external);
+    MessageData slice = wrapped.slice(2, 2);
+    wrapped = MessageData();
+    EXPECT_FALSE(released) << "Slices should keep external memory alive";
+  }
+  EXPECT_TRUE(released);
+}
+
+/// Get a temporary path for a trace which doesn't collide with concurrent runs
+/// of the tests.
+static std::filesystem::path getTempTracePath(const std::string &name) {
+  std::random_device rd;
+  return std::filesystem::temp_directory_path() /
+         ("esi-" + name + "-" + std::to_string(rd()) + ".trace");
+}
+
+// Test writing a binary trace and reading it back.
+TEST(ESITraceTest, BinaryRoundTrip) {
+  using namespace esi::backends::trace;
+  auto path = getTempTracePath("roundtrip");
+  {
+    BinaryTraceWriter writer(path);
+    uint32_t in = writer.addChannel("top.in", format::Direction::ToAccelerator);
+    uint32_t out =
+        writer.addChannel("top.out", format::Direction::FromAccelerator);
+    const uint8_t a[3] = {1, 2, 3}, b[1] = {4};
+    writer.message(in, MessageData(a, sizeof(a)));
+    std::vector<MessageData> batch = {MessageData(b, sizeof(b)),
+                                      MessageData()};
+    writer.messages(out, batch);
+    writer.mmioRead(0x10, 42);
+    writer.mmioRead(0x10, 43);
+    writer.mmioWrite(0x20, 1);
+  }
+
+  BinaryTraceReader reader(path);
+  EXPECT_TRUE(reader.isComplete());
+  ASSERT_EQ(reader.getChannels().size(), 2UL);
+  EXPECT_EQ(reader.findChannel("top.out", format::Direction::ToAccelerator),
+            nullptr);
+  const auto *in =
+      reader.findChannel("top.in", format::Direction::ToAccelerator);
+  ASSERT_NE(in, nullptr);
+  ASSERT_EQ(in->records.size(), 1UL);
+  EXPECT_EQ(std::vector<uint8_t>(reader.getMessage(in->records[0])),
+            std::vector<uint8_t>({1, 2, 3}));
+
+  const auto *out =
+      reader.findChannel("top.out", format::Direction::FromAccelerator);
+  ASSERT_NE(out, nullptr);
+  ASSERT_EQ(out->records.size(), 2UL);
+  EXPECT_EQ(reader.getMessage(out->records[0]).getData()[0], 4);
+  EXPECT_TRUE(reader.getMessage(out->records[1]).empty());
+  EXPECT_LE(reader.getTimestamp(in->records[0]),
+            reader.getTimestamp(out->records[0]));
+
+  auto reads = reader.getMMIOReads();
+  EXPECT_EQ(reads[0x10], std::vector<uint64_t>({42, 43}));
+  std::filesystem::remove(path);
+}
+
+// Test that traces which weren't closed properly can still be read.
+TEST(ESITraceTest, BinaryTruncated) {
+  using namespace esi::backends::trace;
+  auto path = getTempTracePath("truncated");
+  {
+    BinaryTraceWriter writer(path);
+    uint32_t out =
+        writer.addChannel("top.out", format::Direction::FromAccelerator);
+    const uint8_t data[16] = {};
+    for (int i = 0; i < 3; ++i)
+      writer.message(out, MessageData(data, sizeof(data)));
+  }
+  // Drop the index and cut the last message in half, just past its header.
+  uint64_t lastRecord;
+  {
+    BinaryTraceReader reader(path);
+    ASSERT_TRUE(reader.isComplete());
+    ASSERT_EQ(reader.getChannels().at(0).records.size(), 3UL);
+    lastRecord = reader.getChannels()[0].records[2];
+  }
+  std::filesystem::resize_file(path,
+                               lastRecord + sizeof(format::RecordHeader) + 8);
+
+  BinaryTraceReader reader(path);
+  EXPECT_FALSE(reader.isComplete());
+  ASSERT_EQ(reader.getChannels().size(), 1UL);
+  EXPECT_EQ(reader.getChannels()[0].records.size(), 2UL);
+  std::filesystem::remove(path);
+}
+
+// Test the bucketing and percentiles of the latency histogram.
+TEST(ESIMetricsTest, HistogramPercentiles) {
+  // Small values are exact, larger ones within 1/SubBuckets.
+  for (uint64_t v : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull,
+                     ~0ull}) {
+    size_t bucket = LatencyHistogram::getBucket(v);
+    ASSERT_LT(bucket, LatencyHistogram::NumBuckets);
+    uint64_t bucketMax = LatencyHistogram::getBucketMax(bucket);
+    EXPECT_GE(bucketMax, v);
+    EXPECT_LE(bucketMax - v, v / LatencyHistogram::SubBuckets) << v;
+  }
+
+  LatencyHistogram hist;
+  EXPECT_EQ(hist.getPercentile(50), 0UL);
+  for (uint64_t v = 1; v <= 1000; ++v)
+    hist.record(v * 1000);
+  EXPECT_EQ(hist.getCount(), 1000UL);
+  EXPECT_EQ(hist.getMin(), 1000UL);
+  EXPECT_EQ(hist.getMax(), 1000000UL);
+  EXPECT_DOUBLE_EQ(hist.getMean(), 500500.0);
+  EXPECT_NEAR(hist.getPercentile(50), 500000.0, 500000.0 / 16);
+  EXPECT_NEAR(hist.getPercentile(99), 990000.0, 990000.0 / 16);
+  EXPECT_EQ(hist.getPercentile(100), 1000000UL);
+  hist.reset();
+  EXPECT_EQ(hist.getCount(), 0UL);
+  EXPECT_EQ(hist.getMin(), 0UL);
+}
+
+// A write port which accepts every other tryWrite.
+class TestWritePort : public WriteChannelPort {
+public:
+  using WriteChannelPort::WriteChannelPort;
+  void writeImpl(const MessageData &) override {}
+  bool tryWriteImpl(const MessageData &) override { return accept = !accept; }
+  bool accept = false;
+};
+
+// A read port which lets the test deliver messages.
+class TestReadPort : public ReadChannelPort {
+public:
+  using ReadChannelPort::ReadChannelPort;
+  bool deliver(MessageData data) { return callback(std::move(data)); }
+};
+
+// Test that instrumented ports count messages and record latencies.
+TEST(ESIMetricsTest, PortMetrics) {
+  BitsType type("b32", 32);
+  Metrics metrics;
+
+  TestWritePort write(&type);
+  write.setMetrics(&metrics.getChannel("top.write"));
+  write.connect();
+  MessageData msg(std::vector<uint8_t>{1, 2, 3, 4});
+  write.write(msg);
+  std::vector<MessageData> batch(3, msg);
+  write.writeBatch(batch);
+  EXPECT_TRUE(write.tryWrite(msg));
+  EXPECT_FALSE(write.tryWrite(msg));
+  const ChannelMetrics *writeMetrics = metrics.findChannel("top.write");
+  ASSERT_NE(writeMetrics, nullptr);
+  EXPECT_EQ(writeMetrics->getMessages(), 5UL);
+  EXPECT_EQ(writeMetrics->getBytes(), 20UL);
+  // Only the blocking writes record a latency.
+  EXPECT_EQ(writeMetrics->getLatency().getCount(), 2UL);
+
+  TestReadPort read(&type);
+  read.setMetrics(&metrics.getChannel("top.read"));
+  read.connect();
+  std::future<MessageData> pending = read.readAsync();
+  EXPECT_TRUE(read.deliver(msg));
+  EXPECT_EQ(pending.get().getSize(), 4UL);
+  EXPECT_TRUE(read.deliver(msg));
+  EXPECT_TRUE(read.deliver(msg));
+  MessageData out;
+  read.read(out);
+  const ChannelMetrics *readMetrics = metrics.findChannel("top.read");
+  ASSERT_NE(readMetrics, nullptr);
+  EXPECT_EQ(readMetrics->getMessages(), 3UL);
+  EXPECT_EQ(readMetrics->getMaxQueueDepth(), 2UL);
+  // Only the read which had to wait for data records a latency.
+  EXPECT_EQ(readMetrics->getLatency().getCount(), 1UL);
+
+  std::string json = metrics.toJson();
+  EXPECT_NE(json.find("\"top.read\":{\"messages\":3,"), std::string::npos)
+      << json;
+  EXPECT_NE(json.find("\"top.write\":{\"messages\":5,"), std::string::npos)
+      << json;
+}
+
+// A write port backed by a FIFO with room for a few messages, which the test
+// drains.
+class FifoWritePort : public WriteChannelPort {
+public:
+  FifoWritePort(const Type *type, size_t capacity)
+      : WriteChannelPort(type), capacity(capacity) {}
+  void writeImpl(const MessageData &data) override {
+    fifo.push_back(data.getBytes()[0]);
+  }
+  bool tryWriteImpl(const MessageData &data) override {
+    if (fifo.size() == capacity)
+      return false;
+    fifo.push_back(data.getBytes()[0]);
+    return true;
+  }
+  size_t capacity;
+  std::deque<uint8_t> fifo;
+};
+
+// A read port whose backend produces messages on demand for readBatch().
+class BatchReadPort : public TestReadPort {
+public:
+  using TestReadPort::TestReadPort;
+  void readBatchImpl(size_t maxMessages,
+                     std::vector<MessageData> &out) override {
+    for (; maxMessages > 0 && available > 0; --maxMessages, --available)
+      out.push_back(MessageData({next++}));
+  }
+  size_t available = 0;
+  uint8_t next = 100;
+};
+
+static std::vector<uint8_t> firstBytes(const std::vector<MessageData> &msgs) {
+  std::vector<uint8_t> bytes;
+  for (const MessageData &msg : msgs)
+    bytes.push_back(msg.getBytes()[0]);
+  return bytes;
+}
+
+// Test that non-blocking batch writes report how many messages the backend
+// accepted, and that writing the rest later keeps the messages in order.
+TEST(ESIPortsTest, TryWriteBatch) {
+  BitsType type("b8", 8);
+  Metrics metrics;
+  FifoWritePort port(&type, 3);
+  port.setMetrics(&metrics.getChannel("fifo"));
+  port.connect();
+
+  std::vector<MessageData> msgs;
+  for (uint8_t i = 0; i < 5; ++i)
+    msgs.push_back(MessageData({i}));
+  EXPECT_EQ(port.tryWriteBatch(msgs), 3UL);
+  EXPECT_EQ(port.tryWriteBatch(std::span(msgs).subspan(3)), 0UL);
+  EXPECT_EQ(port.tryWriteBatch({}), 0UL);
+  EXPECT_EQ(port.fifo, (std::deque<uint8_t>{0, 1, 2}));
+  EXPECT_EQ(metrics.findChannel("fifo")->getMessages(), 3UL);
+
+  // Drain two messages per round, such that the batches keep wrapping around
+  // a full FIFO.
+  port.fifo.clear();
+  msgs.clear();
+  for (uint8_t i = 0; i < 100; ++i)
+    msgs.push_back(MessageData({i}));
+  std::vector<uint8_t> received;
+  std::span<const MessageData> pending(msgs);
+  while (!pending.empty() || !port.fifo.empty()) {
+    size_t numWritten = port.tryWriteBatch(pending);
+    EXPECT_LE(numWritten, port.capacity);
+    pending = pending.subspan(numWritten);
+    for (int i = 0; i < 2 && !port.fifo.empty(); ++i) {
+      received.push_back(port.fifo.front());
+      port.fifo.pop_front();
+    }
+  }
+  EXPECT_EQ(received, firstBytes(msgs));
+  EXPECT_EQ(metrics.findChannel("fifo")->getMessages(), 103UL);
+}
+
+// Test that batch reads return queued messages first, then the ones the
+// backend produces, and block only if there are none at all.
+TEST(ESIPortsTest, ReadBatch) {
+  BitsType type("b8", 8);
+  Metrics metrics;
+  BatchReadPort port(&type);
+  port.setMetrics(&metrics.getChannel("batch"));
+  port.connect();
+
+  for (uint8_t i = 0; i < 3; ++i)
+    EXPECT_TRUE(port.deliver(MessageData({i})));
+  EXPECT_TRUE(port.readBatch(0).empty());
+  EXPECT_EQ(firstBytes(port.readBatch(2)), (std::vector<uint8_t>{0, 1}));
+  port.available = 5;
+  EXPECT_EQ(firstBytes(port.readBatch(4)),
+            (std::vector<uint8_t>{2, 100, 101, 102}));
+  EXPECT_EQ(firstBytes(port.readBatch(10)), (std::vector<uint8_t>{103, 104}));
+
+  std::future<std::vector<MessageData>> blocked = std::async(
+      std::launch::async, [&] { return port.readBatch(4); });
+  EXPECT_EQ(blocked.wait_for(std::chrono::milliseconds(20)),
+            std::future_status::timeout);
+  EXPECT_TRUE(port.deliver(MessageData({7})));
+  EXPECT_EQ(firstBytes(blocked.get()), (std::vector<uint8_t>{7}));
+  EXPECT_EQ(metrics.findChannel("batch")->getMessages(), 9UL);
+}
+
+const char *testManifest = R"({
+  "apiVersion": 0,
+  "serviceDeclarations": [{"symbol": "Svc", "serviceName": "test.svc"}],
+  "modules": [
+    {"symbol": "Top", "symInfo": {"name": "Top", "summary": "top level"}},
+    {"symbol": "Leaf", "symInfo": {"name": "Leaf", "version": "1.2"},
+     "symConsts": {"depth": {"type": "ui8", "value": 4}}}
+  ],
+  "types": [
+    {"id": "ui8", "mnemonic": "int", "signedness": "unsigned",
+     "hwBitwidth": 8},
+    {"id": "!hw.struct<a: ui8, b: i4>", "mnemonic": "struct", "fields": [
+      {"name": "a", "type": "ui8"},
+      {"name": "b", "type": {"id": "i4", "mnemonic": "int",
+                             "signedness": "signless", "hwBitwidth": 4}}]},
+    {"id": "bundle", "mnemonic": "bundle", "channels": [
+      {"name": "data", "direction": "to", "type": {
+        "id": "!esi.channel<ui8>", "mnemonic": "channel", "inner": "ui8"}}]}
+  ],
+  "design": {
+    "instOf": "Top",
+    "engines": [{"appID": {"name": "engine"}, "serviceImplName": "trace",
+                 "clientDetails": [
+      {"relAppIDPath": [{"name": "leaf", "index": 0}, {"name": "in"}],
+       "channelAssignments": {"data": {"type": "trace"}}},
+      {"relAppIDPath": [{"name": "leaf", "index": 0}, {"name": "sub"},
+                        {"name": "in"}],
+       "channelAssignments": {"data": {"type": "trace"}}},
+      {"relAppIDPath": [{"name": "leaf", "index": 1}, {"name": "in"}],
+       "channelAssignments": {"data": {"type": "trace"}}},
+      {"relAppIDPath": [{"name": "leaf", "index": 1}, {"name": "sub"},
+                        {"name": "in"}],
+       "channelAssignments": {"data": {"type": "trace"}}}]}],
+    "clientPorts": [],
+    "children": [
+      {"appID": {"name": "leaf", "index": 0}, "instOf": "Leaf",
+       "clientPorts": [
+         {"appID": {"name": "in"}, "typeID": "bundle",
+          "servicePort": {"serviceName": "Svc", "port": "p"}}],
+       "children": [
+         {"appID": {"name": "sub"}, "instOf": "Leaf",
+          "clientPorts": [
+            {"appID": {"name": "in"}, "typeID": "bundle",
+             "servicePort": {"serviceName": "Svc", "port": "p"}}],
+          "children": []}]},
+      {"appID": {"name": "leaf", "index": 1}, "instOf": "Leaf",
+       "clientPorts": [
+         {"appID": {"name": "in"}, "typeID": "bundle",
+          "servicePort": {"serviceName": "Svc", "port": "p"}}],
+       "children": [
+         {"appID": {"name": "sub"}, "instOf": "Leaf",
+          "clientPorts": [
+            {"appID": {"name": "in"}, "typeID": "bundle",
+             "servicePort": {"serviceName": "Svc", "port": "p"}}],
+          "children": []}]}]}
+})";
+
+/// Write the test manifest to a uniquely named file in the working directory,
+/// for the trace backend to read. Relative since the connection string can't
+/// contain colons.
+static std::string writeTestManifest() {
+  std::random_device rd;
+  std::string path = "esi-manifest-" + std::to_string(rd()) + ".json";
+  std::ofstream(path) << testManifest;
+  return path;
+}
+
+/// Check that two design hierarchies have the same instances and ports.
+static void expectSameHierarchy(const HWModule &lazy, const HWModule &eager) {
+  ASSERT_EQ(lazy.getInfo().has_value(), eager.getInfo().has_value());
+  if (eager.getInfo()) {
+    EXPECT_EQ(lazy.getInfo()->name, eager.getInfo()->name);
+  }
+
+  auto lazyPorts = lazy.getPortsOrdered();
+  auto eagerPorts = eager.getPortsOrdered();
+  ASSERT_EQ(lazyPorts.size(), eagerPorts.size());
+  for (size_t i = 0; i < lazyPorts.size(); ++i) {
+    const BundlePort &lazyPort = lazyPorts[i].get();
+    const BundlePort &eagerPort = eagerPorts[i].get();
+    EXPECT_EQ(lazyPort.getID(), eagerPort.getID());
+    ASSERT_EQ(lazyPort.getChannels().size(), eagerPort.getChannels().size());
+    for (const auto &[name, channel] : eagerPort.getChannels()) {
+      auto f = lazyPort.getChannels().find(name);
+      ASSERT_NE(f, lazyPort.getChannels().end()) << name;
+      EXPECT_EQ(f->second.getType()->getID(), channel.getType()->getID());
+    }
+  }
+
+  std::vector<const Instance *> lazyChildren = lazy.getChildrenOrdered();
+  std::vector<const Instance *> eagerChildren = eager.getChildrenOrdered();
+  ASSERT_EQ(lazyChildren.size(), eagerChildren.size());
+  for (size_t i = 0; i < lazyChildren.size(); ++i) {
+    EXPECT_EQ(lazyChildren[i]->getID(), eagerChildren[i]->getID());
+    expectSameHierarchy(*lazyChildren[i], *eagerChildren[i]);
+  }
+}
+
+// Test that lazy manifests, with or without a cached index, produce the same
+// types, module metadata, instances and ports as eagerly parsed ones.
+TEST(ESIManifestTest, LazyMatchesEager) {
+  std::string manifestPath = writeTestManifest();
+  Context eagerCtxt;
+  Manifest eager(eagerCtxt, testManifest);
+  AcceleratorConnection *eagerConn =
+      eagerCtxt.connect("trace", "-:" + manifestPath);
+  Accelerator *eagerAccel = eager.buildAccelerator(*eagerConn);
+  AppIDPath lastLookup;
+  ASSERT_NE(eagerAccel->resolvePort({AppID("leaf", 0), AppID("sub"),
+                                     AppID("in")},
+                                    lastLookup),
+            nullptr);
+
+  std::random_device rd;
+  std::filesystem::path cacheDir =
+      std::filesystem::temp_directory_path() /
+      ("esi-manifest-test-" + std::to_string(rd()));
+  std::filesystem::create_directories(cacheDir);
+  Manifest::Options options;
+  options.lazy = true;
+  options.indexCacheDir = cacheDir;
+
+  // The second round loads the index written by the first one, and takes the
+  // options from the context.
+  for (int round = 0; round < 2; ++round) {
+    Context ctxt;
+    std::unique_ptr<Manifest> manifest;
+    if (round == 0) {
+      manifest = std::make_unique<Manifest>(ctxt, testManifest, options);
+    } else {
+      ctxt.setManifestOptions(options);
+      manifest = std::make_unique<Manifest>(ctxt, testManifest);
+    }
+    Manifest &lazy = *manifest;
+    EXPECT_EQ(lazy.getApiVersion(), eager.getApiVersion());
+    EXPECT_FALSE(ctxt.getType("ui8"));
+
+    std::vector<ModuleInfo> eagerInfos = eager.getModuleInfos();
+    std::vector<ModuleInfo> lazyInfos = lazy.getModuleInfos();
+    ASSERT_EQ(lazyInfos.size(), eagerInfos.size());
+    for (size_t i = 0; i < lazyInfos.size(); ++i) {
+      EXPECT_EQ(lazyInfos[i].name, eagerInfos[i].name);
+      EXPECT_EQ(lazyInfos[i].version, eagerInfos[i].version);
+      EXPECT_EQ(lazyInfos[i].constants.size(), eagerInfos[i].constants.size());
+    }
+    // Parsing the constants needed their type.
+    EXPECT_TRUE(ctxt.getType("ui8"));
+
+    const std::vector<const Type *> &eagerTypes = eager.getTypeTable();
+    const std::vector<const Type *> &lazyTypes = lazy.getTypeTable();
+    ASSERT_EQ(lazyTypes.size(), eagerTypes.size());
+    for (size_t i = 0; i < lazyTypes.size(); ++i) {
+      EXPECT_EQ(lazyTypes[i]->getID(), eagerTypes[i]->getID());
+      EXPECT_EQ(lazyTypes[i]->getBitWidth(), eagerTypes[i]->getBitWidth());
+    }
+
+    // Build the hierarchy, which happens as the comparison walks it.
+    AcceleratorConnection *conn = ctxt.connect("trace", "-:" + manifestPath);
+    Accelerator *lazyAccel = lazy.buildAccelerator(*conn);
+    expectSameHierarchy(*lazyAccel, *eagerAccel);
+  }
+  EXPECT_FALSE(std::filesystem::is_empty(cacheDir));
+  std::filesystem::remove_all(cacheDir);
+  std::filesystem::remove(manifestPath);
+}
+
+// Test that several threads can build the children of a lazy hierarchy at the
+// same time and all see the same instances and ports.
+TEST(ESIManifestTest, LazyConcurrentBuild) {
+  std::string manifestPath = writeTestManifest();
+  Context ctxt;
+  ctxt.setManifestOptions({/*lazy=*/true, {}});
+  Manifest manifest(ctxt, testManifest);
+  AcceleratorConnection *conn = ctxt.connect("trace", "-:" + manifestPath);
+  Accelerator *accel = manifest.buildAccelerator(*conn);
+
+  const AppIDPath paths[] = {{AppID("leaf", 0), AppID("sub"), AppID("in")},
+                             {AppID("leaf", 1), AppID("sub"), AppID("in")},
+                             {AppID("leaf", 0), AppID("in")},
+                             {AppID("leaf", 1), AppID("in")}};
+  constexpr size_t numThreads = 8;
+  std::vector<std::vector<BundlePort *>> found(
+      numThreads, std::vector<BundlePort *>(std::size(paths)));
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; ++t)
+    threads.emplace_back([&, t]() {
+      // Start at different places to have the threads race on different
+      // parts of the hierarchy.
+      for (size_t i = 0; i < std::size(paths); ++i) {
+        size_t p = (i + t) % std::size(paths);
+        AppIDPath lastLookup;
+        found[t][p] = accel->resolvePort(paths[p], lastLookup);
+      }
+    });
+  for (std::thread &thread : threads)
+    thread.join();
+
+  for (size_t t = 0; t < numThreads; ++t)
+    for (size_t i = 0; i < std::size(paths); ++i) {
+      EXPECT_NE(found[t][i], nullptr);
+      EXPECT_EQ(found[t][i], found[0][i]);
+    }
+  std::filesystem::remove(manifestPath);
+}
+
+// Test that MMIO accesses are recorded on a connection and that replaying the
+// trace returns the recorded reads.
+TEST(ESITraceTest, RecordMMIO) {
+  std::string manifestPath = writeTestManifest();
+  // Relative since the connection string can't contain colons.
+  std::string tracePath = "esi-mmio-" + std::to_string(std::random_device()());
+  std::vector<uint64_t> reads;
+  {
+    Context ctxt;
+    AcceleratorConnection *conn = ctxt.connect("trace", "-:" + manifestPath);
+    conn->recordTrace(tracePath);
+    EXPECT_THROW(conn->recordTrace(tracePath), std::runtime_error);
+    auto *mmio = conn->getService<services::MMIO>();
+    ASSERT_NE(mmio, nullptr);
+    for (int i = 0; i < 3; ++i)
+      reads.push_back(mmio->read(0x10));
+    mmio->write(0x20, 7);
+  }
+
+  Context ctxt;
+  AcceleratorConnection *conn =
+      ctxt.connect("trace", "r:" + manifestPath + ":" + tracePath);
+  auto *mmio = conn->getService<services::MMIO>();
+  for (uint64_t expected : reads)
+    EXPECT_EQ(mmio->read(0x10), expected);
+  std::filesystem::remove(tracePath);
+  std::filesystem::remove(manifestPath);
+}
+
+// Test that function calls are pipelined and matched to their results.
+TEST(ESIServicesTest, PipelinedFunctionCalls) {
+  BitsType type("b8", 8);
+  ChannelType chanType("!esi.channel<b8>", &type);
+  BundleType bundleType("func", {{"arg", BundleType::Direction::To, &chanType},
+                                 {"result", BundleType::Direction::From,
+                                  &chanType}});
+  auto tag = [](const MessageData &msg) -> uint64_t {
+    return msg.getBytes()[0];
+  };
+
+  // In order.
+  TestWritePort arg(&type);
+  TestReadPort result(&type);
+  std::unique_ptr<services::FuncService::Function> func(
+      services::FuncService::Function::get(AppID("func"), &bundleType, arg,
+                                           result));
+  func->connect();
+  std::future<MessageData> first = func->call(MessageData({1}));
+  std::future<MessageData> second = func->call(MessageData({2}));
+  EXPECT_EQ(func->getNumInFlight(), 2UL);
+  EXPECT_TRUE(result.deliver(MessageData({10})));
+  EXPECT_TRUE(result.deliver(MessageData({20})));
+  EXPECT_EQ(first.get().getBytes()[0], 10);
+  EXPECT_EQ(second.get().getBytes()[0], 20);
+  EXPECT_EQ(func->getNumInFlight(), 0UL);
+
+  // By tag, out of order, with a limit on the calls in flight.
+  TestWritePort taggedArg(&type);
+  TestReadPort taggedResult(&type);
+  std::unique_ptr<services::FuncService::Function> tagged(
+      services::FuncService::Function::get(AppID("tagged"), &bundleType,
+                                           taggedArg, taggedResult));
+  services::FuncService::Function::Options options;
+  options.maxInFlight = 2;
+  options.argTag = tag;
+  options.resultTag = tag;
+  tagged->connect(options);
+  first = tagged->call(MessageData({1}));
+  second = tagged->call(MessageData({2}));
+  // The third call has to wait for one of the first two to complete.
+  std::future<std::future<MessageData>> third = std::async(
+      std::launch::async, [&] { return tagged->call(MessageData({3})); });
+  EXPECT_EQ(third.wait_for(std::chrono::milliseconds(20)),
+            std::future_status::timeout);
+  EXPECT_TRUE(taggedResult.deliver(MessageData({2})));
+  std::future<MessageData> thirdResult = third.get();
+  EXPECT_EQ(second.get().getBytes()[0], 2);
+  EXPECT_TRUE(taggedResult.deliver(MessageData({3})));
+  EXPECT_TRUE(taggedResult.deliver(MessageData({1})));
+  EXPECT_EQ(thirdResult.get().getBytes()[0], 3);
+  EXPECT_EQ(first.get().getBytes()[0], 1);
+
+  // Tags must be unique among the calls in flight.
+  std::future<MessageData> fourth = tagged->call(MessageData({4}));
+  EXPECT_THROW(tagged->call(MessageData({4})), std::runtime_error);
+  EXPECT_TRUE(taggedResult.deliver(MessageData({4})));
+  EXPECT_EQ(fourth.get().getBytes()[0], 4);
+}
+
+// A logger which counts the errors it receives.
+class ErrorCountingLogger : public Logger {
+public:
+  ErrorCountingLogger() : Logger(false, false) {}
+  void log(Level level, const std::string &, const std::string &,
+           const std::map<std::string, std::any> *) override {
+    if (level == Level::Error)
+      ++numErrors;
+  }
+  std::atomic<unsigned> numErrors = 0;
+};
+
+// Test that results which don't match a call are logged and dropped rather
+// than thrown from the port callback.
+TEST(ESIServicesTest, UnmatchedFunctionResults) {
+  BitsType type("b8", 8);
+  ChannelType chanType("!esi.channel<b8>", &type);
+  BundleType bundleType("func", {{"arg", BundleType::Direction::To, &chanType},
+                                 {"result", BundleType::Direction::From,
+                                  &chanType}});
+  ErrorCountingLogger logger;
+
+  TestWritePort arg(&type);
+  TestReadPort result(&type);
+  std::unique_ptr<services::FuncService::Function> func(
+      services::FuncService::Function::get(AppID("func"), &bundleType, arg,
+                                           result, &logger));
+  func->connect();
+  EXPECT_TRUE(result.deliver(MessageData({1})));
+  EXPECT_EQ(logger.numErrors, 1u);
+  std::future<MessageData> call = func->call(MessageData({2}));
+  EXPECT_TRUE(result.deliver(MessageData({3})));
+  EXPECT_EQ(call.get().getBytes()[0], 3);
+
+  TestWritePort taggedArg(&type);
+  TestReadPort taggedResult(&type);
+  std::unique_ptr<services::FuncService::Function> tagged(
+      services::FuncService::Function::get(AppID("tagged"), &bundleType,
+                                           taggedArg, taggedResult, &logger));
+  services::FuncService::Function::Options options;
+  options.argTag = [](const MessageData &msg) -> uint64_t {
+    return msg.getBytes()[0];
+  };
+  options.resultTag = [](const MessageData &msg) -> uint64_t {
+    if (msg.getSize() != 1)
+      throw std::runtime_error("bad result");
+    return msg.getBytes()[0];
+  };
+  tagged->connect(options);
+  call = tagged->call(MessageData({5}));
+  EXPECT_TRUE(taggedResult.deliver(MessageData({6})));
+  EXPECT_TRUE(taggedResult.deliver(MessageData(std::vector<uint8_t>{5, 5})));
+  EXPECT_EQ(logger.numErrors, 3u);
+  EXPECT_EQ(tagged->getNumInFlight(), 1UL);
+  EXPECT_TRUE(taggedResult.deliver(MessageData({5})));
+  EXPECT_EQ(call.get().getBytes()[0], 5);
+}
+
+// A write port which records what is written to it.
+class RecordingWritePort : public WriteChannelPort {
+public:
+  using WriteChannelPort::WriteChannelPort;
+  void writeImpl(const MessageData &data) override {
+    std::scoped_lock<std::mutex> lock(m);
+    written.push_back(data.getBytes()[0]);
+  }
+  bool tryWriteImpl(const MessageData &data) override {
+    writeImpl(data);
+    return true;
+  }
+  std::mutex m;
+  std::vector<uint8_t> written;
+};
+
+// Test that exceptions thrown by callbacks are logged instead of terminating
+// the program, and that the thread pool finishes the queued invocations when
+// it is shut down.
+TEST(ESIServicesTest, FailingCallbacks) {
+  std::string manifestPath = writeTestManifest();
+  auto ctxt = Context::withLogger<ErrorCountingLogger>();
+  auto &logger = static_cast<ErrorCountingLogger &>(ctxt->getLogger());
+  AcceleratorConnection *conn = ctxt->connect("trace", "-:" + manifestPath);
+
+  BitsType type("b8", 8);
+  ChannelType chanType("!esi.channel<b8>", &type);
+  BundleType bundleType("cb", {{"arg", BundleType::Direction::From, &chanType},
+                               {"result", BundleType::Direction::To,
+                                &chanType}});
+  auto callback = [](const MessageData &arg) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (arg.getBytes()[0] == 1)
+      throw std::runtime_error("callback failed");
+    return MessageData({static_cast<uint8_t>(arg.getBytes()[0] * 10)});
+  };
+
+  for (unsigned numThreads : {0, 2}) {
+    RecordingWritePort result(&type);
+    TestReadPort arg(&type);
+    std::unique_ptr<services::CallService::Callback> cb(
+        services::CallService::Callback::get(*conn, AppID("cb"), &bundleType,
+                                             result, arg));
+    cb->connect(callback, /*quick=*/true, numThreads);
+    for (uint8_t i = 0; i < 4; ++i)
+      EXPECT_TRUE(arg.deliver(MessageData({i})));
+    // Destroying the callback has to wait for the queued invocations.
+    cb.reset();
+    EXPECT_EQ(result.written, (std::vector<uint8_t>{0, 20, 30}))
+        << "with " << numThreads << " threads";
+  }
+  EXPECT_EQ(logger.numErrors, 2u);
+  ctxt.reset();
+  std::filesystem::remove(manifestPath);
+}
+
+// Test that the service thread, which sleeps without a timeout when it has no
+// polled tasks, is woken up by a port receiving data.
+TEST(ESIServiceThreadTest, WakesOnData) {
+  BitsType type("b8", 8);
+  for (unsigned numWorkers : {0, 2}) {
+    TestReadPort port(&type);
+    port.connect();
+    std::mutex m;
+    std::condition_variable cv;
+    std::vector<uint8_t> received;
+
+    AcceleratorServiceThread thread;
+    if (numWorkers)
+      thread.startCallbackWorkers(numWorkers);
+    thread.addListener({&port}, [&](ReadChannelPort *, MessageData data) {
+      std::lock_guard<std::mutex> g(m);
+      received.push_back(data.getBytes()[0]);
+      cv.notify_one();
+    });
+    // Give the thread time to go to sleep.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (uint8_t i = 0; i < 3; ++i)
+      EXPECT_TRUE(port.deliver(MessageData({i})));
+
+    {
+      std::unique_lock<std::mutex> l(m);
+      EXPECT_TRUE(cv.wait_for(l, std::chrono::seconds(10),
+                              [&] { return received.size() == 3; }))
+          << "with " << numWorkers << " workers";
+      EXPECT_EQ(received, (std::vector<uint8_t>{0, 1, 2}));
+    }
+    thread.stop();
+  }
+}
 } // namespace
@@ -0,0 +1,94 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains unit tests checking that annotations imported directly
+// from JSON text match the ones imported through a JSON DOM.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/Import/FIRAnnotations.h"
+#include "mlir/IR/BuiltinAttributes.h"
+#include "mlir/IR/MLIRContext.h"
+#include "llvm/Support/JSON.h"
+#include "gtest/gtest.h"
+
+using namespace mlir;
+using namespace circt;
+using namespace firrtl;
+
+namespace {
+
+/// Import annotations through a JSON DOM.  Returns null on failure.
+static ArrayAttr importWithDOM(MLIRContext *context, StringRef text) {
+  auto json = llvm::json::parse(text);
+  if (!json) {
+    llvm::consumeError(json.takeError());
+    return {};
+  }
+  llvm::json::Path::Root root;
+  SmallVector<Attribute> annotations;
+  if (!importAnnotationsFromJSONRaw(json.get(), annotations, root, context))
+    return {};
+  return ArrayAttr::get(context, annotations);
+}
+
+/// Import annotations directly from the text.  Returns null on failure.
+static ArrayAttr importWithString(MLIRContext *context, StringRef text) {
+  SmallVector<Attribute> annotations;
+  if (!importAnnotationsFromJSONString(text, annotations, context))
+    return {};
+  return ArrayAttr::get(context, annotations);
+}
+
+TEST(AnnotationImportTest, MatchesDOM) {
+  MLIRContext context;
+  const char *inputs[] = {
+      R"([])",
+      R"( [ { } ] )",
+      R"([{"class":"a.b.C","target":"~Foo|Bar>x"}])",
+      R"([{"i":1,"n":-42,"big":18446744073709551616,"f":1.5e3,"z":-0}])",
+      R"([{"lenient":[01,+5,1.,18446744073709551615]}])",
+      R"([{"t":true,"f":false,"n":null,"a":[1,[2,[]],{}]}])",
+      R"([{"esc":"a\"b\\c\/d\b\f\n\r\té😀\ud800x"}])",
+      R"([{"quoted":"{\"a\":[1,2]}","num":"0","arr":" [true]","s":"\"x\""}])",
+      R"([{"bad":"{not json}","partial":"[1,"}])",
+  };
+  for (const char *input : inputs) {
+    ArrayAttr expected = importWithDOM(&context, input);
+    ASSERT_TRUE(expected) << input;
+    EXPECT_EQ(importWithString(&context, input), expected) << input;
+  }
+
+  // Enough annotations to be converted in several shards.
+  std::string many = "[";
+  for (int i = 0; i < 1000; ++i)
+    many += (i ? "," : "") + std::string("{\"class\":\"c\",\"i\":") +
+            std::to_string(i) + "}";
+  many += "]";
+  ArrayAttr expected = importWithDOM(&context, many);
+  ASSERT_TRUE(expected);
+  EXPECT_EQ(importWithString(&context, many), expected);
+}
+
+TEST(AnnotationImportTest, Failures) {
+  MLIRContext context;
+  const char *inputs[] = {
+      R"({"a":"a"})",          R"([{"a":"a"},[{"b":"b"}]])",
+      R"([{"a":"a"},])",        R"([{"a":1}]x)",
+      R"([{"a":"unterminated}])", R"([{}{}])",
+      R"([{"a":1,"a":2}])",
+  };
+  for (const char *input : inputs) {
+    SmallVector<Attribute> annotations;
+    EXPECT_FALSE(importAnnotationsFromJSONString(input, annotations, &context))
+        << input;
+    EXPECT_TRUE(annotations.empty());
+  }
+}
+
+} // namespace
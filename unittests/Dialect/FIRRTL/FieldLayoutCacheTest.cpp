@@ -0,0 +1,106 @@
+//===- FieldLayoutCacheTest.cpp - FIRRTL field layout cache tests ---------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/FIRRTL/FieldLayoutCache.h"
+#include "circt/Dialect/FIRRTL/FIRRTLDialect.h"
+#include "circt/Dialect/FIRRTL/FIRRTLTypes.h"
+#include "mlir/IR/Builders.h"
+#include "gtest/gtest.h"
+
+#include <thread>
+
+using namespace mlir;
+using namespace circt;
+using namespace firrtl;
+
+namespace {
+
+class FieldLayoutCacheTest : public ::testing::Test {
+protected:
+  void SetUp() override { context.loadDialect<FIRRTLDialect>(); }
+
+  MLIRContext context;
+  FieldLayoutCache layouts;
+};
+
+TEST_F(FieldLayoutCacheTest, Bundle) {
+  auto uint = UIntType::get(&context, 8);
+  auto vector = FVectorType::get(uint, 2);
+  auto bundle = BundleType::get(
+      &context, {{StringAttr::get(&context, "a"), false, uint},
+                 {StringAttr::get(&context, "b"), true, vector}});
+
+  auto fields = layouts.getFields(bundle);
+  ASSERT_EQ(fields.size(), 2u);
+  EXPECT_EQ(fields[0].type, uint);
+  EXPECT_EQ(fields[0].index, 0u);
+  EXPECT_EQ(fields[0].fieldID, 1u);
+  EXPECT_EQ(fields[0].suffix, "_a");
+  EXPECT_FALSE(fields[0].isFlip);
+  EXPECT_EQ(fields[1].type, vector);
+  EXPECT_EQ(fields[1].index, 1u);
+  EXPECT_EQ(fields[1].fieldID, 2u);
+  EXPECT_EQ(fields[1].suffix, "_b");
+  EXPECT_TRUE(fields[1].isFlip);
+
+  // The fields are only computed once.
+  EXPECT_EQ(layouts.getFields(bundle).data(), fields.data());
+}
+
+TEST_F(FieldLayoutCacheTest, Vector) {
+  auto uint = UIntType::get(&context, 8);
+  auto fields = layouts.getFields(FVectorType::get(uint, 3));
+  ASSERT_EQ(fields.size(), 3u);
+  for (auto [i, field] : llvm::enumerate(fields)) {
+    EXPECT_EQ(field.type, uint);
+    EXPECT_EQ(field.index, i);
+    EXPECT_EQ(field.fieldID, i + 1);
+    EXPECT_EQ(field.suffix, "_" + std::to_string(i));
+    EXPECT_FALSE(field.isFlip);
+  }
+}
+
+TEST_F(FieldLayoutCacheTest, Ground) {
+  EXPECT_TRUE(layouts.getFields(UIntType::get(&context, 8)).empty());
+}
+
+TEST_F(FieldLayoutCacheTest, Threads) {
+  // Several threads race to look up the same types, each in a different
+  // order, and must all end up with the one layout the cache keeps per type.
+  auto uint = UIntType::get(&context, 1);
+  auto vector = FVectorType::get(uint, 64);
+  auto bundle = BundleType::get(
+      &context, {{StringAttr::get(&context, "a"), false, uint},
+                 {StringAttr::get(&context, "b"), true, vector}});
+  auto nested = FVectorType::get(bundle, 16);
+  SmallVector<FIRRTLBaseType> types = {vector, bundle, nested};
+
+  constexpr size_t numThreads = 8;
+  SmallVector<SmallVector<const FieldLayoutEntry *>> results(
+      numThreads, SmallVector<const FieldLayoutEntry *>(types.size()));
+  SmallVector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; ++t)
+    threads.emplace_back([&, t] {
+      for (size_t i = 0; i < types.size(); ++i) {
+        size_t type = (t + i) % types.size();
+        results[t][type] = layouts.getFields(types[type]).data();
+      }
+    });
+  for (auto &thread : threads)
+    thread.join();
+
+  for (size_t type = 0; type < types.size(); ++type) {
+    auto fields = layouts.getFields(types[type]);
+    ASSERT_FALSE(fields.empty());
+    for (size_t t = 0; t < numThreads; ++t)
+      EXPECT_EQ(results[t][type], fields.data())
+          << "type " << type << ", thread " << t;
+  }
+}
+
+} // namespace
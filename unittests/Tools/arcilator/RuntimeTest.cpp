@@ -0,0 +1,304 @@
+//===- RuntimeTest.cpp - arcilator runtime header unit tests --------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "arcilator-runtime.h"
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+namespace {
+
+//===----------------------------------------------------------------------===//
+// EvalWorkerPool
+//===----------------------------------------------------------------------===//
+
+constexpr unsigned numPartitions = 4;
+
+struct PartitionCounts {
+  std::atomic<unsigned> counts[numPartitions] = {};
+};
+
+template <unsigned I>
+void countPartition(void *state) {
+  static_cast<PartitionCounts *>(state)->counts[I].fetch_add(1);
+  // Give the other threads a chance to pick up partitions as well.
+  std::this_thread::yield();
+}
+
+TEST(EvalWorkerPoolTest, EveryPartitionRunsOncePerPhase) {
+  const EvalWorkerPool::PartitionFn fns[] = {
+      countPartition<0>, countPartition<1>, countPartition<2>,
+      countPartition<3>};
+  EvalWorkerPool pool(4);
+
+  // Many short phases back to back give workers which wake up late plenty of
+  // chances to interfere with the next phase.
+  constexpr unsigned numPhases = 20000;
+  PartitionCounts counts;
+  for (unsigned phase = 0; phase < numPhases; ++phase) {
+    pool.runPhase(fns, numPartitions, &counts);
+    for (unsigned i = 0; i < numPartitions; ++i)
+      ASSERT_EQ(counts.counts[i].load(), phase + 1)
+          << "partition " << i << " in phase " << phase;
+  }
+}
+
+TEST(EvalWorkerPoolTest, AlternatingStates) {
+  const EvalWorkerPool::PartitionFn fns[] = {
+      countPartition<0>, countPartition<1>, countPartition<2>,
+      countPartition<3>};
+  EvalWorkerPool pool(3);
+
+  // A worker which runs a partition of one phase against the state of another
+  // shows up as a miscount in one of the two states.
+  PartitionCounts counts[2];
+  constexpr unsigned numPhases = 10000;
+  for (unsigned phase = 0; phase < numPhases; ++phase)
+    pool.runPhase(fns, numPartitions, &counts[phase % 2]);
+  for (auto &state : counts)
+    for (auto &count : state.counts)
+      EXPECT_EQ(count.load(), numPhases / 2);
+}
+
+//===----------------------------------------------------------------------===//
+// BinaryTraceWriter
+//===----------------------------------------------------------------------===//
+
+Signal testStates[] = {{"d", 16, 4, Signal::Register}};
+
+struct TestLayout {
+  static constexpr const char *name = "Test";
+  static constexpr unsigned numStateBytes = 24;
+  static constexpr uint64_t layoutHash = 0x1234;
+  static constexpr std::array<Signal, 3> io = {
+      Signal{"a", 0, 8, Signal::Input}, Signal{"b", 2, 16, Signal::Output},
+      Signal{"c", 6, 64, Signal::Register}};
+  static inline const Hierarchy hierarchy = {"top", 1, 0, testStates,
+                                             nullptr};
+};
+
+/// A cursor over the varints, strings and bytes of a trace.
+struct TraceCursor {
+  const std::string &data;
+  size_t pos = 0;
+
+  bool atEnd() const { return pos >= data.size(); }
+
+  uint64_t readVarInt() {
+    uint64_t value = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      uint8_t byte = data.at(pos++);
+      value |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+  }
+
+  std::string readBytes(size_t length) {
+    pos += length;
+    return data.substr(pos - length, length);
+  }
+
+  std::string readString() { return readBytes(readVarInt()); }
+};
+
+struct TraceStep {
+  size_t time;
+  std::vector<std::string> values;
+};
+
+/// Decompress one block of a trace.
+std::string decompressBlock(TraceCursor &cursor) {
+  std::string out;
+  while (true) {
+    out += cursor.readString();
+    size_t length = cursor.readVarInt();
+    if (length == 0)
+      return out;
+    size_t start = out.size() - cursor.readVarInt();
+    for (size_t i = 0; i < length; ++i)
+      out.push_back(out[start + i]);
+  }
+}
+
+/// Decode a trace written by `BinaryTraceWriter` into the names of the
+/// declared signals and the values of all signals after each recorded
+/// timestep.
+void readTrace(const std::string &trace, std::vector<std::string> &names,
+               std::vector<TraceStep> &steps) {
+  TraceCursor cursor{trace};
+  ASSERT_EQ(cursor.readBytes(8), "ARCTRACE");
+  ASSERT_EQ(cursor.readVarInt(), 1u);
+
+  std::vector<unsigned> numBytes;
+  while (uint8_t record = cursor.data.at(cursor.pos++)) {
+    if (record == 1) {
+      cursor.readString();
+    } else if (record == 3) {
+      cursor.readVarInt();
+      numBytes.push_back((cursor.readVarInt() + 7) / 8);
+      names.push_back(cursor.readString());
+    } else {
+      ASSERT_EQ(record, 2);
+    }
+  }
+
+  std::vector<std::string> values(numBytes.size());
+  size_t time = 0;
+  while (!cursor.atEnd()) {
+    size_t rawSize = cursor.readVarInt();
+    size_t end = cursor.readVarInt() + cursor.pos;
+    std::string block = decompressBlock(cursor);
+    ASSERT_EQ(cursor.pos, end);
+    ASSERT_EQ(block.size(), rawSize);
+
+    TraceCursor blockCursor{block};
+    while (!blockCursor.atEnd()) {
+      time += blockCursor.readVarInt();
+      for (size_t n = blockCursor.readVarInt(); n > 0; --n) {
+        size_t index = blockCursor.readVarInt();
+        ASSERT_LT(index, values.size());
+        values[index] = blockCursor.readBytes(numBytes[index]);
+      }
+      steps.push_back({time, values});
+    }
+  }
+}
+
+TEST(BinaryTraceWriterTest, RoundTrip) {
+  std::vector<uint8_t> state(TestLayout::numStateBytes, 0);
+  auto getValues = [&] {
+    std::vector<std::string> values;
+    for (auto [offset, numBytes] :
+         {std::pair{0, 1}, {2, 2}, {6, 8}, {16, 1}})
+      values.emplace_back(reinterpret_cast<char *>(&state[offset]), numBytes);
+    return values;
+  };
+
+  std::ostringstream os;
+  std::vector<TraceStep> expected;
+  {
+    // A small block size spreads the trace over many blocks.
+    BinaryTraceWriter<TestLayout> writer(os, state.data(), 64);
+    writer.writeHeader();
+    writer.writeDumpvars();
+    expected.push_back({0, getValues()});
+    for (size_t time = 1; time <= 500; ++time) {
+      // Leave some timesteps without changes, and change the signal spanning
+      // two words only now and then.
+      if (time % 3 != 0)
+        state[0] = time;
+      if (time % 5 == 0)
+        state[3] ^= 0x80;
+      if (time % 7 == 0)
+        state[time % 8 + 6] += 1;
+      if (time % 11 == 0)
+        state[16] = (state[16] + 1) & 0xf;
+      auto values = getValues();
+      writer.writeTimestep(1);
+      if (values != expected.back().values)
+        expected.push_back({time, values});
+    }
+  }
+
+  std::vector<std::string> names;
+  std::vector<TraceStep> steps;
+  readTrace(os.str(), names, steps);
+  EXPECT_EQ(names, (std::vector<std::string>{"a", "b", "c", "d"}));
+  ASSERT_EQ(steps.size(), expected.size());
+  for (size_t i = 0; i < steps.size(); ++i) {
+    EXPECT_EQ(steps[i].time, expected[i].time) << "step " << i;
+    EXPECT_EQ(steps[i].values, expected[i].values) << "step " << i;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// StateSnapshot
+//===----------------------------------------------------------------------===//
+
+#ifdef ARCILATOR_HAS_POSIX_IO
+struct OtherLayout : TestLayout {
+  static constexpr uint64_t layoutHash = 0x5678;
+};
+
+TEST(StateSnapshotTest, SaveAndRestore) {
+  std::string path =
+      ::testing::TempDir() + "arcilator-snapshot-" + std::to_string(getpid());
+  std::vector<uint8_t> state(TestLayout::numStateBytes);
+  for (size_t i = 0; i < state.size(); ++i)
+    state[i] = i * 7 + 1;
+
+  // Concurrent saves of the same snapshot each use their own temporary file.
+  std::vector<std::thread> savers;
+  for (unsigned i = 0; i < 4; ++i)
+    savers.emplace_back(
+        [&] { StateSnapshot::save<TestLayout>(path.c_str(), state.data()); });
+  for (auto &saver : savers)
+    saver.join();
+
+  std::vector<uint8_t> restored(TestLayout::numStateBytes, 0);
+  StateSnapshot::restore<TestLayout>(path.c_str(), restored.data());
+  EXPECT_EQ(restored, state);
+
+  std::vector<uint8_t> untouched(TestLayout::numStateBytes, 0);
+  EXPECT_THROW(
+      StateSnapshot::restore<OtherLayout>(path.c_str(), untouched.data()),
+      std::runtime_error);
+  ASSERT_EQ(::truncate(path.c_str(), StateSnapshot::dataOffset + 4), 0);
+  EXPECT_THROW(
+      StateSnapshot::restore<TestLayout>(path.c_str(), untouched.data()),
+      std::runtime_error);
+  EXPECT_EQ(untouched, std::vector<uint8_t>(TestLayout::numStateBytes, 0));
+  std::remove(path.c_str());
+}
+
+TEST(StateSnapshotTest, Mapping) {
+  std::string path = ::testing::TempDir() + "arcilator-snapshot-map-" +
+                     std::to_string(getpid());
+  std::vector<uint8_t> state(TestLayout::numStateBytes);
+  for (size_t i = 0; i < state.size(); ++i)
+    state[i] = i * 5 + 3;
+  StateSnapshot::save<TestLayout>(path.c_str(), state.data());
+
+  {
+    auto first = StateSnapshot::Mapping::open<TestLayout>(path.c_str());
+    auto second = StateSnapshot::Mapping::open<TestLayout>(path.c_str());
+    EXPECT_TRUE(std::equal(state.begin(), state.end(), first.getState()));
+    // Writes are private to each mapping and don't reach the snapshot.
+    first.getState()[0] ^= 0xff;
+    EXPECT_EQ(second.getState()[0], state[0]);
+    auto moved = std::move(first);
+    EXPECT_EQ(moved.getState()[0], state[0] ^ 0xff);
+  }
+  std::vector<uint8_t> restored(TestLayout::numStateBytes, 0);
+  StateSnapshot::restore<TestLayout>(path.c_str(), restored.data());
+  EXPECT_EQ(restored, state);
+
+  EXPECT_THROW(StateSnapshot::Mapping::open<OtherLayout>(path.c_str()),
+               std::runtime_error);
+  ASSERT_EQ(::truncate(path.c_str(), StateSnapshot::dataOffset + 4), 0);
+  EXPECT_THROW(StateSnapshot::Mapping::open<TestLayout>(path.c_str()),
+               std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(StateSnapshotTest, SaveHonorsUmask) {
+  std::string path = ::testing::TempDir() + "arcilator-snapshot-umask-" +
+                     std::to_string(getpid());
+  std::vector<uint8_t> state(TestLayout::numStateBytes, 0);
+  mode_t oldMask = ::umask(027);
+  StateSnapshot::save<TestLayout>(path.c_str(), state.data());
+  ::umask(oldMask);
+  struct stat fileStat;
+  ASSERT_EQ(::stat(path.c_str(), &fileStat), 0);
+  EXPECT_EQ(fileStat.st_mode & 0777, 0640u);
+  std::remove(path.c_str());
+}
+#endif // ARCILATOR_HAS_POSIX_IO
+
+} // namespace